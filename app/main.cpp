@@ -1,86 +1,63 @@
 #include "BinanceHandler.h"
 #include "rapidjson/document.h"
 #include "spdlog/spdlog.h"
-#include "spdlog/sinks/basic_file_sink.h"
+#include "Logging.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <chrono>
+#include <future>
 #include <thread>
+#include <vector>
 
 std::shared_ptr<spdlog::logger> logger;
 
-// Function to read the logging level from the config file using RapidJSON
-std::string readLoggingLevel(const std::string &configFile)
+// Reads the "logging" settings from the config file using RapidJSON; a missing or unparsable file keeps
+// the defaults and is reported once the rest of the config is read
+bool readLoggingConfig(const std::string &configFile, LoggingOptions &options, std::string &error)
 {
-	std::ifstream file(configFile);
-	if (!file.is_open())
+	MappedFile file;
+	if (!file.open(configFile))
 	{
-		logger->error("Error opening config file.");
-		return "error";
+		return true;
 	}
 
-	std::ostringstream configContents;
-	configContents << file.rdbuf();
-	file.close();
-
 	rapidjson::Document document;
-	document.Parse(configContents.str().c_str());
-
-	if (!document.HasParseError() && document.HasMember("logging") && document["logging"].HasMember("level"))
+	document.Parse(file.data());
+	if (document.HasParseError())
 	{
-		return document["logging"]["level"].GetString();
+		return true;
 	}
-
-	return "error";
+	return readLoggingOptions(document, options, error);
 }
 
 int main()
 {
-	if (!logger)
+	// Set up logging from config.json before anything is logged
+	LoggingOptions loggingOptions;
+	std::string loggingError;
+	if (!readLoggingConfig("config.json", loggingOptions, loggingError))
 	{
-		spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] [thread %t] %v");
-		logger = spdlog::basic_logger_mt("binance_logger", "logs/binance_exchange_logs.log");
-		spdlog::flush_on(spdlog::level::info);
+		std::cout << "Error reading logging config: " << loggingError << std::endl;
+		return EXIT_FAILURE;
 	}
-
-	// Usage of the global logger in main...
-	logger->info("Main function started.");
-	// Initialize the logger
+	logger = createLogger("binance_logger", loggingOptions);
 	spdlog::set_default_logger(logger);
 
-	// Read logging level from config.json
-	std::string logLevel = readLoggingLevel("config.json");
+	logger->info("Main function started.");
+	logger->info("Logging level set to: {}", spdlog::level::to_string_view(loggingOptions.level));
 
-	// Set the logging level based on the configuration
-	if (logLevel == "error" || logLevel == "info" || logLevel == "warn" || logLevel == "trace" || logLevel == "fatal")
-	{
-		spdlog::set_level(spdlog::level::from_str(logLevel));
-		logger->info("Logging level set to: {}", logLevel);
-	}
-	else
-	{
-		std::cout << "Error reading log level from config." << std::endl;
-		return EXIT_FAILURE; // set default logging level
-	}
 	try
 	{
 		// Read URL from config.json
-		std::ifstream configFile("config.json");
-		if (!configFile.is_open())
+		MappedFile configFile;
+		if (!configFile.open("config.json"))
 		{
 			logger->error("Error opening config file.");
 			return EXIT_FAILURE;
 		}
 
-		// Read the entire contents of the config file into a string
-		std::ostringstream configContents;
-		configContents << configFile.rdbuf();
-		configFile.close();
-
 		// Parse JSON using RapidJSON
 		rapidjson::Document configDocument;
-		configDocument.Parse(configContents.str().c_str());
+		configDocument.Parse(configFile.data());
 
 		// Check if parsing succeeded
 		if (configDocument.HasParseError())
@@ -89,67 +66,233 @@ int main()
 			return EXIT_FAILURE;
 		}
 
-		// Check for the presence of the "exchange_info_url" key
-		if (configDocument.HasMember("exchange_info_url") && configDocument["exchange_info_url"].IsString())
+		// Optional "metrics": {"port", "address", "log_interval"}; with a port, Prometheus text is served on /metrics
+		MetricsOptions metricsOptions;
+		if (configDocument.HasMember("metrics") && configDocument["metrics"].IsObject())
+		{
+			const rapidjson::Value &metricsConfig = configDocument["metrics"];
+			if (metricsConfig.HasMember("port") && metricsConfig["port"].IsUint() && metricsConfig["port"].GetUint() <= 65535)
+			{
+				metricsOptions.listen = true;
+				metricsOptions.port = static_cast<unsigned short>(metricsConfig["port"].GetUint());
+			}
+			if (metricsConfig.HasMember("address") && metricsConfig["address"].IsString())
+			{
+				metricsOptions.address = metricsConfig["address"].GetString();
+			}
+			if (metricsConfig.HasMember("log_interval") && metricsConfig["log_interval"].IsUint())
+			{
+				metricsOptions.logInterval = std::chrono::seconds(metricsConfig["log_interval"].GetUint());
+			}
+		}
+		MetricsExporter metricsExporter(metricsOptions);
+
+		// "exchange_info_urls": [{"market": "spot", "url": ...}, ...] fetches several markets side by side;
+		// the single "exchange_info_url" is the spot market on its own
+		std::vector<MarketEndpoint> endpoints;
+		if (configDocument.HasMember("exchange_info_urls") && configDocument["exchange_info_urls"].IsArray())
+		{
+			const rapidjson::Value &urls = configDocument["exchange_info_urls"];
+			for (rapidjson::SizeType i = 0; i < urls.Size(); ++i)
+			{
+				const rapidjson::Value &entry = urls[i];
+				MarketEndpoint endpoint;
+				if (!entry.IsObject() || !entry.HasMember("market") || !entry["market"].IsString() || !entry.HasMember("url") || !entry["url"].IsString() ||
+					!parseEndpointUrl(entry["url"].GetString(), endpoint))
+				{
+					logger->error("Invalid entry in 'exchange_info_urls', each needs a 'market' name and an https 'url'.");
+					return EXIT_FAILURE;
+				}
+				endpoint.market = entry["market"].GetString();
+				endpoints.push_back(endpoint);
+			}
+		}
+		else if (configDocument.HasMember("exchange_info_url") && configDocument["exchange_info_url"].IsString())
 		{
 			std::string apiUrl = configDocument["exchange_info_url"].GetString();
+			MarketEndpoint endpoint;
+			if (!parseEndpointUrl(apiUrl, endpoint))
+			{
+				logger->error("Invalid URL format: {}", apiUrl);
+				return EXIT_FAILURE;
+			}
+			endpoint.market = "spot";
+			endpoints.push_back(endpoint);
+		}
+		if (endpoints.empty())
+		{
+			logger->error("Missing or invalid 'exchange_info_url' or 'exchange_info_urls' in config file.");
+			return EXIT_FAILURE;
+		}
+
+		int version = 11; // HTTP version 1.1
+		// Seconds between exchangeInfo refreshes, 0 fetches only once
+		std::chrono::seconds refreshInterval(0);
+		if (configDocument.HasMember("request_interval") && configDocument["request_interval"].IsUint())
+		{
+			refreshInterval = std::chrono::seconds(configDocument["request_interval"].GetUint());
+		}
+
+		logger->info("Calling PerformAPI.");
+		// Create an object of JSONParser
+		JSONParser jsonParser;
 
-			// Extract host and target from the URL
-			std::string protocolDelimiter = "://";
-			size_t posProtocol = apiUrl.find(protocolDelimiter);
-			if (posProtocol != std::string::npos)
+		// Optional "shared_memory": POSIX shared-memory segment other processes on this host read the symbol
+		// table from (SharedSymbolTable.h), sized for "shared_memory_capacity" symbols
+		if (configDocument.HasMember("shared_memory") && configDocument["shared_memory"].IsString())
+		{
+			uint32_t capacity = 16384;
+			if (configDocument.HasMember("shared_memory_capacity") && configDocument["shared_memory_capacity"].IsUint())
 			{
-				posProtocol += protocolDelimiter.length();
+				capacity = configDocument["shared_memory_capacity"].GetUint();
+			}
+			jsonParser.setSharedMemory(configDocument["shared_memory"].GetString(), capacity);
+		}
 
-				size_t posPath = apiUrl.find('/', posProtocol);
-				if (posPath != std::string::npos)
+		// Optional "snapshot_file": the exchange data is saved there in the background, at most once a second
+		// while it changes, and loaded at startup, so queries are answered before the first fetch completes,
+		// or without the network at all
+		bool warmStart = false;
+		if (configDocument.HasMember("snapshot_file") && configDocument["snapshot_file"].IsString())
+		{
+			std::string snapshotFile = configDocument["snapshot_file"].GetString();
+			for (const MarketEndpoint &endpoint : endpoints)
+			{
+				jsonParser.addMarket(endpoint.market);
+			}
+			warmStart = jsonParser.loadSnapshot(snapshotFile);
+			jsonParser.setSnapshotFile(snapshotFile);
+		}
+
+		// The first fetch of every market runs concurrently here, later ones on each refresher's own thread.
+		// After a warm start it runs in the background and merges into the snapshot's table.
+		MarketFetcher marketFetcher(jsonParser);
+		std::future<std::size_t> initialFetch;
+		if (warmStart)
+		{
+			initialFetch = std::async(std::launch::async, [&marketFetcher, &endpoints, version]
+									  { return marketFetcher.fetchAll(endpoints, version); });
+		}
+		else
+		{
+			marketFetcher.fetchAll(endpoints, version);
+			logger->info("Response received.");
+		}
+		std::vector<std::unique_ptr<ExchangeInfoRefresher>> refreshers;
+		for (const MarketEndpoint &endpoint : endpoints)
+		{
+			MarketId market = jsonParser.addMarket(endpoint.market);
+			refreshers.push_back(std::make_unique<ExchangeInfoRefresher>(jsonParser, endpoint.host, endpoint.port, endpoint.target, version, refreshInterval, market));
+			refreshers.back()->start();
+		}
+
+		// Optional "market_streams": [{"market": "usdm", "url": "wss://fstream.binance.com/stream", "streams":
+		// ["!contractInfo"]}, ...] applies exchange changes as they happen; a gap or reconnect refreshes that
+		// market's exchangeInfo right away
+		std::vector<std::unique_ptr<MarketStream>> marketStreams;
+		if (configDocument.HasMember("market_streams") && configDocument["market_streams"].IsArray())
+		{
+			const rapidjson::Value &streams = configDocument["market_streams"];
+			for (rapidjson::SizeType i = 0; i < streams.Size(); ++i)
+			{
+				const rapidjson::Value &entry = streams[i];
+				MarketEndpoint endpoint;
+				std::size_t endpointIndex = endpoints.size();
+				if (entry.IsObject() && entry.HasMember("market") && entry["market"].IsString())
 				{
-					std::string host = apiUrl.substr(posProtocol, posPath - posProtocol);
-					logger->info(host);
-					std::string target = apiUrl.substr(posPath);
-					logger->info(target);
-
-					// Hard-coded values for demonstration purposes
-					std::string port = "443";
-					int version = 11; // HTTP version 1.1
-					logger->info("Calling PerformAPI.");
-					// Create an object of HTTPRequests
-					HTTPRequest binanceRequest;
-
-					// Call performBinanceAPIRequest with the parsed URL
-					std::string response = binanceRequest.performBinanceAPIRequest(host, port, target, version);
-					logger->info("Response received.");
-					// Create an object of JSONParser
-					JSONParser jsonParser;
-
-					// Call performJSONDataParsing with the response
-					jsonParser.performJSONDataParsing(response);
-					QueryHandler queryHandler;
-					while (true)
+					for (std::size_t j = 0; j < endpoints.size(); ++j)
 					{
-						// Read the queries from query.json
-						queryHandler.handleQueries("query.json", jsonParser);
-
-						// Sleep for a certain interval before checking again (e.g., every 1 second)
-						std::this_thread::sleep_for(std::chrono::seconds(1));
+						endpointIndex = endpoints[j].market == entry["market"].GetString() ? j : endpointIndex;
 					}
 				}
-				else
+				if (endpointIndex == endpoints.size() || !entry.HasMember("url") || !entry["url"].IsString() || !parseEndpointUrl(entry["url"].GetString(), endpoint))
 				{
-					logger->error("Invalid URL format: {}", apiUrl);
+					logger->error("Invalid entry in 'market_streams', each needs the 'market' of an exchangeInfo URL and a wss 'url'.");
 					return EXIT_FAILURE;
 				}
+				MarketStreamOptions streamOptions;
+				streamOptions.host = endpoint.host;
+				streamOptions.port = endpoint.port;
+				streamOptions.target = endpoint.target;
+				if (entry.HasMember("streams") && entry["streams"].IsArray())
+				{
+					const rapidjson::Value &names = entry["streams"];
+					for (rapidjson::SizeType k = 0; k < names.Size(); ++k)
+					{
+						if (names[k].IsString())
+						{
+							streamOptions.streams.push_back(names[k].GetString());
+						}
+					}
+				}
+				MarketId market = jsonParser.addMarket(endpoints[endpointIndex].market);
+				marketStreams.push_back(std::make_unique<MarketStream>(jsonParser, streamOptions, market));
+				marketStreams.back()->setResyncHandler([refresher = refreshers[endpointIndex].get()](MarketId)
+													   { refresher->requestRefresh(); });
+				marketStreams.back()->start();
 			}
-			else
+		}
+
+		// Optional "answers": {"file", "format": "ndjson"|"array", "flush_bytes", "flush_interval_ms", "background_flush"}
+		AnswerWriter::Options answerOptions;
+		if (configDocument.HasMember("answers") && configDocument["answers"].IsObject())
+		{
+			const rapidjson::Value &answers = configDocument["answers"];
+			if (answers.HasMember("file") && answers["file"].IsString())
 			{
-				logger->error("Invalid URL format: {}", apiUrl);
-				return EXIT_FAILURE;
+				answerOptions.path = answers["file"].GetString();
+			}
+			if (answers.HasMember("format") && (!answers["format"].IsString() || !AnswerWriter::parseFormat(answers["format"].GetString(), answerOptions.format)))
+			{
+				logger->error("Invalid 'answers.format' in config file, using ndjson.");
+			}
+			if (answers.HasMember("flush_bytes") && answers["flush_bytes"].IsUint())
+			{
+				answerOptions.flushBytes = answers["flush_bytes"].GetUint();
+			}
+			if (answers.HasMember("flush_interval_ms") && answers["flush_interval_ms"].IsUint())
+			{
+				answerOptions.flushInterval = std::chrono::milliseconds(answers["flush_interval_ms"].GetUint());
+			}
+			if (answers.HasMember("background_flush") && answers["background_flush"].IsBool())
+			{
+				answerOptions.backgroundFlush = answers["background_flush"].GetBool();
 			}
 		}
-		else
+		// Optional "query_threads": threads running each batch of new queries; 0 and 1 run them on this thread
+		std::size_t queryThreads = 1;
+		if (configDocument.HasMember("query_threads") && configDocument["query_threads"].IsUint())
 		{
-			logger->error("Missing or invalid 'exchange_info_url' in config file.");
-			return EXIT_FAILURE;
+			queryThreads = configDocument["query_threads"].GetUint();
+		}
+		QueryHandler queryHandler(answerOptions, queryThreads);
+
+		// Optional "query_socket": Unix socket taking binary queries (see QueryProtocol.h) alongside the query file
+		std::unique_ptr<QueryServer> queryServer;
+		if (configDocument.HasMember("query_socket") && configDocument["query_socket"].IsString())
+		{
+			queryServer = std::make_unique<QueryServer>(jsonParser, configDocument["query_socket"].GetString());
+		}
+
+		// With "query_log" set, queries are appended one per line and only new lines are read
+		bool logMode = configDocument.HasMember("query_log") && configDocument["query_log"].IsString();
+		std::string queryFile = logMode ? configDocument["query_log"].GetString() : "query.json";
+		QueryFileWatcher queryWatcher(queryFile);
+		while (true)
+		{
+			if (logMode)
+			{
+				queryHandler.handleQueryLog(queryFile, jsonParser);
+			}
+			else
+			{
+				queryHandler.handleQueries(queryFile, jsonParser);
+			}
+			// Answers of this pass reach the file now, not when the next query arrives
+			queryHandler.getAnswerWriter().flush();
+
+			// Wake as soon as the file is written, re-check at least once a second
+			queryWatcher.waitForChange(std::chrono::seconds(1));
 		}
 	}
 	catch (std::exception const &e)
@@ -0,0 +1,1029 @@
+#include "benchmark/benchmark.h"
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/null_sink.h"
+#include "BinanceHandler.h"
+#include "JsonScanner.h"
+#include "OrderBook.h"
+#include "OrderNormalizer.h"
+#include "SharedSymbolTable.h"
+#include "rapidjson/document.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <malloc.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+std::shared_ptr<spdlog::logger> logger = spdlog::null_logger_mt("bench");
+
+namespace
+{
+	// Synthetic exchangeInfo shaped like the spot payload: every symbol carries the usual
+	// arrays and seven filters, so the parser has the same amount of irrelevant data to skip.
+	// Statuses, quote assets and filter precisions rotate deterministically the way they are
+	// spread over a recorded response, so every run and every commit parses the same bytes.
+	std::string makeExchangeInfo(int symbols)
+	{
+		static const char *const kStatuses[] = {"TRADING", "TRADING", "TRADING", "TRADING", "TRADING", "TRADING", "TRADING", "BREAK", "TRADING", "HALT"};
+		static const char *const kQuotes[] = {"USDT", "USDT", "BTC", "USDT", "FDUSD", "ETH", "USDT", "BNB", "TRY", "USDC", "EUR", "USDT"};
+		static const char *const kTicks[] = {"0.01000000", "0.00010000", "0.00000100", "0.10000000", "0.00000001", "1.00000000"};
+		static const char *const kSteps[] = {"0.00001000", "0.00100000", "1.00000000", "0.10000000", "0.01000000"};
+		std::string json = R"({"timezone":"UTC","serverTime":1700000000000,"rateLimits":[)"
+						   R"({"rateLimitType":"REQUEST_WEIGHT","interval":"MINUTE","intervalNum":1,"limit":6000},)"
+						   R"({"rateLimitType":"ORDERS","interval":"SECOND","intervalNum":10,"limit":100}],)"
+						   R"("exchangeFilters":[],"symbols":[)";
+		for (int i = 0; i < symbols; ++i)
+		{
+			std::string name = "SYM" + std::to_string(i);
+			json += i ? "," : "";
+			json += R"({"symbol":")" + name + R"(USDT","status":")" + kStatuses[i % 10] + R"(","baseAsset":")" + name +
+					R"(","baseAssetPrecision":8,"quoteAsset":")" + kQuotes[i % 12] + R"(","quotePrecision":8,"quoteAssetPrecision":8,)"
+					R"("baseCommissionPrecision":8,"quoteCommissionPrecision":8,)"
+					R"("orderTypes":["LIMIT","LIMIT_MAKER","MARKET","STOP_LOSS_LIMIT","TAKE_PROFIT_LIMIT"],)"
+					R"("icebergAllowed":true,"ocoAllowed":true,"quoteOrderQtyMarketAllowed":true,"allowTrailingStop":true,)"
+					R"("cancelReplaceAllowed":true,"isSpotTradingAllowed":true,"isMarginTradingAllowed":false,"filters":[)"
+					R"({"filterType":"PRICE_FILTER","minPrice":"0.01000000","maxPrice":"1000000.00000000","tickSize":")" + kTicks[i % 6] + R"("},)"
+					R"({"filterType":"LOT_SIZE","minQty":"0.00001000","maxQty":"9000.00000000","stepSize":")" + kSteps[i % 5] + R"("},)"
+					R"({"filterType":"ICEBERG_PARTS","limit":10},)"
+					R"({"filterType":"MARKET_LOT_SIZE","minQty":"0.00000000","maxQty":"115.12345678","stepSize":"0.00000000"},)"
+					R"({"filterType":"TRAILING_DELTA","minTrailingAboveDelta":10,"maxTrailingAboveDelta":2000,"minTrailingBelowDelta":10,"maxTrailingBelowDelta":2000},)"
+					R"({"filterType":"PERCENT_PRICE_BY_SIDE","bidMultiplierUp":"5","bidMultiplierDown":"0.2","askMultiplierUp":"5","askMultiplierDown":"0.2","avgPriceMins":5},)"
+					R"({"filterType":"NOTIONAL","minNotional":"5.00000000","applyMinToMarket":true,"maxNotional":"9000000.00000000","applyMaxToMarket":false,"avgPriceMins":5}],)"
+					R"("permissions":[],"permissionSets":[["SPOT","MARGIN","TRD_GRP_004","TRD_GRP_005"]],)"
+					R"("defaultSelfTradePreventionMode":"EXPIRE_MAKER","allowedSelfTradePreventionModes":["EXPIRE_TAKER","EXPIRE_MAKER","EXPIRE_BOTH"]})";
+		}
+		json += "]}";
+		return json;
+	}
+
+	// exchangeInfo fixture with the given number of symbols, built once per run. When
+	// BINANCE_BENCH_FIXTURES names a directory holding exchangeInfo_<symbols>.json (a recorded
+	// response), that file is used instead of the generated payload.
+	const std::string &exchangeInfoFixture(int symbols)
+	{
+		static std::map<int, std::string> fixtures;
+		auto it = fixtures.find(symbols);
+		if (it != fixtures.end())
+		{
+			return it->second;
+		}
+
+		std::string json;
+		if (const char *directory = std::getenv("BINANCE_BENCH_FIXTURES"))
+		{
+			std::ifstream file(std::string(directory) + "/exchangeInfo_" + std::to_string(symbols) + ".json");
+			std::ostringstream contents;
+			contents << file.rdbuf();
+			json = contents.str();
+		}
+		if (json.empty())
+		{
+			json = makeExchangeInfo(symbols);
+		}
+		return fixtures.emplace(symbols, std::move(json)).first->second;
+	}
+
+	std::string fixtureSymbol(int index, int symbols)
+	{
+		return "SYM" + std::to_string(index % symbols) + "USDT";
+	}
+
+	// The previous implementation: full DOM, then HasMember walks over symbols[i].filters[j]
+	void parseWithDocument(const std::string &jsonResponse, SymbolTable &symbolTable)
+	{
+		rapidjson::Document document;
+		document.Parse(jsonResponse.c_str());
+		if (document.HasParseError() || !document.HasMember("symbols") || !document["symbols"].IsArray())
+		{
+			return;
+		}
+
+		const rapidjson::Value &symbolsArray = document["symbols"];
+		for (rapidjson::SizeType i = 0; i < symbolsArray.Size(); ++i)
+		{
+			const rapidjson::Value &symbolObject = symbolsArray[i];
+			if (!symbolObject.HasMember("symbol") || !symbolObject["symbol"].IsString())
+			{
+				continue;
+			}
+
+			std::string tickSize;
+			std::string stepSize;
+			if (symbolObject.HasMember("filters") && symbolObject["filters"].IsArray())
+			{
+				const rapidjson::Value &filtersArray = symbolObject["filters"];
+				for (rapidjson::SizeType j = 0; j < filtersArray.Size(); ++j)
+				{
+					const rapidjson::Value &filterObject = filtersArray[j];
+					if (filterObject.HasMember("filterType") && filterObject["filterType"].IsString())
+					{
+						std::string filterType = filterObject["filterType"].GetString();
+						if (filterType == "PRICE_FILTER" && filterObject.HasMember("tickSize") && filterObject["tickSize"].IsString())
+						{
+							tickSize = filterObject["tickSize"].GetString();
+						}
+						else if (filterType == "LOT_SIZE" && filterObject.HasMember("stepSize") && filterObject["stepSize"].IsString())
+						{
+							stepSize = filterObject["stepSize"].GetString();
+						}
+					}
+				}
+			}
+
+			FixedDecimal tickValue;
+			FixedDecimal stepValue;
+			FixedDecimal::parse(tickSize, tickValue);
+			FixedDecimal::parse(stepSize, stepValue);
+			SymbolTable::SymbolId id = symbolTable.insert(symbolObject["symbol"].GetString());
+			symbolTable.setStatus(id, symbolObject["status"].GetString());
+			symbolTable.setQuoteAsset(id, symbolObject["quoteAsset"].GetString());
+			symbolTable.setTickSize(id, tickValue);
+			symbolTable.setStepSize(id, stepValue);
+		}
+	}
+
+	// Reads "VmRSS" or "VmHWM" (peak resident set) from /proc/self/status, in kB
+	long statusFieldKb(const char *field)
+	{
+		long value = -1;
+		std::FILE *status = std::fopen("/proc/self/status", "r");
+		if (status)
+		{
+			char line[256];
+			std::size_t length = std::strlen(field);
+			while (std::fgets(line, sizeof(line), status))
+			{
+				if (std::strncmp(line, field, length) == 0 && line[length] == ':')
+				{
+					value = std::strtol(line + length + 1, nullptr, 10);
+					break;
+				}
+			}
+			std::fclose(status);
+		}
+		return value;
+	}
+
+	// Runs work once in a forked child and returns how far its resident set grew at the peak.
+	// Freed heap left over from earlier benchmarks is trimmed and the peak counter reset first,
+	// so each measurement only sees its own allocations (plus the pages of the input it touches).
+	template <typename Work>
+	long peakRssGrowthKb(const Work &work)
+	{
+		int fds[2];
+		if (pipe(fds) != 0)
+		{
+			return -1;
+		}
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			malloc_trim(0);
+			std::FILE *clearRefs = std::fopen("/proc/self/clear_refs", "w");
+			if (clearRefs)
+			{
+				std::fputs("5", clearRefs); // resets VmHWM to the current RSS
+				std::fclose(clearRefs);
+			}
+			long before = statusFieldKb("VmRSS");
+			work();
+			long growth = statusFieldKb("VmHWM") - before;
+			ssize_t written = write(fds[1], &growth, sizeof(growth));
+			_exit(written == sizeof(growth) ? 0 : 1);
+		}
+		close(fds[1]);
+		long growth = -1;
+		if (read(fds[0], &growth, sizeof(growth)) != sizeof(growth))
+		{
+			growth = -1;
+		}
+		close(fds[0]);
+		waitpid(pid, nullptr, 0);
+		return growth;
+	}
+
+	ChunkReader chunksOf(const std::string &body, std::size_t &offset)
+	{
+		return [&body, &offset](char *buffer, std::size_t size)
+		{
+			std::size_t count = std::min(size, body.size() - offset);
+			body.copy(buffer, count, offset);
+			offset += count;
+			return count;
+		};
+	}
+}
+
+static void BM_ExchangeInfoDOM(benchmark::State &state)
+{
+	const std::string &json = exchangeInfoFixture(static_cast<int>(state.range(0)));
+	for (auto _ : state)
+	{
+		SymbolTable symbolTable;
+		parseWithDocument(json, symbolTable);
+		benchmark::DoNotOptimize(symbolTable.size());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * json.size()));
+	state.counters["peak_rss_kb"] = static_cast<double>(peakRssGrowthKb([&]
+																		 { SymbolTable symbolTable; parseWithDocument(json, symbolTable); }));
+}
+BENCHMARK(BM_ExchangeInfoDOM)->ArgName("symbols")->Arg(1000)->Arg(3000)->Arg(30000)->Unit(benchmark::kMillisecond);
+
+// "scanner" 0 is rapidjson's SAX reader over every token, 1 is JsonScanner skipping what is not kept
+static void BM_ExchangeInfoSAX(benchmark::State &state)
+{
+	const std::string &json = exchangeInfoFixture(static_cast<int>(state.range(0)));
+	ExchangeInfoParser parser = state.range(1) ? ExchangeInfoParser::Scanner : ExchangeInfoParser::Reader;
+	for (auto _ : state)
+	{
+		JSONParser jsonParser;
+		jsonParser.setExchangeInfoParser(parser);
+		jsonParser.performJSONDataParsing(json);
+		benchmark::DoNotOptimize(jsonParser.snapshot()->size());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * json.size()));
+	state.SetLabel(state.range(1) ? scanBackendName(activeScanBackend()) : "reader");
+	state.counters["peak_rss_kb"] = static_cast<double>(peakRssGrowthKb([&]
+																		 { JSONParser jsonParser; jsonParser.setExchangeInfoParser(parser); jsonParser.performJSONDataParsing(json); }));
+}
+BENCHMARK(BM_ExchangeInfoSAX)->ArgNames({"symbols", "scanner"})->ArgsProduct({{1000, 3000, 30000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+// Same parsers fed 64 KB at a time, the way the body arrives from the socket
+static void BM_ExchangeInfoSAXStreamed(benchmark::State &state)
+{
+	const std::string &json = exchangeInfoFixture(static_cast<int>(state.range(0)));
+	ExchangeInfoParser parser = state.range(1) ? ExchangeInfoParser::Scanner : ExchangeInfoParser::Reader;
+	for (auto _ : state)
+	{
+		std::size_t offset = 0;
+		JSONParser jsonParser;
+		jsonParser.setExchangeInfoParser(parser);
+		jsonParser.performJSONDataParsing(chunksOf(json, offset));
+		benchmark::DoNotOptimize(jsonParser.snapshot()->size());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * json.size()));
+	state.SetLabel(state.range(1) ? scanBackendName(activeScanBackend()) : "reader");
+	state.counters["peak_rss_kb"] = static_cast<double>(peakRssGrowthKb([&]
+																		 { std::size_t offset = 0; JSONParser jsonParser; jsonParser.setExchangeInfoParser(parser); jsonParser.performJSONDataParsing(chunksOf(json, offset)); }));
+}
+BENCHMARK(BM_ExchangeInfoSAXStreamed)->ArgNames({"symbols", "scanner"})->ArgsProduct({{1000, 3000, 30000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+namespace
+{
+	// Keeps nothing: the reader still tokenizes every value, the scanner skips the whole document
+	struct NullScanHandler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, NullScanHandler>
+	{
+		bool skipping() const { return true; }
+	};
+}
+
+// Raw scanning speed, without the symbol table work both parsers share. "scanner" as above.
+static void BM_ExchangeInfoScan(benchmark::State &state)
+{
+	const std::string &json = exchangeInfoFixture(static_cast<int>(state.range(0)));
+	for (auto _ : state)
+	{
+		NullScanHandler handler;
+		bool parsed;
+		if (state.range(1))
+		{
+			JsonScanner scanner(json.data(), json.size());
+			parsed = scanner.parse(handler);
+		}
+		else
+		{
+			rapidjson::Reader reader;
+			rapidjson::StringStream stream(json.c_str());
+			parsed = !reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler).IsError();
+		}
+		benchmark::DoNotOptimize(parsed);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * json.size()));
+	state.SetLabel(state.range(1) ? scanBackendName(activeScanBackend()) : "reader");
+}
+BENCHMARK(BM_ExchangeInfoScan)->ArgNames({"symbols", "scanner"})->ArgsProduct({{3000, 30000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+namespace
+{
+	// Read-only parser per fixture size, shared by the GET benchmarks
+	JSONParser &answerBenchParser(int symbols)
+	{
+		static std::map<int, std::unique_ptr<JSONParser>> parsers;
+		std::unique_ptr<JSONParser> &jsonParser = parsers[symbols];
+		if (!jsonParser)
+		{
+			jsonParser = std::make_unique<JSONParser>();
+			jsonParser->performJSONDataParsing(exchangeInfoFixture(symbols));
+		}
+		return *jsonParser;
+	}
+
+	std::unique_ptr<JSONParser> loadedParser(int symbols)
+	{
+		auto jsonParser = std::make_unique<JSONParser>();
+		jsonParser->performJSONDataParsing(exchangeInfoFixture(symbols));
+		return jsonParser;
+	}
+
+	// Spread consecutive ids over the table instead of walking it in row order
+	int querySymbolIndex(int id, int symbols)
+	{
+		return static_cast<int>((static_cast<long long>(id) * 7919) % symbols);
+	}
+
+	rapidjson::Document makeQuery(int id, const char *queryType, int symbols)
+	{
+		rapidjson::Document query(rapidjson::kObjectType);
+		query.AddMember("id", id, query.GetAllocator());
+		query.AddMember("query_type", rapidjson::StringRef(queryType), query.GetAllocator());
+		query.AddMember("symbol", rapidjson::Value(fixtureSymbol(querySymbolIndex(id, symbols), symbols).c_str(), query.GetAllocator()).Move(), query.GetAllocator());
+		return query;
+	}
+
+	rapidjson::Document makeGetQuery(int id, int symbols = 3000)
+	{
+		return makeQuery(id, "GET", symbols);
+	}
+
+	rapidjson::Document makeUpdateQuery(int id, int symbols)
+	{
+		rapidjson::Document query = makeQuery(id, "UPDATE", symbols);
+		rapidjson::Value data(rapidjson::kObjectType);
+		data.AddMember("tickSize", id & 1 ? "0.05000000" : "0.01000000", query.GetAllocator());
+		data.AddMember("status", id & 2 ? "BREAK" : "TRADING", query.GetAllocator());
+		query.AddMember("data", data, query.GetAllocator());
+		return query;
+	}
+
+	rapidjson::Document makeDeleteQuery(int id, int symbols)
+	{
+		return makeQuery(id, "DELETE", symbols);
+	}
+
+	// Share of the GETs since the two counter readings that were answered from the answer cache
+	double cacheHitRatio(std::uint64_t hitsBefore, std::uint64_t missesBefore)
+	{
+		double hits = static_cast<double>(metrics().answerCacheHits - hitsBefore);
+		double misses = static_cast<double>(metrics().answerCacheMisses - missesBefore);
+		return hits + misses > 0 ? hits / (hits + misses) : 0.0;
+	}
+
+	// Query mixes for handleQueries, by share of GET / UPDATE / DELETE
+	enum QueryMix
+	{
+		GetOnly,	// 100 / 0 / 0
+		ReadHeavy,	// 90 / 5 / 5
+		WriteHeavy, // 50 / 25 / 25
+	};
+
+	// {"query": [...]} document as main reads it from query.json
+	std::string makeQueryFile(int queries, QueryMix mix, int symbols)
+	{
+		rapidjson::Document document(rapidjson::kObjectType);
+		rapidjson::Value array(rapidjson::kArrayType);
+		for (int id = 0; id < queries; ++id)
+		{
+			int slot = mix == ReadHeavy ? id % 20 : mix == WriteHeavy ? id % 4 : -1;
+			rapidjson::Document query = slot == 0 ? makeUpdateQuery(id, symbols) : slot == 1 ? makeDeleteQuery(id, symbols)
+																							   : makeGetQuery(id, symbols);
+			array.PushBack(rapidjson::Value(query, document.GetAllocator()), document.GetAllocator());
+		}
+		document.AddMember("query", array, document.GetAllocator());
+
+		rapidjson::StringBuffer buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		document.Accept(writer);
+		return std::string(buffer.GetString(), buffer.GetSize());
+	}
+}
+
+// The previous answer path: open answers.json, pretty-print one document, close, per GET
+static void BM_AnswerPerQueryOpen(benchmark::State &state)
+{
+	const char *answerFile = "bench_answers_open.json";
+	std::remove(answerFile);
+	rapidjson::Document answer(rapidjson::kObjectType);
+	answer.AddMember("status", "TRADING", answer.GetAllocator());
+	answer.AddMember("tickSize", "0.01000000", answer.GetAllocator());
+	answer.AddMember("stepSize", "0.00001000", answer.GetAllocator());
+	answer.AddMember("quoteAsset", "USDT", answer.GetAllocator());
+	for (auto _ : state)
+	{
+		std::ofstream outputFile(answerFile, std::ios::app);
+		rapidjson::OStreamWrapper osw(outputFile);
+		rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(osw);
+		answer.Accept(writer);
+		outputFile << "," << std::endl;
+	}
+	state.SetItemsProcessed(state.iterations());
+	std::remove(answerFile);
+}
+BENCHMARK(BM_AnswerPerQueryOpen);
+
+// Full GET path through QueryHandler with the batched AnswerWriter; items/s is queries/sec
+static void BM_GetQueriesBatchedAnswers(benchmark::State &state)
+{
+	const int symbols = static_cast<int>(state.range(0));
+	JSONParser &jsonParser = answerBenchParser(symbols);
+	AnswerWriter::Options options;
+	options.path = "bench_answers_batched.json";
+	options.backgroundFlush = state.range(1) != 0;
+	std::remove(options.path.c_str());
+
+	std::vector<rapidjson::Document> queries;
+	for (int i = 0; i < 1024; ++i)
+	{
+		queries.push_back(makeGetQuery(i, symbols));
+	}
+	{
+		QueryHandler queryHandler(options);
+		std::uint64_t hits = metrics().answerCacheHits;
+		std::uint64_t misses = metrics().answerCacheMisses;
+		std::size_t next = 0;
+		for (auto _ : state)
+		{
+			queryHandler.handleGetQuery(queries[next++ & 1023], jsonParser);
+		}
+		queryHandler.getAnswerWriter().flush();
+		state.counters["flushes"] = static_cast<double>(queryHandler.getAnswerWriter().getFlushCount());
+		state.counters["cache_hit_ratio"] = cacheHitRatio(hits, misses);
+	}
+	state.SetItemsProcessed(state.iterations());
+	std::remove(options.path.c_str());
+}
+BENCHMARK(BM_GetQueriesBatchedAnswers)->ArgNames({"symbols", "background"})->Args({1000, 0})->Args({3000, 0})->Args({30000, 0})->Args({3000, 1});
+
+// GET with a "data" list of 1, 4 or all 8 fields. Cycling through 30000 symbols keeps the answer cache
+// from absorbing the work, so this mostly measures lookup plus serialization of the requested fields.
+static void BM_GetQueryProjection(benchmark::State &state)
+{
+	static const char *const kFields[] = {"status", "ticksize", "stepsize", "quoteAsset", "baseAsset", "minQty", "minNotional", "contract_type"};
+	const int fields = static_cast<int>(state.range(0));
+	const int symbols = 30000;
+	JSONParser &jsonParser = answerBenchParser(symbols);
+	AnswerWriter::Options options;
+	options.path = "bench_answers_projection.json";
+	std::remove(options.path.c_str());
+
+	std::vector<rapidjson::Document> queries;
+	for (int i = 0; i < symbols; ++i)
+	{
+		rapidjson::Document query = makeGetQuery(i, symbols);
+		rapidjson::Value data(rapidjson::kArrayType);
+		for (int field = 0; field < fields; ++field)
+		{
+			data.PushBack(rapidjson::StringRef(kFields[field]), query.GetAllocator());
+		}
+		query.AddMember("data", data, query.GetAllocator());
+		queries.push_back(std::move(query));
+	}
+	{
+		QueryHandler queryHandler(options);
+		std::size_t next = 0;
+		for (auto _ : state)
+		{
+			queryHandler.handleGetQuery(queries[next++ % queries.size()], jsonParser);
+		}
+		queryHandler.getAnswerWriter().flush();
+	}
+	std::ifstream answers(options.path, std::ios::ate | std::ios::binary);
+	state.counters["answer_bytes"] = static_cast<double>(answers.tellg()) / static_cast<double>(state.iterations());
+	state.SetItemsProcessed(state.iterations());
+	std::remove(options.path.c_str());
+}
+BENCHMARK(BM_GetQueryProjection)->ArgName("fields")->Arg(1)->Arg(4)->Arg(8);
+
+// UPDATE through QueryHandler: snapshot lookup plus the copy-on-write publish of the changed row
+static void BM_UpdateQuery(benchmark::State &state)
+{
+	const int symbols = static_cast<int>(state.range(0));
+	std::unique_ptr<JSONParser> jsonParser = loadedParser(symbols);
+	std::vector<rapidjson::Document> queries;
+	for (int i = 0; i < 1024; ++i)
+	{
+		queries.push_back(makeUpdateQuery(i, symbols));
+	}
+
+	QueryHandler queryHandler;
+	std::size_t next = 0;
+	for (auto _ : state)
+	{
+		queryHandler.handleUpdateQuery(queries[next++ & 1023], *jsonParser);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UpdateQuery)->ArgName("symbols")->Arg(1000)->Arg(3000)->Arg(30000);
+
+// DELETE of a live symbol; once every symbol is gone the table is reloaded outside the timing
+static void BM_DeleteQuery(benchmark::State &state)
+{
+	const int symbols = static_cast<int>(state.range(0));
+	std::unique_ptr<JSONParser> jsonParser = loadedParser(symbols);
+	std::vector<rapidjson::Document> queries;
+	for (int i = 0; i < symbols; ++i)
+	{
+		queries.push_back(makeDeleteQuery(i, symbols));
+	}
+
+	QueryHandler queryHandler;
+	std::size_t next = 0;
+	for (auto _ : state)
+	{
+		if (next == queries.size())
+		{
+			state.PauseTiming();
+			jsonParser = loadedParser(symbols);
+			next = 0;
+			state.ResumeTiming();
+		}
+		queryHandler.handleDeleteQuery(queries[next++], *jsonParser);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeleteQuery)->ArgName("symbols")->Arg(1000)->Arg(3000)->Arg(30000);
+
+// One pass of main's document mode over query files of different sizes and mixes: read and parse
+// the file, dispatch every new id, flush the answers. Each pass starts from a freshly loaded 3000
+// symbol table and an empty QueryHandler, both set up outside the timing. items/s is queries/sec.
+static void BM_HandleQueries(benchmark::State &state)
+{
+	const int queries = static_cast<int>(state.range(0));
+	const QueryMix mix = static_cast<QueryMix>(state.range(1));
+	const char *queryFile = "bench_query.json";
+	{
+		std::ofstream file(queryFile, std::ios::trunc);
+		file << makeQueryFile(queries, mix, 3000);
+	}
+	AnswerWriter::Options options;
+	options.path = "bench_answers_queries.json";
+	std::uint64_t hits = metrics().answerCacheHits;
+	std::uint64_t misses = metrics().answerCacheMisses;
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		std::remove(options.path.c_str());
+		std::unique_ptr<JSONParser> jsonParser = loadedParser(3000);
+		auto queryHandler = std::make_unique<QueryHandler>(options);
+		state.ResumeTiming();
+
+		queryHandler->handleQueries(queryFile, *jsonParser);
+		queryHandler->getAnswerWriter().flush();
+
+		state.PauseTiming();
+		queryHandler.reset();
+		jsonParser.reset();
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * queries);
+	state.counters["cache_hit_ratio"] = cacheHitRatio(hits, misses);
+	std::remove(queryFile);
+	std::remove(options.path.c_str());
+}
+BENCHMARK(BM_HandleQueries)->ArgNames({"queries", "mix"})->ArgsProduct({{100, 1000, 10000}, {GetOnly, ReadHeavy, WriteHeavy}})->Unit(benchmark::kMicrosecond);
+
+// Cold start to the first answered GET: a fresh JSONParser gets its table either by parsing the
+// exchangeInfo fixture (snapshot:0, the network fetch in front of it is not included) or by loading a
+// snapshot file saved from the same data (snapshot:1), then one GET is answered and flushed.
+static void BM_ColdStartToFirstGet(benchmark::State &state)
+{
+	const int symbols = static_cast<int>(state.range(0));
+	const bool fromSnapshot = state.range(1) != 0;
+	const std::string &json = exchangeInfoFixture(symbols);
+	const std::string snapshotFile = "bench_symbols.snapshot";
+	loadedParser(symbols)->saveSnapshot(snapshotFile);
+	rapidjson::Document query = makeGetQuery(0, symbols);
+	AnswerWriter::Options options;
+	options.path = "/dev/null";
+
+	for (auto _ : state)
+	{
+		JSONParser jsonParser;
+		if (fromSnapshot)
+		{
+			jsonParser.loadSnapshot(snapshotFile);
+		}
+		else
+		{
+			jsonParser.performJSONDataParsing(json);
+		}
+		QueryHandler queryHandler(options);
+		queryHandler.handleGetQuery(query, jsonParser);
+		queryHandler.getAnswerWriter().flush();
+	}
+	std::ifstream file(snapshotFile, std::ios::ate | std::ios::binary);
+	state.counters["snapshot_bytes"] = static_cast<double>(file.tellg());
+	state.counters["json_bytes"] = static_cast<double>(json.size());
+	std::remove(snapshotFile.c_str());
+}
+BENCHMARK(BM_ColdStartToFirstGet)->ArgNames({"symbols", "snapshot"})->ArgsProduct({{3000, 30000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+// Loading a query file into a document: the previous ifstream -> ostringstream -> str() -> Parse chain
+// (method 0) against parsing straight from a MappedFile (method 1). peak_rss_kb is the resident growth
+// of one load, including the page cache pages the mapping touches.
+static void BM_LoadQueryFile(benchmark::State &state)
+{
+	const int queries = static_cast<int>(state.range(0));
+	const bool mapped = state.range(1) != 0;
+	const char *queryFile = "bench_load_query.json";
+	{
+		std::ofstream file(queryFile, std::ios::trunc);
+		file << makeQueryFile(queries, ReadHeavy, 3000);
+	}
+	auto load = [&]
+	{
+		rapidjson::Document document;
+		if (mapped)
+		{
+			MappedFile file;
+			file.open(queryFile);
+			document.Parse(file.data());
+		}
+		else
+		{
+			std::ifstream file(queryFile);
+			std::ostringstream contents;
+			contents << file.rdbuf();
+			document.Parse(contents.str().c_str());
+		}
+		benchmark::DoNotOptimize(document["query"].Size());
+	};
+
+	for (auto _ : state)
+	{
+		load();
+	}
+	std::ifstream file(queryFile, std::ios::ate | std::ios::binary);
+	state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(file.tellg()));
+	state.counters["peak_rss_kb"] = static_cast<double>(peakRssGrowthKb(load));
+	std::remove(queryFile);
+}
+BENCHMARK(BM_LoadQueryFile)->ArgNames({"queries", "mapped"})->ArgsProduct({{10000, 100000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+// handleBatch over a 1M-query read-heavy file at 1, 2, 4 and 8 pool threads, against a freshly loaded
+// 3000 symbol table each pass. Answers go to /dev/null so the writer does not dominate. items/s is
+// queries/sec; steals is how many ranges per pass ran on a worker other than the one they were dealt to.
+static void BM_HandleBatch(benchmark::State &state)
+{
+	const std::size_t threads = static_cast<std::size_t>(state.range(0));
+	rapidjson::Document document;
+	document.Parse(makeQueryFile(1 << 20, ReadHeavy, 3000).c_str());
+	const rapidjson::Value &array = document["query"];
+	std::vector<const rapidjson::Value *> queries;
+	for (rapidjson::SizeType i = 0; i < array.Size(); ++i)
+	{
+		queries.push_back(&array[i]);
+	}
+	AnswerWriter::Options options;
+	options.path = "/dev/null";
+	QueryHandler queryHandler(options, threads);
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		std::unique_ptr<JSONParser> jsonParser = loadedParser(3000);
+		state.ResumeTiming();
+
+		queryHandler.handleBatch(queries, *jsonParser);
+		queryHandler.getAnswerWriter().flush();
+
+		state.PauseTiming();
+		jsonParser.reset();
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(queries.size()));
+	state.counters["steals"] = benchmark::Counter(static_cast<double>(queryHandler.getBatchStealCount()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_HandleBatch)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+namespace
+{
+	double percentileNs(std::vector<int64_t> &samples, double fraction)
+	{
+		if (samples.empty())
+		{
+			return 0;
+		}
+		std::size_t index = static_cast<std::size_t>(fraction * static_cast<double>(samples.size() - 1));
+		std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+		return static_cast<double>(samples[index]);
+	}
+
+	// Shared by all threads of BM_SnapshotGetLatency; thread 0 runs the writer alongside the readers
+	JSONParser snapshotBenchParser;
+	std::atomic<bool> writerStop{false};
+	std::thread writerThread;
+}
+
+// GET lookups through the published snapshot while one writer keeps applying UPDATEs. Each reader
+// times every lookup (clock overhead included) and reports its p50/p99, averaged over the readers.
+static void BM_SnapshotGetLatency(benchmark::State &state)
+{
+	if (state.thread_index() == 0)
+	{
+		if (snapshotBenchParser.snapshot()->size() == 0)
+		{
+			snapshotBenchParser.performJSONDataParsing(exchangeInfoFixture(3000));
+		}
+		writerStop = false;
+		writerThread = std::thread([]
+								   {
+									   for (int i = 0; !writerStop; ++i)
+									   {
+										   std::string value = std::to_string(i % 1000) + ".01";
+										   snapshotBenchParser.handleUpdate("SYM" + std::to_string(i % 3000) + "USDT", {{"tickSize", value}, {"stepSize", value}});
+										   std::this_thread::sleep_for(std::chrono::microseconds(50));
+									   } });
+	}
+
+	std::vector<std::string> symbols;
+	for (int i = 0; i < 3000; ++i)
+	{
+		symbols.push_back("SYM" + std::to_string((i * 7919) % 3000) + "USDT");
+	}
+	std::vector<int64_t> samples;
+	samples.reserve(1 << 20);
+	std::size_t next = 0;
+	for (auto _ : state)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::shared_ptr<const SymbolSnapshot> view = snapshotBenchParser.snapshot();
+		SymbolSnapshot::Row row = view->find(symbols[next++ % symbols.size()]);
+		benchmark::DoNotOptimize(row ? row.table->tickSize(row.id).mantissa : 0);
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		if (samples.size() < samples.capacity())
+		{
+			samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		}
+	}
+
+	if (state.thread_index() == 0)
+	{
+		writerStop = true;
+		writerThread.join();
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["p50_ns"] = benchmark::Counter(percentileNs(samples, 0.50), benchmark::Counter::kAvgThreads);
+	state.counters["p99_ns"] = benchmark::Counter(percentileNs(samples, 0.99), benchmark::Counter::kAvgThreads);
+}
+BENCHMARK(BM_SnapshotGetLatency)->ThreadRange(1, 8)->UseRealTime();
+
+// One symbol's tickSize as a co-located process sees it: through the shared-memory segment by slot,
+// resolved once up front (shared 1), against the in-process snapshot lookup by name (shared 0)
+static void BM_SharedSymbolRead(benchmark::State &state)
+{
+	const bool shared = state.range(0) != 0;
+	const std::string segmentName = "/binance_symbols_bench_" + std::to_string(::getpid());
+	std::unique_ptr<JSONParser> jsonParser = loadedParser(3000);
+	jsonParser->setSharedMemory(segmentName, 4096);
+	SharedSymbolReader reader;
+	reader.open(segmentName);
+
+	std::vector<std::string> symbols;
+	std::vector<uint32_t> slots;
+	for (int i = 0; i < 3000; ++i)
+	{
+		symbols.push_back("SYM" + std::to_string(querySymbolIndex(i, 3000)) + "USDT");
+		slots.push_back(reader.find(symbols.back()));
+	}
+	std::size_t next = 0;
+	SharedSymbolData data;
+	for (auto _ : state)
+	{
+		if (shared)
+		{
+			benchmark::DoNotOptimize(reader.read(slots[next++ % slots.size()], data) ? data.tickMantissa : 0);
+		}
+		else
+		{
+			std::shared_ptr<const SymbolSnapshot> view = jsonParser->snapshot();
+			SymbolSnapshot::Row row = view->find(symbols[next++ % symbols.size()]);
+			benchmark::DoNotOptimize(row ? row.table->tickSize(row.id).mantissa : 0);
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedSymbolRead)->ArgName("shared")->Arg(0)->Arg(1);
+
+// Decoding and applying market-stream frames, as the stream's one thread does for every message: diff
+// depth updates with ten levels a side, book tickers and unchanged contractInfo events over 3000 symbols
+static void BM_MarketStreamMessages(benchmark::State &state)
+{
+	std::unique_ptr<JSONParser> jsonParser = loadedParser(3000);
+	MarketStream stream(*jsonParser, MarketStreamOptions());
+	std::vector<std::string> frames;
+	std::string levels;
+	for (int level = 0; level < 10; ++level)
+	{
+		levels += (level ? "," : "") + std::string(R"(["100.)") + std::to_string(level) + R"(","1.500"])";
+	}
+	for (int i = 0; i < 30000; ++i)
+	{
+		std::string symbol = "SYM" + std::to_string(i % 3000) + "USDT";
+		std::string id = std::to_string(1000 + i / 3000);
+		switch (i % 10)
+		{
+		case 0:
+			frames.push_back(R"({"stream":"!contractInfo","data":{"e":"contractInfo","E":1,"s":")" + symbol + R"(","ct":"PERPETUAL","cs":"TRADING","bks":[{"bs":1,"bnf":0,"bnc":5000,"mmr":0.01,"cum":0,"mi":125,"ma":50}]}})");
+			break;
+		case 1:
+		case 2:
+		case 3:
+			frames.push_back(R"({"stream":"sym@bookTicker","data":{"u":)" + id + R"(,"s":")" + symbol + R"(","b":"100.1","B":"31.2","a":"100.2","A":"40.6"}})");
+			break;
+		default:
+			frames.push_back(R"({"stream":"sym@depth","data":{"e":"depthUpdate","E":1,"s":")" + symbol + R"(","U":)" + id + R"(,"u":)" + id + R"(,"b":[)" + levels + R"(],"a":[)" + levels + "]}}");
+			break;
+		}
+	}
+	std::size_t next = 0;
+	std::size_t bytes = 0;
+	for (auto _ : state)
+	{
+		const std::string &frame = frames[next++ % frames.size()];
+		stream.processMessage(frame.data(), frame.size());
+		bytes += frame.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_MarketStreamMessages);
+
+// contractInfo events that each change a symbol's status, so every frame goes through applyExchangeUpdate,
+// publishes a new version and, with "snapshot" 1, marks the snapshot file dirty for the background writer
+static void BM_MarketStreamApply(benchmark::State &state)
+{
+	const std::string snapshotFile = "bench_stream_apply.snapshot";
+	std::unique_ptr<JSONParser> jsonParser = loadedParser(3000);
+	if (state.range(0) != 0)
+	{
+		jsonParser->setSnapshotFile(snapshotFile);
+	}
+	MarketStream stream(*jsonParser, MarketStreamOptions());
+	std::vector<std::string> frames;
+	for (int i = 0; i < 6000; ++i)
+	{
+		std::string symbol = "SYM" + std::to_string(i % 3000) + "USDT";
+		const char *status = i / 3000 % 2 ? "TRADING" : "SETTLING";
+		frames.push_back(R"({"stream":"!contractInfo","data":{"e":"contractInfo","E":1,"s":")" + symbol + R"(","ct":"PERPETUAL","cs":")" + status + R"("}})");
+	}
+	std::size_t next = 0;
+	for (auto _ : state)
+	{
+		const std::string &frame = frames[next++ % frames.size()];
+		stream.processMessage(frame.data(), frame.size());
+	}
+	state.SetItemsProcessed(state.iterations());
+	jsonParser.reset();
+	std::remove(snapshotFile.c_str());
+}
+BENCHMARK(BM_MarketStreamApply)->ArgName("snapshot")->Arg(0)->Arg(1);
+
+// Depth diffs of one symbol, as recorded around a random-walk mid: 10 levels a side, a quarter of them
+// removals. "json" 1 parses every event, 0 applies the same events pre-decoded, i.e. the book alone.
+static void BM_OrderBookDepthUpdates(benchmark::State &state)
+{
+	bool json = state.range(0) != 0;
+	std::mt19937 random(42);
+	// Levels both as Binance's text and in ticks of 0.01 and quantity units of 0.001
+	auto side = [&random](int64_t from, int64_t direction, bool removals, std::vector<DepthLevel> &levels)
+	{
+		std::string text;
+		for (int i = 0; i < 10; ++i)
+		{
+			DepthLevel level{from + direction * static_cast<int64_t>(removals ? random() % 20 : i), 0};
+			if (!removals || random() % 4 != 0)
+			{
+				level.quantity = static_cast<int64_t>(1 + random() % 50) * 1000 + 250;
+			}
+			levels.push_back(level);
+			std::string cents = std::to_string(100 + level.ticks % 100);
+			std::string quantity = level.quantity ? std::to_string(level.quantity / 1000) + ".250" : "0";
+			text += (i ? ",[\"" : "[\"") + std::to_string(level.ticks / 100) + "." + cents.substr(1) + "\",\"" + quantity + "\"]";
+		}
+		return text;
+	};
+	int64_t mid = 3000000;
+	DepthUpdate snapshotLevels;
+	std::string snapshot = R"({"lastUpdateId":999,"bids":[)" + side(mid - 1, -1, false, snapshotLevels.bids) + R"(],"asks":[)" +
+						   side(mid + 1, 1, false, snapshotLevels.asks) + "]}";
+	std::vector<std::string> frames;
+	std::vector<DepthUpdate> updates(10000);
+	for (std::size_t i = 0; i < updates.size(); ++i)
+	{
+		mid += static_cast<int64_t>(random() % 3) - 1;
+		updates[i].firstId = updates[i].lastId = 1000 + i;
+		std::string id = std::to_string(updates[i].lastId);
+		frames.push_back(R"({"stream":"btcusdt@depth@100ms","data":{"e":"depthUpdate","E":1,"s":"BTCUSDT","U":)" + id + R"(,"u":)" + id +
+						 R"(,"b":[)" + side(mid - 1, -1, true, updates[i].bids) + R"(],"a":[)" + side(mid + 1, 1, true, updates[i].asks) + "]}}");
+	}
+
+	std::unique_ptr<OrderBook> book;
+	std::size_t next = updates.size();
+	std::size_t levels = 0;
+	for (auto _ : state)
+	{
+		// Out of events: the same ones again on a fresh book
+		if (next == updates.size())
+		{
+			state.PauseTiming();
+			book = std::make_unique<OrderBook>(FixedDecimal{1, 2}, FixedDecimal{1, 3});
+			book->applySnapshot(snapshot.data(), snapshot.size());
+			next = 0;
+			state.ResumeTiming();
+		}
+		OrderBook::Result result = json ? book->applyDiff(frames[next].data(), frames[next].size()) : book->applyDiff(updates[next]);
+		benchmark::DoNotOptimize(result);
+		levels += updates[next].bids.size() + updates[next].asks.size();
+		++next;
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["levels"] = benchmark::Counter(static_cast<double>(levels), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_OrderBookDepthUpdates)->ArgName("json")->Arg(0)->Arg(1);
+
+// Orders over the 3000 fixture symbols, rounded (price to nearest tick, quantity down to step) and validated.
+// "batch" 1 goes through the single-order calls, otherwise the struct-of-arrays ones take batch orders at a time.
+static void BM_NormalizeOrders(benchmark::State &state)
+{
+	std::size_t batch = static_cast<std::size_t>(state.range(0));
+	std::unique_ptr<JSONParser> jsonParser = loadedParser(3000);
+	OrderNormalizer normalizer(*jsonParser->snapshot());
+	std::mt19937 random(5);
+	std::size_t count = 4096;
+	std::vector<OrderNormalizer::Slot> slots(count);
+	std::vector<int64_t> prices(count);
+	std::vector<int64_t> quantities(count);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		slots[i] = normalizer.find("SYM" + std::to_string(querySymbolIndex(static_cast<int>(i), 3000)) + "USDT");
+		prices[i] = static_cast<int64_t>(1 + random() % 10000000) * 1000;
+		quantities[i] = static_cast<int64_t>(1 + random() % 100000) * 100;
+	}
+	std::vector<int64_t> roundedPrices(count);
+	std::vector<int64_t> roundedQuantities(count);
+	std::vector<uint8_t> violations(count);
+	std::size_t next = 0;
+	for (auto _ : state)
+	{
+		if (batch == 1)
+		{
+			int64_t price = normalizer.roundPrice(slots[next], prices[next]);
+			int64_t quantity = normalizer.roundQuantity(slots[next], quantities[next]);
+			violations[next] = normalizer.validate(slots[next], price, quantity);
+		}
+		else
+		{
+			std::copy_n(prices.begin() + next, batch, roundedPrices.begin() + next);
+			std::copy_n(quantities.begin() + next, batch, roundedQuantities.begin() + next);
+			normalizer.roundPrices(&slots[next], &roundedPrices[next], batch);
+			normalizer.roundQuantities(&slots[next], &roundedQuantities[next], batch);
+			normalizer.validate(&slots[next], &roundedPrices[next], &roundedQuantities[next], &violations[next], batch);
+		}
+		benchmark::DoNotOptimize(violations.data());
+		next = (next + batch) % count;
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+}
+BENCHMARK(BM_NormalizeOrders)->ArgName("batch")->Arg(1)->Arg(64)->Arg(1024);
+
+// Same as BENCHMARK_MAIN, except the results also go to BinanceHandlerBench.json unless --benchmark_out
+// is given, so every run leaves a file that tools/compare.py can diff against another commit's
+int main(int argc, char **argv)
+{
+	std::vector<char *> args(argv, argv + argc);
+	bool hasOut = std::any_of(args.begin(), args.end(), [](const char *arg)
+							  { return std::strncmp(arg, "--benchmark_out=", 16) == 0; });
+	static char defaultOut[] = "--benchmark_out=BinanceHandlerBench.json";
+	static char defaultFormat[] = "--benchmark_out_format=json";
+	if (!hasOut)
+	{
+		args.push_back(defaultOut);
+		args.push_back(defaultFormat);
+	}
+	int count = static_cast<int>(args.size());
+
+	benchmark::Initialize(&count, args.data());
+	if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+	{
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
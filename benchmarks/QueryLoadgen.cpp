@@ -0,0 +1,307 @@
+// Load generator for the query socket. Each connection keeps --depth requests in flight and sends a new
+// one for every response, for --seconds; at the end it prints the sustained rate and the round-trip
+// latency distribution over all connections.
+//
+//   BinanceQueryLoadgen --socket /tmp/binance_query.sock --connections 4 --depth 64 --seconds 10
+//
+// With --fixture-symbols N it serves N synthetic symbols (SYM0USDT ...) from an in-process QueryServer
+// instead, which needs no running application or network.
+#include "BinanceHandler.h"
+#include "QueryProtocol.h"
+#include "spdlog/sinks/null_sink.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+std::shared_ptr<spdlog::logger> logger = spdlog::null_logger_mt("loadgen");
+
+namespace
+{
+	struct LoadOptions
+	{
+		std::string socketPath = "/tmp/binance_query.sock";
+		unsigned connections = 1;
+		unsigned depth = 64;
+		unsigned seconds = 10;
+		unsigned updatePercent = 0;
+		std::string market;
+		std::vector<std::string> symbols = {"BTCUSDT", "ETHUSDT", "BNBUSDT"};
+		unsigned fixtureSymbols = 0;
+	};
+
+	struct ConnectionStats
+	{
+		std::uint64_t completed = 0;
+		std::uint64_t notFound = 0;
+		std::uint64_t badRequest = 0;
+		std::string error;
+	};
+
+	bool writeAll(int fd, const std::string &data)
+	{
+		std::size_t sent = 0;
+		while (sent < data.size())
+		{
+			ssize_t count = ::write(fd, data.data() + sent, data.size() - sent);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				return false;
+			}
+			sent += static_cast<std::size_t>(count);
+		}
+		return true;
+	}
+
+	void runConnection(const LoadOptions &options, unsigned index, const std::atomic<bool> &stopping, LatencyHistogram &roundTrips, ConnectionStats &stats)
+	{
+		int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		std::strncpy(address.sun_path, options.socketPath.c_str(), sizeof(address.sun_path) - 1);
+		if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+		{
+			stats.error = std::string("connect: ") + std::strerror(errno);
+			if (fd >= 0)
+			{
+				::close(fd);
+			}
+			return;
+		}
+
+		// Responses come back in order and at most depth are outstanding, so id % depth finds the send time
+		std::vector<std::chrono::steady_clock::time_point> sentAt(options.depth);
+		WireQuery query;
+		query.market = options.market;
+		uint32_t nextId = 0;
+		std::size_t outstanding = 0;
+		std::string output;
+		auto enqueue = [&]
+		{
+			query.id = nextId++;
+			query.symbol = options.symbols[(static_cast<std::size_t>(query.id) * 7919 + index) % options.symbols.size()];
+			query.updates.clear();
+			if (query.id % 100 < options.updatePercent)
+			{
+				query.type = WireQueryType::Update;
+				query.updates.emplace_back(SymbolField::Status, "TRADING");
+			}
+			else
+			{
+				query.type = WireQueryType::Get;
+			}
+			sentAt[query.id % options.depth] = std::chrono::steady_clock::now();
+			encodeWireQuery(query, output);
+			++outstanding;
+		};
+
+		for (unsigned i = 0; i < options.depth; ++i)
+		{
+			enqueue();
+		}
+		std::vector<char> input(1 << 20);
+		std::size_t received = 0;
+		while (outstanding > 0)
+		{
+			if (!output.empty())
+			{
+				if (!writeAll(fd, output))
+				{
+					stats.error = std::string("write: ") + std::strerror(errno);
+					break;
+				}
+				output.clear();
+			}
+			ssize_t count = ::read(fd, input.data() + received, input.size() - received);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				stats.error = count == 0 ? "server closed the connection" : std::string("read: ") + std::strerror(errno);
+				break;
+			}
+			received += static_cast<std::size_t>(count);
+
+			auto now = std::chrono::steady_clock::now();
+			std::size_t consumed = 0;
+			uint32_t length;
+			while (wireFrameLength(input.data() + consumed, received - consumed, length) && received - consumed >= kWireLengthSize + length)
+			{
+				uint32_t id;
+				WireStatus status;
+				const char *answer;
+				std::size_t size;
+				if (decodeWireResponse(input.data() + consumed + kWireLengthSize, length, id, status, answer, size))
+				{
+					roundTrips.record(now - sentAt[id % options.depth]);
+					++stats.completed;
+					stats.notFound += status == WireStatus::NotFound;
+					stats.badRequest += status == WireStatus::BadRequest;
+				}
+				consumed += kWireLengthSize + length;
+				--outstanding;
+				if (!stopping.load(std::memory_order_relaxed))
+				{
+					enqueue();
+				}
+			}
+			std::memmove(input.data(), input.data() + consumed, received - consumed);
+			received -= consumed;
+		}
+		::close(fd);
+	}
+
+	std::vector<std::string> splitList(const std::string &text)
+	{
+		std::vector<std::string> items;
+		std::istringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty())
+			{
+				items.push_back(item);
+			}
+		}
+		return items;
+	}
+
+	bool parseArguments(int argc, char **argv, LoadOptions &options)
+	{
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			std::string name = argv[i];
+			std::string value = argv[i + 1];
+			if (name == "--socket")
+			{
+				options.socketPath = value;
+			}
+			else if (name == "--connections")
+			{
+				options.connections = static_cast<unsigned>(std::stoul(value));
+			}
+			else if (name == "--depth")
+			{
+				options.depth = static_cast<unsigned>(std::stoul(value));
+			}
+			else if (name == "--seconds")
+			{
+				options.seconds = static_cast<unsigned>(std::stoul(value));
+			}
+			else if (name == "--update-percent")
+			{
+				options.updatePercent = static_cast<unsigned>(std::stoul(value));
+			}
+			else if (name == "--market")
+			{
+				options.market = value;
+			}
+			else if (name == "--symbols")
+			{
+				options.symbols = splitList(value);
+			}
+			else if (name == "--fixture-symbols")
+			{
+				options.fixtureSymbols = static_cast<unsigned>(std::stoul(value));
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return argc % 2 == 1 && options.connections > 0 && options.depth > 0 && !options.symbols.empty();
+	}
+
+	std::string fixtureExchangeInfo(unsigned symbols)
+	{
+		std::string json = R"({"symbols":[)";
+		for (unsigned i = 0; i < symbols; ++i)
+		{
+			json += (i ? "," : "") + std::string(R"({"symbol":"SYM)") + std::to_string(i) + R"(USDT","status":"TRADING","quoteAsset":"USDT","filters":[)" +
+					R"({"filterType":"PRICE_FILTER","tickSize":"0.01000000"},{"filterType":"LOT_SIZE","stepSize":"0.00001000"}]})";
+		}
+		return json + "]}";
+	}
+}
+
+int main(int argc, char **argv)
+{
+	LoadOptions options;
+	try
+	{
+		if (!parseArguments(argc, argv, options))
+		{
+			std::cerr << "usage: " << argv[0] << " [--socket PATH] [--connections N] [--depth N] [--seconds N] [--update-percent N]"
+					  << " [--market NAME] [--symbols A,B,...] [--fixture-symbols N]" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (std::exception const &e)
+	{
+		std::cerr << "Invalid argument: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	JSONParser jsonParser;
+	std::unique_ptr<QueryServer> server;
+	if (options.fixtureSymbols > 0)
+	{
+		jsonParser.performJSONDataParsing(fixtureExchangeInfo(options.fixtureSymbols));
+		options.symbols.clear();
+		for (unsigned i = 0; i < options.fixtureSymbols; ++i)
+		{
+			options.symbols.push_back("SYM" + std::to_string(i) + "USDT");
+		}
+		server = std::make_unique<QueryServer>(jsonParser, options.socketPath);
+	}
+
+	LatencyHistogram roundTrips;
+	std::vector<ConnectionStats> stats(options.connections);
+	std::atomic<bool> stopping{false};
+	std::vector<std::thread> connections;
+	auto started = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < options.connections; ++i)
+	{
+		connections.emplace_back([&, i]
+								 { runConnection(options, i, stopping, roundTrips, stats[i]); });
+	}
+	std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+	stopping = true;
+	for (std::thread &connection : connections)
+	{
+		connection.join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	ConnectionStats total;
+	for (const ConnectionStats &connection : stats)
+	{
+		total.completed += connection.completed;
+		total.notFound += connection.notFound;
+		total.badRequest += connection.badRequest;
+		if (!connection.error.empty())
+		{
+			std::cerr << "connection error: " << connection.error << std::endl;
+		}
+	}
+	LatencyHistogram::Snapshot latency = roundTrips.snapshot();
+	std::cout << "connections " << options.connections << ", depth " << options.depth << ", " << options.updatePercent << "% updates, " << elapsed << " s\n"
+			  << "requests " << total.completed << " (" << total.notFound << " not found, " << total.badRequest << " bad), "
+			  << static_cast<std::uint64_t>(static_cast<double>(total.completed) / elapsed) << " QPS\n"
+			  << "round trip us: p50 " << static_cast<double>(latency.quantileNs(0.5)) / 1e3
+			  << ", p99 " << static_cast<double>(latency.quantileNs(0.99)) / 1e3
+			  << ", p99.9 " << static_cast<double>(latency.quantileNs(0.999)) / 1e3
+			  << ", mean " << (latency.count ? static_cast<double>(latency.sumNs) / 1e3 / static_cast<double>(latency.count) : 0.0) << std::endl;
+	return total.completed > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
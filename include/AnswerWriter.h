@@ -0,0 +1,98 @@
+#ifndef ANSWER_WRITER_H
+#define ANSWER_WRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+// Sink for query answers. Answers are serialized with a compact writer into a reused buffer and
+// written to the file in batches, once flushBytes are pending or flushInterval has passed, so a
+// burst of GETs costs one write() per batch instead of an open/write/close per query. Between flushes
+// the file is always complete JSON; the owner flushes after each pass over its queries.
+class AnswerWriter
+{
+public:
+	enum class Format
+	{
+		NDJSON,	   // one answer per line, appended to the existing file
+		JSONArray, // the file is truncated and holds a single array, closed again after every flush
+	};
+
+	struct Options
+	{
+		std::string path = "answers.json";
+		Format format = Format::NDJSON;
+		std::size_t flushBytes = 64 * 1024;
+		std::chrono::milliseconds flushInterval{100};
+		// Flush on a timer thread too, so answers do not wait for the next write to reach the file
+		bool backgroundFlush = false;
+	};
+
+	using JSONWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+	AnswerWriter();
+	explicit AnswerWriter(const Options &options);
+	~AnswerWriter();
+	AnswerWriter(const AnswerWriter &) = delete;
+	AnswerWriter &operator=(const AnswerWriter &) = delete;
+
+	void write(const rapidjson::Value &answer);
+
+	// Lets the caller emit one answer straight into the writer without building a Document first
+	template <typename Emit>
+	void writeWith(const Emit &emit)
+	{
+		std::unique_lock<std::mutex> lock(bufferMutex);
+		serialized.Clear();
+		jsonWriter.Reset(serialized);
+		emit(jsonWriter);
+		appendLocked(lock, serialized.GetString(), serialized.GetSize());
+	}
+
+	// Appends one answer that was already serialized, e.g. kept from an earlier query
+	void writeSerialized(const char *answer, std::size_t size);
+
+	// Writes everything pending to the file
+	void flush();
+
+	std::uint64_t getAnswerCount() const;
+	std::uint64_t getFlushCount() const;
+	static bool parseFormat(const std::string &name, Format &format);
+
+private:
+	void appendLocked(std::unique_lock<std::mutex> &lock, const char *answer, std::size_t size);
+	bool openFile();
+	void writeFile(const std::string &data);
+	void runFlusher();
+
+	Options options;
+
+	// Guards the pending batch; held only while an answer is appended, never during I/O
+	mutable std::mutex bufferMutex;
+	rapidjson::StringBuffer serialized;
+	JSONWriter jsonWriter;
+	std::string pending;
+	std::uint64_t answerCount = 0;
+	std::chrono::steady_clock::time_point lastFlush;
+
+	// Guards the file and the batch being written
+	mutable std::mutex fileMutex;
+	std::string outgoing;
+	int fd = -1;
+	bool openFailed = false;
+	// JSONArray: where the closing bracket starts, the next batch overwrites it
+	std::uint64_t arrayEnd = 0;
+	std::uint64_t flushCount = 0;
+
+	std::thread flusher;
+	std::condition_variable flusherWake;
+	bool stopping = false;
+};
+
+#endif
@@ -1,51 +1,521 @@
 #ifndef BINANCE_HANDLER_H
 #define BINANCE_HANDLER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/basic_file_sink.h"
 #include "rapidjson/document.h"
+#include "SymbolTable.h"
+#include "SymbolSnapshot.h"
+#include "AnswerWriter.h"
+#include "Metrics.h"
+#include "WorkStealingPool.h"
+#include "MappedFile.h"
+#include "JsonArena.h"
 #include <unordered_set>
+#include <vector>
 
 extern std::shared_ptr<spdlog::logger> logger;
 
+// Pulls the next part of a response body into buffer and returns the number of bytes written, 0 once the body is complete
+using ChunkReader = std::function<std::size_t(char *buffer, std::size_t size)>;
+using BodyConsumer = std::function<void(const ChunkReader &)>;
+
+// Reads gzip or zlib-wrapped deflate bytes from source and hands them out inflated; throws on a corrupt
+// or truncated stream
+ChunkReader inflatingReader(const ChunkReader &source);
+
+// Revalidation state for one resource, owned by whoever holds the data parsed from it. Filled from the
+// ETag and Last-Modified of a complete 200 response and sent back as If-None-Match/If-Modified-Since.
+struct CacheValidators
+{
+	std::string etag;
+	std::string lastModified;
+	// Set when the last request was answered 304 Not Modified and the body consumer was not called
+	bool notModified = false;
+};
+
+// A single HTTPS connection to one host that is kept open between requests (HTTP/1.1 keep-alive).
+// The resolved endpoints and the TLS session are cached, so when the server drops the connection
+// the next request reconnects transparently with an abbreviated (resumed) handshake.
+class HTTPSession
+{
+public:
+	HTTPSession(const std::string &host, const std::string &port);
+	~HTTPSession();
+
+	// Returns the response body; throws boost::system::system_error if the request fails after a reconnect
+	std::string request(const std::string &target, int version);
+	// Hands the body to consumer while it is still being read from the socket instead of buffering it.
+	// gzip/deflate bodies are inflated on the way. With validators the request is conditional and
+	// false is returned, without calling consumer, when the server answers 304 Not Modified.
+	bool streamRequest(const std::string &target, int version, const BodyConsumer &consumer, CacheValidators *validators = nullptr);
+	void close();
+
+	std::size_t getHandshakeCount() const;
+	std::size_t getResumedHandshakeCount() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
 class HTTPRequest
 {
 public:
 	HTTPRequest();
+	~HTTPRequest();
 	std::string performBinanceAPIRequest(const std::string &host, const std::string &port, const std::string &target, int version);
+	bool streamBinanceAPIRequest(const std::string &host, const std::string &port, const std::string &target, int version, const BodyConsumer &consumer, CacheValidators *validators = nullptr);
+
+	// Session pool keyed by host and port, created on first use
+	HTTPSession &getSession(const std::string &host, const std::string &port);
+
+private:
+	std::unordered_map<std::string, std::unique_ptr<HTTPSession>> sessions;
 };
 
+// Writer side of the shared-memory segment described in SharedSymbolTable.h. Mirrors published snapshots
+// into it for processes using SharedSymbolReader; only one thread writes at a time (JSONParser calls it
+// under its write lock). A row is only rewritten when its version moved.
+class SharedSymbolPublisher
+{
+public:
+	// Creates the segment, replacing (and retiring) any earlier one of that name, with room for capacity
+	// symbols over all markets; throws std::runtime_error when it cannot. Symbols past the capacity, or
+	// with names longer than the record holds, are left out with an error logged.
+	SharedSymbolPublisher(const std::string &name, uint32_t capacity);
+	// Retires and unlinks the segment; readers keep their mapping until they close it
+	~SharedSymbolPublisher();
+	SharedSymbolPublisher(const SharedSymbolPublisher &) = delete;
+	SharedSymbolPublisher &operator=(const SharedSymbolPublisher &) = delete;
+
+	// Brings every record in line with snapshot, marking symbols it no longer has as not live
+	void publishAll(const SymbolSnapshot &snapshot);
+	// Same for the listed symbols only
+	void publish(const SymbolSnapshot &snapshot, const std::vector<SymbolKey> &changed);
+
+	std::size_t rowCount() const;
+
+private:
+	// Slot of the symbol, npos when it has none
+	uint32_t writeRow(MarketId market, const std::string &symbol, SymbolSnapshot::Row row);
+
+	std::string name;
+	uint32_t capacity;
+	void *mapping = nullptr;
+	std::size_t mappedSize = 0;
+	// Version last written to each slot, 0 while the slot holds no live symbol
+	std::vector<uint64_t> writtenVersion;
+	bool reportedFull = false;
+};
+
+// How exchangeInfo is parsed: rapidjson's SAX reader over every token, or JsonScanner, which walks only
+// the fields that are kept and skips the rest with SIMD block scans. The BINANCE_JSON_SCANNER CMake option
+// picks the default.
+enum class ExchangeInfoParser
+{
+	Reader,
+	Scanner
+};
+
+// Owns the symbol table and publishes it as immutable SymbolSnapshot versions. Any number of threads
+// may read through snapshot() without locking while one writer at a time parses, updates or deletes.
+//
+// Every parse of exchangeInfo is merged into the current table rather than replacing it: only symbols
+// whose exchange data differs from the previous fetch are rewritten, and symbols that disappeared from
+// the response are deleted. A local UPDATE or DELETE of a symbol overrides the exchange data until the
+// exchange itself changes or delists that symbol; from then on the exchange data is used again.
+//
+// Symbols are keyed by (market, symbol). Each market's exchangeInfo is merged on its own, so a refresh of
+// one market never delists another's symbols. Market 0 is "spot" and is what callers get by default.
 class JSONParser
 {
 public:
-	void performJSONDataParsing(const std::string &jsonResponse);
-	void handleDelete(const std::string &symbol);
-	void handleUpdate(const std::string &symbol, const std::unordered_map<std::string, std::string> &updatedInfo);
+	JSONParser();
+	// Writes a snapshot still pending for the snapshot file before returning
+	~JSONParser();
+
+	bool performJSONDataParsing(const std::string &jsonResponse, MarketId market = 0);
+	bool performJSONDataParsing(const ChunkReader &readChunk, MarketId market = 0);
+	// Set before the first parse; both give the same table
+	void setExchangeInfoParser(ExchangeInfoParser parser) { exchangeInfoParser = parser; }
+	void handleDelete(const std::string &symbol, MarketId market = 0);
+	void handleUpdate(const std::string &symbol, const std::unordered_map<std::string, std::string> &updatedInfo, MarketId market = 0);
+	// Same with the field names already resolved, as UPDATE queries and the wire protocol deliver them.
+	// All fields apply or none do: false, with nothing published, when the symbol is unknown or the table
+	// refuses one of the values. An unknown name drops the whole update in the overload above as well.
+	bool handleUpdate(const std::string &symbol, const std::vector<std::pair<SymbolField, std::string>> &fields, MarketId market = 0);
+	// Field changes the exchange announced outside of exchangeInfo (MarketStream). They go into the baseline
+	// as well as the published table, and replace a local override of the symbol like a changed fetch
+	// does. Unknown symbols and fields already holding the value are left alone; true when anything changed.
+	bool applyExchangeUpdate(const std::string &symbol, const std::vector<std::pair<SymbolField, std::string>> &fields, MarketId market = 0);
+
+	// Current version of the table; holding on to it keeps that version alive and unchanged
+	std::shared_ptr<const SymbolSnapshot> snapshot() const;
+
+	// Binary snapshot of the exchange data as of the last merge of each market; local UPDATEs and DELETEs
+	// are not part of it. The file is a fixed header (magic, format version, byte order, payload size and
+	// CRC-32) followed by the market names and SymbolTable::serialize() output, and is replaced atomically.
+	bool saveSnapshot(const std::string &path);
+	// Publishes the snapshot's symbols as the current table and as the baseline later fetches are merged
+	// against. Its markets are registered by name. False, leaving everything as it was, when the file is
+	// missing, from another format version or byte order, or fails its checksum.
+	bool loadSnapshot(const std::string &path);
+	// Saves a snapshot to path after merges that changed the exchange data; empty turns it off. Writers
+	// only mark the data dirty: a background thread copies it under the write lock, writes the file
+	// outside of it, and writes at most once per minInterval however many changes arrive.
+	void setSnapshotFile(const std::string &path, std::chrono::milliseconds minInterval = std::chrono::seconds(1));
+	// Mirrors every published version into the POSIX shared-memory segment name (see SharedSymbolTable.h)
+	// from now on; empty stops it and retires the segment. False, with the error logged, when the segment
+	// cannot be created.
+	bool setSharedMemory(const std::string &name, uint32_t capacity);
+
+	// Markets are registered at startup, before any fetch or query runs; the lookups below do not lock.
+	// Returns the existing id when the name is already known.
+	MarketId addMarket(const std::string &name);
+	bool findMarket(const std::string &name, MarketId &market) const;
+	const std::string &marketName(MarketId market) const { return marketNames[market]; }
+	std::size_t marketCount() const { return marketNames.size(); }
 
 private:
-	std::unordered_map<std::string, std::unordered_map<std::string, std::string>> symbolInfoMap;
+	// Only accessed through std::atomic_load/atomic_store
+	std::shared_ptr<const SymbolSnapshot> current;
+	// Serializes writers; readers never take it
+	std::mutex writeMutex;
+
+	// Exchange data as of the last parse of each market, and the symbols changed locally since; both
+	// under writeMutex. Overrides are keyed by overrideKey().
+	SymbolTable exchangeTable;
+	std::unordered_set<std::string> localOverrides;
+	// Under writeMutex as well
+	std::string snapshotFile;
+	std::unique_ptr<SharedSymbolPublisher> sharedTable;
+
+	// Background snapshot writer; snapshotMutex is taken after writeMutex, never the other way around
+	std::thread snapshotThread;
+	std::mutex snapshotMutex;
+	std::condition_variable snapshotWake;
+	bool snapshotDirty = false;
+	bool snapshotStopping = false;
+	std::chrono::milliseconds snapshotInterval{1000};
+
+	std::vector<std::string> marketNames;
+	ExchangeInfoParser exchangeInfoParser = ExchangeInfoParser::Reader;
+
+	// Makes next the current version; changed, when known, limits the shared-memory mirror to those rows
+	void publish(std::shared_ptr<const SymbolSnapshot> next);
+	void publish(std::shared_ptr<const SymbolSnapshot> next, const std::vector<SymbolKey> &changed);
+	bool parseAndPublish(const std::function<bool(SymbolTable &)> &parse, MarketId market);
+	void mergeExchangeInfo(SymbolTable fresh, MarketId market);
+	static std::string overrideKey(MarketId market, const std::string &symbol);
+	static void applyInfo(SymbolTable &table, SymbolTable::SymbolId id, const std::string &symbol, const std::unordered_map<std::string, std::string> &infoMap);
+	void logMemoryUsage() const;
+	// Needs writeMutex held; wakes the snapshot writer
+	void markSnapshotDirty();
+	void snapshotLoop();
+	// Copies the exchange data under writeMutex, then writes it to path without holding the lock
+	bool writeSnapshot(const std::string &path);
 
 public:
 	// Getter methods
-	const std::unordered_map<std::string, std::unordered_map<std::string, std::string>> &getSymbolInfoMap() const;
-	const std::unordered_map<std::string, std::string> &getSymbolInfo(const std::string &symbol) const;
+	// Text views rebuilt from the current snapshot, meant for tests and diagnostics
+	std::unordered_map<std::string, std::unordered_map<std::string, std::string>> getSymbolInfoMap(MarketId market = 0) const;
+	std::unordered_map<std::string, std::string> getSymbolInfo(const std::string &symbol, MarketId market = 0) const;
 
 	// Setter methods
+	// Replaces the whole table, every market included, with symbolInfoMap on market 0
 	void setSymbolInfoMap(const std::unordered_map<std::string, std::unordered_map<std::string, std::string>> &symbolInfoMap);
-	void setSymbolInfo(const std::string &symbol, const std::unordered_map<std::string, std::string> &infoMap);
+	void setSymbolInfo(const std::string &symbol, const std::unordered_map<std::string, std::string> &infoMap, MarketId market = 0);
+};
+
+// Refetches exchangeInfo every interval on its own thread and merges it into the parser. The body is
+// parsed while it streams in, on this thread, so queries only ever see the finished new version.
+class ExchangeInfoRefresher
+{
+public:
+	ExchangeInfoRefresher(JSONParser &jsonParser, const std::string &host, const std::string &port, const std::string &target, int version, std::chrono::seconds interval, MarketId market = 0);
+	~ExchangeInfoRefresher();
+	ExchangeInfoRefresher(const ExchangeInfoRefresher &) = delete;
+	ExchangeInfoRefresher &operator=(const ExchangeInfoRefresher &) = delete;
+
+	// One fetch and merge on the calling thread; false when the request or the parse failed
+	bool refreshNow();
+	// Starts the background thread; with an interval of zero it only refreshes on requestRefresh()
+	void start();
+	void stop();
+	// Makes the background thread refresh now instead of at the end of the interval, e.g. after a market
+	// stream missed messages; requests made while one is pending are merged. Safe from any thread.
+	void requestRefresh();
+
+	std::size_t getRefreshCount() const { return refreshCount; }
+	std::size_t getNotModifiedCount() const { return notModifiedCount; }
+	std::size_t getFailureCount() const { return failureCount; }
+
+private:
+	void run();
+
+	JSONParser &jsonParser;
+	HTTPRequest httpRequest;
+	std::string host;
+	std::string port;
+	std::string target;
+	int version;
+	std::chrono::seconds interval;
+	MarketId market;
+
+	std::thread worker;
+	std::mutex stopMutex;
+	std::condition_variable stopWake;
+	bool stopping = false;
+	bool refreshRequested = false;
+	CacheValidators validators;
+	std::atomic<std::size_t> refreshCount{0};
+	std::atomic<std::size_t> notModifiedCount{0};
+	std::atomic<std::size_t> failureCount{0};
+};
+
+// One exchangeInfo source, e.g. spot, USD-M or COIN-M futures
+struct MarketEndpoint
+{
+	std::string market;
+	std::string host;
+	std::string port = "443";
+	std::string target;
+};
+
+// Splits "https://host[:port]/path" into endpoint; false when the URL has no host or path
+bool parseEndpointUrl(const std::string &url, MarketEndpoint &endpoint);
+
+// Fetches the exchangeInfo of several markets at once: every request runs on one io_context with async
+// Beast operations, and each body is parsed and merged on a worker pool as soon as it arrives, so the
+// whole fetch takes about as long as the slowest market rather than the sum of them.
+class MarketFetcher
+{
+public:
+	// parseThreads of 0 uses one thread per endpoint, capped at the number of cores
+	explicit MarketFetcher(JSONParser &jsonParser, std::size_t parseThreads = 0);
+
+	// Registers each endpoint's market with the parser if needed; returns how many markets were merged
+	std::size_t fetchAll(const std::vector<MarketEndpoint> &endpoints, int version);
+
+private:
+	JSONParser &jsonParser;
+	std::size_t parseThreads;
+};
+
+// One WebSocket market-data connection, e.g. wss://fstream.binance.com/stream with "!contractInfo"
+struct MarketStreamOptions
+{
+	std::string host;
+	std::string port = "443";
+	// "/ws" for raw events, "/stream" for the combined {"stream", "data"} wrapping
+	std::string target = "/stream";
+	// Subscribed with a SUBSCRIBE request after every (re)connect
+	std::vector<std::string> streams;
+	// Reconnect delays double from the first to the last, with jitter; a connection that delivers a
+	// message starts the series over
+	std::chrono::milliseconds initialBackoff{250};
+	std::chrono::milliseconds maxBackoff{30000};
+	// After half of this without a frame the client pings; a connection silent for all of it is dropped
+	// and reconnected
+	std::chrono::seconds idleTimeout{30};
+};
+
+// Live exchange changes over a Binance WebSocket stream, applied to the parser as they arrive instead of
+// with the next exchangeInfo refresh. Runs its own asio event loop with async Beast operations on a
+// background thread; pings are answered, dead connections detected and reconnected with backoff.
+//
+// Events are objects carrying the symbol in "s". Symbol fields in them, by their exchangeInfo names
+// ("status", "tickSize", ...) or the short names of futures contractInfo events ("cs" status, "ct"
+// contract type), go through JSONParser::applyExchangeUpdate. Events with update ids are checked for
+// gaps per stream: "pu" has to be the previous "u", or else "U" has to follow it. A gap, and every
+// reconnect after the first connection, calls the resync handler, since changes may have been missed.
+class MarketStream
+{
+public:
+	using ResyncHandler = std::function<void(MarketId market)>;
+
+	MarketStream(JSONParser &jsonParser, const MarketStreamOptions &options, MarketId market = 0);
+	~MarketStream();
+	MarketStream(const MarketStream &) = delete;
+	MarketStream &operator=(const MarketStream &) = delete;
+
+	// Called on the stream's thread; set it before start()
+	void setResyncHandler(ResyncHandler handler);
+	// Connects on the background thread. stop() drops the connection for good, a stopped stream is not
+	// started again.
+	void start();
+	void stop();
+
+	// Decodes and applies one text frame; the stream's thread runs it for every message it reads. Also for
+	// feeding recorded traffic without a connection, but not while the stream is started.
+	void processMessage(const char *data, std::size_t size);
+
+	std::uint64_t getMessageCount() const;
+	// Events that changed the symbol table
+	std::uint64_t getAppliedCount() const;
+	std::uint64_t getGapCount() const;
+	// Successful handshakes, the first connection included
+	std::uint64_t getConnectionCount() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
 };
 
 class QueryHandler
 {
 public:
+	// A query id runs once. Both modes remember the most recent kMaxRememberedIds ids they ran; document
+	// mode also keeps every id of its last read, so a file bigger than the window is not run again. The
+	// memory starts over only when the query log is truncated or replaced, whose ids begin anew.
 	std::unordered_set<int> processedIds;
+	static constexpr std::size_t kMaxRememberedIds = 65536;
+
+	QueryHandler();
+	// batchThreads is the parallelism of handleBatch and document mode, counting the calling thread. 0 and
+	// 1 keep everything on the caller without starting a pool; more threads have only been measured on a
+	// single core, where they cost time, so they stay opt-in until multi-core numbers show a gain
+	explicit QueryHandler(const AnswerWriter::Options &answerOptions, std::size_t batchThreads = 1);
+	~QueryHandler();
+
+	// Answers the fields listed in the query's optional "data" array (case and underscores ignored, so
+	// "ticksize" and "contract_type" work), or status, tickSize, stepSize and quoteAsset without one
 	void handleGetQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser);
 	void handleUpdateQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser);
 	void handleDeleteQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser);
+	void dispatchQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser);
+	// GET of an already decoded query, for callers that answer somewhere else than the answer file (the
+	// query socket): same answer text, cache and logging as a JSON GET, fields 0 being the default set.
+	// The answer stays valid until the next call; false for a symbol that is not live.
+	bool answerGet(MarketId market, const std::string &symbol, SymbolFieldMask fields, JSONParser &jsonParser, const char *&answer, std::size_t &size);
+
+	// Runs queries as dependency-ordered groups. A query joins the first group after every earlier query
+	// it conflicts with, i.e. one on the same market and symbol where either side is an UPDATE or DELETE.
+	// Each group then runs in parallel on the pool, so reads run side by side and writes to one symbol
+	// keep their submission order. Answers are written in submission order.
+	void handleBatch(const std::vector<const rapidjson::Value *> &queries, JSONParser &jsonParser);
 
+	// Document mode: queryFile holds {"query": [...]} and is re-read as a whole; the new queries of each
+	// read go through handleBatch
 	void handleQueries(const std::string &queryFile, JSONParser &jsonParser);
+	// Log mode: logFile is append-only with one query object per line; only bytes appended since the
+	// previous call are read and parsed
+	void handleQueryLog(const std::string &logFile, JSONParser &jsonParser);
+
+	std::uint64_t getQueryLogOffset() const { return queryLogOffset; }
+	// Heap allocations of the arena query files and log records are parsed into (see JsonArena)
+	std::size_t getArenaHeapAllocations() const { return queryArena.heapAllocations(); }
+	// GET answers are batched here; flush() before reading the answer file
+	AnswerWriter &getAnswerWriter() { return answerWriter; }
+	// Ranges of batch work that ran on another pool thread than the one they were dealt to
+	std::uint64_t getBatchStealCount() const { return pool ? pool->getStealCount() : 0; }
+
+private:
+	// Serialized GET answer, the version of the row it was built from and the fields it holds. A row
+	// gets a new version on every UPDATE, DELETE or refresh that changes it, so an entry whose version
+	// still matches is exact.
+	struct CachedAnswer
+	{
+		std::uint64_t version = 0;
+		SymbolFieldMask fields = 0;
+		std::string answer;
+	};
+	// Two-way sets indexed by version, most recently used entry first
+	static constexpr unsigned kAnswerCacheSetBits = 11;
+	static std::size_t answerCacheSet(std::uint64_t version, SymbolFieldMask fields);
+
+	// What one thread needs to answer GETs; each batch worker has its own, so none of it is shared
+	struct GetWorker
+	{
+		std::vector<CachedAnswer> answerCache = std::vector<CachedAnswer>(std::size_t(2) << kAnswerCacheSetBits);
+		rapidjson::StringBuffer buffer;
+		// Answers of the current batch window, back to back
+		std::string batchAnswers;
+		// Symbol of the GET being answered
+		std::string symbol;
+	};
+	// Points answer at the serialized answer in worker's cache or buffer; false when there is none to write
+	static bool answerGet(const rapidjson::Value &queryObject, JSONParser &jsonParser, GetWorker &worker, const char *&answer, std::size_t &size);
+	// requireLive refuses unknown symbols too, which the answer file answers with {}
+	static bool answerSymbol(MarketId market, const std::string &symbol, SymbolFieldMask fields, bool requireLive, JSONParser &jsonParser, GetWorker &worker, const char *&answer, std::size_t &size);
+
+	// Queries handleBatch plans and runs at a time, bounding the answers held back for ordering
+	static constexpr std::size_t kBatchWindow = 65536;
+	void runBatchWindow(const rapidjson::Value *const *queries, std::size_t count, JSONParser &jsonParser);
+	// Adds id to the window of run ids; false when it is already there
+	bool rememberId(int id);
+	WorkStealingPool &batchPool();
+
+	AnswerWriter answerWriter;
+	GetWorker getWorker;
+	std::size_t batchThreads = 1;
+	std::unique_ptr<WorkStealingPool> pool;
+	std::vector<std::unique_ptr<GetWorker>> batchWorkers;
+	std::uint64_t queryLogOffset = 0;
+	unsigned long long queryLogInode = 0;
+	std::string queryLogBuffer;
+	std::deque<int> processedIdOrder;
+	// Document mode: ids of the last read, sorted, and scratch for the next one. Kept between reads with
+	// the arena the query file is parsed into, so a steady query file costs no allocations per query.
+	std::vector<int> documentIds;
+	std::vector<int> fileIds;
+	std::vector<std::pair<int, rapidjson::SizeType>> newIds;
+	std::vector<const rapidjson::Value *> newQueries;
+	JsonArena queryArena;
+	// Read rather than mapped, since the producer may truncate the file while it is open
+	MappedFile queryFileBytes;
+};
+
+// Low-latency query ingress: a Unix domain socket speaking the framing of QueryProtocol.h, served by one
+// asio event loop on a background thread. GETs are answered by a QueryHandler of its own (same answers,
+// projection and cache as the answer file), UPDATE and DELETE go to jsonParser like their JSON queries.
+// Clients may pipeline; each connection's requests run and are answered in the order they arrive.
+class QueryServer
+{
+public:
+	// Replaces a stale socket file at socketPath and removes it again on destruction
+	QueryServer(JSONParser &jsonParser, const std::string &socketPath);
+	~QueryServer();
+	QueryServer(const QueryServer &) = delete;
+	QueryServer &operator=(const QueryServer &) = delete;
+
+	std::uint64_t getRequestCount() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+// Blocks until a file is written, created or replaced, using inotify on its directory so editors that
+// save via rename are noticed too. Falls back to a plain sleep when inotify is unavailable.
+class QueryFileWatcher
+{
+public:
+	explicit QueryFileWatcher(const std::string &path);
+	~QueryFileWatcher();
+	QueryFileWatcher(const QueryFileWatcher &) = delete;
+	QueryFileWatcher &operator=(const QueryFileWatcher &) = delete;
+
+	// Returns true when the file changed, false when the timeout expired first
+	bool waitForChange(std::chrono::milliseconds timeout);
+
+private:
+	std::string fileName;
+	int inotifyFd = -1;
+	int watchDescriptor = -1;
+	std::vector<char> eventBuffer;
 };
 
 #endif
@@ -0,0 +1,322 @@
+#ifndef FIELD_REGISTRY_H
+#define FIELD_REGISTRY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "SymbolTable.h"
+
+// Smallest power of two that keeps a NameTable at most half full
+constexpr std::size_t nameTableSlots(std::size_t count)
+{
+	std::size_t slots = 1;
+	while (slots < 2 * count)
+	{
+		slots <<= 1;
+	}
+	return slots;
+}
+
+// Fixed set of names resolved through a perfect hash whose seed is searched for at compile time: a lookup
+// is one hash over the name, one probe and one comparison, however many names there are. The hash folds
+// case and skips underscores, so the same table serves exact lookups and the looser ones of queries.
+// nullptr entries are left out; lookups return the index of the entry, or N when nothing matches.
+template <std::size_t N>
+class NameTable
+{
+public:
+	constexpr explicit NameTable(const std::array<const char *, N> &entries)
+	{
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			names[i] = entries[i];
+			lengths[i] = entries[i] ? textLength(entries[i]) : 0;
+		}
+		while (seed < kMaxSeed && !place())
+		{
+			++seed;
+		}
+	}
+
+	// False when no seed separates the names, e.g. two that only differ in case or underscores
+	constexpr bool complete() const { return seed < kMaxSeed; }
+
+	std::size_t find(const char *name, std::size_t length) const
+	{
+		std::size_t i = candidate(name, length);
+		return i < N && lengths[i] == length && std::memcmp(names[i], name, length) == 0 ? i : N;
+	}
+
+	// Case and underscores ignored, so "ticksize" and "tick_size" find "tickSize"
+	std::size_t findLoose(const char *name, std::size_t length) const
+	{
+		std::size_t i = candidate(name, length);
+		return i < N && looseEqual(names[i], lengths[i], name, length) ? i : N;
+	}
+
+	constexpr const char *name(std::size_t i) const { return names[i]; }
+	constexpr std::size_t length(std::size_t i) const { return lengths[i]; }
+
+private:
+	static constexpr std::size_t kSlots = nameTableSlots(N);
+	static constexpr uint32_t kMaxSeed = 1u << 16;
+
+	static constexpr std::size_t textLength(const char *text)
+	{
+		std::size_t length = 0;
+		while (text[length] != '\0')
+		{
+			++length;
+		}
+		return length;
+	}
+
+	// FNV-1a over the folded bytes
+	static constexpr uint32_t hash(uint32_t seed, const char *name, std::size_t length)
+	{
+		uint32_t h = 2166136261u ^ seed;
+		for (std::size_t i = 0; i < length; ++i)
+		{
+			if (name[i] != '_')
+			{
+				h = (h ^ (static_cast<unsigned char>(name[i]) | 0x20u)) * 16777619u;
+			}
+		}
+		return h ^ (h >> 15);
+	}
+
+	// ASCII only, without the locale lookup of std::tolower
+	static char lower(char c)
+	{
+		return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+	}
+
+	static bool looseEqual(const char *expected, std::size_t expectedLength, const char *name, std::size_t length)
+	{
+		std::size_t i = 0;
+		std::size_t j = 0;
+		while (true)
+		{
+			while (i < expectedLength && expected[i] == '_')
+			{
+				++i;
+			}
+			while (j < length && name[j] == '_')
+			{
+				++j;
+			}
+			if (i == expectedLength || j == length)
+			{
+				return i == expectedLength && j == length;
+			}
+			if (lower(expected[i]) != lower(name[j]))
+			{
+				return false;
+			}
+			++i;
+			++j;
+		}
+	}
+
+	// Slots under the current seed; false on a collision
+	constexpr bool place()
+	{
+		for (std::size_t s = 0; s < kSlots; ++s)
+		{
+			slots[s] = 0;
+		}
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			if (!names[i])
+			{
+				continue;
+			}
+			std::size_t s = hash(seed, names[i], lengths[i]) & (kSlots - 1);
+			if (slots[s] != 0)
+			{
+				return false;
+			}
+			slots[s] = static_cast<uint16_t>(i + 1);
+		}
+		return true;
+	}
+
+	std::size_t candidate(const char *name, std::size_t length) const
+	{
+		std::size_t entry = slots[hash(seed, name, length) & (kSlots - 1)];
+		return entry ? entry - 1 : N;
+	}
+
+	const char *names[N] = {};
+	std::size_t lengths[N] = {};
+	// Entry index plus one, 0 for an empty slot
+	uint16_t slots[kSlots] = {};
+	uint32_t seed = 0;
+};
+
+// How a field's value is stored, which is also how an UPDATE value is checked
+enum class FieldKind : uint8_t
+{
+	Text,
+	// FixedDecimal; values that do not parse are refused
+	Decimal
+};
+
+struct FieldSpec
+{
+	SymbolField field;
+	// Name in exchangeInfo, GET answers and UPDATE queries
+	const char *name;
+	FieldKind kind;
+	// exchangeInfo filter that carries the field, nullptr for a member of the symbol object
+	const char *filterType;
+	// Filter type and key some markets use instead (USD-M futures)
+	const char *otherFilterType;
+	const char *otherName;
+	// A symbol without a valid value is dropped from exchangeInfo; other fields are left unset when absent
+	bool required;
+	// Part of a GET answer that does not list fields
+	bool answeredByDefault;
+};
+
+namespace fieldRegistryDetail
+{
+	template <std::size_t N>
+	constexpr bool coversEveryField(const FieldSpec (&specs)[N])
+	{
+		unsigned seen = 0;
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			if (specs[i].field >= SymbolField::Count || (seen & (1u << static_cast<unsigned>(specs[i].field))))
+			{
+				return false;
+			}
+			seen |= 1u << static_cast<unsigned>(specs[i].field);
+		}
+		return N == static_cast<std::size_t>(SymbolField::Count);
+	}
+
+	template <std::size_t N>
+	constexpr std::array<uint8_t, N> rowsByField(const FieldSpec (&specs)[N])
+	{
+		std::array<uint8_t, N> rows{};
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			rows[static_cast<std::size_t>(specs[i].field)] = static_cast<uint8_t>(i);
+		}
+		return rows;
+	}
+
+	// Names at the SymbolField's index; with otherNames, the other names follow at N + index
+	template <std::size_t N, std::size_t M>
+	constexpr std::array<const char *, M> namesByField(const FieldSpec (&specs)[N], bool otherNames)
+	{
+		std::array<const char *, M> names{};
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			std::size_t field = static_cast<std::size_t>(specs[i].field);
+			names[field] = specs[i].name;
+			if (otherNames)
+			{
+				names[N + field] = specs[i].otherName;
+			}
+		}
+		return names;
+	}
+
+	template <std::size_t N>
+	constexpr SymbolFieldMask defaultAnswerFields(const FieldSpec (&specs)[N])
+	{
+		SymbolFieldMask fields = 0;
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			if (specs[i].answeredByDefault)
+			{
+				fields = static_cast<SymbolFieldMask>(fields | (1u << static_cast<unsigned>(specs[i].field)));
+			}
+		}
+		return fields;
+	}
+}
+
+// What the query and parse paths know about each SymbolField, all derived at compile time from kSpecs
+struct FieldRegistry
+{
+	// One row per SymbolField, in the order GET answers list them. A new field needs its SymbolField entry,
+	// its SymbolTable column and a row here; name lookups, answers, UPDATE checks and the exchangeInfo
+	// extraction all follow from the row.
+	static constexpr FieldSpec kSpecs[] = {
+		// field, name, kind, filterType, otherFilterType, otherName, required, answeredByDefault
+		{SymbolField::Status, "status", FieldKind::Text, nullptr, nullptr, nullptr, true, true},
+		{SymbolField::TickSize, "tickSize", FieldKind::Decimal, "PRICE_FILTER", nullptr, nullptr, true, true},
+		{SymbolField::StepSize, "stepSize", FieldKind::Decimal, "LOT_SIZE", nullptr, nullptr, true, true},
+		{SymbolField::QuoteAsset, "quoteAsset", FieldKind::Text, nullptr, nullptr, nullptr, true, true},
+		{SymbolField::BaseAsset, "baseAsset", FieldKind::Text, nullptr, nullptr, nullptr, false, false},
+		{SymbolField::ContractType, "contractType", FieldKind::Text, nullptr, nullptr, nullptr, false, false},
+		{SymbolField::MinQty, "minQty", FieldKind::Decimal, "LOT_SIZE", nullptr, nullptr, false, false},
+		{SymbolField::MinNotional, "minNotional", FieldKind::Decimal, "NOTIONAL", "MIN_NOTIONAL", "notional", false, false},
+	};
+	static constexpr std::size_t kCount = sizeof(kSpecs) / sizeof(kSpecs[0]);
+	static_assert(fieldRegistryDetail::coversEveryField(kSpecs), "kSpecs needs exactly one row per SymbolField");
+
+	static constexpr SymbolFieldMask kDefaultAnswerFields = fieldRegistryDetail::defaultAnswerFields(kSpecs);
+
+	static constexpr std::array<uint8_t, kCount> kRows = fieldRegistryDetail::rowsByField(kSpecs);
+	// Field names, indexed by SymbolField
+	static constexpr NameTable<kCount> kNames{fieldRegistryDetail::namesByField<kCount, kCount>(kSpecs, false)};
+	// Keys exchangeInfo uses: a field's name at its SymbolField index, its other name kCount further
+	static constexpr NameTable<2 * kCount> kExchangeKeys{fieldRegistryDetail::namesByField<kCount, 2 * kCount>(kSpecs, true)};
+	static_assert(kNames.complete() && kExchangeKeys.complete(), "no perfect hash seed for the field names");
+
+	static constexpr const FieldSpec &spec(SymbolField field) { return kSpecs[kRows[static_cast<std::size_t>(field)]]; }
+	static constexpr std::size_t nameLength(SymbolField field) { return kNames.length(static_cast<std::size_t>(field)); }
+
+	static bool find(const char *name, std::size_t length, SymbolField &field) { return found(kNames.find(name, length), kCount, field); }
+	static bool findLoose(const char *name, std::size_t length, SymbolField &field) { return found(kNames.findLoose(name, length), kCount, field); }
+	static bool findExchangeKey(const char *key, std::size_t length, SymbolField &field)
+	{
+		std::size_t index = kExchangeKeys.find(key, length);
+		return found(index < kCount ? index : index - kCount, kCount, field);
+	}
+
+	// The fields exchangeInfo carries in a filter of this type; 0 for filters nothing is kept from
+	static SymbolFieldMask filterFields(const char *type, std::size_t length)
+	{
+		SymbolFieldMask fields = 0;
+		for (const FieldSpec &row : kSpecs)
+		{
+			if (matches(row.filterType, type, length) || matches(row.otherFilterType, type, length))
+			{
+				fields = static_cast<SymbolFieldMask>(fields | symbolFieldBit(row.field));
+			}
+		}
+		return fields;
+	}
+
+	// Whether an UPDATE may store value in the field
+	static bool validValue(SymbolField field, const std::string &value)
+	{
+		FixedDecimal decimal;
+		return spec(field).kind != FieldKind::Decimal || FixedDecimal::parse(value, decimal);
+	}
+
+private:
+	static bool found(std::size_t index, std::size_t count, SymbolField &field)
+	{
+		if (index >= count)
+		{
+			return false;
+		}
+		field = static_cast<SymbolField>(index);
+		return true;
+	}
+
+	static bool matches(const char *expected, const char *text, std::size_t length)
+	{
+		return expected && std::strlen(expected) == length && std::memcmp(expected, text, length) == 0;
+	}
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include "rapidjson/document.h"
+
+// Reusable memory for parsed rapidjson documents. The document's values and the parser's stack are
+// carved out of two buffers owned by the arena, and document() rewinds them instead of freeing: a
+// MemoryPoolAllocator only gives memory back when it is cleared, and the default stack is freed and
+// malloc'ed again by every Parse. A document that outgrows the buffers spills into heap chunks; the
+// next document() grows the buffers past that high-water mark, so a steady stream of similar documents
+// parses without touching the heap at all.
+//
+// Values of the arena's document are plain rapidjson::Value, so they go anywhere a Document's would.
+class JsonArena
+{
+public:
+	// Same value type as rapidjson::Document; only the parse stack is pooled as well
+	using Document = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>, rapidjson::MemoryPoolAllocator<>>;
+
+	explicit JsonArena(std::size_t valueBytes = 64 * 1024, std::size_t stackBytes = 16 * 1024);
+	~JsonArena();
+	JsonArena(const JsonArena &) = delete;
+	JsonArena &operator=(const JsonArena &) = delete;
+
+	// Empty document over the rewound arena. Everything the previous document() returned, and every
+	// value taken from it, is gone.
+	Document &document();
+
+	// Heap allocations the arena has made or seen: its buffers, plus one for every document that spilled
+	// out of them. Flat in steady state, which is what tests check.
+	std::size_t heapAllocations() const { return heapAllocationCount; }
+	std::size_t capacity() const { return valueBytes + stackBytes; }
+
+private:
+	void allocate();
+
+	std::size_t valueBytes;
+	std::size_t stackBytes;
+	std::unique_ptr<char[]> valueBuffer;
+	std::unique_ptr<char[]> stackBuffer;
+	std::optional<rapidjson::MemoryPoolAllocator<>> valuePool;
+	std::optional<rapidjson::MemoryPoolAllocator<>> stackPool;
+	// Declared after the pools, so it is destroyed before them
+	std::optional<Document> current;
+	std::size_t heapAllocationCount = 0;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef JSON_SCANNER_H
+#define JSON_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Implementation the block classifier runs on, picked from the CPU the process runs on
+enum class ScanBackend
+{
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+ScanBackend activeScanBackend();
+const char *scanBackendName(ScanBackend backend);
+bool scanBackendSupported(ScanBackend backend);
+// For tests and benchmarks: every scan classifies with backend from now on. False, changing nothing, when
+// the CPU lacks it. Not to be called while another thread scans.
+bool setScanBackend(ScanBackend backend);
+
+// On-demand JSON reader for documents of which only a small part is wanted, such as exchangeInfo.
+// parse() drives a rapidjson-style SAX handler, but only through the objects and arrays the handler
+// asks for: right after StartObject or StartArray, and after every member or element, it checks
+// handler.skipping(), and when that is true the rest of the container is jumped over and closed with
+// EndObject or EndArray straight away. Skipping classifies
+// 64 bytes at a time (quotes, backslashes, brackets) with AVX2 or SSE2 and tracks string and nesting state
+// with bit operations, so a skipped container costs a few instructions per 64 bytes instead of a token-by-
+// token parse.
+//
+// The parts that are walked are checked as strictly as rapidjson does; skipped containers are only checked
+// for balanced brackets and terminated strings, and skipped numbers and literals not at all.
+class JsonScanner
+{
+public:
+	using Refill = std::function<std::size_t(char *buffer, std::size_t size)>;
+
+	// Whole document in memory, which must outlive the scanner
+	JsonScanner(const char *data, std::size_t size);
+	// Streamed document, read through a buffer that only grows for a token longer than it
+	explicit JsonScanner(const Refill &refill, std::size_t bufferSize = 64 * 1024);
+
+	template <typename Handler>
+	bool parse(Handler &handler);
+
+	// Bytes consumed so far, i.e. the document size after a successful parse
+	std::size_t offset() const { return consumed + static_cast<std::size_t>(p - data); }
+	// Set when parse() fails
+	const char *error() const { return errorText; }
+	std::size_t errorOffset() const { return failedAt; }
+
+private:
+	static constexpr int kMaxDepth = 64;
+
+	template <typename Handler>
+	bool parseValue(Handler &handler, int depth);
+
+	// Moves the unread bytes to the front of the buffer and appends the next chunk; false at the end
+	bool fill();
+	// Positions p on the next non-whitespace byte; false at the end of the document
+	bool skipWhitespace();
+	// p on the opening quote; text stays valid until the next call
+	bool readString(const char *&text, std::size_t &length);
+	// p inside a container, outside of any string; ends right after the bracket that closes it
+	bool skipToClose();
+	// A number or literal outside of skipped containers, checked against the JSON grammar
+	bool skipScalar();
+	bool fail(const char *message);
+
+	const char *data;
+	const char *p;
+	const char *end;
+	std::size_t consumed = 0;
+	Refill refill;
+	std::vector<char> buffer;
+	bool exhausted = false;
+	// Unescaped copy of the last string that had escapes in it
+	std::string unescaped;
+	const char *errorText = nullptr;
+	std::size_t failedAt = 0;
+};
+
+template <typename Handler>
+bool JsonScanner::parse(Handler &handler)
+{
+	if (!parseValue(handler, 0))
+	{
+		return false;
+	}
+	if (skipWhitespace() && *p != '\0')
+	{
+		return fail("The document root must not be followed by other values.");
+	}
+	return true;
+}
+
+template <typename Handler>
+bool JsonScanner::parseValue(Handler &handler, int depth)
+{
+	if (depth > kMaxDepth)
+	{
+		return fail("Nesting too deep.");
+	}
+	if (!skipWhitespace())
+	{
+		return fail("The document is empty or ends early.");
+	}
+
+	const char *text;
+	std::size_t length;
+	if (*p == '"')
+	{
+		if (!readString(text, length))
+		{
+			return false;
+		}
+		return handler.String(text, static_cast<unsigned>(length), true) || fail("Terminated by the handler.");
+	}
+	if (*p != '{' && *p != '[')
+	{
+		return skipScalar() && (handler.Default() || fail("Terminated by the handler."));
+	}
+
+	bool object = *p == '{';
+	char close = object ? '}' : ']';
+	if (!(object ? handler.StartObject() : handler.StartArray()))
+	{
+		return fail("Terminated by the handler.");
+	}
+	unsigned count = 0;
+	++p;
+	if (handler.skipping())
+	{
+		if (!skipToClose())
+		{
+			return false;
+		}
+		return (object ? handler.EndObject(count) : handler.EndArray(count)) || fail("Terminated by the handler.");
+	}
+
+	if (!skipWhitespace())
+	{
+		return fail("Missing a closing bracket.");
+	}
+	while (*p != close)
+	{
+		if (object)
+		{
+			if (*p != '"')
+			{
+				return fail("Missing a name for object member.");
+			}
+			if (!readString(text, length))
+			{
+				return false;
+			}
+			if (!handler.Key(text, static_cast<unsigned>(length), true))
+			{
+				return fail("Terminated by the handler.");
+			}
+			if (!skipWhitespace() || *p != ':')
+			{
+				return fail("Missing a colon after a name of object member.");
+			}
+			++p;
+		}
+		if (!parseValue(handler, depth + 1))
+		{
+			return false;
+		}
+		++count;
+		if (handler.skipping())
+		{
+			if (!skipToClose())
+			{
+				return false;
+			}
+			return (object ? handler.EndObject(count) : handler.EndArray(count)) || fail("Terminated by the handler.");
+		}
+		if (!skipWhitespace())
+		{
+			return fail("Missing a closing bracket.");
+		}
+		if (*p == ',')
+		{
+			++p;
+			if (!skipWhitespace() || *p == close)
+			{
+				return fail("Trailing comma or missing value.");
+			}
+		}
+		else if (*p != close)
+		{
+			return fail(object ? "Missing a comma or '}' after an object member." : "Missing a comma or ']' after an array element.");
+		}
+	}
+	++p;
+	return (object ? handler.EndObject(count) : handler.EndArray(count)) || fail("Terminated by the handler.");
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef BINANCE_LOGGING_H
+#define BINANCE_LOGGING_H
+
+#include <memory>
+#include <string>
+#include "spdlog/spdlog.h"
+#include "spdlog/async_logger.h"
+#include "rapidjson/document.h"
+
+// Logger setup driven by the "logging" object in config.json:
+//   "level":      trace, debug, info, warn, error, fatal (alias of critical) or off
+//   "file":       true for logs/binance_exchange_logs.log, or a path, false to disable
+//   "console":    true to also log to stdout
+//   "async":      hand records to a background thread instead of writing on the caller (default true)
+//   "queue_size": records the async queue holds before the overflow policy applies (default 8192)
+//   "overflow":   "block" waits for room, "overrun_oldest" drops the oldest queued record
+struct LoggingOptions
+{
+	spdlog::level::level_enum level = spdlog::level::info;
+	std::string filePath = "logs/binance_exchange_logs.log"; // empty disables the file sink
+	bool console = false;
+	bool async = true;
+	std::size_t queueSize = 8192;
+	spdlog::async_overflow_policy overflowPolicy = spdlog::async_overflow_policy::block;
+};
+
+// Fills options from config["logging"]; logs nothing and returns false on the first invalid value
+bool readLoggingOptions(const rapidjson::Value &config, LoggingOptions &options, std::string &error);
+
+// Builds and registers the logger. All async loggers share spdlog's global thread pool, which is
+// created with the queue size of the first async logger.
+std::shared_ptr<spdlog::logger> createLogger(const std::string &name, const LoggingOptions &options);
+
+#endif
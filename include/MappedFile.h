@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file. Regular files are mapped, so parsing straight from data() touches the
+// page cache without copying the file onto the heap; pipes, FIFOs and other files that cannot be mapped
+// are read into an owned buffer instead. Either way data()[size()] is a NUL, so the view can go to
+// rapidjson's Parse(const char *), which skips the per-character bounds check of Parse(data, size).
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Replaces any previous contents; on failure returns false with errno set and the view empty
+	bool open(const std::string &path);
+	// Like open, but always reads into the owned buffer, keeping its capacity from the last read. For files
+	// another process may truncate or rewrite while they are in use, where a mapping would raise SIGBUS on
+	// the pages that went away.
+	bool read(const std::string &path);
+	void close();
+
+	const char *data() const { return bytes; }
+	std::size_t size() const { return length; }
+	bool isMapped() const { return mapping != nullptr; }
+
+private:
+	bool load(const std::string &path, bool map);
+	void unmap();
+
+	void *mapping = nullptr;
+	std::string buffer;
+	std::size_t mappedSize = 0;
+	const char *bytes = buffer.c_str();
+	std::size_t length = 0;
+};
+
+#endif
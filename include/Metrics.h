@@ -0,0 +1,135 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Latency histogram with HDR-style log-linear buckets: values below 64 ns are exact, above that every
+// power of two is split into 32 buckets, so any quantile is within about 3% of the recorded value.
+// Writers never lock: each thread adds to one of kShards copies of the counters with relaxed atomics,
+// and readers sum the shards, so a report taken during a burst may be a few records behind.
+class LatencyHistogram
+{
+public:
+	static constexpr unsigned kSubBucketBits = 5;
+	static constexpr unsigned kBuckets = 1152; // up to 2^40 ns (about 18 minutes), larger values clamp
+	static constexpr unsigned kShards = 8;
+
+	// Merged view of every shard at one point in time
+	struct Snapshot
+	{
+		std::vector<std::uint64_t> counts;
+		std::uint64_t count = 0;
+		std::uint64_t sumNs = 0;
+
+		// Upper estimate of the value below which fraction of the records fall, in nanoseconds
+		std::uint64_t quantileNs(double fraction) const;
+	};
+
+	void record(std::uint64_t nanoseconds);
+	void record(std::chrono::steady_clock::duration elapsed);
+	Snapshot snapshot() const;
+	void reset();
+
+	static unsigned bucketIndex(std::uint64_t nanoseconds);
+	// Largest value that lands in the bucket
+	static std::uint64_t bucketUpperBound(unsigned index);
+
+private:
+	struct alignas(64) Shard
+	{
+		std::array<std::atomic<std::uint64_t>, kBuckets> counts{};
+		std::atomic<std::uint64_t> sumNs{0};
+	};
+
+	std::array<Shard, kShards> shards;
+};
+
+// Records the time from construction to destruction (or to stop()) into a histogram. steady_clock
+// reads the TSC through the vDSO on Linux, so a span costs two ~20 ns clock reads.
+class LatencySpan
+{
+public:
+	explicit LatencySpan(LatencyHistogram &histogram) : histogram(&histogram), start(std::chrono::steady_clock::now()) {}
+	~LatencySpan() { stop(); }
+	LatencySpan(const LatencySpan &) = delete;
+	LatencySpan &operator=(const LatencySpan &) = delete;
+
+	void stop()
+	{
+		if (histogram)
+		{
+			histogram->record(std::chrono::steady_clock::now() - start);
+			histogram = nullptr;
+		}
+	}
+
+private:
+	LatencyHistogram *histogram;
+	std::chrono::steady_clock::time_point start;
+};
+
+// Process-wide hot-path measurements
+struct Metrics
+{
+	// Phases of an exchangeInfo request, blocking sessions and MarketFetcher alike
+	LatencyHistogram httpResolve;
+	LatencyHistogram httpConnect;
+	LatencyHistogram httpHandshake;
+	LatencyHistogram httpWrite;
+	LatencyHistogram httpRead;
+
+	// One record per exchangeInfo parse, and the same time scaled to one MB of input
+	LatencyHistogram parse;
+	LatencyHistogram parsePerMB;
+	std::atomic<std::uint64_t> parsedBytes{0};
+
+	// Query dispatch, by query type
+	LatencyHistogram queryGet;
+	LatencyHistogram queryUpdate;
+	LatencyHistogram queryDelete;
+	// GETs answered from the serialized answer cache, and those that had to build the answer
+	std::atomic<std::uint64_t> answerCacheHits{0};
+	std::atomic<std::uint64_t> answerCacheMisses{0};
+
+	// Prometheus text exposition format (version 0.0.4)
+	std::string renderPrometheus() const;
+	// One info line per histogram that has records
+	void logSummary() const;
+};
+
+Metrics &metrics();
+
+struct MetricsOptions
+{
+	// Serve GET /metrics over plain HTTP; port 0 picks a free port
+	bool listen = false;
+	std::string address = "127.0.0.1";
+	unsigned short port = 9464;
+	// Seconds between summaries written to the log, 0 for none
+	std::chrono::seconds logInterval{0};
+};
+
+// Small Beast HTTP listener for Prometheus plus the periodic log dump, both on one background thread
+class MetricsExporter
+{
+public:
+	explicit MetricsExporter(const MetricsOptions &options);
+	~MetricsExporter();
+	MetricsExporter(const MetricsExporter &) = delete;
+	MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+	// Port actually bound, 0 when not listening
+	unsigned short port() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef ORDER_BOOK_H
+#define ORDER_BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "rapidjson/reader.h"
+#include "SymbolSnapshot.h"
+
+// One price level in integer form: the price in ticks of the symbol's tickSize, the quantity in units of
+// 10^-quantityScale (the scale of its stepSize). Quantities are absolute, 0 removes the level.
+struct DepthLevel
+{
+	int64_t ticks = 0;
+	int64_t quantity = 0;
+};
+
+// A depth snapshot (lastUpdateId in lastId) or a diff event ("U", "u" and, on futures, "pu")
+struct DepthUpdate
+{
+	uint64_t firstId = 0;
+	uint64_t lastId = 0;
+	uint64_t previousId = 0;
+	bool hasPreviousId = false;
+	std::vector<DepthLevel> bids;
+	std::vector<DepthLevel> asks;
+};
+
+// L2 order book of one symbol, kept in sync with Binance's depth snapshot + diff stream procedure:
+// diffs that arrive before the snapshot are buffered, those the snapshot already covers (u <= its
+// lastUpdateId) are dropped, the first one applied has to straddle lastUpdateId + 1, and every later one
+// has to continue its predecessor (U = previous u + 1, or pu = previous u on futures). A diff that does
+// not is a gap; the book then waits, buffering again, for a new snapshot.
+//
+// Each side is a flat array of levels sorted so that the best price is at the back: the best bid and
+// ask are O(1), and an update near the top of the book, where nearly all of them land, moves only the
+// few levels above it. Prices never leave the integer domain, so levels compare exactly.
+class OrderBook
+{
+public:
+	enum class Result
+	{
+		Applied,
+		// The diff or snapshot is not newer than the book; nothing changed
+		Stale,
+		// Kept until a snapshot arrives
+		Buffered,
+		// Missing events between the book and this diff; a new snapshot is needed
+		Gap,
+		// Malformed JSON, or a price or quantity that is not a whole number of ticks or quantity units
+		Rejected
+	};
+
+	// Diffs buffered while waiting for a snapshot, beyond which the oldest are dropped
+	static constexpr std::size_t kMaxBufferedUpdates = 4096;
+
+	// tickSize must be positive; quantities may have at most as many decimals as stepSize
+	OrderBook(FixedDecimal tickSize, FixedDecimal stepSize);
+	// Book for a symbol of the table, with its tickSize and stepSize; nullptr when the symbol is unknown
+	// or misses either. A later tickSize change needs a new book.
+	static std::unique_ptr<OrderBook> forSymbol(const SymbolSnapshot &snapshot, const std::string &symbol, MarketId market = 0);
+
+	// Replaces the book with the snapshot and replays the buffered diffs after it
+	Result applySnapshot(const DepthUpdate &snapshot);
+	Result applyDiff(const DepthUpdate &update);
+	// Same for the REST snapshot {"lastUpdateId", "bids", "asks"} and for diff events, raw or wrapped in
+	// a combined stream's {"stream", "data"}; parsing reuses the book's buffers
+	Result applySnapshot(const char *json, std::size_t size);
+	Result applyDiff(const char *json, std::size_t size);
+
+	bool synced() const { return isSynced; }
+	uint64_t lastUpdateId() const { return lastId; }
+	std::size_t bidLevels() const { return bids.size(); }
+	std::size_t askLevels() const { return asks.size(); }
+	// False when the side is empty
+	bool bestBid(DepthLevel &level) const;
+	bool bestAsk(DepthLevel &level) const;
+	// Level i of a side counted from the best price, i < bidLevels() or askLevels()
+	const DepthLevel &bid(std::size_t i) const { return bids[bids.size() - 1 - i]; }
+	const DepthLevel &ask(std::size_t i) const { return asks[asks.size() - 1 - i]; }
+
+	// Integer form of a price or quantity text; false when it is not a whole number of ticks or units
+	bool toTicks(const char *price, std::size_t length, int64_t &ticks) const;
+	bool toQuantity(const char *quantity, std::size_t length, int64_t &units) const;
+	FixedDecimal price(int64_t ticks) const { return {ticks * tickSize.mantissa, tickSize.scale}; }
+	FixedDecimal quantity(int64_t units) const { return {units, quantityScale}; }
+
+private:
+	class DepthHandler;
+
+	// Bids ascending and asks descending, so better is always further back
+	static void setLevel(std::vector<DepthLevel> &side, const DepthLevel &level, bool ascending);
+	void applyLevels(const DepthUpdate &update);
+	Result applyInSequence(const DepthUpdate &update);
+	Result parse(const char *json, std::size_t size);
+
+	FixedDecimal tickSize;
+	uint8_t quantityScale;
+	std::vector<DepthLevel> bids;
+	std::vector<DepthLevel> asks;
+	uint64_t lastId = 0;
+	bool isSynced = false;
+	// No diff applied since the snapshot yet, the next one has to straddle it
+	bool firstAfterSnapshot = false;
+	std::deque<DepthUpdate> buffered;
+
+	// Scratch for the JSON entry points
+	rapidjson::Reader reader;
+	DepthUpdate decoded;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef ORDER_NORMALIZER_H
+#define ORDER_NORMALIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SymbolSnapshot.h"
+
+// Reasons validate() refuses an order, OR-ed together
+struct OrderViolation
+{
+	// Not in the snapshot, or a filter with more decimals than OrderNormalizer::kScale
+	static constexpr uint8_t UnknownSymbol = 1 << 0;
+	static constexpr uint8_t NotTrading = 1 << 1;
+	static constexpr uint8_t NonPositive = 1 << 2;
+	static constexpr uint8_t PriceOffTick = 1 << 3;
+	static constexpr uint8_t QuantityOffStep = 1 << 4;
+	static constexpr uint8_t BelowMinQty = 1 << 5;
+	static constexpr uint8_t BelowMinNotional = 1 << 6;
+};
+
+// Rounds and checks order prices and quantities against the symbols' tickSize, stepSize, minQty and
+// minNotional. Everything is an int64 count of 10^-kScale units ("0.015" is 1500000), so results are exact
+// decimals and the hot path never touches text or floating point.
+//
+// The filters are turned into units once, when the normalizer is built from a snapshot; build a new one
+// for a new snapshot. Every symbol gets a dense slot, and the batch calls take struct-of-arrays inputs so
+// a gateway can run a whole burst of orders through one tight loop. Those loops are branch-free:
+// remainders come from a precomputed reciprocal (a multiply-high and one correction) instead of a
+// division, and rounding and each check are arithmetic on the remainder.
+class OrderNormalizer
+{
+public:
+	using Slot = uint32_t;
+
+	// Binance's prices and quantities have at most eight decimals
+	static constexpr uint8_t kScale = 8;
+	static constexpr int64_t kUnitsPerOne = 100000000;
+	// Slot of every unknown symbol; it fails validation and rounds nothing
+	static constexpr Slot kUnknownSlot = 0;
+
+	enum class Rounding : uint8_t
+	{
+		Down,
+		Up,
+		// Half up
+		Nearest
+	};
+
+	OrderNormalizer();
+	explicit OrderNormalizer(const SymbolSnapshot &snapshot);
+
+	// Resolve once per symbol, not per order
+	Slot find(const std::string &symbol, MarketId market = 0) const;
+	// Slots in use, kUnknownSlot included
+	std::size_t size() const { return tick.size(); }
+
+	// Prices and quantities must be positive; anything else rounds to 0. A tick or step the symbol does not
+	// have leaves the value as is.
+	int64_t roundPrice(Slot slot, int64_t price, Rounding rounding = Rounding::Nearest) const;
+	int64_t roundQuantity(Slot slot, int64_t quantity, Rounding rounding = Rounding::Down) const;
+	uint8_t validate(Slot slot, int64_t price, int64_t quantity) const;
+
+	// Same over count orders, in place for the rounding
+	void roundPrices(const Slot *slots, int64_t *prices, std::size_t count, Rounding rounding = Rounding::Nearest) const;
+	void roundQuantities(const Slot *slots, int64_t *quantities, std::size_t count, Rounding rounding = Rounding::Down) const;
+	void validate(const Slot *slots, const int64_t *prices, const int64_t *quantities, uint8_t *violations, std::size_t count) const;
+
+	// Text <-> units at the edge of the gateway; false when the text has more than kScale decimals
+	static bool toUnits(const char *text, std::size_t length, int64_t &units);
+	static std::string toString(int64_t units);
+
+private:
+	// d and floor((2^64 - 1) / d): for n < 2^63 the multiply-high of n and magic is n / d or one less
+	struct Divisor
+	{
+		int64_t value = 1;
+		uint64_t magic = UINT64_MAX;
+
+		static Divisor of(int64_t value);
+		int64_t remainder(int64_t n) const;
+	};
+
+	template <Rounding R>
+	static void roundAll(const std::vector<Divisor> &divisors, const Slot *slots, int64_t *values, std::size_t count);
+
+	Slot add(uint8_t flags, const Divisor &tickSize, const Divisor &stepSize, int64_t minQuantity, int64_t minNotionalValue);
+
+	// One entry per slot
+	std::vector<Divisor> tick;
+	std::vector<Divisor> step;
+	std::vector<int64_t> minQty;
+	std::vector<int64_t> minNotional;
+	// UnknownSymbol and NotTrading, known up front
+	std::vector<uint8_t> symbolFlags;
+
+	std::vector<std::unordered_map<std::string, Slot>> slotsByMarket;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef QUERY_PROTOCOL_H
+#define QUERY_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include "SymbolTable.h"
+
+// Binary framing of the query socket. Every frame is a uint32 body length followed by the body; all
+// integers are in host byte order, the socket being local. A client may send any number of requests
+// before reading; responses come back one per request, in request order, carrying the request's id.
+//
+// Request body:  uint32 id, uint8 type, uint8 market length + market name ("" is market 0),
+//                uint8 symbol length + symbol, then by type
+//                  GET     uint16 SymbolFieldMask, 0 for the default fields
+//                  UPDATE  uint8 count, then count times uint8 SymbolField, uint8 length + value
+//                  DELETE  nothing
+// Response body: uint32 id, uint8 WireStatus, then for a GET answered with Ok the same JSON object
+//                QueryHandler writes to the answer file
+enum class WireQueryType : uint8_t
+{
+	Get = 1,
+	Update = 2,
+	Delete = 3,
+};
+
+enum class WireStatus : uint8_t
+{
+	Ok = 0,
+	NotFound = 1,	// UPDATE or DELETE of a symbol that is not live, or GET of a deleted one
+	BadRequest = 2, // unknown market, field or type, or a malformed value
+};
+
+struct WireQuery
+{
+	uint32_t id = 0;
+	WireQueryType type = WireQueryType::Get;
+	std::string market;
+	std::string symbol;
+	SymbolFieldMask fields = 0;
+	std::vector<std::pair<SymbolField, std::string>> updates;
+};
+
+// Frames larger than this end the connection
+constexpr std::size_t kMaxWireFrame = 64 * 1024;
+constexpr std::size_t kWireLengthSize = sizeof(uint32_t);
+
+// Append one complete frame, length prefix included, to out
+void encodeWireQuery(const WireQuery &query, std::string &out);
+void encodeWireResponse(uint32_t id, WireStatus status, const char *answer, std::size_t size, std::string &out);
+
+// Decode one frame body, the bytes after the length prefix. query is reused, so its strings keep their
+// capacity from one request to the next. False when the body is truncated or has bytes left over.
+bool decodeWireQuery(const char *body, std::size_t size, WireQuery &query);
+bool decodeWireResponse(const char *body, std::size_t size, uint32_t &id, WireStatus &status, const char *&answer, std::size_t &answerSize);
+
+// Body length of the frame starting at data, once its prefix is complete
+inline bool wireFrameLength(const char *data, std::size_t available, uint32_t &length)
+{
+	if (available < kWireLengthSize)
+	{
+		return false;
+	}
+	std::memcpy(&length, data, sizeof(length));
+	return true;
+}
+
+#endif
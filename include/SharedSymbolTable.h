@@ -0,0 +1,272 @@
+#ifndef SHARED_SYMBOL_TABLE_H
+#define SHARED_SYMBOL_TABLE_H
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SymbolTable.h"
+
+// Layout of the POSIX shared-memory segment the handler publishes its symbol table into, and a reader
+// for other processes on the same host. Header only: a strategy process includes this file and nothing
+// else of the handler (SymbolTable.h only contributes the enums), and links no library.
+//
+// The segment is a header, a fixed array of records and an open-addressing index from (market, symbol)
+// to record slot. A slot is handed out the first time the handler sees a symbol and is never reused, so
+// a reader resolves a name once and then reads by slot. Each record is a seqlock: the writer makes its
+// sequence odd, stores the data words, then makes it even again; a reader copies the words and retries
+// when the sequence was odd or moved meanwhile, so it never returns half of one write and half of the
+// next, and never blocks the writer.
+//
+// Markets are the handler's ids, in the order its config lists them; 0 is the first.
+constexpr char kSharedSymbolMagic[8] = {'B', 'N', 'S', 'H', 'M', '\0', '\0', '\0'};
+// Bump whenever SharedSymbolHeader, SharedSymbolRecord or SharedSymbolData changes shape
+constexpr uint32_t kSharedSymbolLayoutVersion = 1;
+constexpr std::size_t kSharedSymbolMaxName = 26;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory atomics must be lock-free");
+
+// One symbol's values as the handler last wrote them. Decimals are mantissa and scale as in
+// FixedDecimal, scale 0xFF when the field is absent; texts are NUL-padded and cut at their size.
+struct SharedSymbolData
+{
+	// The handler's row version, changes with every write of the row
+	uint64_t version;
+	int64_t tickMantissa;
+	int64_t stepMantissa;
+	int64_t minQtyMantissa;
+	int64_t minNotionalMantissa;
+	uint8_t tickScale;
+	uint8_t stepScale;
+	uint8_t minQtyScale;
+	uint8_t minNotionalScale;
+	uint8_t live;
+	// SymbolStatus, or a value past SymbolStatus::Count for a status only statusText names
+	uint8_t status;
+	SymbolFieldMask fields;
+	char statusText[16];
+	char quoteAsset[16];
+	char baseAsset[16];
+	char contractType[24];
+
+	bool has(SymbolField field) const { return fields & symbolFieldBit(field); }
+	double tickSize() const { return value(tickMantissa, tickScale); }
+	double stepSize() const { return value(stepMantissa, stepScale); }
+	double minQty() const { return value(minQtyMantissa, minQtyScale); }
+	double minNotional() const { return value(minNotionalMantissa, minNotionalScale); }
+
+	// NaN when absent
+	static double value(int64_t mantissa, uint8_t scale)
+	{
+		return scale > 18 ? std::numeric_limits<double>::quiet_NaN() : static_cast<double>(mantissa) / std::pow(10.0, scale);
+	}
+};
+static_assert(sizeof(SharedSymbolData) % sizeof(uint64_t) == 0, "record data is copied in whole words");
+
+struct SharedSymbolRecord
+{
+	// Odd while the writer is inside the record
+	std::atomic<uint32_t> sequence;
+	// Written once, before the slot is entered in the index, and never changed after
+	MarketId market;
+	uint8_t nameLength;
+	char name[kSharedSymbolMaxName];
+	// SharedSymbolData, word by word, so concurrent copies are well defined
+	std::atomic<uint64_t> words[sizeof(SharedSymbolData) / sizeof(uint64_t)];
+};
+
+struct SharedSymbolHeader
+{
+	char magic[8];
+	uint32_t layoutVersion;
+	uint32_t capacity;
+	// Power of two, at least twice the capacity
+	uint32_t indexSlots;
+	uint32_t reserved;
+	// Slots handed out so far
+	std::atomic<uint32_t> rowCount;
+	// Set when the handler stops or starts over with a new segment; this one is no longer written
+	std::atomic<uint32_t> retired;
+	// Bumped after every batch of writes, for readers that poll for changes
+	std::atomic<uint64_t> publishCount;
+};
+
+// Address arithmetic over a mapped segment, shared by the handler's writer and SharedSymbolReader
+class SharedSymbolSegment
+{
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	SharedSymbolSegment() = default;
+	explicit SharedSymbolSegment(void *base) : base(static_cast<char *>(base)) {}
+
+	static uint32_t indexSlotsFor(uint32_t capacity)
+	{
+		uint32_t slots = 16;
+		while (slots < 2 * static_cast<uint64_t>(capacity))
+		{
+			slots *= 2;
+		}
+		return slots;
+	}
+	static std::size_t bytesFor(uint32_t capacity)
+	{
+		return sizeof(SharedSymbolHeader) + capacity * sizeof(SharedSymbolRecord) + indexSlotsFor(capacity) * sizeof(std::atomic<uint32_t>);
+	}
+
+	static uint32_t hash(const char *symbol, std::size_t length, MarketId market)
+	{
+		// FNV-1a
+		uint32_t hash = 2166136261u ^ market;
+		for (std::size_t i = 0; i < length; ++i)
+		{
+			hash = (hash ^ static_cast<unsigned char>(symbol[i])) * 16777619u;
+		}
+		return hash;
+	}
+
+	SharedSymbolHeader &header() const { return *reinterpret_cast<SharedSymbolHeader *>(base); }
+	SharedSymbolRecord &record(uint32_t slot) const { return reinterpret_cast<SharedSymbolRecord *>(base + sizeof(SharedSymbolHeader))[slot]; }
+	// Slot + 1 of the record, 0 for an empty entry
+	std::atomic<uint32_t> &indexEntry(uint32_t position) const
+	{
+		return reinterpret_cast<std::atomic<uint32_t> *>(base + sizeof(SharedSymbolHeader) + header().capacity * sizeof(SharedSymbolRecord))[position];
+	}
+
+	uint32_t find(const char *symbol, std::size_t length, MarketId market) const
+	{
+		uint32_t mask = header().indexSlots - 1;
+		for (uint32_t position = hash(symbol, length, market) & mask;; position = (position + 1) & mask)
+		{
+			uint32_t entry = indexEntry(position).load(std::memory_order_acquire);
+			if (entry == 0)
+			{
+				return npos;
+			}
+			const SharedSymbolRecord &candidate = record(entry - 1);
+			if (candidate.market == market && candidate.nameLength == length && std::memcmp(candidate.name, symbol, length) == 0)
+			{
+				return entry - 1;
+			}
+		}
+	}
+
+private:
+	char *base = nullptr;
+};
+
+// Read-only view of a segment in another process. Lookups are lock-free and copy one record.
+class SharedSymbolReader
+{
+public:
+	static constexpr uint32_t npos = SharedSymbolSegment::npos;
+
+	SharedSymbolReader() = default;
+	~SharedSymbolReader() { close(); }
+	SharedSymbolReader(const SharedSymbolReader &) = delete;
+	SharedSymbolReader &operator=(const SharedSymbolReader &) = delete;
+
+	// name as given to shm_open, e.g. "/binance_symbols". False, with errno set, when the segment is
+	// missing or not of this layout version (EPROTO).
+	bool open(const std::string &name)
+	{
+		close();
+		int fd = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat status;
+		bool statted = ::fstat(fd, &status) == 0;
+		if (!statted || static_cast<std::size_t>(status.st_size) < sizeof(SharedSymbolHeader))
+		{
+			int error = statted ? EPROTO : errno;
+			::close(fd);
+			errno = error;
+			return false;
+		}
+		void *mapping = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (mapping == MAP_FAILED)
+		{
+			return false;
+		}
+		const SharedSymbolHeader &header = *static_cast<const SharedSymbolHeader *>(mapping);
+		if (std::memcmp(header.magic, kSharedSymbolMagic, sizeof(header.magic)) != 0 || header.layoutVersion != kSharedSymbolLayoutVersion ||
+			header.indexSlots != SharedSymbolSegment::indexSlotsFor(header.capacity) ||
+			SharedSymbolSegment::bytesFor(header.capacity) > static_cast<std::size_t>(status.st_size))
+		{
+			::munmap(mapping, static_cast<std::size_t>(status.st_size));
+			errno = EPROTO;
+			return false;
+		}
+		segment = SharedSymbolSegment(mapping);
+		mappedSize = static_cast<std::size_t>(status.st_size);
+		return true;
+	}
+
+	void close()
+	{
+		if (mappedSize > 0)
+		{
+			::munmap(&segment.header(), mappedSize);
+			segment = SharedSymbolSegment();
+			mappedSize = 0;
+		}
+	}
+
+	bool isOpen() const { return mappedSize > 0; }
+
+	// Slot of a symbol the handler has seen, live or not; npos otherwise. Stable for the segment's life.
+	uint32_t find(const char *symbol, std::size_t length, MarketId market = 0) const { return segment.find(symbol, length, market); }
+	uint32_t find(const std::string &symbol, MarketId market = 0) const { return find(symbol.data(), symbol.size(), market); }
+
+	// Consistent copy of one record; false when the slot is out of range or the symbol is not live
+	bool read(uint32_t slot, SharedSymbolData &out) const
+	{
+		if (slot >= segment.header().rowCount.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		const SharedSymbolRecord &record = segment.record(slot);
+		uint64_t words[sizeof(SharedSymbolData) / sizeof(uint64_t)];
+		for (;;)
+		{
+			uint32_t before = record.sequence.load(std::memory_order_acquire);
+			if (before & 1)
+			{
+				continue;
+			}
+			for (std::size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i)
+			{
+				words[i] = record.words[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (record.sequence.load(std::memory_order_relaxed) == before)
+			{
+				break;
+			}
+		}
+		std::memcpy(&out, words, sizeof(out));
+		return out.live != 0;
+	}
+
+	std::size_t rowCount() const { return segment.header().rowCount.load(std::memory_order_acquire); }
+	uint64_t publishCount() const { return segment.header().publishCount.load(std::memory_order_acquire); }
+	// The handler has stopped or replaced the segment; open it again to follow a restarted handler
+	bool retired() const { return segment.header().retired.load(std::memory_order_acquire) != 0; }
+
+private:
+	SharedSymbolSegment segment;
+	std::size_t mappedSize = 0;
+};
+
+#endif
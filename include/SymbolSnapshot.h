@@ -0,0 +1,62 @@
+#ifndef SYMBOL_SNAPSHOT_H
+#define SYMBOL_SNAPSHOT_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SymbolTable.h"
+
+// One immutable, published version of the symbol table. The base table is shared by every version
+// built from it; UPDATE and DELETE only copy the small delta table holding the rows changed since
+// (deleted rows stay in it as tombstones). Once the delta grows past a fraction of the base the two
+// are merged into a new base, so the amortised cost of a write stays a few row copies.
+class SymbolSnapshot
+{
+public:
+	// A live row in either the base or the delta table
+	struct Row
+	{
+		const SymbolTable *table = nullptr;
+		SymbolTable::SymbolId id = SymbolTable::npos;
+
+		explicit operator bool() const { return table != nullptr; }
+	};
+
+	using RowEdit = std::function<void(SymbolTable &table, SymbolTable::SymbolId id)>;
+
+	SymbolSnapshot();
+	explicit SymbolSnapshot(SymbolTable base);
+
+	Row find(const std::string &symbol, MarketId market = 0) const;
+	std::size_t size() const { return liveCount; }
+	std::unordered_map<std::string, std::string> toMap(const std::string &symbol, MarketId market = 0) const;
+	// Calls visit for every live symbol of every market, in no particular order
+	void forEach(const std::function<void(const std::string &symbol, Row row)> &visit) const;
+
+	// Copy-on-write edit of one symbol: the row is brought into a copy of the delta (taken from the
+	// base when present, inserted otherwise) and handed to edit, which may change fields or erase it.
+	std::shared_ptr<const SymbolSnapshot> withEdit(const SymbolKey &key, const RowEdit &edit) const;
+	// Same for several symbols at once, all visible in the one returned version
+	std::shared_ptr<const SymbolSnapshot> withEdits(const std::vector<SymbolKey> &keys, const RowEdit &edit) const;
+
+	// Base and delta merged into a single table
+	SymbolTable compacted() const;
+
+	std::size_t deltaRows() const { return delta->rowCount(); }
+	std::size_t memoryUsage() const;
+
+private:
+	SymbolSnapshot(std::shared_ptr<const SymbolTable> base, std::shared_ptr<const SymbolTable> delta, std::size_t liveCount);
+
+	// Compact once the delta holds more rows than this fraction of the base (and at least kMinDeltaRows)
+	static constexpr std::size_t kMinDeltaRows = 64;
+	static constexpr std::size_t kDeltaFraction = 8;
+
+	std::shared_ptr<const SymbolTable> base;
+	std::shared_ptr<const SymbolTable> delta;
+	std::size_t liveCount = 0;
+};
+
+#endif
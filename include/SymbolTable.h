@@ -0,0 +1,253 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Decimal value kept exactly as Binance writes it: "0.01000000" is mantissa 1000000 with scale 8,
+// so converting back to text reproduces the original string including trailing zeros.
+struct FixedDecimal
+{
+	static constexpr uint8_t kMaxScale = 18;
+	static constexpr uint8_t kEmpty = 0xFF; // present in the source but written as ""
+
+	int64_t mantissa = 0;
+	uint8_t scale = kEmpty;
+
+	bool empty() const { return scale == kEmpty; }
+	std::string toString() const;
+
+	// Parses "123", "0.001", "-1.50"; returns false on anything else. "" parses to an empty value.
+	static bool parse(const char *text, std::size_t length, FixedDecimal &out);
+	static bool parse(const std::string &text, FixedDecimal &out) { return parse(text.data(), text.size(), out); }
+
+	// Mantissa of the same value at another scale; false when empty, when digits would be dropped
+	// ("0.015" at scale 2) or on overflow
+	bool toScale(uint8_t targetScale, int64_t &out) const;
+};
+
+// Known Binance trading states. Values outside this list (e.g. a local UPDATE to "PENDING") are still
+// accepted and get codes from Count on, so the text always round-trips.
+enum class SymbolStatus : uint8_t
+{
+	PreTrading,
+	Trading,
+	PostTrading,
+	EndOfDay,
+	Halt,
+	AuctionMatch,
+	Break,
+	PendingTrading,
+	Delivering,
+	Delivered,
+	PreDelivering,
+	Settling,
+	Close,
+	Count
+};
+
+// Most common quote assets; anything else is interned from Count on.
+enum class QuoteAsset : uint16_t
+{
+	USDT,
+	BTC,
+	ETH,
+	BNB,
+	BUSD,
+	USDC,
+	FDUSD,
+	TUSD,
+	USD,
+	EUR,
+	TRY,
+	Count
+};
+
+enum class SymbolField : uint8_t
+{
+	Status,
+	QuoteAsset,
+	TickSize,
+	StepSize,
+	BaseAsset,
+	ContractType, // futures only, e.g. PERPETUAL or CURRENT_QUARTER
+	MinQty,		  // LOT_SIZE minQty
+	MinNotional,  // NOTIONAL or MIN_NOTIONAL filter
+	Count
+};
+
+// Set of fields, one bit per SymbolField
+using SymbolFieldMask = uint16_t;
+
+inline SymbolFieldMask symbolFieldBit(SymbolField field)
+{
+	return static_cast<SymbolFieldMask>(1u << static_cast<unsigned>(field));
+}
+
+// Index of the market a symbol trades on (spot, USD-M futures, ...); the names live with the parser.
+// The same symbol name on two markets is two unrelated rows.
+using MarketId = uint8_t;
+
+struct SymbolKey
+{
+	MarketId market = 0;
+	std::string symbol;
+};
+
+const char *symbolFieldName(SymbolField field);
+bool symbolFieldFromName(const std::string &name, SymbolField &field);
+// Looser match for field names written in queries: case and underscores are ignored, so "ticksize"
+// and "contract_type" resolve as well
+bool symbolFieldFromQueryName(const char *name, std::size_t length, SymbolField &field);
+
+// Small string <-> code table used for the enum-like columns.
+template <typename Code>
+class StringDictionary
+{
+public:
+	explicit StringDictionary(std::vector<std::string> seed = {});
+
+	// Throws std::length_error once every code is taken; holds() tells beforehand
+	Code intern(const std::string &text);
+	// Whether intern(text) has a code to return
+	bool holds(const std::string &text) const { return names.size() <= std::numeric_limits<Code>::max() || codes.count(text) != 0; }
+	const std::string &text(Code code) const { return names[code]; }
+	std::size_t size() const { return names.size(); }
+	std::size_t memoryUsage() const;
+
+private:
+	std::vector<std::string> names;
+	std::unordered_map<std::string, Code> codes;
+};
+
+// Dense struct-of-arrays store of per-symbol reference data, keyed by (market, symbol). Every symbol gets
+// a stable integer id the first time it is seen; ids are never reused, so a deleted symbol that comes
+// back keeps its old row. The market argument defaults to market 0 for single-market callers.
+//
+// Each row also carries a version, drawn from one process-wide counter whenever the row is inserted,
+// erased or has a field set. copyRow carries the version along with the values, so two rows with the
+// same version hold the same data, in whichever table or snapshot they live.
+class SymbolTable
+{
+public:
+	using SymbolId = uint32_t;
+	static constexpr SymbolId npos = UINT32_MAX;
+
+	SymbolTable();
+
+	// Lookup of a live (not deleted) symbol; npos when unknown or deleted.
+	SymbolId find(const std::string &symbol, MarketId market = 0) const;
+	SymbolId find(const char *symbol, std::size_t length, MarketId market = 0) const;
+	// Row of a symbol whether it is live or deleted; npos only when it was never inserted.
+	SymbolId findRow(const std::string &symbol, MarketId market = 0) const;
+	SymbolId findRow(const char *symbol, std::size_t length, MarketId market = 0) const;
+
+	// Interns the symbol, marks it live and clears all of its fields.
+	SymbolId insert(const std::string &symbol, MarketId market = 0);
+	bool erase(const std::string &symbol, MarketId market = 0);
+	void clear();
+
+	std::size_t size() const { return liveCount; }
+	std::size_t rowCount() const { return nameOffset.size(); }
+	bool isLive(SymbolId id) const { return id < rowCount() && (flags[id] & kLive); }
+
+	std::string name(SymbolId id) const;
+	MarketId market(SymbolId id) const { return marketOf[id]; }
+	bool hasField(SymbolId id, SymbolField field) const { return flags[id] & symbolFieldBit(field); }
+	// Never 0, so 0 can stand for "no version" in caches keyed by it
+	uint64_t version(SymbolId id) const { return versionOf[id]; }
+
+	SymbolStatus status(SymbolId id) const { return static_cast<SymbolStatus>(statusCode[id]); }
+	const std::string &statusText(SymbolId id) const { return statusNames.text(statusCode[id]); }
+	QuoteAsset quoteAsset(SymbolId id) const { return static_cast<QuoteAsset>(quoteCode[id]); }
+	const std::string &quoteAssetText(SymbolId id) const { return quoteNames.text(quoteCode[id]); }
+	FixedDecimal tickSize(SymbolId id) const { return {tickMantissa[id], tickScale[id]}; }
+	FixedDecimal stepSize(SymbolId id) const { return {stepMantissa[id], stepScale[id]}; }
+	const std::string &baseAssetText(SymbolId id) const { return baseNames.text(baseCode[id]); }
+	const std::string &contractTypeText(SymbolId id) const { return contractNames.text(contractCode[id]); }
+	FixedDecimal minQty(SymbolId id) const { return {minQtyMantissa[id], minQtyScale[id]}; }
+	FixedDecimal minNotional(SymbolId id) const { return {minNotionalMantissa[id], minNotionalScale[id]}; }
+
+	void setStatus(SymbolId id, const std::string &status);
+	void setQuoteAsset(SymbolId id, const std::string &quoteAsset);
+	void setTickSize(SymbolId id, const FixedDecimal &tickSize);
+	void setStepSize(SymbolId id, const FixedDecimal &stepSize);
+	void setBaseAsset(SymbolId id, const std::string &baseAsset);
+	void setContractType(SymbolId id, const std::string &contractType);
+	void setMinQty(SymbolId id, const FixedDecimal &minQty);
+	void setMinNotional(SymbolId id, const FixedDecimal &minNotional);
+
+	// Copies every field of another table's row into id; dictionary codes are re-interned, liveness is kept.
+	void copyRow(SymbolId id, const SymbolTable &source, SymbolId sourceId);
+	// True when both rows carry the same fields with the same values (names and liveness are not compared).
+	bool sameRow(SymbolId id, const SymbolTable &other, SymbolId otherId) const;
+
+	// String-keyed write used by UPDATE queries; false when the field is unknown, the value malformed or
+	// its dictionary column out of codes.
+	bool setField(SymbolId id, const std::string &field, const std::string &value);
+	bool setField(SymbolId id, SymbolField field, const std::string &value);
+	std::string fieldText(SymbolId id, SymbolField field) const;
+	// True when the field is set and holds value as setField would store it; does not allocate
+	bool fieldIs(SymbolId id, SymbolField field, const char *value, std::size_t length) const;
+
+	// Materialised "field -> text" view of one row, empty for unknown or deleted symbols.
+	std::unordered_map<std::string, std::string> toMap(SymbolId id) const;
+
+	// Bytes held by the table including hash index and dictionaries.
+	std::size_t memoryUsage() const;
+
+	// Appends the columns and dictionaries to out as the snapshot file layout: each column is a row count
+	// followed by its raw values, starting on an 8-byte boundary relative to the first byte appended.
+	void serialize(std::string &out) const;
+	// Replaces the table with serialize() output. Row markets are translated through markets (the
+	// writer's id indexes it); every row gets a fresh version. False, with the table cleared, when the
+	// data is truncated or inconsistent.
+	bool deserialize(const char *data, std::size_t size, const std::vector<MarketId> &markets);
+
+private:
+	// Field bits of SymbolFieldMask plus the live bit
+	using RowFlags = uint16_t;
+	static constexpr RowFlags kLive = 0x8000;
+
+	static uint32_t hashName(const char *symbol, std::size_t length, MarketId market);
+	bool rowIs(SymbolId id, const char *symbol, std::size_t length, MarketId market) const;
+	void growIndex();
+	void buildIndex(std::size_t slotCount);
+
+	// Symbol names packed back to back, addressed by offset/length
+	std::string namePool;
+	std::vector<uint32_t> nameOffset;
+	std::vector<uint8_t> nameLength;
+	std::vector<MarketId> marketOf;
+
+	// Open-addressing index of ids, sized to a power of two
+	std::vector<SymbolId> slots;
+
+	std::vector<RowFlags> flags;
+	std::vector<uint64_t> versionOf;
+	std::vector<uint8_t> statusCode;
+	std::vector<uint16_t> quoteCode;
+	std::vector<int64_t> tickMantissa;
+	std::vector<uint8_t> tickScale;
+	std::vector<int64_t> stepMantissa;
+	std::vector<uint8_t> stepScale;
+	std::vector<uint16_t> baseCode;
+	std::vector<uint8_t> contractCode;
+	std::vector<int64_t> minQtyMantissa;
+	std::vector<uint8_t> minQtyScale;
+	std::vector<int64_t> minNotionalMantissa;
+	std::vector<uint8_t> minNotionalScale;
+
+	StringDictionary<uint8_t> statusNames;
+	StringDictionary<uint16_t> quoteNames;
+	StringDictionary<uint16_t> baseNames;
+	StringDictionary<uint8_t> contractNames;
+
+	std::size_t liveCount = 0;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. parallelFor cuts [0, count) into ranges and deals
+// them round-robin into one deque per worker; a worker takes from the front of its own deque and, once
+// that is empty, steals from the back of the others, so uneven ranges still finish together. The
+// calling thread works along as worker 0 and parallelFor returns when every range has run.
+class WorkStealingPool
+{
+public:
+	// worker is in [0, size()) and fixed for the whole range, so it can index per-worker state
+	using RangeTask = std::function<void(std::size_t worker, std::size_t begin, std::size_t end)>;
+
+	// threads counts the calling thread: 1 runs everything inline, 0 uses one per core
+	explicit WorkStealingPool(std::size_t threads = 0);
+	~WorkStealingPool();
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+	std::size_t size() const { return queues.size(); }
+
+	// Runs task over [0, count) in ranges of at most grain items; task must not throw. One call at a time.
+	void parallelFor(std::size_t count, std::size_t grain, const RangeTask &task);
+
+	// Ranges run by a worker other than the one they were dealt to
+	std::uint64_t getStealCount() const { return steals; }
+
+private:
+	struct Range
+	{
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	struct alignas(64) Queue
+	{
+		std::mutex mutex;
+		std::deque<Range> ranges;
+	};
+
+	bool runOne(std::size_t worker);
+	void workerLoop(std::size_t worker);
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::uint64_t generation = 0;
+	bool stopping = false;
+
+	const RangeTask *task = nullptr;
+	std::atomic<std::size_t> pending{0};
+	std::atomic<std::uint64_t> steals{0};
+};
+
+#endif
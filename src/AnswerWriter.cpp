@@ -0,0 +1,205 @@
+#include "BinanceHandler.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+AnswerWriter::AnswerWriter() : AnswerWriter(Options())
+{
+}
+
+AnswerWriter::AnswerWriter(const Options &options)
+	: options(options), jsonWriter(serialized)
+{
+	pending.reserve(options.flushBytes + 1024);
+	if (options.backgroundFlush)
+	{
+		flusher = std::thread([this]
+							  { runFlusher(); });
+	}
+}
+
+AnswerWriter::~AnswerWriter()
+{
+	if (flusher.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(bufferMutex);
+			stopping = true;
+		}
+		flusherWake.notify_all();
+		flusher.join();
+	}
+
+	flush();
+
+	std::lock_guard<std::mutex> fileLock(fileMutex);
+	if (options.format == Format::JSONArray && fd < 0)
+	{
+		// An empty array, so the file is well-formed even when no answer was written
+		openFile();
+	}
+	if (fd >= 0)
+	{
+		::close(fd);
+	}
+}
+
+void AnswerWriter::write(const rapidjson::Value &answer)
+{
+	std::unique_lock<std::mutex> lock(bufferMutex);
+	serialized.Clear();
+	jsonWriter.Reset(serialized);
+	answer.Accept(jsonWriter);
+	appendLocked(lock, serialized.GetString(), serialized.GetSize());
+}
+
+void AnswerWriter::writeSerialized(const char *answer, std::size_t size)
+{
+	std::unique_lock<std::mutex> lock(bufferMutex);
+	appendLocked(lock, answer, size);
+}
+
+void AnswerWriter::appendLocked(std::unique_lock<std::mutex> &lock, const char *answer, std::size_t size)
+{
+	if (options.format == Format::JSONArray && answerCount > 0)
+	{
+		pending += ",\n";
+	}
+	pending.append(answer, size);
+	if (options.format == Format::NDJSON)
+	{
+		pending += '\n';
+	}
+	++answerCount;
+
+	// Without the timer thread the interval is checked here, so a lone answer after a quiet spell
+	// still goes out immediately while a burst is batched
+	bool due = pending.size() >= options.flushBytes ||
+			   (!options.backgroundFlush && std::chrono::steady_clock::now() - lastFlush >= options.flushInterval);
+	lock.unlock();
+	if (due)
+	{
+		flush();
+	}
+}
+
+void AnswerWriter::flush()
+{
+	// Batches are swapped out under the file lock, so they reach the file in the order they were filled
+	std::lock_guard<std::mutex> fileLock(fileMutex);
+	{
+		std::lock_guard<std::mutex> lock(bufferMutex);
+		outgoing.swap(pending);
+		lastFlush = std::chrono::steady_clock::now();
+	}
+	if (outgoing.empty())
+	{
+		return;
+	}
+	if (fd >= 0 || openFile())
+	{
+		if (options.format == Format::JSONArray)
+		{
+			// Over the old closing bracket, with a new one after the batch
+			std::uint64_t batchSize = outgoing.size();
+			outgoing += "\n]\n";
+			if (::lseek(fd, static_cast<off_t>(arrayEnd), SEEK_SET) < 0)
+			{
+				logger->error("Failed to seek in {}: {}", options.path, std::strerror(errno));
+			}
+			arrayEnd += batchSize;
+		}
+		writeFile(outgoing);
+		++flushCount;
+	}
+	outgoing.clear();
+}
+
+bool AnswerWriter::openFile()
+{
+	if (openFailed)
+	{
+		return false;
+	}
+
+	int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (options.format == Format::JSONArray ? O_TRUNC : O_APPEND);
+	fd = ::open(options.path.c_str(), flags, 0644);
+	if (fd < 0)
+	{
+		// Reported once; answers are dropped rather than piling up in memory
+		logger->error("Failed to open {} for writing: {}", options.path, std::strerror(errno));
+		openFailed = true;
+		return false;
+	}
+	if (options.format == Format::JSONArray)
+	{
+		writeFile("[\n]\n");
+		arrayEnd = 2;
+	}
+	return true;
+}
+
+void AnswerWriter::writeFile(const std::string &data)
+{
+	std::size_t written = 0;
+	while (written < data.size())
+	{
+		ssize_t count = ::write(fd, data.data() + written, data.size() - written);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			logger->error("Failed to write answers to {}: {}", options.path, std::strerror(errno));
+			return;
+		}
+		written += static_cast<std::size_t>(count);
+	}
+}
+
+void AnswerWriter::runFlusher()
+{
+	std::unique_lock<std::mutex> lock(bufferMutex);
+	while (!stopping)
+	{
+		flusherWake.wait_for(lock, options.flushInterval);
+		if (stopping || pending.empty())
+		{
+			continue;
+		}
+		lock.unlock();
+		flush();
+		lock.lock();
+	}
+}
+
+std::uint64_t AnswerWriter::getAnswerCount() const
+{
+	std::lock_guard<std::mutex> lock(bufferMutex);
+	return answerCount;
+}
+
+std::uint64_t AnswerWriter::getFlushCount() const
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+	return flushCount;
+}
+
+bool AnswerWriter::parseFormat(const std::string &name, Format &format)
+{
+	if (name == "ndjson")
+	{
+		format = Format::NDJSON;
+	}
+	else if (name == "array")
+	{
+		format = Format::JSONArray;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,107 @@
+#include "BinanceHandler.h"
+
+ExchangeInfoRefresher::ExchangeInfoRefresher(JSONParser &jsonParser, const std::string &host, const std::string &port, const std::string &target, int version, std::chrono::seconds interval, MarketId market)
+	: jsonParser(jsonParser), host(host), port(port), target(target), version(version), interval(interval), market(market)
+{
+}
+
+ExchangeInfoRefresher::~ExchangeInfoRefresher()
+{
+	stop();
+}
+
+bool ExchangeInfoRefresher::refreshNow()
+{
+	bool parsed = false;
+	bool fetched = httpRequest.streamBinanceAPIRequest(host, port, target, version, [this, &parsed](const ChunkReader &readChunk)
+													   { parsed = jsonParser.performJSONDataParsing(readChunk, market); },
+													   &validators);
+	if (fetched && validators.notModified)
+	{
+		// Same data as last time, parsing and merging are skipped entirely
+		++notModifiedCount;
+		return true;
+	}
+	if (fetched && parsed)
+	{
+		++refreshCount;
+		return true;
+	}
+	if (fetched)
+	{
+		// A body that did not parse must not be revalidated into a 304, the next request fetches it whole
+		validators.etag.clear();
+		validators.lastModified.clear();
+	}
+	// The previous version stays published, the next interval tries again
+	++failureCount;
+	logger->error("exchangeInfo refresh from {}:{}{} failed, keeping the current symbol table.", host, port, target);
+	return false;
+}
+
+void ExchangeInfoRefresher::start()
+{
+	if (worker.joinable())
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(stopMutex);
+		stopping = false;
+	}
+	worker = std::thread([this]
+						 { run(); });
+	if (interval.count() > 0)
+	{
+		logger->info("Refreshing exchangeInfo every {} seconds.", interval.count());
+	}
+}
+
+void ExchangeInfoRefresher::stop()
+{
+	if (!worker.joinable())
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(stopMutex);
+		stopping = true;
+	}
+	stopWake.notify_all();
+	worker.join();
+}
+
+void ExchangeInfoRefresher::requestRefresh()
+{
+	{
+		std::lock_guard<std::mutex> lock(stopMutex);
+		refreshRequested = true;
+	}
+	stopWake.notify_all();
+}
+
+void ExchangeInfoRefresher::run()
+{
+	std::unique_lock<std::mutex> lock(stopMutex);
+	auto woken = [this]
+	{ return stopping || refreshRequested; };
+	while (true)
+	{
+		if (interval.count() > 0)
+		{
+			stopWake.wait_for(lock, interval, woken);
+		}
+		else
+		{
+			stopWake.wait(lock, woken);
+		}
+		if (stopping)
+		{
+			return;
+		}
+		refreshRequested = false;
+		lock.unlock();
+		refreshNow();
+		lock.lock();
+	}
+}
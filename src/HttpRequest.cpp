@@ -8,6 +8,9 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl.hpp>
 #include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/basic_file_sink.h"
 
@@ -17,62 +20,474 @@ namespace net = boost::asio;
 namespace ssl = boost::asio::ssl;
 using tcp = net::ip::tcp;
 
-HTTPRequest::HTTPRequest()
+namespace
 {
-	// Ensure the global logger is initialized
-	if (!logger)
+	// Streaming inflate over another ChunkReader. windowBits 15 + 32 detects gzip and zlib framing from
+	// the header, which covers both "gzip" and the usual zlib-wrapped form of "deflate".
+	class InflatingReader
 	{
-		spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] [thread %t] %v");
-		logger = spdlog::basic_logger_mt("console", "logs/binary_exchange_logs.log");
-		spdlog::flush_on(spdlog::level::info);
+	public:
+		explicit InflatingReader(const ChunkReader &source) : source(source), input(16 * 1024)
+		{
+			if (inflateInit2(&stream, 15 + 32) != Z_OK)
+			{
+				throw std::runtime_error("inflateInit2 failed");
+			}
+		}
+
+		~InflatingReader() { inflateEnd(&stream); }
+		InflatingReader(const InflatingReader &) = delete;
+		InflatingReader &operator=(const InflatingReader &) = delete;
+
+		std::size_t read(char *out, std::size_t size)
+		{
+			if (finished || size == 0)
+			{
+				return 0;
+			}
+			stream.next_out = reinterpret_cast<Bytef *>(out);
+			stream.avail_out = static_cast<uInt>(size);
+			while (stream.avail_out == size)
+			{
+				if (stream.avail_in == 0)
+				{
+					std::size_t count = source(input.data(), input.size());
+					if (count == 0)
+					{
+						throw std::runtime_error("Compressed body ended early");
+					}
+					stream.next_in = reinterpret_cast<Bytef *>(input.data());
+					stream.avail_in = static_cast<uInt>(count);
+				}
+				int rc = inflate(&stream, Z_NO_FLUSH);
+				if (rc == Z_STREAM_END)
+				{
+					// Drain the rest of the body so the connection can be reused
+					finished = true;
+					while (source(input.data(), input.size()) > 0)
+					{
+					}
+					break;
+				}
+				if (rc != Z_OK && rc != Z_BUF_ERROR)
+				{
+					throw std::runtime_error(std::string("Invalid compressed body: ") + (stream.msg ? stream.msg : "inflate failed"));
+				}
+			}
+			return size - stream.avail_out;
+		}
+
+	private:
+		ChunkReader source;
+		z_stream stream{};
+		std::vector<char> input;
+		bool finished = false;
+	};
+
+	bool isCompressed(beast::string_view encoding)
+	{
+		return beast::iequals(encoding, "gzip") || beast::iequals(encoding, "deflate");
 	}
 }
-std::string HTTPRequest::performBinanceAPIRequest(const std::string &host, const std::string &port, const std::string &target, int version)
+
+ChunkReader inflatingReader(const ChunkReader &source)
 {
-	try
+	auto inflater = std::make_shared<InflatingReader>(source);
+	return [inflater](char *out, std::size_t size)
+	{ return inflater->read(out, size); };
+}
+
+struct HTTPSession::Impl
+{
+	Impl(const std::string &host, const std::string &port)
+		: host(host), port(port), ctx(ssl::context::sslv23_client), resolver(ioc)
+	{
+		// Let the client keep session tickets so reconnects can resume instead of doing a full handshake
+		SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_CLIENT);
+	}
+
+	~Impl()
+	{
+		close();
+		if (tlsSession)
+		{
+			SSL_SESSION_free(tlsSession);
+		}
+	}
+
+	void connect()
 	{
-		// The io_context is required for all I/O
-		net::io_context ioc;
+		if (endpoints.empty())
+		{
+			// Look up the domain name once, reused by every reconnect
+			LatencySpan resolveSpan(metrics().httpResolve);
+			endpoints = resolver.resolve(host, port);
+		}
 
-		// SSL context
-		ssl::context ctx(ssl::context::sslv23_client);
+		stream = std::make_unique<ssl::stream<tcp::socket>>(ioc, ctx);
 
-		// These objects perform our I/O
-		tcp::resolver resolver(ioc);
-		ssl::stream<tcp::socket> stream(ioc, ctx);
+		// SNI is required by most CDNs and keys the cached session on the server side
+		if (!SSL_set_tlsext_host_name(stream->native_handle(), host.c_str()))
+		{
+			throw beast::system_error(beast::error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()));
+		}
+		if (tlsSession)
+		{
+			SSL_set_session(stream->native_handle(), tlsSession);
+		}
 
-		// Look up the domain name
-		auto const results = resolver.resolve(host, port);
+		{
+			LatencySpan connectSpan(metrics().httpConnect);
+			beast::error_code ec;
+			net::connect(stream->next_layer(), endpoints.begin(), endpoints.end(), ec);
+			if (ec)
+			{
+				// The cached addresses may have gone stale, resolve again before giving up
+				endpoints = resolver.resolve(host, port);
+				net::connect(stream->next_layer(), endpoints.begin(), endpoints.end());
+			}
+		}
 
-		// Make the connection on the IP address we get from a lookup
-		net::connect(stream.next_layer(), results.begin(), results.end());
+		LatencySpan handshakeSpan(metrics().httpHandshake);
+		stream->handshake(ssl::stream_base::client);
+		handshakeSpan.stop();
+		++handshakes;
+		if (SSL_session_reused(stream->native_handle()))
+		{
+			++resumedHandshakes;
+		}
+		buffer.clear();
+	}
 
-		// Perform the SSL handshake
-		stream.handshake(ssl::stream_base::client);
+	void close()
+	{
+		if (stream)
+		{
+			// Gracefully close the socket
+			beast::error_code ec;
+			stream->shutdown(ec);
+			stream->next_layer().close(ec);
+			stream.reset();
+		}
+	}
+
+	void rememberTlsSession()
+	{
+		// With TLS 1.3 the ticket arrives after the handshake, so this is only useful once data was read
+		SSL_SESSION *session = SSL_get1_session(stream->native_handle());
+		if (session)
+		{
+			if (tlsSession)
+			{
+				SSL_SESSION_free(tlsSession);
+			}
+			tlsSession = session;
+		}
+	}
 
+	void sendRequest(const std::string &target, int version, const CacheValidators *validators = nullptr)
+	{
 		// Set up an HTTP GET request message
 		http::request<http::string_body> req{http::verb::get, target, version};
 		req.set(http::field::host, host);
 		req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+		req.set(http::field::accept_encoding, "gzip, deflate");
+		req.keep_alive(true);
+		if (validators && !validators->etag.empty())
+		{
+			req.set(http::field::if_none_match, validators->etag);
+		}
+		if (validators && !validators->lastModified.empty())
+		{
+			req.set(http::field::if_modified_since, validators->lastModified);
+		}
 
 		// Send the HTTP request to the remote host
-		http::write(stream, req);
+		LatencySpan writeSpan(metrics().httpWrite);
+		http::write(*stream, req);
+	}
+
+	template <typename Body>
+	void finishResponse(const http::response<Body> &res)
+	{
+		if (res.result() != http::status::ok && res.result() != http::status::not_modified)
+		{
+			logger->warn("{}:{} answered with HTTP {}", host, port, res.result_int());
+		}
+		rememberTlsSession();
+		if (!res.keep_alive())
+		{
+			close();
+		}
+	}
+
+	std::string exchange(const std::string &target, int version)
+	{
+		sendRequest(target, version);
+
+		// Receive the HTTP response; string_body reserves the whole Content-Length up front
+		http::response_parser<http::string_body> parser;
+		parser.body_limit(kBodyLimit);
+		LatencySpan readSpan(metrics().httpRead);
+		http::read(*stream, buffer, parser);
+		readSpan.stop();
+
+		finishResponse(parser.get());
+		std::string body = std::move(parser.get().body());
+		if (!isCompressed(parser.get()[http::field::content_encoding]))
+		{
+			return body;
+		}
+
+		std::size_t offset = 0;
+		InflatingReader inflater([&body, &offset](char *out, std::size_t size)
+								 {
+									 std::size_t count = body.copy(out, size, offset);
+									 offset += count;
+									 return count; });
+		std::string inflated;
+		inflated.resize(body.size() * 4);
+		std::size_t length = 0;
+		while (std::size_t count = inflater.read(&inflated[length], inflated.size() - length))
+		{
+			length += count;
+			if (length == inflated.size())
+			{
+				inflated.resize(inflated.size() * 2);
+			}
+		}
+		inflated.resize(length);
+		return inflated;
+	}
+
+	bool streamExchange(const std::string &target, int version, const BodyConsumer &consumer, CacheValidators *validators, bool &bodyStarted)
+	{
+		sendRequest(target, version, validators);
+
+		http::response_parser<http::buffer_body> parser;
+		parser.body_limit(kBodyLimit);
+		// Only time spent waiting on the socket counts as read, not the consumer's parsing in between
+		std::chrono::steady_clock::duration readTime{};
+		auto readStart = std::chrono::steady_clock::now();
+		http::read_header(*stream, buffer, parser);
+		readTime += std::chrono::steady_clock::now() - readStart;
+		bodyStarted = true;
+
+		if (parser.get().result() == http::status::not_modified)
+		{
+			metrics().httpRead.record(readTime);
+			// Nothing changed since the validators were taken, there is no body to read
+			if (!parser.is_done())
+			{
+				close();
+			}
+			else
+			{
+				finishResponse(parser.get());
+			}
+			return false;
+		}
+
+		// Every call reads straight into the caller's buffer, the whole body is never held in memory
+		ChunkReader readChunk = [this, &parser, &readTime](char *out, std::size_t size) -> std::size_t
+		{
+			while (!parser.is_done())
+			{
+				parser.get().body().data = out;
+				parser.get().body().size = size;
+				beast::error_code ec;
+				auto chunkStart = std::chrono::steady_clock::now();
+				http::read(*stream, buffer, parser, ec);
+				readTime += std::chrono::steady_clock::now() - chunkStart;
+				if (ec == http::error::need_buffer)
+				{
+					ec = {};
+				}
+				if (ec)
+				{
+					throw beast::system_error(ec);
+				}
+				std::size_t received = size - parser.get().body().size;
+				if (received > 0)
+				{
+					return received;
+				}
+			}
+			return 0;
+		};
+
+		if (isCompressed(parser.get()[http::field::content_encoding]))
+		{
+			// Decompressed as it arrives, the consumer only ever sees plain bytes
+			InflatingReader inflater(readChunk);
+			consumer([&inflater](char *out, std::size_t size)
+					 { return inflater.read(out, size); });
+		}
+		else
+		{
+			consumer(readChunk);
+		}
+		metrics().httpRead.record(readTime);
+
+		if (!parser.is_done())
+		{
+			// The consumer gave up part way, the rest of the body is still on the wire
+			close();
+			return true;
+		}
+		if (validators && parser.get().result() == http::status::ok)
+		{
+			// Only a body that was read to the end may be revalidated later
+			validators->etag = std::string(parser.get()[http::field::etag]);
+			validators->lastModified = std::string(parser.get()[http::field::last_modified]);
+		}
+		finishResponse(parser.get());
+		return true;
+	}
+
+	// Runs one exchange on the kept-alive connection. If a reused connection turns out to be dead
+	// before any of the response was handed out, GET is idempotent so it is retried once on a fresh one.
+	template <typename Exchange>
+	void withReconnect(const Exchange &exchange, const bool &bodyStarted)
+	{
+		bool reused = static_cast<bool>(stream);
+		if (!reused)
+		{
+			connect();
+		}
+
+		try
+		{
+			exchange();
+			return;
+		}
+		catch (beast::system_error const &e)
+		{
+			close();
+			if (!reused || bodyStarted)
+			{
+				throw;
+			}
+			logger->warn("Connection to {}:{} lost ({}), reconnecting.", host, port, e.code().message());
+		}
+		catch (...)
+		{
+			// Whatever the consumer threw, the connection is left mid-response
+			close();
+			throw;
+		}
+
+		connect();
+		try
+		{
+			exchange();
+		}
+		catch (...)
+		{
+			close();
+			throw;
+		}
+	}
+
+	std::string request(const std::string &target, int version)
+	{
+		std::string body;
+		bool bodyStarted = false;
+		withReconnect([&]
+					  { body = exchange(target, version); },
+					  bodyStarted);
+		return body;
+	}
 
-		// This buffer is used for reading and must be persisted
-		beast::flat_buffer buffer;
+	bool streamRequest(const std::string &target, int version, const BodyConsumer &consumer, CacheValidators *validators)
+	{
+		bool bodyStarted = false;
+		bool modified = true;
+		withReconnect([&]
+					  { modified = streamExchange(target, version, consumer, validators, bodyStarted); },
+					  bodyStarted);
+		return modified;
+	}
+
+	// exchangeInfo for all markets is a few MB; Beast's default 8 MB limit is too close for comfort
+	static constexpr std::uint64_t kBodyLimit = 256ull * 1024 * 1024;
+
+	std::string host;
+	std::string port;
+	net::io_context ioc;
+	ssl::context ctx;
+	tcp::resolver resolver;
+	tcp::resolver::results_type endpoints;
+	std::unique_ptr<ssl::stream<tcp::socket>> stream;
+	SSL_SESSION *tlsSession = nullptr;
+
+	// This buffer is used for reading and must be persisted across keep-alive responses
+	beast::flat_buffer buffer;
+
+	std::size_t handshakes = 0;
+	std::size_t resumedHandshakes = 0;
+};
+
+HTTPSession::HTTPSession(const std::string &host, const std::string &port)
+	: impl(std::make_unique<Impl>(host, port))
+{
+}
+
+HTTPSession::~HTTPSession() = default;
+
+std::string HTTPSession::request(const std::string &target, int version)
+{
+	return impl->request(target, version);
+}
+
+bool HTTPSession::streamRequest(const std::string &target, int version, const BodyConsumer &consumer, CacheValidators *validators)
+{
+	return impl->streamRequest(target, version, consumer, validators);
+}
+
+void HTTPSession::close()
+{
+	impl->close();
+}
+
+std::size_t HTTPSession::getHandshakeCount() const
+{
+	return impl->handshakes;
+}
+
+std::size_t HTTPSession::getResumedHandshakeCount() const
+{
+	return impl->resumedHandshakes;
+}
 
-		// Declare a container to hold the response
-		http::response<http::dynamic_body> res;
+HTTPRequest::HTTPRequest()
+{
+	// Ensure the global logger is initialized
+	if (!logger)
+	{
+		spdlog::set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] [thread %t] %v");
+		logger = spdlog::basic_logger_mt("console", "logs/binary_exchange_logs.log");
+		spdlog::flush_on(spdlog::level::info);
+	}
+}
 
-		// Receive the HTTP response
-		http::read(stream, buffer, res);
+HTTPRequest::~HTTPRequest() = default;
 
-		// Gracefully close the socket
-		beast::error_code ec;
-		stream.shutdown(ec);
+HTTPSession &HTTPRequest::getSession(const std::string &host, const std::string &port)
+{
+	std::unique_ptr<HTTPSession> &session = sessions[host + ":" + port];
+	if (!session)
+	{
+		session = std::make_unique<HTTPSession>(host, port);
+	}
+	return *session;
+}
 
-		// Converting the response body as a string
-		auto response = boost::beast::buffers_to_string(res.body().data());
+std::string HTTPRequest::performBinanceAPIRequest(const std::string &host, const std::string &port, const std::string &target, int version)
+{
+	try
+	{
+		std::string response = getSession(host, port).request(target, version);
 
 		// Log success
 		logger->info("Successfully performed Binance API request to {}:{}{}", host, port, target);
@@ -86,3 +501,30 @@ std::string HTTPRequest::performBinanceAPIRequest(const std::string &host, const
 		return ""; // Return an empty string in case of an error
 	}
 }
+
+bool HTTPRequest::streamBinanceAPIRequest(const std::string &host, const std::string &port, const std::string &target, int version, const BodyConsumer &consumer, CacheValidators *validators)
+{
+	try
+	{
+		if (validators)
+		{
+			validators->notModified = false;
+		}
+		if (!getSession(host, port).streamRequest(target, version, consumer, validators))
+		{
+			validators->notModified = true;
+			logger->info("{}:{}{} not modified since the last fetch.", host, port, target);
+			return true;
+		}
+
+		// Log success
+		logger->info("Successfully streamed Binance API request to {}:{}{}", host, port, target);
+		return true;
+	}
+	catch (std::exception const &e)
+	{
+		// Log an error
+		logger->error("Error: {}", e.what());
+		return false;
+	}
+}
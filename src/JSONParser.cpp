@@ -1,181 +1,862 @@
 #include "BinanceHandler.h"
+#include "FieldRegistry.h"
+#include "JsonScanner.h"
 #include "rapidjson/document.h"
-#include "rapidjson/ostreamwrapper.h"
-#include "rapidjson/prettywriter.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/error/en.h"
 #include <iostream>
 #include <fstream>
-#include <boost/beast/core.hpp>
-#include <boost/beast/http.hpp>
-#include <boost/beast/version.hpp>
-#include <boost/asio/connect.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/asio/ssl.hpp>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/basic_file_sink.h"
 
-void JSONParser::performJSONDataParsing(const std::string &jsonResponse)
+namespace
 {
-	try
+	bool keyIs(const char *key, rapidjson::SizeType length, const char *expected)
 	{
-		logger->info("PerformJSONDataParsing called.");
-		rapidjson::Document document;
-		document.Parse(jsonResponse.c_str()); // returns char pointer to string array
+		return std::strlen(expected) == length && std::memcmp(key, expected, length) == 0;
+	}
+
+	// rapidjson input stream over a ChunkReader, buffering one chunk at a time (same scheme as FileReadStream)
+	class ChunkedInputStream
+	{
+	public:
+		typedef char Ch;
 
-		if (document.HasParseError())
+		explicit ChunkedInputStream(const ChunkReader &readChunk, std::size_t bufferSize = 64 * 1024)
+			: readChunk(readChunk), buffer(bufferSize)
 		{
-			// Log an error
-			logger->error("Error parsing JSON. Parse error code: {}, Offset: {}", document.GetParseError(), document.GetErrorOffset());
-			return;
+			current = buffer.data();
+			bufferLast = current;
+			read();
 		}
 
-		if (document.HasMember("symbols") && document["symbols"].IsArray()) // check for null value in array
+		Ch Peek() const { return *current; }
+		Ch Take()
 		{
-			const rapidjson::Value &symbolsArray = document["symbols"]; // accessing highest symbols array without making a copy, checks for symbol key
+			Ch c = *current;
+			read();
+			return c;
+		}
+		std::size_t Tell() const { return count + static_cast<std::size_t>(current - buffer.data()); }
 
-			for (rapidjson::SizeType i = 0; i < symbolsArray.Size(); ++i)
+		// Not implemented, the stream is read-only
+		void Put(Ch) { RAPIDJSON_ASSERT(false); }
+		void Flush() { RAPIDJSON_ASSERT(false); }
+		Ch *PutBegin()
+		{
+			RAPIDJSON_ASSERT(false);
+			return 0;
+		}
+		std::size_t PutEnd(Ch *)
+		{
+			RAPIDJSON_ASSERT(false);
+			return 0;
+		}
+
+	private:
+		void read()
+		{
+			if (current < bufferLast)
+			{
+				++current;
+			}
+			else if (!eof)
 			{
-				const rapidjson::Value &symbolObject = symbolsArray[i]; // getting value against symbols key
+				count += readCount;
+				readCount = readChunk(buffer.data(), buffer.size());
+				bufferLast = buffer.data() + readCount - 1;
+				current = buffer.data();
+
+				if (readCount == 0)
+				{
+					buffer[0] = '\0';
+					bufferLast = buffer.data();
+					eof = true;
+				}
+			}
+		}
+
+		const ChunkReader &readChunk;
+		std::vector<Ch> buffer;
+		std::size_t readCount = 0;
+		std::size_t count = 0;
+		Ch *bufferLast;
+		Ch *current;
+		bool eof = false;
+	};
 
-				if (symbolObject.HasMember("symbol") && symbolObject["symbol"].IsString()) // checking inner sysmbols array
+	// SAX state machine that walks exchangeInfo in one pass and only keeps symbols[].symbol plus the fields
+	// of FieldRegistry: members of the symbol object, and values of the filters the registry names (tickSize
+	// of PRICE_FILTER, stepSize and minQty of LOT_SIZE, ...). Containers nobody asked for (rateLimits,
+	// orderTypes, permissions, ...) are skipped by depth.
+	class ExchangeInfoHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ExchangeInfoHandler>
+	{
+	public:
+		ExchangeInfoHandler(SymbolTable &symbolTable, MarketId market) : symbolTable(symbolTable), market(market) {}
+
+		bool sawSymbolsArray() const { return symbolsSeen; }
+		std::size_t symbolsParsed() const { return parsedCount; }
+		// Inside a container nobody asked for, or past the last wanted member of one; JsonScanner jumps to its end
+		bool skipping() const { return skipDepth > 0; }
+
+		bool StartObject()
+		{
+			if (skipDepth > 0)
+			{
+				++skipDepth;
+				return true;
+			}
+			switch (state)
+			{
+			case State::Root:
+				state = State::TopLevel;
+				break;
+			case State::Symbols:
+				state = State::Symbol;
+				symbol.clear();
+				for (std::string &value : values)
+				{
+					value.clear();
+				}
+				hasSymbol = false;
+				break;
+			case State::Filters:
+				state = State::Filter;
+				filterType.clear();
+				filterCarries = 0;
+				for (std::string &value : filterValues)
 				{
-					std::string symbol = symbolObject["symbol"].GetString();
-					std::string quoteAsset = symbolObject["quoteAsset"].GetString();
-					std::string status = symbolObject["status"].GetString();
-					std::string tickSize = "";
-					std::string stepSize = "";
+					value.clear();
+				}
+				break;
+			default:
+				skipDepth = 1;
+				break;
+			}
+			expect = Expect::Nothing;
+			target = nullptr;
+			return true;
+		}
 
-					if (symbolObject.HasMember("filters") && symbolObject["filters"].IsArray())
+		bool EndObject(rapidjson::SizeType)
+		{
+			if (skipDepth > 0)
+			{
+				// Unless this closes the object whose remaining members were dropped
+				if (--skipDepth > 0 || !skippingRest)
+				{
+					return true;
+				}
+				skippingRest = false;
+			}
+			switch (state)
+			{
+			case State::Symbol:
+				commitSymbol();
+				state = State::Symbols;
+				break;
+			case State::Filter:
+				// Only the filter type that carries a field sets it
+				for (std::size_t i = 0; i < FieldRegistry::kCount; ++i)
+				{
+					if (filterCarries & symbolFieldBit(static_cast<SymbolField>(i)))
 					{
-						const rapidjson::Value &filtersArray = symbolObject["filters"];
+						values[i] = filterValues[i];
+					}
+				}
+				state = State::Filters;
+				break;
+			default:
+				state = State::Done;
+				break;
+			}
+			return true;
+		}
 
-						for (rapidjson::SizeType j = 0; j < filtersArray.Size(); ++j)
-						{
-							const rapidjson::Value &filterObject = filtersArray[j];
+		bool StartArray()
+		{
+			if (skipDepth > 0)
+			{
+				++skipDepth;
+			}
+			else if (state == State::TopLevel && expect == Expect::SymbolsArray)
+			{
+				state = State::Symbols;
+				symbolsSeen = true;
+			}
+			else if (state == State::Symbol && expect == Expect::FiltersArray)
+			{
+				state = State::Filters;
+			}
+			else
+			{
+				skipDepth = 1;
+			}
+			expect = Expect::Nothing;
+			target = nullptr;
+			return true;
+		}
 
-							if (filterObject.HasMember("filterType") && filterObject["filterType"].IsString())
-							{
-								std::string filterType = filterObject["filterType"].GetString();
-
-								if (filterType == "PRICE_FILTER" && filterObject.HasMember("tickSize") &&
-									filterObject["tickSize"].IsString())
-								{
-									tickSize = filterObject["tickSize"].GetString();
-								}
-								else if (filterType == "LOT_SIZE" && filterObject.HasMember("stepSize") &&
-										 filterObject["stepSize"].IsString())
-								{
-									stepSize = filterObject["stepSize"].GetString();
-								}
-							}
-						}
+		bool EndArray(rapidjson::SizeType)
+		{
+			if (skipDepth > 0)
+			{
+				--skipDepth;
+			}
+			else if (state == State::Symbols)
+			{
+				state = State::TopLevel;
+			}
+			else if (state == State::Filters)
+			{
+				state = State::Symbol;
+			}
+			return true;
+		}
+
+		bool Key(const char *key, rapidjson::SizeType length, bool)
+		{
+			if (skipDepth > 0)
+			{
+				return true;
+			}
+			target = nullptr;
+			expect = Expect::Nothing;
+			SymbolField field;
+			switch (state)
+			{
+			case State::TopLevel:
+				if (keyIs(key, length, "symbols"))
+				{
+					expect = Expect::SymbolsArray;
+				}
+				break;
+			case State::Symbol:
+				if (keyIs(key, length, "symbol"))
+				{
+					target = &symbol;
+					expect = Expect::SymbolName;
+				}
+				else if (keyIs(key, length, "filters"))
+				{
+					expect = Expect::FiltersArray;
+				}
+				else if (FieldRegistry::findExchangeKey(key, length, field) && !FieldRegistry::spec(field).filterType)
+				{
+					target = &values[static_cast<std::size_t>(field)];
+				}
+				break;
+			case State::Filter:
+				if (keyIs(key, length, "filterType"))
+				{
+					target = &filterType;
+				}
+				else if (FieldRegistry::findExchangeKey(key, length, field) && FieldRegistry::spec(field).filterType)
+				{
+					target = &filterValues[static_cast<std::size_t>(field)];
+				}
+				break;
+			default:
+				break;
+			}
+			return true;
+		}
+
+		bool String(const char *value, rapidjson::SizeType length, bool)
+		{
+			if (skipDepth == 0 && target)
+			{
+				target->assign(value, length);
+				if (expect == Expect::SymbolName)
+				{
+					hasSymbol = true;
+				}
+				else if (target == &filterType)
+				{
+					filterCarries = FieldRegistry::filterFields(value, length);
+					if (filterCarries == 0)
+					{
+						// Nothing else in this filter is needed, the rest of its members go unread
+						skipDepth = 1;
+						skippingRest = true;
 					}
+				}
+			}
+			target = nullptr;
+			expect = Expect::Nothing;
+			return true;
+		}
 
-					// Using setter to set the symbol info
-					setSymbolInfo(symbol, {{"status", status},
-										   {"quoteAsset", quoteAsset},
-										   {"tickSize", tickSize},
-										   {"stepSize", stepSize}});
+		// Numbers, booleans and nulls are never needed
+		bool Default()
+		{
+			target = nullptr;
+			expect = Expect::Nothing;
+			return true;
+		}
+
+	private:
+		enum class State
+		{
+			Root,
+			TopLevel,
+			Symbols,
+			Symbol,
+			Filters,
+			Filter,
+			Done
+		};
+
+		enum class Expect
+		{
+			Nothing,
+			SymbolsArray,
+			FiltersArray,
+			SymbolName
+		};
+
+		void commitSymbol()
+		{
+			if (!hasSymbol)
+			{
+				// Log an error
+				logger->error("Missing or invalid 'symbol' in JSON response.");
+				return;
+			}
+
+			for (const FieldSpec &row : FieldRegistry::kSpecs)
+			{
+				const std::string &value = values[static_cast<std::size_t>(row.field)];
+				if (row.required && !FieldRegistry::validValue(row.field, value))
+				{
+					logger->error("Invalid {} '{}' for symbol {}.", row.name, value, symbol);
+					return;
 				}
+			}
 
-				else
+			SymbolTable::SymbolId id = symbolTable.insert(symbol, market);
+			for (const FieldSpec &row : FieldRegistry::kSpecs)
+			{
+				// Optional fields that are absent or malformed are simply left unset
+				const std::string &value = values[static_cast<std::size_t>(row.field)];
+				if (row.required || !value.empty())
 				{
-					// Log an error
-					logger->error("Missing or invalid 'symbol' in JSON response.");
+					symbolTable.setField(id, row.field, value);
 				}
 			}
+			++parsedCount;
 		}
-		else
+
+		SymbolTable &symbolTable;
+		MarketId market;
+		State state = State::Root;
+		Expect expect = Expect::Nothing;
+		int skipDepth = 0;
+		// skipDepth counts from the middle of the current object rather than from a container start
+		bool skippingRest = false;
+		std::string *target = nullptr;
+		bool symbolsSeen = false;
+		bool hasSymbol = false;
+		std::size_t parsedCount = 0;
+
+		// Reused for every symbol so steady-state parsing does not allocate; indexed by SymbolField
+		std::string symbol;
+		std::string values[FieldRegistry::kCount];
+		std::string filterType;
+		std::string filterValues[FieldRegistry::kCount];
+		// Fields the current filter's type carries
+		SymbolFieldMask filterCarries = 0;
+	};
+
+	void recordParse(std::chrono::steady_clock::duration elapsed, std::size_t bytes)
+	{
+		// Time per MB makes parses of differently sized markets comparable
+		metrics().parse.record(elapsed);
+		metrics().parsedBytes.fetch_add(bytes, std::memory_order_relaxed);
+		if (bytes > 0)
+		{
+			metrics().parsePerMB.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() * (1024.0 * 1024.0 / static_cast<double>(bytes))));
+		}
+	}
+
+	bool finishParse(const ExchangeInfoHandler &handler)
+	{
+		if (!handler.sawSymbolsArray())
 		{
 			// Log an error
 			logger->error("Missing or invalid 'symbols' array in JSON response.");
+			return false;
 		}
 
 		// Log success
-		logger->info("Successfully performed JSON data parsing");
+		logger->info("Successfully performed JSON data parsing of {} symbols", handler.symbolsParsed());
+		return true;
 	}
-	catch (std::exception const &e)
+
+	// ChunkReader that adds up the time spent waiting on its source, so parse metrics of a streamed body
+	// leave the network out
+	class TimedChunkReader
 	{
-		// Log an error
-		logger->error("Error: {}", e.what());
+	public:
+		explicit TimedChunkReader(const ChunkReader &source)
+			: source(source), reader([this](char *buffer, std::size_t size)
+									 {
+										 auto started = std::chrono::steady_clock::now();
+										 std::size_t read = this->source(buffer, size);
+										 waited += std::chrono::steady_clock::now() - started;
+										 return read; })
+		{
+		}
+
+		TimedChunkReader(const TimedChunkReader &) = delete;
+		TimedChunkReader &operator=(const TimedChunkReader &) = delete;
+
+		const ChunkReader &get() const { return reader; }
+		std::chrono::steady_clock::duration waitedFor() const { return waited; }
+
+	private:
+		const ChunkReader &source;
+		ChunkReader reader;
+		std::chrono::steady_clock::duration waited{0};
+	};
+
+	// Parse time without what source spent reading, when there is one
+	std::chrono::steady_clock::duration parseTime(std::chrono::steady_clock::time_point started, std::chrono::steady_clock::duration waitedBefore, const TimedChunkReader *source)
+	{
+		auto elapsed = std::chrono::steady_clock::now() - started;
+		return source ? elapsed - (source->waitedFor() - waitedBefore) : elapsed;
+	}
+
+	template <typename InputStream>
+	bool parseExchangeInfo(InputStream &stream, SymbolTable &symbolTable, MarketId market, const TimedChunkReader *source = nullptr)
+	{
+		ExchangeInfoHandler handler(symbolTable, market);
+		rapidjson::Reader reader;
+		auto waitedBefore = source ? source->waitedFor() : std::chrono::steady_clock::duration(0);
+		auto started = std::chrono::steady_clock::now();
+		rapidjson::ParseResult result = reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler);
+		recordParse(parseTime(started, waitedBefore, source), stream.Tell());
+
+		if (result.IsError())
+		{
+			// Log an error
+			logger->error("Error parsing JSON. Parse error code: {} ({}), Offset: {}", result.Code(), rapidjson::GetParseError_En(result.Code()), result.Offset());
+			return false;
+		}
+		return finishParse(handler);
+	}
+
+	bool scanExchangeInfo(JsonScanner &scanner, SymbolTable &symbolTable, MarketId market, const TimedChunkReader *source = nullptr)
+	{
+		ExchangeInfoHandler handler(symbolTable, market);
+		auto waitedBefore = source ? source->waitedFor() : std::chrono::steady_clock::duration(0);
+		auto started = std::chrono::steady_clock::now();
+		bool scanned = scanner.parse(handler);
+		recordParse(parseTime(started, waitedBefore, source), scanner.offset());
+
+		if (!scanned)
+		{
+			// Log an error
+			logger->error("Error parsing JSON. {} Offset: {}", scanner.error(), scanner.errorOffset());
+			return false;
+		}
+		return finishParse(handler);
 	}
 }
 
-// Getter method implementations
-const std::unordered_map<std::string, std::unordered_map<std::string, std::string>> &JSONParser::getSymbolInfoMap() const
+JSONParser::JSONParser()
+	: current(std::make_shared<const SymbolSnapshot>()), marketNames{"spot"}
 {
-	return symbolInfoMap;
+#if BINANCE_JSON_SCANNER
+	exchangeInfoParser = ExchangeInfoParser::Scanner;
+#endif
 }
 
-const std::unordered_map<std::string, std::string> &JSONParser::getSymbolInfo(const std::string &symbol) const
+MarketId JSONParser::addMarket(const std::string &name)
 {
-	auto it = symbolInfoMap.find(symbol);
-	if (it != symbolInfoMap.end())
+	MarketId market;
+	if (findMarket(name, market))
 	{
-		return it->second;
+		return market;
 	}
-	else
+	if (marketNames.size() > std::numeric_limits<MarketId>::max())
+	{
+		throw std::length_error("Too many markets, cannot add " + name);
+	}
+	marketNames.push_back(name);
+	return static_cast<MarketId>(marketNames.size() - 1);
+}
+
+bool JSONParser::findMarket(const std::string &name, MarketId &market) const
+{
+	for (std::size_t i = 0; i < marketNames.size(); ++i)
+	{
+		if (marketNames[i] == name)
+		{
+			market = static_cast<MarketId>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string JSONParser::overrideKey(MarketId market, const std::string &symbol)
+{
+	return std::string(1, static_cast<char>(market)) + symbol;
+}
+
+std::shared_ptr<const SymbolSnapshot> JSONParser::snapshot() const
+{
+	return std::atomic_load(&current);
+}
+
+void JSONParser::publish(std::shared_ptr<const SymbolSnapshot> next)
+{
+	if (sharedTable)
+	{
+		sharedTable->publishAll(*next);
+	}
+	std::atomic_store(&current, std::move(next));
+}
+
+void JSONParser::publish(std::shared_ptr<const SymbolSnapshot> next, const std::vector<SymbolKey> &changed)
+{
+	if (sharedTable)
+	{
+		sharedTable->publish(*next, changed);
+	}
+	std::atomic_store(&current, std::move(next));
+}
+
+bool JSONParser::parseAndPublish(const std::function<bool(SymbolTable &)> &parse, MarketId market)
+{
+	// Parse into a private table without holding the write lock; readers and writers carry on meanwhile
+	SymbolTable fresh;
+	if (!parse(fresh))
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(writeMutex);
+	mergeExchangeInfo(std::move(fresh), market);
+	return true;
+}
+
+void JSONParser::mergeExchangeInfo(SymbolTable fresh, MarketId market)
+{
+	std::vector<SymbolKey> changed;
+	std::size_t delisted = 0;
+	std::size_t keptOverrides = 0;
+
+	for (SymbolTable::SymbolId id = 0; id < fresh.rowCount(); ++id)
+	{
+		if (!fresh.isLive(id))
+		{
+			continue;
+		}
+		std::string symbol = fresh.name(id);
+		SymbolTable::SymbolId previous = exchangeTable.find(symbol, market);
+		bool exchangeChanged = previous == SymbolTable::npos || !fresh.sameRow(id, exchangeTable, previous);
+		if (!exchangeChanged)
+		{
+			// Nothing new from the exchange; a local UPDATE or DELETE of this symbol stays in force
+			keptOverrides += localOverrides.count(overrideKey(market, symbol));
+			continue;
+		}
+		// The exchange moved on, its data replaces any local override
+		localOverrides.erase(overrideKey(market, symbol));
+		changed.push_back({market, std::move(symbol)});
+	}
+
+	// Only this market's symbols can be delisted by its response
+	for (SymbolTable::SymbolId id = 0; id < exchangeTable.rowCount(); ++id)
 	{
-		// Symbol not found, return an empty map or handle appropriately
-		static const std::unordered_map<std::string, std::string> emptyMap;
-		return emptyMap;
+		if (exchangeTable.isLive(id) && exchangeTable.market(id) == market && fresh.find(exchangeTable.name(id), market) == SymbolTable::npos)
+		{
+			std::string symbol = exchangeTable.name(id);
+			localOverrides.erase(overrideKey(market, symbol));
+			changed.push_back({market, std::move(symbol)});
+			++delisted;
+		}
 	}
+
+	if (!changed.empty())
+	{
+		const SymbolSnapshot::RowEdit applyFresh = [&fresh, market](SymbolTable &table, SymbolTable::SymbolId id)
+		{
+			std::string symbol = table.name(id);
+			SymbolTable::SymbolId freshId = fresh.find(symbol, market);
+			if (freshId == SymbolTable::npos)
+			{
+				table.erase(symbol, market);
+				return;
+			}
+			table.insert(symbol, market);
+			table.copyRow(id, fresh, freshId);
+		};
+		publish(snapshot()->withEdits(changed, applyFresh), changed);
+
+		// The baseline keeps the other markets, so only the changed rows are carried over
+		for (const SymbolKey &key : changed)
+		{
+			SymbolTable::SymbolId id = exchangeTable.findRow(key.symbol, market);
+			applyFresh(exchangeTable, id != SymbolTable::npos ? id : exchangeTable.insert(key.symbol, market));
+		}
+		markSnapshotDirty();
+	}
+	logger->info("exchangeInfo for {} merged: {} symbols changed, {} delisted, {} local overrides kept.", marketName(market), changed.size() - delisted, delisted, keptOverrides);
 }
+
+bool JSONParser::performJSONDataParsing(const std::string &jsonResponse, MarketId market)
+{
+	try
+	{
+		logger->info("PerformJSONDataParsing called.");
+		bool parsed = parseAndPublish([this, &jsonResponse, market](SymbolTable &table)
+									  {
+										  if (exchangeInfoParser == ExchangeInfoParser::Scanner)
+										  {
+											  JsonScanner scanner(jsonResponse.data(), jsonResponse.size());
+											  return scanExchangeInfo(scanner, table, market);
+										  }
+										  rapidjson::StringStream stream(jsonResponse.c_str());
+										  return parseExchangeInfo(stream, table, market); },
+									  market);
+		logMemoryUsage();
+		return parsed;
+	}
+	catch (std::exception const &e)
+	{
+		// Log an error
+		logger->error("Error: {}", e.what());
+		return false;
+	}
+}
+
+bool JSONParser::performJSONDataParsing(const ChunkReader &readChunk, MarketId market)
+{
+	try
+	{
+		logger->info("PerformJSONDataParsing called on a streamed body.");
+		bool parsed = parseAndPublish([this, &readChunk, market](SymbolTable &table)
+									  {
+										  TimedChunkReader timed(readChunk);
+										  if (exchangeInfoParser == ExchangeInfoParser::Scanner)
+										  {
+											  JsonScanner scanner(timed.get());
+											  return scanExchangeInfo(scanner, table, market, &timed);
+										  }
+										  ChunkedInputStream stream(timed.get());
+										  return parseExchangeInfo(stream, table, market, &timed); },
+									  market);
+		logMemoryUsage();
+		return parsed;
+	}
+	catch (std::exception const &e)
+	{
+		// Log an error
+		logger->error("Error: {}", e.what());
+		return false;
+	}
+}
+
+// Getter method implementations
+std::unordered_map<std::string, std::unordered_map<std::string, std::string>> JSONParser::getSymbolInfoMap(MarketId market) const
+{
+	std::unordered_map<std::string, std::unordered_map<std::string, std::string>> infoMap;
+	snapshot()->forEach([&infoMap, market](const std::string &symbol, SymbolSnapshot::Row row)
+						{
+							if (row.table->market(row.id) == market)
+							{
+								infoMap.emplace(symbol, row.table->toMap(row.id));
+							} });
+	return infoMap;
+}
+
+std::unordered_map<std::string, std::string> JSONParser::getSymbolInfo(const std::string &symbol, MarketId market) const
+{
+	// Unknown or deleted symbols give an empty map
+	return snapshot()->toMap(symbol, market);
+}
+
 // Setter method implementations
 void JSONParser::setSymbolInfoMap(const std::unordered_map<std::string, std::unordered_map<std::string, std::string>> &symbolInfoMap)
 {
-	this->symbolInfoMap = symbolInfoMap;
+	SymbolTable table;
+	for (const auto &entry : symbolInfoMap)
+	{
+		SymbolTable::SymbolId id = table.insert(entry.first);
+		applyInfo(table, id, entry.first, entry.second);
+	}
+
+	// Treated like freshly fetched data: it becomes the baseline later refreshes are compared against
+	std::lock_guard<std::mutex> lock(writeMutex);
+	exchangeTable = table;
+	localOverrides.clear();
+	publish(std::make_shared<const SymbolSnapshot>(std::move(table)));
 }
 
-void JSONParser::setSymbolInfo(const std::string &symbol, const std::unordered_map<std::string, std::string> &infoMap)
+void JSONParser::setSymbolInfo(const std::string &symbol, const std::unordered_map<std::string, std::string> &infoMap, MarketId market)
 {
-	symbolInfoMap[symbol] = infoMap;
-	// logger->info("Symbol info map contents:");
-	// for (const auto &entry : symbolInfoMap)
-	// {
-	// 	logger->info("Symbol: {}", entry.first);
-	// 	for (const auto &info : entry.second)
-	// 	{
-	// 		logger->info("  {} : {}", info.first, info.second);
-	// 	}
-	// }
+	std::lock_guard<std::mutex> lock(writeMutex);
+	localOverrides.insert(overrideKey(market, symbol));
+	publish(snapshot()->withEdit({market, symbol}, [&](SymbolTable &table, SymbolTable::SymbolId id)
+								 {
+									 // Replaces the whole row, like assigning a new entry did
+									 table.insert(symbol, market);
+									 applyInfo(table, id, symbol, infoMap); }),
+			{{market, symbol}});
 }
 
-void JSONParser::handleDelete(const std::string &symbol)
+void JSONParser::applyInfo(SymbolTable &table, SymbolTable::SymbolId id, const std::string &symbol, const std::unordered_map<std::string, std::string> &infoMap)
 {
-	logger->info("Before deletion. SymbolInfoMap size: {}", symbolInfoMap.size());
-	const auto &it = symbolInfoMap.find(symbol);
-	if (it != symbolInfoMap.end())
+	for (const auto &info : infoMap)
 	{
-		// Symbol found, perform deletion
-		symbolInfoMap.erase(it);
-		logger->info("Symbol {} deleted.", symbol);
+		if (!table.setField(id, info.first, info.second))
+		{
+			logger->warn("Symbol: {}, ignoring unknown or malformed field {} = '{}'.", symbol, info.first, info.second);
+		}
+	}
+}
+
+void JSONParser::logMemoryUsage() const
+{
+	std::shared_ptr<const SymbolSnapshot> view = snapshot();
+	std::size_t bytes = view->memoryUsage();
+	std::size_t symbols = view->size();
+	logger->info("Symbol table holds {} symbols in {} bytes ({} bytes per symbol).", symbols, bytes, symbols ? bytes / symbols : 0);
+}
+
+void JSONParser::handleDelete(const std::string &symbol, MarketId market)
+{
+	std::lock_guard<std::mutex> lock(writeMutex);
+	std::shared_ptr<const SymbolSnapshot> view = snapshot();
+	SPDLOG_LOGGER_TRACE(logger, "Before deletion. SymbolTable size: {}", view->size());
+	if (view->find(symbol, market))
+	{
+		// Symbol found, publish a version without it
+		view = view->withEdit({market, symbol}, [&symbol, market](SymbolTable &table, SymbolTable::SymbolId)
+							  { table.erase(symbol, market); });
+		publish(view, {{market, symbol}});
+		localOverrides.insert(overrideKey(market, symbol));
+		SPDLOG_LOGGER_DEBUG(logger, "Symbol {} deleted.", symbol);
 	}
 	else
 	{
 		// Symbol not found
 		logger->warn("Symbol {} not found for deletion.", symbol);
 	}
-	logger->info("After deletion. SymbolInfoMap size: {}", symbolInfoMap.size());
+	SPDLOG_LOGGER_TRACE(logger, "After deletion. SymbolTable size: {}", view->size());
 }
 
-void JSONParser::handleUpdate(const std::string &symbol, const std::unordered_map<std::string, std::string> &updatedInfo)
+void JSONParser::handleUpdate(const std::string &symbol, const std::unordered_map<std::string, std::string> &updatedInfo, MarketId market)
 {
-
-	const auto &it = symbolInfoMap.find(symbol);
-	if (it != symbolInfoMap.end())
+	std::vector<std::pair<SymbolField, std::string>> fields;
+	for (const auto &entry : updatedInfo)
 	{
-		for (const auto &entry : updatedInfo)
+		SymbolField field;
+		if (!symbolFieldFromName(entry.first, field))
 		{
-			logger->info("Before update. SymbolInfoMap: {}", it->second[entry.first]);
-			it->second[entry.first] = entry.second;
-			logger->info("Symbol: {}, Field: {} updated to {}", symbol, entry.first, entry.second);
-			logger->info("After update. SymbolInfoMap: {}", it->second[entry.first]);
+			logger->warn("Symbol: {}, unknown field {}, update dropped.", symbol, entry.first);
+			return;
 		}
+		fields.emplace_back(field, entry.second);
 	}
-	else
+	handleUpdate(symbol, fields, market);
+}
+
+bool JSONParser::handleUpdate(const std::string &symbol, const std::vector<std::pair<SymbolField, std::string>> &fields, MarketId market)
+{
+	std::lock_guard<std::mutex> lock(writeMutex);
+	std::shared_ptr<const SymbolSnapshot> view = snapshot();
+	if (!view->find(symbol, market))
 	{
 		// Symbol not found
 		logger->warn("Symbol {} not found for update.", symbol);
+		return false;
 	}
-}
\ No newline at end of file
+	if (fields.empty())
+	{
+		// Nothing to change: no new version, no override, cached answers stay valid
+		return true;
+	}
+
+	// All fields of one UPDATE land in the same new version, readers never see half of it; a field the
+	// table refuses rejects the whole UPDATE
+	bool rejected = false;
+	std::shared_ptr<const SymbolSnapshot> next = view->withEdit({market, symbol}, [&](SymbolTable &table, SymbolTable::SymbolId id)
+						   {
+							   for (const auto &entry : fields)
+							   {
+								   const char *name = symbolFieldName(entry.first);
+								   // fieldText builds a string, so only pay for it when the record will be written
+								   bool traceValues = logger->should_log(spdlog::level::trace);
+								   if (traceValues)
+								   {
+									   SPDLOG_LOGGER_TRACE(logger, "Before update. SymbolTable: {}", table.fieldText(id, entry.first));
+								   }
+								   if (!table.setField(id, entry.first, entry.second))
+								   {
+									   logger->warn("Symbol: {}, Field: {} rejected value {} (malformed, or too many distinct values), update dropped", symbol, name, entry.second);
+									   rejected = true;
+									   return;
+								   }
+								   SPDLOG_LOGGER_DEBUG(logger, "Symbol: {}, Field: {} updated to {}", symbol, name, entry.second);
+								   if (traceValues)
+								   {
+									   SPDLOG_LOGGER_TRACE(logger, "After update. SymbolTable: {}", table.fieldText(id, entry.first));
+								   }
+							   } });
+	if (rejected)
+	{
+		return false;
+	}
+	localOverrides.insert(overrideKey(market, symbol));
+	publish(next, {{market, symbol}});
+	return true;
+}
+
+bool JSONParser::applyExchangeUpdate(const std::string &symbol, const std::vector<std::pair<SymbolField, std::string>> &fields, MarketId market)
+{
+	std::lock_guard<std::mutex> lock(writeMutex);
+	SymbolTable::SymbolId id = exchangeTable.find(symbol, market);
+	if (id == SymbolTable::npos)
+	{
+		// New listings arrive with the next exchangeInfo, which has all of their fields
+		return false;
+	}
+	bool changed = false;
+	for (const auto &field : fields)
+	{
+		if (exchangeTable.fieldIs(id, field.first, field.second.data(), field.second.size()))
+		{
+			continue;
+		}
+		if (!exchangeTable.setField(id, field.first, field.second))
+		{
+			logger->warn("Symbol: {}, exchange sent malformed or one too many distinct {} '{}'.", symbol, symbolFieldName(field.first), field.second);
+			continue;
+		}
+		changed = true;
+	}
+	if (!changed)
+	{
+		return false;
+	}
+
+	localOverrides.erase(overrideKey(market, symbol));
+	publish(snapshot()->withEdit({market, symbol}, [this, &symbol, market, id](SymbolTable &table, SymbolTable::SymbolId row)
+								 {
+									 table.insert(symbol, market);
+									 table.copyRow(row, exchangeTable, id); }),
+			{{market, symbol}});
+	// A burst of stream events costs one snapshot write per interval, made off this lock
+	markSnapshotDirty();
+	logger->info("Symbol {} on {} changed on the exchange.", symbol, marketName(market));
+	return true;
+}
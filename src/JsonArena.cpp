@@ -0,0 +1,52 @@
+#include "JsonArena.h"
+#include <algorithm>
+
+JsonArena::JsonArena(std::size_t valueBytes, std::size_t stackBytes) : valueBytes(valueBytes), stackBytes(stackBytes)
+{
+}
+
+JsonArena::~JsonArena() = default;
+
+void JsonArena::allocate()
+{
+	current.reset();
+	valuePool.reset();
+	stackPool.reset();
+	valueBuffer = std::make_unique<char[]>(valueBytes);
+	stackBuffer = std::make_unique<char[]>(stackBytes);
+	heapAllocationCount += 2;
+	valuePool.emplace(valueBuffer.get(), valueBytes);
+	stackPool.emplace(stackBuffer.get(), stackBytes);
+}
+
+JsonArena::Document &JsonArena::document()
+{
+	// The buffers come with the first document, so an arena that is never used costs nothing
+	if (!valueBuffer)
+	{
+		allocate();
+	}
+	else if (current)
+	{
+		// A pool that holds more than its buffer had to add heap chunks during the last document
+		std::size_t valueNeeded = valuePool->Capacity();
+		std::size_t stackNeeded = stackPool->Capacity();
+		current.reset();
+		if (valueNeeded > valueBytes || stackNeeded > stackBytes)
+		{
+			++heapAllocationCount;
+			// Headroom, so a document slightly bigger than the last one does not spill again
+			valueBytes = std::max(valueBytes, valueNeeded + valueNeeded / 2);
+			stackBytes = std::max(stackBytes, stackNeeded + stackNeeded / 2);
+			allocate();
+		}
+		else
+		{
+			valuePool->Clear();
+			stackPool->Clear();
+		}
+	}
+	// The parser's first stack block takes half the stack buffer, leaving room for it to grow once
+	current.emplace(&*valuePool, stackBytes / 2, &*stackPool);
+	return *current;
+}
@@ -0,0 +1,611 @@
+#include "JsonScanner.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSON_SCANNER_X86 1
+#else
+#define JSON_SCANNER_X86 0
+#endif
+
+namespace
+{
+	constexpr std::size_t kBlock = 64;
+
+	// One bit per byte of a 64-byte block
+	struct BlockMasks
+	{
+		uint64_t quote = 0;
+		uint64_t backslash = 0;
+		// '[' or '{', and ']' or '}'
+		uint64_t open = 0;
+		uint64_t close = 0;
+	};
+
+	using Classifier = void (*)(const char *block, BlockMasks &masks);
+
+	// '[' | 0x20 is '{' and ']' | 0x20 is '}', and no other byte maps onto either
+	void classifyScalar(const char *block, BlockMasks &masks)
+	{
+		masks = BlockMasks();
+		for (std::size_t i = 0; i < kBlock; ++i)
+		{
+			uint64_t bit = uint64_t(1) << i;
+			char c = block[i];
+			masks.quote |= c == '"' ? bit : 0;
+			masks.backslash |= c == '\\' ? bit : 0;
+			masks.open |= (c | 0x20) == '{' ? bit : 0;
+			masks.close |= (c | 0x20) == '}' ? bit : 0;
+		}
+	}
+
+#if JSON_SCANNER_X86
+	__attribute__((target("sse2"))) void classifySSE2(const char *block, BlockMasks &masks)
+	{
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+		const __m128i lower = _mm_set1_epi8(0x20);
+		const __m128i open = _mm_set1_epi8('{');
+		const __m128i close = _mm_set1_epi8('}');
+		masks = BlockMasks();
+		for (int part = 0; part < 4; ++part)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + part * 16));
+			__m128i folded = _mm_or_si128(bytes, lower);
+			int shift = part * 16;
+			masks.quote |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote)))) << shift;
+			masks.backslash |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, backslash)))) << shift;
+			masks.open |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, open)))) << shift;
+			masks.close |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, close)))) << shift;
+		}
+	}
+
+	__attribute__((target("avx2"))) void classifyAVX2(const char *block, BlockMasks &masks)
+	{
+		const __m256i quote = _mm256_set1_epi8('"');
+		const __m256i backslash = _mm256_set1_epi8('\\');
+		const __m256i lower = _mm256_set1_epi8(0x20);
+		const __m256i open = _mm256_set1_epi8('{');
+		const __m256i close = _mm256_set1_epi8('}');
+		masks = BlockMasks();
+		for (int part = 0; part < 2; ++part)
+		{
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + part * 32));
+			__m256i folded = _mm256_or_si256(bytes, lower);
+			int shift = part * 32;
+			masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, quote)))) << shift;
+			masks.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, backslash)))) << shift;
+			masks.open |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, open)))) << shift;
+			masks.close |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, close)))) << shift;
+		}
+	}
+#endif
+
+	ScanBackend detectBackend()
+	{
+		for (ScanBackend backend : {ScanBackend::AVX2, ScanBackend::SSE2})
+		{
+			if (scanBackendSupported(backend))
+			{
+				return backend;
+			}
+		}
+		return ScanBackend::Scalar;
+	}
+
+	ScanBackend &selectedBackend()
+	{
+		static ScanBackend backend = detectBackend();
+		return backend;
+	}
+
+	Classifier classifierFor(ScanBackend backend)
+	{
+		switch (backend)
+		{
+#if JSON_SCANNER_X86
+		case ScanBackend::AVX2:
+			return classifyAVX2;
+		case ScanBackend::SSE2:
+			return classifySSE2;
+#endif
+		default:
+			return classifyScalar;
+		}
+	}
+
+	Classifier classify = classifierFor(selectedBackend());
+
+	// Bit i set when an odd number of bits at or below i are set: from the quote mask, the bytes inside
+	// strings (opening quote included, closing quote not)
+	uint64_t prefixXor(uint64_t bits)
+	{
+		bits ^= bits << 1;
+		bits ^= bits << 2;
+		bits ^= bits << 4;
+		bits ^= bits << 8;
+		bits ^= bits << 16;
+		bits ^= bits << 32;
+		return bits;
+	}
+
+	bool isWhitespace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	void appendUtf8(std::string &out, uint32_t codepoint)
+	{
+		if (codepoint < 0x80)
+		{
+			out += static_cast<char>(codepoint);
+		}
+		else if (codepoint < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (codepoint >> 6));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (codepoint >> 12));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (codepoint >> 18));
+			out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+	}
+
+	bool hex4(const char *text, uint32_t &value)
+	{
+		value = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			char c = text[i];
+			int digit = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : -1;
+			if (digit < 0)
+			{
+				return false;
+			}
+			value = value << 4 | static_cast<uint32_t>(digit);
+		}
+		return true;
+	}
+
+	// Body of a string (between the quotes) with its escapes resolved; false on an invalid escape
+	bool unescape(const char *text, const char *end, std::string &out)
+	{
+		out.clear();
+		while (text < end)
+		{
+			const char *backslash = static_cast<const char *>(std::memchr(text, '\\', static_cast<std::size_t>(end - text)));
+			if (!backslash)
+			{
+				out.append(text, end);
+				return true;
+			}
+			out.append(text, backslash);
+			text = backslash + 1;
+			uint32_t codepoint;
+			switch (*text++)
+			{
+			case '"':
+				out += '"';
+				break;
+			case '\\':
+				out += '\\';
+				break;
+			case '/':
+				out += '/';
+				break;
+			case 'b':
+				out += '\b';
+				break;
+			case 'f':
+				out += '\f';
+				break;
+			case 'n':
+				out += '\n';
+				break;
+			case 'r':
+				out += '\r';
+				break;
+			case 't':
+				out += '\t';
+				break;
+			case 'u':
+				if (end - text < 4 || !hex4(text, codepoint))
+				{
+					return false;
+				}
+				text += 4;
+				// A high surrogate has to be followed by an escaped low one
+				if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+				{
+					uint32_t low;
+					if (end - text < 6 || text[0] != '\\' || text[1] != 'u' || !hex4(text + 2, low) || low < 0xDC00 || low > 0xDFFF)
+					{
+						return false;
+					}
+					text += 6;
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+				{
+					return false;
+				}
+				appendUtf8(out, codepoint);
+				break;
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// JSON's number grammar, one byte at a time: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	enum class NumberState : uint8_t
+	{
+		Start,
+		Minus,
+		Zero,
+		Integer,
+		Dot,
+		Fraction,
+		Exponent,
+		ExponentSign,
+		ExponentDigits,
+		Invalid
+	};
+
+	NumberState nextNumberState(NumberState state, char c)
+	{
+		bool digit = c >= '0' && c <= '9';
+		switch (state)
+		{
+		case NumberState::Start:
+			if (c == '-')
+			{
+				return NumberState::Minus;
+			}
+			// fall through
+		case NumberState::Minus:
+			return c == '0' ? NumberState::Zero : digit ? NumberState::Integer : NumberState::Invalid;
+		case NumberState::Integer:
+			if (digit)
+			{
+				return NumberState::Integer;
+			}
+			// fall through
+		case NumberState::Zero:
+			return c == '.' ? NumberState::Dot : (c | 0x20) == 'e' ? NumberState::Exponent : NumberState::Invalid;
+		case NumberState::Dot:
+			return digit ? NumberState::Fraction : NumberState::Invalid;
+		case NumberState::Fraction:
+			return digit ? NumberState::Fraction : (c | 0x20) == 'e' ? NumberState::Exponent : NumberState::Invalid;
+		case NumberState::Exponent:
+			if (c == '+' || c == '-')
+			{
+				return NumberState::ExponentSign;
+			}
+			// fall through
+		case NumberState::ExponentSign:
+		case NumberState::ExponentDigits:
+			return digit ? NumberState::ExponentDigits : NumberState::Invalid;
+		default:
+			return NumberState::Invalid;
+		}
+	}
+
+	bool numberComplete(NumberState state)
+	{
+		return state == NumberState::Zero || state == NumberState::Integer || state == NumberState::Fraction || state == NumberState::ExponentDigits;
+	}
+}
+
+ScanBackend activeScanBackend()
+{
+	return selectedBackend();
+}
+
+bool scanBackendSupported(ScanBackend backend)
+{
+#if JSON_SCANNER_X86
+	__builtin_cpu_init();
+	switch (backend)
+	{
+	case ScanBackend::AVX2:
+		return __builtin_cpu_supports("avx2");
+	case ScanBackend::SSE2:
+		return __builtin_cpu_supports("sse2");
+	default:
+		return true;
+	}
+#else
+	return backend == ScanBackend::Scalar;
+#endif
+}
+
+bool setScanBackend(ScanBackend backend)
+{
+	if (!scanBackendSupported(backend))
+	{
+		return false;
+	}
+	selectedBackend() = backend;
+	classify = classifierFor(backend);
+	return true;
+}
+
+const char *scanBackendName(ScanBackend backend)
+{
+	switch (backend)
+	{
+	case ScanBackend::AVX2:
+		return "AVX2";
+	case ScanBackend::SSE2:
+		return "SSE2";
+	default:
+		return "scalar";
+	}
+}
+
+JsonScanner::JsonScanner(const char *data, std::size_t size) : data(data), p(data), end(data + size), exhausted(true)
+{
+}
+
+JsonScanner::JsonScanner(const Refill &refill, std::size_t bufferSize) : refill(refill), buffer(std::max<std::size_t>(bufferSize, kBlock))
+{
+	data = p = end = buffer.data();
+}
+
+bool JsonScanner::fail(const char *message)
+{
+	if (!errorText)
+	{
+		errorText = message;
+		failedAt = offset();
+	}
+	return false;
+}
+
+bool JsonScanner::fill()
+{
+	if (exhausted)
+	{
+		return false;
+	}
+	std::size_t kept = static_cast<std::size_t>(end - p);
+	consumed += static_cast<std::size_t>(p - data);
+	std::memmove(buffer.data(), p, kept);
+	// A token that fills the whole buffer needs a bigger one
+	if (kept == buffer.size())
+	{
+		buffer.resize(buffer.size() * 2);
+	}
+	std::size_t read = refill(buffer.data() + kept, buffer.size() - kept);
+	exhausted = read == 0;
+	data = p = buffer.data();
+	end = data + kept + read;
+	return read > 0;
+}
+
+bool JsonScanner::skipWhitespace()
+{
+	for (;;)
+	{
+		while (p < end && isWhitespace(*p))
+		{
+			++p;
+		}
+		if (p < end || !fill())
+		{
+			return p < end;
+		}
+	}
+}
+
+bool JsonScanner::readString(const char *&text, std::size_t &length)
+{
+	// Strings worth reading are short, a byte loop finds their end sooner than a block scan
+	std::size_t scanned = 1;
+	bool escaped = false;
+	for (;;)
+	{
+		const char *at = p + scanned;
+		while (at < end && *at != '"')
+		{
+			if (static_cast<unsigned char>(*at) < 0x20)
+			{
+				return fail("Invalid character in a string.");
+			}
+			if (*at == '\\')
+			{
+				escaped = true;
+				++at;
+			}
+			++at;
+		}
+		if (at < end)
+		{
+			if (escaped)
+			{
+				if (!unescape(p + 1, at, unescaped))
+				{
+					return fail("Invalid escape in a string.");
+				}
+				text = unescaped.data();
+				length = unescaped.size();
+			}
+			else
+			{
+				text = p + 1;
+				length = static_cast<std::size_t>(at - p - 1);
+			}
+			p = at + 1;
+			return true;
+		}
+		// Resume after the last complete character once more of the document is in; fill keeps p's offset 0
+		scanned = static_cast<std::size_t>(std::min(at, end) - p);
+		if (at > end)
+		{
+			--scanned;
+		}
+		if (!fill())
+		{
+			return fail("Missing a closing quotation mark in a string.");
+		}
+	}
+}
+
+bool JsonScanner::skipScalar()
+{
+	const char *literal = nullptr;
+	switch (*p)
+	{
+	case 't':
+		literal = "true";
+		break;
+	case 'f':
+		literal = "false";
+		break;
+	case 'n':
+		literal = "null";
+		break;
+	default:
+		if (*p != '-' && (*p < '0' || *p > '9'))
+		{
+			return fail("Invalid value.");
+		}
+	}
+
+	// The token runs to the next delimiter, possibly across refills, and is checked byte by byte
+	NumberState state = NumberState::Start;
+	std::size_t matched = 0;
+	for (;;)
+	{
+		while (p < end && !isWhitespace(*p) && *p != ',' && *p != ']' && *p != '}')
+		{
+			if (literal)
+			{
+				if (literal[matched] != *p)
+				{
+					return fail("Invalid value.");
+				}
+				++matched;
+			}
+			else if ((state = nextNumberState(state, *p)) == NumberState::Invalid)
+			{
+				return fail("Invalid value.");
+			}
+			++p;
+		}
+		if (p < end || !fill())
+		{
+			break;
+		}
+	}
+	return (literal ? literal[matched] == '\0' : numberComplete(state)) || fail("Invalid value.");
+}
+
+bool JsonScanner::skipToClose()
+{
+	int64_t depth = 1;
+	bool inString = false;
+	bool escape = false;
+	char padded[kBlock];
+	for (;;)
+	{
+		if (p == end && !fill())
+		{
+			return fail("Missing a closing bracket.");
+		}
+		// A short tail is padded with spaces, which are none of the classified bytes
+		std::size_t length = std::min(kBlock, static_cast<std::size_t>(end - p));
+		if (length < kBlock && fill())
+		{
+			continue;
+		}
+		const char *block = p;
+		if (length < kBlock)
+		{
+			std::memset(padded, ' ', kBlock);
+			std::memcpy(padded, p, length);
+			block = padded;
+		}
+
+		BlockMasks masks;
+		classify(block, masks);
+		if (masks.backslash || escape)
+		{
+			// Escapes are rare enough in exchange data that a byte loop over their block is fine
+			for (std::size_t i = 0; i < length; ++i)
+			{
+				char c = block[i];
+				if (inString)
+				{
+					if (escape)
+					{
+						escape = false;
+					}
+					else if (c == '\\')
+					{
+						escape = true;
+					}
+					else if (c == '"')
+					{
+						inString = false;
+					}
+				}
+				else if (c == '"')
+				{
+					inString = true;
+				}
+				else if ((c | 0x20) == '{')
+				{
+					++depth;
+				}
+				else if ((c | 0x20) == '}' && --depth == 0)
+				{
+					p += i + 1;
+					return true;
+				}
+			}
+			p += length;
+			continue;
+		}
+
+		uint64_t stringBytes = prefixXor(masks.quote) ^ (inString ? ~uint64_t(0) : 0);
+		uint64_t opens = masks.open & ~stringBytes;
+		uint64_t closes = masks.close & ~stringBytes;
+		int closeCount = __builtin_popcountll(closes);
+		if (closeCount < depth)
+		{
+			// The container cannot end in this block
+			depth += __builtin_popcountll(opens) - closeCount;
+		}
+		else
+		{
+			for (uint64_t brackets = opens | closes; brackets; brackets &= brackets - 1)
+			{
+				int i = __builtin_ctzll(brackets);
+				if (opens >> i & 1)
+				{
+					++depth;
+				}
+				else if (--depth == 0)
+				{
+					p += i + 1;
+					return true;
+				}
+			}
+		}
+		inString = stringBytes >> 63;
+		p += length;
+	}
+}
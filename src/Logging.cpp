@@ -0,0 +1,142 @@
+#include "Logging.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/null_sink.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include <vector>
+
+bool readLoggingOptions(const rapidjson::Value &config, LoggingOptions &options, std::string &error)
+{
+	if (!config.IsObject() || !config.HasMember("logging"))
+	{
+		return true;
+	}
+	const rapidjson::Value &logging = config["logging"];
+	if (!logging.IsObject())
+	{
+		error = "'logging' must be an object";
+		return false;
+	}
+
+	if (logging.HasMember("level"))
+	{
+		std::string level = logging["level"].IsString() ? logging["level"].GetString() : "";
+		if (level == "fatal")
+		{
+			level = "critical";
+		}
+		options.level = spdlog::level::from_str(level);
+		if (options.level == spdlog::level::off && level != "off")
+		{
+			error = "invalid 'logging.level'";
+			return false;
+		}
+	}
+
+	if (logging.HasMember("file"))
+	{
+		const rapidjson::Value &file = logging["file"];
+		if (file.IsBool())
+		{
+			options.filePath = file.GetBool() ? LoggingOptions().filePath : "";
+		}
+		else if (file.IsString())
+		{
+			options.filePath = file.GetString();
+		}
+		else
+		{
+			error = "'logging.file' must be a boolean or a path";
+			return false;
+		}
+	}
+
+	if (logging.HasMember("console"))
+	{
+		if (!logging["console"].IsBool())
+		{
+			error = "'logging.console' must be a boolean";
+			return false;
+		}
+		options.console = logging["console"].GetBool();
+	}
+
+	if (logging.HasMember("async"))
+	{
+		if (!logging["async"].IsBool())
+		{
+			error = "'logging.async' must be a boolean";
+			return false;
+		}
+		options.async = logging["async"].GetBool();
+	}
+
+	if (logging.HasMember("queue_size"))
+	{
+		if (!logging["queue_size"].IsUint() || logging["queue_size"].GetUint() == 0)
+		{
+			error = "'logging.queue_size' must be a positive integer";
+			return false;
+		}
+		options.queueSize = logging["queue_size"].GetUint();
+	}
+
+	if (logging.HasMember("overflow"))
+	{
+		std::string overflow = logging["overflow"].IsString() ? logging["overflow"].GetString() : "";
+		if (overflow == "block")
+		{
+			options.overflowPolicy = spdlog::async_overflow_policy::block;
+		}
+		else if (overflow == "overrun_oldest")
+		{
+			options.overflowPolicy = spdlog::async_overflow_policy::overrun_oldest;
+		}
+		else
+		{
+			error = "'logging.overflow' must be \"block\" or \"overrun_oldest\"";
+			return false;
+		}
+	}
+	return true;
+}
+
+std::shared_ptr<spdlog::logger> createLogger(const std::string &name, const LoggingOptions &options)
+{
+	std::vector<spdlog::sink_ptr> sinks;
+	if (!options.filePath.empty())
+	{
+		sinks.push_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>(options.filePath));
+	}
+	if (options.console)
+	{
+		sinks.push_back(std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
+	}
+	if (sinks.empty())
+	{
+		sinks.push_back(std::make_shared<spdlog::sinks::null_sink_mt>());
+	}
+
+	std::shared_ptr<spdlog::logger> created;
+	if (options.async)
+	{
+		if (!spdlog::thread_pool())
+		{
+			spdlog::init_thread_pool(options.queueSize, 1);
+		}
+		created = std::make_shared<spdlog::async_logger>(name, sinks.begin(), sinks.end(), spdlog::thread_pool(), options.overflowPolicy);
+	}
+	else
+	{
+		created = std::make_shared<spdlog::logger>(name, sinks.begin(), sinks.end());
+	}
+
+	created->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] [thread %t] %v");
+	created->set_level(options.level);
+	// Flushing on every info record made each query wait for the disk; warnings and errors still go out
+	// immediately, everything else at least once a second
+	created->flush_on(spdlog::level::warn);
+	spdlog::register_logger(created);
+	spdlog::flush_every(std::chrono::seconds(1));
+	return created;
+}
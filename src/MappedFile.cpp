@@ -0,0 +1,120 @@
+#include "MappedFile.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::close()
+{
+	unmap();
+	std::string().swap(buffer);
+	bytes = buffer.c_str();
+	length = 0;
+}
+
+void MappedFile::unmap()
+{
+	if (mapping)
+	{
+		::munmap(mapping, mappedSize);
+		mapping = nullptr;
+	}
+}
+
+bool MappedFile::open(const std::string &path)
+{
+	close();
+	return load(path, true);
+}
+
+bool MappedFile::read(const std::string &path)
+{
+	unmap();
+	buffer.clear();
+	bytes = buffer.c_str();
+	length = 0;
+	return load(path, false);
+}
+
+bool MappedFile::load(const std::string &path, bool map)
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (::fstat(fd, &info) != 0)
+	{
+		int error = errno;
+		::close(fd);
+		errno = error;
+		return false;
+	}
+
+	if (map && S_ISREG(info.st_mode) && info.st_size > 0)
+	{
+		// The file goes over the start of a zeroed anonymous region one byte longer, so the view ends in a
+		// NUL even when the file fills its last page. Populating up front takes one pass over the page
+		// cache instead of a fault per page during parsing.
+		std::size_t size = static_cast<std::size_t>(info.st_size);
+		void *region = ::mmap(nullptr, size + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (region != MAP_FAILED)
+		{
+			void *view = ::mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED | MAP_POPULATE, fd, 0);
+			if (view != MAP_FAILED)
+			{
+				::close(fd);
+				mapping = view;
+				mappedSize = size + 1;
+				bytes = static_cast<const char *>(view);
+				length = size;
+				return true;
+			}
+			::munmap(region, size + 1);
+		}
+	}
+
+	// Not to be mapped, not mappable, or empty by its size like the files in /proc: read until EOF, growing the buffer
+	// geometrically. A regular file gets one spare byte, so the read that finds EOF has room and the buffer
+	// only doubles when the file grew since fstat.
+	std::size_t received = 0;
+	buffer.resize(S_ISREG(info.st_mode) && info.st_size > 0 ? static_cast<std::size_t>(info.st_size) + 1 : 65536);
+	while (true)
+	{
+		if (received == buffer.size())
+		{
+			buffer.resize(buffer.size() * 2);
+		}
+		ssize_t count = ::read(fd, &buffer[received], buffer.size() - received);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count < 0)
+		{
+			int error = errno;
+			::close(fd);
+			close();
+			errno = error;
+			return false;
+		}
+		if (count == 0)
+		{
+			break;
+		}
+		received += static_cast<std::size_t>(count);
+	}
+	::close(fd);
+	buffer.resize(received);
+	bytes = buffer.c_str();
+	length = received;
+	return true;
+}
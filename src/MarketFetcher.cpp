@@ -0,0 +1,243 @@
+#include "BinanceHandler.h"
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/version.hpp>
+#include <algorithm>
+#include <atomic>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+namespace ssl = boost::asio::ssl;
+using tcp = net::ip::tcp;
+
+namespace
+{
+	// Every step of one fetch, from resolving to the last body byte, has to finish within this
+	constexpr std::chrono::seconds kFetchTimeout{30};
+	// Same limit as the blocking session, exchangeInfo for all markets is a few MB
+	constexpr std::uint64_t kBodyLimit = 256ull * 1024 * 1024;
+
+	using Response = http::response<http::string_body>;
+
+	// One market's request as a chain of async operations on the shared io_context. A complete 200
+	// response is handed to onResponse; failures are logged and the market is left out.
+	class AsyncFetch : public std::enable_shared_from_this<AsyncFetch>
+	{
+	public:
+		using ResponseHandler = std::function<void(Response response)>;
+
+		AsyncFetch(net::io_context &ioc, ssl::context &ctx, const MarketEndpoint &endpoint, int version, ResponseHandler onResponse)
+			: endpoint(endpoint), resolver(ioc), stream(ioc, ctx), onResponse(std::move(onResponse))
+		{
+			request = {http::verb::get, endpoint.target, version};
+			request.set(http::field::host, endpoint.host);
+			request.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+			request.set(http::field::accept_encoding, "gzip, deflate");
+			parser.body_limit(kBodyLimit);
+		}
+
+		void start()
+		{
+			// SNI is required by most CDNs
+			if (!SSL_set_tlsext_host_name(stream.native_handle(), endpoint.host.c_str()))
+			{
+				fail("SNI", beast::error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()));
+				return;
+			}
+			beast::get_lowest_layer(stream).expires_after(kFetchTimeout);
+			phaseStart = std::chrono::steady_clock::now();
+			resolver.async_resolve(endpoint.host, endpoint.port, beast::bind_front_handler(&AsyncFetch::onResolve, shared_from_this()));
+		}
+
+	private:
+		void onResolve(beast::error_code ec, tcp::resolver::results_type results)
+		{
+			if (ec)
+			{
+				return fail("resolve", ec);
+			}
+			endPhase(metrics().httpResolve);
+			beast::get_lowest_layer(stream).async_connect(results, beast::bind_front_handler(&AsyncFetch::onConnect, shared_from_this()));
+		}
+
+		void onConnect(beast::error_code ec, tcp::resolver::results_type::endpoint_type)
+		{
+			if (ec)
+			{
+				return fail("connect", ec);
+			}
+			endPhase(metrics().httpConnect);
+			stream.async_handshake(ssl::stream_base::client, beast::bind_front_handler(&AsyncFetch::onHandshake, shared_from_this()));
+		}
+
+		void onHandshake(beast::error_code ec)
+		{
+			if (ec)
+			{
+				return fail("handshake", ec);
+			}
+			endPhase(metrics().httpHandshake);
+			http::async_write(stream, request, beast::bind_front_handler(&AsyncFetch::onWrite, shared_from_this()));
+		}
+
+		void onWrite(beast::error_code ec, std::size_t)
+		{
+			if (ec)
+			{
+				return fail("write", ec);
+			}
+			endPhase(metrics().httpWrite);
+			http::async_read(stream, buffer, parser, beast::bind_front_handler(&AsyncFetch::onRead, shared_from_this()));
+		}
+
+		void onRead(beast::error_code ec, std::size_t)
+		{
+			if (ec)
+			{
+				return fail("read", ec);
+			}
+			endPhase(metrics().httpRead);
+
+			// One request per connection; closing without the TLS close_notify does not hold up the others
+			beast::error_code ignored;
+			beast::get_lowest_layer(stream).socket().close(ignored);
+
+			if (parser.get().result() != http::status::ok)
+			{
+				logger->error("exchangeInfo for {} from {}:{}{} answered with HTTP {}", endpoint.market, endpoint.host, endpoint.port, endpoint.target, parser.get().result_int());
+				return;
+			}
+			onResponse(parser.release());
+		}
+
+		// The phases run back to back, each one ends where the next begins
+		void endPhase(LatencyHistogram &histogram)
+		{
+			auto now = std::chrono::steady_clock::now();
+			histogram.record(now - phaseStart);
+			phaseStart = now;
+		}
+
+		void fail(const char *step, beast::error_code ec)
+		{
+			logger->error("exchangeInfo for {} from {}:{}{} failed at {}: {}", endpoint.market, endpoint.host, endpoint.port, endpoint.target, step, ec.message());
+		}
+
+		MarketEndpoint endpoint;
+		tcp::resolver resolver;
+		beast::ssl_stream<beast::tcp_stream> stream;
+		beast::flat_buffer buffer;
+		http::request<http::empty_body> request;
+		http::response_parser<http::string_body> parser;
+		ResponseHandler onResponse;
+		std::chrono::steady_clock::time_point phaseStart;
+	};
+
+	bool isCompressed(beast::string_view encoding)
+	{
+		return beast::iequals(encoding, "gzip") || beast::iequals(encoding, "deflate");
+	}
+}
+
+bool parseEndpointUrl(const std::string &url, MarketEndpoint &endpoint)
+{
+	std::string protocolDelimiter = "://";
+	std::size_t posHost = url.find(protocolDelimiter);
+	if (posHost == std::string::npos)
+	{
+		return false;
+	}
+	posHost += protocolDelimiter.length();
+
+	std::size_t posPath = url.find('/', posHost);
+	if (posPath == std::string::npos || posPath == posHost)
+	{
+		return false;
+	}
+
+	std::string authority = url.substr(posHost, posPath - posHost);
+	std::size_t posPort = authority.find(':');
+	endpoint.host = authority.substr(0, posPort);
+	endpoint.port = posPort == std::string::npos ? "443" : authority.substr(posPort + 1);
+	endpoint.target = url.substr(posPath);
+	return !endpoint.host.empty() && !endpoint.port.empty();
+}
+
+MarketFetcher::MarketFetcher(JSONParser &jsonParser, std::size_t parseThreads)
+	: jsonParser(jsonParser), parseThreads(parseThreads)
+{
+}
+
+std::size_t MarketFetcher::fetchAll(const std::vector<MarketEndpoint> &endpoints, int version)
+{
+	if (endpoints.empty())
+	{
+		return 0;
+	}
+
+	std::vector<MarketId> markets;
+	for (const MarketEndpoint &endpoint : endpoints)
+	{
+		markets.push_back(jsonParser.addMarket(endpoint.market));
+	}
+
+	std::size_t threads = parseThreads;
+	if (threads == 0)
+	{
+		threads = std::min<std::size_t>(endpoints.size(), std::max(1u, std::thread::hardware_concurrency()));
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	net::thread_pool parsers(threads);
+	net::io_context ioc;
+	ssl::context ctx(ssl::context::sslv23_client);
+	std::atomic<std::size_t> merged{0};
+
+	for (std::size_t i = 0; i < endpoints.size(); ++i)
+	{
+		const MarketEndpoint &endpoint = endpoints[i];
+		MarketId market = markets[i];
+		auto onResponse = [this, &parsers, &merged, &endpoint, market, started](Response response)
+		{
+			// The I/O thread goes straight back to the other downloads, parsing runs on the pool
+			auto body = std::make_shared<Response>(std::move(response));
+			net::post(parsers, [this, &merged, &endpoint, market, started, body]
+					  {
+						  bool parsed;
+						  if (isCompressed((*body)[http::field::content_encoding]))
+						  {
+							  const std::string &compressed = body->body();
+							  std::size_t offset = 0;
+							  parsed = jsonParser.performJSONDataParsing(inflatingReader([&compressed, &offset](char *out, std::size_t size)
+																						 {
+																							 std::size_t count = compressed.copy(out, size, offset);
+																							 offset += count;
+																							 return count; }),
+																		 market);
+						  }
+						  else
+						  {
+							  parsed = jsonParser.performJSONDataParsing(body->body(), market);
+						  }
+						  if (parsed)
+						  {
+							  ++merged;
+							  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+							  logger->info("exchangeInfo for {} from {} merged after {} ms.", endpoint.market, endpoint.host, elapsed.count());
+						  } });
+		};
+		std::make_shared<AsyncFetch>(ioc, ctx, endpoint, version, std::move(onResponse))->start();
+	}
+
+	// Returns once every download finished or failed; the pool then drains the remaining parses
+	ioc.run();
+	parsers.join();
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+	logger->info("Fetched exchangeInfo for {} of {} markets in {} ms.", merged.load(), endpoints.size(), elapsed.count());
+	return merged;
+}
@@ -0,0 +1,550 @@
+#include "BinanceHandler.h"
+#include "rapidjson/memorystream.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/error/en.h"
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/version.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+namespace ssl = boost::asio::ssl;
+using tcp = net::ip::tcp;
+
+namespace
+{
+	// Resolving, connecting and both handshakes of one connection have to finish within this
+	constexpr std::chrono::seconds kConnectTimeout{30};
+	// Backoff doublings before the delay is pinned at maxBackoff
+	constexpr unsigned kMaxBackoffDoublings = 20;
+
+	bool keyIs(const char *key, rapidjson::SizeType length, const char *expected)
+	{
+		return std::strlen(expected) == length && std::memcmp(key, expected, length) == 0;
+	}
+
+	// SAX handler keeping what one stream event needs: its type, symbol, update ids and symbol fields,
+	// found at the top level (raw streams) or inside "data" (combined streams). Nested containers such as
+	// depth levels are skipped. The strings are reused, so steady-state decoding does not allocate.
+	class StreamEventHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, StreamEventHandler>
+	{
+	public:
+		std::string stream;
+		std::string eventType;
+		std::string symbol;
+		std::array<std::string, static_cast<std::size_t>(SymbolField::Count)> values;
+		SymbolFieldMask fields = 0;
+		// "U", "u" and "pu", each valid when its flag is set
+		std::uint64_t firstId = 0;
+		std::uint64_t lastId = 0;
+		std::uint64_t previousId = 0;
+		bool hasFirstId = false;
+		bool hasLastId = false;
+		bool hasPreviousId = false;
+		// The message answers a request with {"error": ...}
+		bool error = false;
+
+		void reset()
+		{
+			stream.clear();
+			eventType.clear();
+			symbol.clear();
+			fields = 0;
+			hasFirstId = hasLastId = hasPreviousId = false;
+			error = false;
+			depth = 0;
+			eventDepth = 1;
+			dataNext = false;
+			clearTarget();
+		}
+
+		bool StartObject()
+		{
+			++depth;
+			if (depth == 2 && dataNext)
+			{
+				eventDepth = 2;
+			}
+			clearTarget();
+			return true;
+		}
+
+		bool EndObject(rapidjson::SizeType)
+		{
+			--depth;
+			return true;
+		}
+
+		bool StartArray()
+		{
+			++depth;
+			clearTarget();
+			return true;
+		}
+
+		bool EndArray(rapidjson::SizeType)
+		{
+			--depth;
+			return true;
+		}
+
+		bool Key(const char *key, rapidjson::SizeType length, bool)
+		{
+			clearTarget();
+			if (depth == 1)
+			{
+				if (keyIs(key, length, "stream"))
+				{
+					textTarget = &stream;
+					return true;
+				}
+				if (keyIs(key, length, "data"))
+				{
+					dataNext = true;
+					return true;
+				}
+				if (keyIs(key, length, "error"))
+				{
+					error = true;
+					return true;
+				}
+			}
+			if (depth != eventDepth)
+			{
+				return true;
+			}
+			if (keyIs(key, length, "e"))
+			{
+				textTarget = &eventType;
+			}
+			else if (keyIs(key, length, "s"))
+			{
+				textTarget = &symbol;
+			}
+			else if (keyIs(key, length, "U"))
+			{
+				idTarget = &firstId;
+				idFlag = &hasFirstId;
+			}
+			else if (keyIs(key, length, "u"))
+			{
+				idTarget = &lastId;
+				idFlag = &hasLastId;
+			}
+			else if (keyIs(key, length, "pu"))
+			{
+				idTarget = &previousId;
+				idFlag = &hasPreviousId;
+			}
+			else if (keyIs(key, length, "cs"))
+			{
+				fieldTarget = SymbolField::Status;
+			}
+			else if (keyIs(key, length, "ct"))
+			{
+				fieldTarget = SymbolField::ContractType;
+			}
+			else
+			{
+				SymbolField field;
+				if (symbolFieldFromQueryName(key, length, field))
+				{
+					fieldTarget = field;
+				}
+			}
+			return true;
+		}
+
+		bool String(const char *value, rapidjson::SizeType length, bool)
+		{
+			if (textTarget)
+			{
+				textTarget->assign(value, length);
+			}
+			else if (fieldTarget != SymbolField::Count)
+			{
+				values[static_cast<std::size_t>(fieldTarget)].assign(value, length);
+				fields |= symbolFieldBit(fieldTarget);
+			}
+			clearTarget();
+			return true;
+		}
+
+		bool Uint(unsigned value) { return Uint64(value); }
+		bool Uint64(std::uint64_t value)
+		{
+			if (idTarget)
+			{
+				*idTarget = value;
+				*idFlag = true;
+			}
+			clearTarget();
+			return true;
+		}
+
+		bool Default()
+		{
+			clearTarget();
+			return true;
+		}
+
+	private:
+		void clearTarget()
+		{
+			textTarget = nullptr;
+			idTarget = nullptr;
+			idFlag = nullptr;
+			fieldTarget = SymbolField::Count;
+		}
+
+		int depth = 0;
+		int eventDepth = 1;
+		bool dataNext = false;
+		std::string *textTarget = nullptr;
+		std::uint64_t *idTarget = nullptr;
+		bool *idFlag = nullptr;
+		SymbolField fieldTarget = SymbolField::Count;
+	};
+}
+
+struct MarketStream::Impl
+{
+	using Socket = websocket::stream<beast::ssl_stream<beast::tcp_stream>>;
+
+	Impl(JSONParser &jsonParser, const MarketStreamOptions &options, MarketId market)
+		: jsonParser(jsonParser), options(options), market(market), ctx(ssl::context::sslv23_client), resolver(ioc), retryTimer(ioc), random(std::random_device{}())
+	{
+	}
+
+	~Impl()
+	{
+		stop();
+	}
+
+	void start()
+	{
+		if (started)
+		{
+			return;
+		}
+		started = true;
+		net::post(ioc, [this]
+				  { connect(); });
+		worker = std::thread([this]
+							 { ioc.run(); });
+	}
+
+	void stop()
+	{
+		ioc.stop();
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+
+	// Every connection gets a new id; completions of an abandoned one see a different id and do nothing
+	void connect()
+	{
+		++connectionId;
+		socket = std::make_unique<Socket>(ioc, ctx);
+		buffer.clear();
+		if (!SSL_set_tlsext_host_name(socket->next_layer().native_handle(), options.host.c_str()))
+		{
+			return fail(connectionId, "SNI", beast::error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()));
+		}
+		beast::get_lowest_layer(*socket).expires_after(kConnectTimeout);
+		resolver.async_resolve(options.host, options.port, [this, id = connectionId](beast::error_code ec, tcp::resolver::results_type results)
+							   {
+								   if (ec)
+								   {
+									   return fail(id, "resolve", ec);
+								   }
+								   beast::get_lowest_layer(*socket).async_connect(results, [this, id](beast::error_code ec, tcp::endpoint)
+																				  { onConnect(id, ec); }); });
+	}
+
+	void onConnect(std::uint64_t id, beast::error_code ec)
+	{
+		if (ec)
+		{
+			return fail(id, "connect", ec);
+		}
+		socket->next_layer().async_handshake(ssl::stream_base::client, [this, id](beast::error_code ec)
+											 { onTlsHandshake(id, ec); });
+	}
+
+	void onTlsHandshake(std::uint64_t id, beast::error_code ec)
+	{
+		if (ec)
+		{
+			return fail(id, "TLS handshake", ec);
+		}
+		// From here on the websocket's own timeouts apply: keep-alive pings when idle, and a drop when the
+		// peer stays silent for the whole idle timeout
+		beast::get_lowest_layer(*socket).expires_never();
+		websocket::stream_base::timeout timeout;
+		timeout.handshake_timeout = kConnectTimeout;
+		timeout.idle_timeout = options.idleTimeout;
+		timeout.keep_alive_pings = true;
+		socket->set_option(timeout);
+		socket->set_option(websocket::stream_base::decorator([](websocket::request_type &request)
+															 { request.set(beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING); }));
+		socket->async_handshake(options.host, options.target, [this, id](beast::error_code ec)
+								{ onHandshake(id, ec); });
+	}
+
+	void onHandshake(std::uint64_t id, beast::error_code ec)
+	{
+		if (ec)
+		{
+			return fail(id, "websocket handshake", ec);
+		}
+		std::uint64_t count = connections.fetch_add(1, std::memory_order_relaxed) + 1;
+		logger->info("Market stream connected to {}:{}{}, {} streams.", options.host, options.port, options.target, options.streams.size());
+		// Update ids start over on a new connection, and whatever changed while disconnected was missed
+		lastIds.clear();
+		if (count > 1)
+		{
+			resync();
+		}
+		if (!options.streams.empty())
+		{
+			subscribeRequest = R"({"method":"SUBSCRIBE","params":[)";
+			for (std::size_t i = 0; i < options.streams.size(); ++i)
+			{
+				subscribeRequest += (i ? ",\"" : "\"") + options.streams[i] + "\"";
+			}
+			subscribeRequest += "],\"id\":" + std::to_string(count) + "}";
+			socket->text(true);
+			socket->async_write(net::buffer(subscribeRequest), [this, id](beast::error_code ec, std::size_t)
+								{
+									if (ec)
+									{
+										fail(id, "subscribe", ec);
+									} });
+		}
+		read(id);
+	}
+
+	void read(std::uint64_t id)
+	{
+		socket->async_read(buffer, [this, id](beast::error_code ec, std::size_t)
+						   { onRead(id, ec); });
+	}
+
+	void onRead(std::uint64_t id, beast::error_code ec)
+	{
+		if (ec)
+		{
+			return fail(id, "read", ec);
+		}
+		// The connection works, the next failure starts backing off from the beginning again
+		attempt = 0;
+		if (socket->got_text())
+		{
+			processMessage(static_cast<const char *>(buffer.data().data()), buffer.size());
+		}
+		buffer.consume(buffer.size());
+		read(id);
+	}
+
+	void fail(std::uint64_t id, const char *step, beast::error_code ec)
+	{
+		if (id != connectionId)
+		{
+			return;
+		}
+		++connectionId;
+		beast::error_code ignored;
+		beast::get_lowest_layer(*socket).socket().close(ignored);
+
+		// Exponential backoff with jitter, so many clients dropped at once do not reconnect in lockstep
+		auto delay = std::min(options.maxBackoff, options.initialBackoff * (std::int64_t(1) << std::min(attempt, kMaxBackoffDoublings)));
+		delay = std::uniform_int_distribution<std::int64_t>(delay.count() / 2, delay.count())(random) * std::chrono::milliseconds(1);
+		++attempt;
+		logger->warn("Market stream {}:{}{} failed at {}: {}; reconnecting in {} ms.", options.host, options.port, options.target, step, ec.message(), delay.count());
+		retryTimer.expires_after(delay);
+		retryTimer.async_wait([this](beast::error_code ec)
+							  {
+								  if (!ec)
+								  {
+									  connect();
+								  } });
+	}
+
+	void resync()
+	{
+		if (resyncHandler)
+		{
+			resyncHandler(market);
+		}
+	}
+
+	void processMessage(const char *data, std::size_t size)
+	{
+		messages.fetch_add(1, std::memory_order_relaxed);
+		handler.reset();
+		rapidjson::MemoryStream stream(data, size);
+		rapidjson::ParseResult result = reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler);
+		if (result.IsError())
+		{
+			logger->warn("Market stream: skipping unparsable message ({} at offset {}).", rapidjson::GetParseError_En(result.Code()), result.Offset());
+			return;
+		}
+		if (handler.error)
+		{
+			logger->error("Market stream {}:{}{} rejected a request: {}", options.host, options.port, options.target, std::string(data, size));
+			return;
+		}
+		if (handler.hasLastId && (handler.hasFirstId || handler.hasPreviousId) && !inSequence())
+		{
+			return;
+		}
+		if (!handler.symbol.empty() && handler.fields != 0)
+		{
+			applyFields();
+		}
+	}
+
+	// False for an event that is older than what its stream already delivered
+	bool inSequence()
+	{
+		// Combined connections name the stream, a raw one only carries the one stream per event type
+		sequenceKey = handler.stream;
+		if (sequenceKey.empty())
+		{
+			sequenceKey.assign(handler.eventType).append(1, '@').append(handler.symbol);
+		}
+		auto found = lastIds.find(sequenceKey);
+		if (found == lastIds.end())
+		{
+			lastIds.emplace(sequenceKey, handler.lastId);
+			return true;
+		}
+		std::uint64_t &last = found->second;
+		if (handler.lastId <= last)
+		{
+			return false;
+		}
+		bool gap = handler.hasPreviousId ? handler.previousId != last : handler.firstId > last + 1;
+		if (gap)
+		{
+			gaps.fetch_add(1, std::memory_order_relaxed);
+			logger->warn("Market stream: gap in {} after update {}, next event covers {} to {}.", sequenceKey, last, handler.hasPreviousId ? handler.previousId : handler.firstId, handler.lastId);
+			resync();
+		}
+		last = handler.lastId;
+		return true;
+	}
+
+	void applyFields()
+	{
+		// Compared against the published version first, so the usual event that changes nothing takes no
+		// lock. A symbol with a local override differs here every time; the parser then finds no change.
+		std::shared_ptr<const SymbolSnapshot> view = jsonParser.snapshot();
+		SymbolSnapshot::Row row = view->find(handler.symbol, market);
+		if (!row)
+		{
+			return;
+		}
+		changes.clear();
+		for (unsigned field = 0; field < static_cast<unsigned>(SymbolField::Count); ++field)
+		{
+			const std::string &value = handler.values[field];
+			if ((handler.fields & symbolFieldBit(static_cast<SymbolField>(field))) && !row.table->fieldIs(row.id, static_cast<SymbolField>(field), value.data(), value.size()))
+			{
+				changes.emplace_back(static_cast<SymbolField>(field), value);
+			}
+		}
+		if (!changes.empty() && jsonParser.applyExchangeUpdate(handler.symbol, changes, market))
+		{
+			applied.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	JSONParser &jsonParser;
+	MarketStreamOptions options;
+	MarketId market;
+	ResyncHandler resyncHandler;
+
+	net::io_context ioc;
+	ssl::context ctx;
+	tcp::resolver resolver;
+	net::steady_timer retryTimer;
+	std::unique_ptr<Socket> socket;
+	beast::flat_buffer buffer;
+	std::string subscribeRequest;
+	std::uint64_t connectionId = 0;
+	unsigned attempt = 0;
+	std::mt19937_64 random;
+	bool started = false;
+	std::thread worker;
+
+	rapidjson::Reader reader;
+	StreamEventHandler handler;
+	std::string sequenceKey;
+	// Last update id per stream, for the current connection
+	std::unordered_map<std::string, std::uint64_t> lastIds;
+	std::vector<std::pair<SymbolField, std::string>> changes;
+
+	std::atomic<std::uint64_t> messages{0};
+	std::atomic<std::uint64_t> applied{0};
+	std::atomic<std::uint64_t> gaps{0};
+	std::atomic<std::uint64_t> connections{0};
+};
+
+MarketStream::MarketStream(JSONParser &jsonParser, const MarketStreamOptions &options, MarketId market)
+	: impl(std::make_unique<Impl>(jsonParser, options, market))
+{
+}
+
+MarketStream::~MarketStream() = default;
+
+void MarketStream::setResyncHandler(ResyncHandler handler)
+{
+	impl->resyncHandler = std::move(handler);
+}
+
+void MarketStream::start()
+{
+	impl->start();
+}
+
+void MarketStream::stop()
+{
+	impl->stop();
+}
+
+void MarketStream::processMessage(const char *data, std::size_t size)
+{
+	impl->processMessage(data, size);
+}
+
+std::uint64_t MarketStream::getMessageCount() const
+{
+	return impl->messages.load(std::memory_order_relaxed);
+}
+
+std::uint64_t MarketStream::getAppliedCount() const
+{
+	return impl->applied.load(std::memory_order_relaxed);
+}
+
+std::uint64_t MarketStream::getGapCount() const
+{
+	return impl->gaps.load(std::memory_order_relaxed);
+}
+
+std::uint64_t MarketStream::getConnectionCount() const
+{
+	return impl->connections.load(std::memory_order_relaxed);
+}
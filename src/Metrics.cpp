@@ -0,0 +1,202 @@
+#include "BinanceHandler.h"
+#include "spdlog/fmt/fmt.h"
+#include <cmath>
+
+namespace
+{
+	// Each thread keeps writing to the shard it was given first
+	unsigned threadShard()
+	{
+		static std::atomic<unsigned> nextShard{0};
+		thread_local unsigned shard = nextShard.fetch_add(1, std::memory_order_relaxed) % LatencyHistogram::kShards;
+		return shard;
+	}
+
+	struct Family
+	{
+		const char *name;
+		const char *help;
+		const char *label;
+	};
+
+	struct Series
+	{
+		const Family *family;
+		const char *labelValue;
+		const LatencyHistogram Metrics::*histogram;
+	};
+
+	const Family kHttpPhase = {"binance_http_phase_seconds", "Time spent in each phase of an exchangeInfo HTTPS request.", "phase"};
+	const Family kParse = {"binance_parse_seconds", "Time to parse one exchangeInfo response into a symbol table.", nullptr};
+	const Family kParsePerMB = {"binance_parse_seconds_per_megabyte", "exchangeInfo parse time scaled to one MB of input.", nullptr};
+	const Family kQuery = {"binance_query_seconds", "Time to dispatch one query, by query type.", "type"};
+
+	const Series kSeries[] = {
+		{&kHttpPhase, "resolve", &Metrics::httpResolve},
+		{&kHttpPhase, "connect", &Metrics::httpConnect},
+		{&kHttpPhase, "handshake", &Metrics::httpHandshake},
+		{&kHttpPhase, "write", &Metrics::httpWrite},
+		{&kHttpPhase, "read", &Metrics::httpRead},
+		{&kParse, nullptr, &Metrics::parse},
+		{&kParsePerMB, nullptr, &Metrics::parsePerMB},
+		{&kQuery, "GET", &Metrics::queryGet},
+		{&kQuery, "UPDATE", &Metrics::queryUpdate},
+		{&kQuery, "DELETE", &Metrics::queryDelete},
+	};
+
+	const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+	std::string labels(const Series &series, const char *quantile = nullptr)
+	{
+		std::string text;
+		if (series.family->label)
+		{
+			text += std::string(series.family->label) + "=\"" + series.labelValue + "\"";
+		}
+		if (quantile)
+		{
+			text += std::string(text.empty() ? "" : ",") + "quantile=\"" + quantile + "\"";
+		}
+		return text.empty() ? text : "{" + text + "}";
+	}
+}
+
+unsigned LatencyHistogram::bucketIndex(std::uint64_t nanoseconds)
+{
+	if (nanoseconds < (2u << kSubBucketBits))
+	{
+		return static_cast<unsigned>(nanoseconds);
+	}
+	unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(nanoseconds));
+	unsigned shift = msb - kSubBucketBits;
+	unsigned index = (shift << kSubBucketBits) + static_cast<unsigned>(nanoseconds >> shift);
+	return index < kBuckets ? index : kBuckets - 1;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(unsigned index)
+{
+	if (index < (2u << kSubBucketBits))
+	{
+		return index;
+	}
+	unsigned shift = (index >> kSubBucketBits) - 1;
+	std::uint64_t subBucket = index - (shift << kSubBucketBits);
+	return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds)
+{
+	Shard &shard = shards[threadShard()];
+	shard.counts[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	shard.sumNs.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration elapsed)
+{
+	auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	record(static_cast<std::uint64_t>(nanoseconds > 0 ? nanoseconds : 0));
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+	Snapshot merged;
+	merged.counts.assign(kBuckets, 0);
+	for (const Shard &shard : shards)
+	{
+		for (unsigned i = 0; i < kBuckets; ++i)
+		{
+			std::uint64_t count = shard.counts[i].load(std::memory_order_relaxed);
+			merged.counts[i] += count;
+			merged.count += count;
+		}
+		merged.sumNs += shard.sumNs.load(std::memory_order_relaxed);
+	}
+	return merged;
+}
+
+void LatencyHistogram::reset()
+{
+	for (Shard &shard : shards)
+	{
+		for (std::atomic<std::uint64_t> &count : shard.counts)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+		shard.sumNs.store(0, std::memory_order_relaxed);
+	}
+}
+
+std::uint64_t LatencyHistogram::Snapshot::quantileNs(double fraction) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+	std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(count)));
+	rank = rank == 0 ? 1 : rank;
+	std::uint64_t seen = 0;
+	for (unsigned i = 0; i < counts.size(); ++i)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			return bucketUpperBound(i);
+		}
+	}
+	return bucketUpperBound(kBuckets - 1);
+}
+
+Metrics &metrics()
+{
+	static Metrics instance;
+	return instance;
+}
+
+std::string Metrics::renderPrometheus() const
+{
+	std::string text;
+	text.reserve(4096);
+	const Family *family = nullptr;
+	for (const Series &series : kSeries)
+	{
+		if (series.family != family)
+		{
+			family = series.family;
+			text += std::string("# HELP ") + family->name + " " + family->help + "\n";
+			text += std::string("# TYPE ") + family->name + " summary\n";
+		}
+
+		LatencyHistogram::Snapshot snapshot = (this->*series.histogram).snapshot();
+		for (double quantile : kQuantiles)
+		{
+			text += fmt::format("{}{} {:.9f}\n", family->name, labels(series, fmt::format("{}", quantile).c_str()), static_cast<double>(snapshot.quantileNs(quantile)) / 1e9);
+		}
+		text += fmt::format("{}_sum{} {:.9f}\n", family->name, labels(series), static_cast<double>(snapshot.sumNs) / 1e9);
+		text += fmt::format("{}_count{} {}\n", family->name, labels(series), snapshot.count);
+	}
+
+	text += "# HELP binance_parse_bytes_total exchangeInfo bytes parsed.\n";
+	text += "# TYPE binance_parse_bytes_total counter\n";
+	text += fmt::format("binance_parse_bytes_total {}\n", parsedBytes.load(std::memory_order_relaxed));
+	text += "# HELP binance_answer_cache_requests_total GET queries by answer cache outcome.\n";
+	text += "# TYPE binance_answer_cache_requests_total counter\n";
+	text += fmt::format("binance_answer_cache_requests_total{{result=\"hit\"}} {}\n", answerCacheHits.load(std::memory_order_relaxed));
+	text += fmt::format("binance_answer_cache_requests_total{{result=\"miss\"}} {}\n", answerCacheMisses.load(std::memory_order_relaxed));
+	return text;
+}
+
+void Metrics::logSummary() const
+{
+	for (const Series &series : kSeries)
+	{
+		LatencyHistogram::Snapshot snapshot = (this->*series.histogram).snapshot();
+		if (snapshot.count == 0)
+		{
+			continue;
+		}
+		logger->info("Latency {}{}: count {}, p50 {:.1f} us, p99 {:.1f} us, p99.9 {:.1f} us, mean {:.1f} us",
+					 series.family->name, labels(series), snapshot.count,
+					 static_cast<double>(snapshot.quantileNs(0.5)) / 1e3, static_cast<double>(snapshot.quantileNs(0.99)) / 1e3,
+					 static_cast<double>(snapshot.quantileNs(0.999)) / 1e3, static_cast<double>(snapshot.sumNs) / 1e3 / static_cast<double>(snapshot.count));
+	}
+}
@@ -0,0 +1,154 @@
+#include "BinanceHandler.h"
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+namespace
+{
+	// One scrape connection; Prometheus keeps it alive between scrapes
+	class MetricsSession : public std::enable_shared_from_this<MetricsSession>
+	{
+	public:
+		explicit MetricsSession(tcp::socket socket) : stream(std::move(socket)) {}
+
+		void start() { read(); }
+
+	private:
+		void read()
+		{
+			request = {};
+			stream.expires_after(std::chrono::seconds(60));
+			http::async_read(stream, buffer, request, beast::bind_front_handler(&MetricsSession::onRead, shared_from_this()));
+		}
+
+		void onRead(beast::error_code ec, std::size_t)
+		{
+			if (ec)
+			{
+				// Closed by the scraper, timed out or malformed; nothing to answer
+				return;
+			}
+
+			response = {};
+			response.version(request.version());
+			response.keep_alive(request.keep_alive());
+			response.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+			if (request.method() != http::verb::get)
+			{
+				response.result(http::status::method_not_allowed);
+			}
+			else if (request.target() != "/metrics")
+			{
+				response.result(http::status::not_found);
+			}
+			else
+			{
+				response.result(http::status::ok);
+				response.set(http::field::content_type, "text/plain; version=0.0.4");
+				response.body() = metrics().renderPrometheus();
+			}
+			response.prepare_payload();
+			http::async_write(stream, response, beast::bind_front_handler(&MetricsSession::onWrite, shared_from_this()));
+		}
+
+		void onWrite(beast::error_code ec, std::size_t)
+		{
+			if (ec || !response.keep_alive())
+			{
+				beast::error_code ignored;
+				stream.socket().shutdown(tcp::socket::shutdown_send, ignored);
+				return;
+			}
+			read();
+		}
+
+		beast::tcp_stream stream;
+		beast::flat_buffer buffer;
+		http::request<http::string_body> request;
+		http::response<http::string_body> response;
+	};
+}
+
+struct MetricsExporter::Impl
+{
+	explicit Impl(const MetricsOptions &options) : acceptor(ioc), logTimer(ioc), logInterval(options.logInterval)
+	{
+		if (options.listen)
+		{
+			tcp::endpoint endpoint(net::ip::make_address(options.address), options.port);
+			acceptor.open(endpoint.protocol());
+			acceptor.set_option(net::socket_base::reuse_address(true));
+			acceptor.bind(endpoint);
+			acceptor.listen(net::socket_base::max_listen_connections);
+			accept();
+			logger->info("Serving metrics on http://{}:{}/metrics", options.address, acceptor.local_endpoint().port());
+		}
+		if (logInterval.count() > 0)
+		{
+			scheduleLog();
+		}
+		worker = std::thread([this]
+							 { ioc.run(); });
+	}
+
+	~Impl()
+	{
+		ioc.stop();
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+
+	void accept()
+	{
+		acceptor.async_accept([this](beast::error_code ec, tcp::socket socket)
+							  {
+								  if (ec == net::error::operation_aborted)
+								  {
+									  return;
+								  }
+								  if (!ec)
+								  {
+									  std::make_shared<MetricsSession>(std::move(socket))->start();
+								  }
+								  accept(); });
+	}
+
+	void scheduleLog()
+	{
+		logTimer.expires_after(logInterval);
+		logTimer.async_wait([this](beast::error_code ec)
+							{
+								if (ec)
+								{
+									return;
+								}
+								metrics().logSummary();
+								scheduleLog(); });
+	}
+
+	net::io_context ioc;
+	tcp::acceptor acceptor;
+	net::steady_timer logTimer;
+	std::chrono::seconds logInterval;
+	std::thread worker;
+};
+
+MetricsExporter::MetricsExporter(const MetricsOptions &options)
+	: impl(std::make_unique<Impl>(options))
+{
+}
+
+MetricsExporter::~MetricsExporter() = default;
+
+unsigned short MetricsExporter::port() const
+{
+	return impl->acceptor.is_open() ? impl->acceptor.local_endpoint().port() : 0;
+}
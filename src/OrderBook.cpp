@@ -0,0 +1,375 @@
+#include "OrderBook.h"
+#include "rapidjson/memorystream.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+	// Quantities of a stepSize-less symbol keep Binance's usual eight decimals
+	constexpr uint8_t kDefaultQuantityScale = 8;
+
+	bool keyIs(const char *key, rapidjson::SizeType length, const char *expected)
+	{
+		return std::strlen(expected) == length && std::memcmp(key, expected, length) == 0;
+	}
+
+	// value in multiples of divisor * 10^-scale; false unless that is a whole number
+	bool toUnits(const char *text, std::size_t length, uint8_t scale, int64_t divisor, int64_t &units)
+	{
+		FixedDecimal value;
+		int64_t mantissa;
+		if (!FixedDecimal::parse(text, length, value) || value.mantissa < 0 || !value.toScale(scale, mantissa) || mantissa % divisor != 0)
+		{
+			return false;
+		}
+		units = mantissa / divisor;
+		return true;
+	}
+}
+
+// SAX handler filling a DepthUpdate from a REST snapshot or a diff event, raw or under a combined
+// stream's "data". Levels are converted to integers on the spot; one that does not convert stops the parse.
+class OrderBook::DepthHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, OrderBook::DepthHandler>
+{
+public:
+	DepthHandler(const OrderBook &book, DepthUpdate &update) : book(book), update(update) {}
+
+	bool hasLastId = false;
+	bool badLevel = false;
+
+	bool StartObject()
+	{
+		++depth;
+		if (depth == 2 && dataNext)
+		{
+			eventDepth = 2;
+		}
+		clearTarget();
+		return true;
+	}
+
+	bool EndObject(rapidjson::SizeType)
+	{
+		--depth;
+		return true;
+	}
+
+	bool StartArray()
+	{
+		++depth;
+		if (sideNext && depth == eventDepth + 1)
+		{
+			side = sideNext;
+		}
+		else if (side && depth == eventDepth + 2)
+		{
+			column = 0;
+		}
+		clearTarget();
+		return true;
+	}
+
+	bool EndArray(rapidjson::SizeType)
+	{
+		if (depth == eventDepth + 1)
+		{
+			side = nullptr;
+		}
+		--depth;
+		return true;
+	}
+
+	bool Key(const char *key, rapidjson::SizeType length, bool)
+	{
+		clearTarget();
+		if (depth == 1 && keyIs(key, length, "data"))
+		{
+			dataNext = true;
+		}
+		if (depth != eventDepth)
+		{
+			return true;
+		}
+		if (keyIs(key, length, "u") || keyIs(key, length, "lastUpdateId"))
+		{
+			idTarget = &update.lastId;
+			idFlag = &hasLastId;
+		}
+		else if (keyIs(key, length, "U"))
+		{
+			idTarget = &update.firstId;
+		}
+		else if (keyIs(key, length, "pu"))
+		{
+			idTarget = &update.previousId;
+			idFlag = &update.hasPreviousId;
+		}
+		else if (keyIs(key, length, "b") || keyIs(key, length, "bids"))
+		{
+			sideNext = &update.bids;
+		}
+		else if (keyIs(key, length, "a") || keyIs(key, length, "asks"))
+		{
+			sideNext = &update.asks;
+		}
+		return true;
+	}
+
+	bool String(const char *value, rapidjson::SizeType length, bool)
+	{
+		clearTarget();
+		if (!side || depth != eventDepth + 2)
+		{
+			return true;
+		}
+		// ["price", "quantity"], anything after them is ignored
+		if (column == 0)
+		{
+			badLevel = !book.toTicks(value, length, level.ticks);
+		}
+		else if (column == 1)
+		{
+			badLevel = !book.toQuantity(value, length, level.quantity);
+			side->push_back(level);
+		}
+		++column;
+		return !badLevel;
+	}
+
+	bool Uint(unsigned value) { return Uint64(value); }
+	bool Uint64(uint64_t value)
+	{
+		if (idTarget)
+		{
+			*idTarget = value;
+			if (idFlag)
+			{
+				*idFlag = true;
+			}
+		}
+		clearTarget();
+		return true;
+	}
+
+	bool Default()
+	{
+		clearTarget();
+		return true;
+	}
+
+private:
+	void clearTarget()
+	{
+		idTarget = nullptr;
+		idFlag = nullptr;
+		sideNext = nullptr;
+	}
+
+	const OrderBook &book;
+	DepthUpdate &update;
+	int depth = 0;
+	int eventDepth = 1;
+	bool dataNext = false;
+	uint64_t *idTarget = nullptr;
+	bool *idFlag = nullptr;
+	std::vector<DepthLevel> *sideNext = nullptr;
+	std::vector<DepthLevel> *side = nullptr;
+	int column = 0;
+	DepthLevel level;
+};
+
+OrderBook::OrderBook(FixedDecimal tickSize, FixedDecimal stepSize)
+	: tickSize(tickSize), quantityScale(stepSize.empty() ? kDefaultQuantityScale : stepSize.scale)
+{
+}
+
+std::unique_ptr<OrderBook> OrderBook::forSymbol(const SymbolSnapshot &snapshot, const std::string &symbol, MarketId market)
+{
+	SymbolSnapshot::Row row = snapshot.find(symbol, market);
+	if (!row || !row.table->hasField(row.id, SymbolField::TickSize) || !row.table->hasField(row.id, SymbolField::StepSize))
+	{
+		return nullptr;
+	}
+	FixedDecimal tick = row.table->tickSize(row.id);
+	if (tick.empty() || tick.mantissa <= 0)
+	{
+		return nullptr;
+	}
+	return std::make_unique<OrderBook>(tick, row.table->stepSize(row.id));
+}
+
+bool OrderBook::toTicks(const char *price, std::size_t length, int64_t &ticks) const
+{
+	return toUnits(price, length, tickSize.scale, tickSize.mantissa, ticks);
+}
+
+bool OrderBook::toQuantity(const char *quantity, std::size_t length, int64_t &units) const
+{
+	return toUnits(quantity, length, quantityScale, 1, units);
+}
+
+bool OrderBook::bestBid(DepthLevel &level) const
+{
+	if (bids.empty())
+	{
+		return false;
+	}
+	level = bids.back();
+	return true;
+}
+
+bool OrderBook::bestAsk(DepthLevel &level) const
+{
+	if (asks.empty())
+	{
+		return false;
+	}
+	level = asks.back();
+	return true;
+}
+
+void OrderBook::setLevel(std::vector<DepthLevel> &side, const DepthLevel &level, bool ascending)
+{
+	auto position = ascending ? std::lower_bound(side.begin(), side.end(), level.ticks, [](const DepthLevel &entry, int64_t ticks)
+												 { return entry.ticks < ticks; })
+							  : std::lower_bound(side.begin(), side.end(), level.ticks, [](const DepthLevel &entry, int64_t ticks)
+												 { return entry.ticks > ticks; });
+	bool found = position != side.end() && position->ticks == level.ticks;
+	if (level.quantity == 0)
+	{
+		if (found)
+		{
+			side.erase(position);
+		}
+	}
+	else if (found)
+	{
+		position->quantity = level.quantity;
+	}
+	else
+	{
+		side.insert(position, level);
+	}
+}
+
+void OrderBook::applyLevels(const DepthUpdate &update)
+{
+	for (const DepthLevel &level : update.bids)
+	{
+		setLevel(bids, level, true);
+	}
+	for (const DepthLevel &level : update.asks)
+	{
+		setLevel(asks, level, false);
+	}
+}
+
+OrderBook::Result OrderBook::applySnapshot(const DepthUpdate &snapshot)
+{
+	if (isSynced && snapshot.lastId <= lastId)
+	{
+		return Result::Stale;
+	}
+	// A snapshot lists its levels best first; sorting once beats inserting them one by one
+	auto withoutEmpty = [](const std::vector<DepthLevel> &levels, std::vector<DepthLevel> &side)
+	{
+		side.clear();
+		std::copy_if(levels.begin(), levels.end(), std::back_inserter(side), [](const DepthLevel &level)
+					 { return level.quantity != 0; });
+	};
+	withoutEmpty(snapshot.bids, bids);
+	withoutEmpty(snapshot.asks, asks);
+	std::sort(bids.begin(), bids.end(), [](const DepthLevel &a, const DepthLevel &b)
+			  { return a.ticks < b.ticks; });
+	std::sort(asks.begin(), asks.end(), [](const DepthLevel &a, const DepthLevel &b)
+			  { return a.ticks > b.ticks; });
+	lastId = snapshot.lastId;
+	isSynced = true;
+	firstAfterSnapshot = true;
+
+	// Diffs the snapshot covers are dropped as stale; a gap among the rest buffers them again
+	std::deque<DepthUpdate> pending;
+	pending.swap(buffered);
+	Result result = Result::Applied;
+	for (const DepthUpdate &update : pending)
+	{
+		if (applyDiff(update) == Result::Gap)
+		{
+			result = Result::Gap;
+		}
+	}
+	return result;
+}
+
+OrderBook::Result OrderBook::applyDiff(const DepthUpdate &update)
+{
+	Result result = isSynced ? applyInSequence(update) : Result::Buffered;
+	if (result == Result::Buffered || result == Result::Gap)
+	{
+		// A gap's diff is newer than the book, the next snapshot may still need it
+		if (buffered.size() == kMaxBufferedUpdates)
+		{
+			buffered.pop_front();
+		}
+		buffered.push_back(update);
+	}
+	return result;
+}
+
+OrderBook::Result OrderBook::applyInSequence(const DepthUpdate &update)
+{
+	if (update.lastId <= lastId)
+	{
+		return Result::Stale;
+	}
+	bool continues;
+	if (firstAfterSnapshot)
+	{
+		continues = update.firstId <= lastId + 1;
+	}
+	else if (update.hasPreviousId)
+	{
+		continues = update.previousId == lastId;
+	}
+	else
+	{
+		continues = update.firstId == lastId + 1;
+	}
+	if (!continues)
+	{
+		isSynced = false;
+		return Result::Gap;
+	}
+	applyLevels(update);
+	lastId = update.lastId;
+	firstAfterSnapshot = false;
+	return Result::Applied;
+}
+
+OrderBook::Result OrderBook::parse(const char *json, std::size_t size)
+{
+	decoded.firstId = decoded.lastId = decoded.previousId = 0;
+	decoded.hasPreviousId = false;
+	decoded.bids.clear();
+	decoded.asks.clear();
+	DepthHandler handler(*this, decoded);
+	rapidjson::MemoryStream stream(json, size);
+	if (reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler).IsError() || handler.badLevel || !handler.hasLastId)
+	{
+		return Result::Rejected;
+	}
+	return Result::Applied;
+}
+
+OrderBook::Result OrderBook::applySnapshot(const char *json, std::size_t size)
+{
+	Result result = parse(json, size);
+	return result == Result::Applied ? applySnapshot(decoded) : result;
+}
+
+OrderBook::Result OrderBook::applyDiff(const char *json, std::size_t size)
+{
+	Result result = parse(json, size);
+	return result == Result::Applied ? applyDiff(decoded) : result;
+}
@@ -0,0 +1,191 @@
+#include "OrderNormalizer.h"
+
+namespace
+{
+	// Filter value in units; an absent filter, or one written as 0, is fallback
+	bool filterUnits(const FixedDecimal &value, bool present, int64_t fallback, int64_t &units)
+	{
+		if (!present || value.empty() || value.mantissa == 0)
+		{
+			units = fallback;
+			return true;
+		}
+		return value.mantissa > 0 && value.toScale(OrderNormalizer::kScale, units);
+	}
+
+	// Negative values count as 0, without a branch
+	int64_t clampNegative(int64_t value)
+	{
+		return value & ~(value >> 63);
+	}
+}
+
+OrderNormalizer::Divisor OrderNormalizer::Divisor::of(int64_t value)
+{
+	return {value, UINT64_MAX / static_cast<uint64_t>(value)};
+}
+
+int64_t OrderNormalizer::Divisor::remainder(int64_t n) const
+{
+	uint64_t dividend = static_cast<uint64_t>(n);
+	uint64_t divisor = static_cast<uint64_t>(value);
+	uint64_t quotient = static_cast<uint64_t>((static_cast<unsigned __int128>(dividend) * magic) >> 64);
+	uint64_t rest = dividend - quotient * divisor;
+	rest -= divisor & (0 - static_cast<uint64_t>(rest >= divisor));
+	return static_cast<int64_t>(rest);
+}
+
+OrderNormalizer::OrderNormalizer()
+{
+	add(OrderViolation::UnknownSymbol, Divisor(), Divisor(), 0, 0);
+}
+
+OrderNormalizer::OrderNormalizer(const SymbolSnapshot &snapshot) : OrderNormalizer()
+{
+	snapshot.forEach([this](const std::string &symbol, SymbolSnapshot::Row row)
+					 {
+						 const SymbolTable &table = *row.table;
+						 SymbolTable::SymbolId id = row.id;
+						 int64_t tickUnits, stepUnits, minQtyUnits, minNotionalUnits;
+						 bool fits = filterUnits(table.tickSize(id), table.hasField(id, SymbolField::TickSize), 1, tickUnits) &&
+									 filterUnits(table.stepSize(id), table.hasField(id, SymbolField::StepSize), 1, stepUnits) &&
+									 filterUnits(table.minQty(id), table.hasField(id, SymbolField::MinQty), 0, minQtyUnits) &&
+									 filterUnits(table.minNotional(id), table.hasField(id, SymbolField::MinNotional), 0, minNotionalUnits);
+						 if (!fits)
+						 {
+							 return; // stays on kUnknownSlot
+						 }
+						 bool trading = table.hasField(id, SymbolField::Status) && table.status(id) == SymbolStatus::Trading;
+						 MarketId market = table.market(id);
+						 if (market >= slotsByMarket.size())
+						 {
+							 slotsByMarket.resize(market + 1);
+						 }
+						 slotsByMarket[market][symbol] = add(trading ? 0 : OrderViolation::NotTrading, Divisor::of(tickUnits),
+															 Divisor::of(stepUnits), minQtyUnits, minNotionalUnits); });
+}
+
+OrderNormalizer::Slot OrderNormalizer::add(uint8_t flags, const Divisor &tickSize, const Divisor &stepSize, int64_t minQuantity,
+										   int64_t minNotionalValue)
+{
+	tick.push_back(tickSize);
+	step.push_back(stepSize);
+	minQty.push_back(minQuantity);
+	minNotional.push_back(minNotionalValue);
+	symbolFlags.push_back(flags);
+	return static_cast<Slot>(tick.size() - 1);
+}
+
+OrderNormalizer::Slot OrderNormalizer::find(const std::string &symbol, MarketId market) const
+{
+	if (market >= slotsByMarket.size())
+	{
+		return kUnknownSlot;
+	}
+	auto it = slotsByMarket[market].find(symbol);
+	return it == slotsByMarket[market].end() ? kUnknownSlot : it->second;
+}
+
+template <OrderNormalizer::Rounding R>
+void OrderNormalizer::roundAll(const std::vector<Divisor> &divisors, const Slot *slots, int64_t *values, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const Divisor &divisor = divisors[slots[i]];
+		int64_t value = clampNegative(values[i]);
+		int64_t rest = divisor.remainder(value);
+		int64_t down = value - rest;
+		switch (R)
+		{
+		case Rounding::Down:
+			values[i] = down;
+			break;
+		case Rounding::Up:
+			values[i] = down + divisor.value * (rest != 0);
+			break;
+		case Rounding::Nearest:
+			values[i] = down + divisor.value * (2 * rest >= divisor.value);
+			break;
+		}
+	}
+}
+
+void OrderNormalizer::roundPrices(const Slot *slots, int64_t *prices, std::size_t count, Rounding rounding) const
+{
+	switch (rounding)
+	{
+	case Rounding::Down:
+		roundAll<Rounding::Down>(tick, slots, prices, count);
+		break;
+	case Rounding::Up:
+		roundAll<Rounding::Up>(tick, slots, prices, count);
+		break;
+	case Rounding::Nearest:
+		roundAll<Rounding::Nearest>(tick, slots, prices, count);
+		break;
+	}
+}
+
+void OrderNormalizer::roundQuantities(const Slot *slots, int64_t *quantities, std::size_t count, Rounding rounding) const
+{
+	switch (rounding)
+	{
+	case Rounding::Down:
+		roundAll<Rounding::Down>(step, slots, quantities, count);
+		break;
+	case Rounding::Up:
+		roundAll<Rounding::Up>(step, slots, quantities, count);
+		break;
+	case Rounding::Nearest:
+		roundAll<Rounding::Nearest>(step, slots, quantities, count);
+		break;
+	}
+}
+
+void OrderNormalizer::validate(const Slot *slots, const int64_t *prices, const int64_t *quantities, uint8_t *violations, std::size_t count) const
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		Slot slot = slots[i];
+		int64_t price = clampNegative(prices[i]);
+		int64_t quantity = clampNegative(quantities[i]);
+		__int128 notional = static_cast<__int128>(price) * quantity;
+		__int128 required = static_cast<__int128>(minNotional[slot]) * kUnitsPerOne;
+		violations[i] = static_cast<uint8_t>(symbolFlags[slot] |
+											 OrderViolation::NonPositive * ((price == 0) | (quantity == 0)) |
+											 OrderViolation::PriceOffTick * (tick[slot].remainder(price) != 0) |
+											 OrderViolation::QuantityOffStep * (step[slot].remainder(quantity) != 0) |
+											 OrderViolation::BelowMinQty * (quantity < minQty[slot]) |
+											 OrderViolation::BelowMinNotional * (notional < required));
+	}
+}
+
+int64_t OrderNormalizer::roundPrice(Slot slot, int64_t price, Rounding rounding) const
+{
+	roundPrices(&slot, &price, 1, rounding);
+	return price;
+}
+
+int64_t OrderNormalizer::roundQuantity(Slot slot, int64_t quantity, Rounding rounding) const
+{
+	roundQuantities(&slot, &quantity, 1, rounding);
+	return quantity;
+}
+
+uint8_t OrderNormalizer::validate(Slot slot, int64_t price, int64_t quantity) const
+{
+	uint8_t violations;
+	validate(&slot, &price, &quantity, &violations, 1);
+	return violations;
+}
+
+bool OrderNormalizer::toUnits(const char *text, std::size_t length, int64_t &units)
+{
+	FixedDecimal value;
+	return FixedDecimal::parse(text, length, value) && value.toScale(kScale, units);
+}
+
+std::string OrderNormalizer::toString(int64_t units)
+{
+	return FixedDecimal{units, kScale}.toString();
+}
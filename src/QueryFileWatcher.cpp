@@ -0,0 +1,85 @@
+#include "BinanceHandler.h"
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <climits>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+QueryFileWatcher::QueryFileWatcher(const std::string &path)
+	: eventBuffer(64 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+{
+	std::size_t slash = path.find_last_of('/');
+	std::string directory = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+	fileName = slash == std::string::npos ? path : path.substr(slash + 1);
+
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd >= 0)
+	{
+		// Watch the directory rather than the file so creation and rename-over are seen as well
+		watchDescriptor = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO);
+	}
+	if (watchDescriptor < 0)
+	{
+		logger->warn("inotify unavailable for {} ({}), falling back to polling.", path, std::strerror(errno));
+	}
+}
+
+QueryFileWatcher::~QueryFileWatcher()
+{
+	if (inotifyFd >= 0)
+	{
+		::close(inotifyFd);
+	}
+}
+
+bool QueryFileWatcher::waitForChange(std::chrono::milliseconds timeout)
+{
+	if (watchDescriptor < 0)
+	{
+		std::this_thread::sleep_for(timeout);
+		return true;
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	for (;;)
+	{
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		if (remaining.count() < 0)
+		{
+			return false;
+		}
+
+		struct pollfd descriptor = {inotifyFd, POLLIN, 0};
+		int ready = ::poll(&descriptor, 1, static_cast<int>(remaining.count()));
+		if (ready < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (ready <= 0)
+		{
+			return false;
+		}
+
+		// Drain every queued event; other files in the same directory are ignored
+		bool changed = false;
+		ssize_t length;
+		while ((length = ::read(inotifyFd, eventBuffer.data(), eventBuffer.size())) > 0)
+		{
+			for (char *cursor = eventBuffer.data(); cursor < eventBuffer.data() + length;)
+			{
+				const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(cursor);
+				if (event->len > 0 && fileName == event->name)
+				{
+					changed = true;
+				}
+				cursor += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		if (changed)
+		{
+			return true;
+		}
+	}
+}
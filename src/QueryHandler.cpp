@@ -1,7 +1,5 @@
 #include "BinanceHandler.h"
-#include "rapidjson/ostreamwrapper.h"
-#include "rapidjson/prettywriter.h"
-#include <fstream>
+#include "FieldRegistry.h"
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
@@ -12,24 +10,303 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/basic_file_sink.h"
 #include <unordered_set>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	// Optional "market" member of a query; queries without one address market 0
+	bool queryMarket(const rapidjson::Value &queryObject, const JSONParser &jsonParser, MarketId &market)
+	{
+		market = 0;
+		if (!queryObject.HasMember("market"))
+		{
+			return true;
+		}
+		if (!queryObject["market"].IsString() || !jsonParser.findMarket(queryObject["market"].GetString(), market))
+		{
+			logger->error("Unknown or invalid 'market' in the query object.");
+			return false;
+		}
+		return true;
+	}
+
+	// Optional "data" list of a GET compiled into a field set; names the table does not know are skipped
+	bool queryFields(const rapidjson::Value &queryObject, SymbolFieldMask &fields)
+	{
+		fields = 0;
+		if (!queryObject.HasMember("data"))
+		{
+			fields = FieldRegistry::kDefaultAnswerFields;
+			return true;
+		}
+		const rapidjson::Value &dataArray = queryObject["data"];
+		if (!dataArray.IsArray())
+		{
+			logger->error("'data' of a GET query must be an array of field names.");
+			return false;
+		}
+		for (rapidjson::SizeType i = 0; i < dataArray.Size(); ++i)
+		{
+			SymbolField field;
+			if (dataArray[i].IsString() && FieldRegistry::findLoose(dataArray[i].GetString(), dataArray[i].GetStringLength(), field))
+			{
+				fields |= symbolFieldBit(field);
+			}
+			else
+			{
+				logger->warn("GET Query - unknown field {} ignored.", dataArray[i].IsString() ? dataArray[i].GetString() : "(not a string)");
+			}
+		}
+		if (dataArray.Empty())
+		{
+			fields = FieldRegistry::kDefaultAnswerFields;
+		}
+		return true;
+	}
+
+	enum class QueryKind : uint8_t
+	{
+		Get,
+		Update,
+		Delete,
+		Count
+	};
+
+	// "query_type" names, indexed by QueryKind
+	constexpr std::array<const char *, static_cast<std::size_t>(QueryKind::Count)> kQueryTypeNames = {{"GET", "UPDATE", "DELETE"}};
+	constexpr NameTable<kQueryTypeNames.size()> kQueryTypes(kQueryTypeNames);
+	static_assert(kQueryTypes.complete(), "no perfect hash seed for the query types");
+
+	bool queryKind(const rapidjson::Value &queryType, QueryKind &kind)
+	{
+		if (!queryType.IsString())
+		{
+			return false;
+		}
+		std::size_t index = kQueryTypes.find(queryType.GetString(), queryType.GetStringLength());
+		if (index == static_cast<std::size_t>(QueryKind::Count))
+		{
+			return false;
+		}
+		kind = static_cast<QueryKind>(index);
+		return true;
+	}
+
+	// Queries one pool worker takes at a time
+	constexpr std::size_t kBatchGrain = 128;
+
+	struct PlannedQuery
+	{
+		std::size_t index;
+		QueryKind kind;
+	};
+
+	// Groups a symbol's next query has to come after, each stored plus one so 0 means none
+	struct SymbolLevels
+	{
+		std::size_t afterWrite = 0;
+		std::size_t afterReads = 0;
+	};
+
+	// Where a batch worker left the answer of one query
+	struct BatchAnswer
+	{
+		std::size_t worker = 0;
+		std::size_t offset = 0;
+		std::size_t size = 0;
+		bool present = false;
+	};
+}
+
+QueryHandler::QueryHandler() = default;
+
+QueryHandler::QueryHandler(const AnswerWriter::Options &answerOptions, std::size_t batchThreads)
+	: answerWriter(answerOptions), batchThreads(batchThreads)
+{
+}
+
+QueryHandler::~QueryHandler() = default;
+
+void QueryHandler::dispatchQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser)
+{
+	if (!queryObject.HasMember("query_type") || !queryObject["query_type"].IsString())
+	{
+		logger->error("Missing or invalid 'query_type' in JSON query.");
+		return;
+	}
+
+	QueryKind kind;
+	if (!queryKind(queryObject["query_type"], kind))
+	{
+		logger->error("Invalid query type: {}", queryObject["query_type"].GetString());
+		return;
+	}
+	switch (kind)
+	{
+	case QueryKind::Get:
+	{
+		LatencySpan span(metrics().queryGet);
+		handleGetQuery(queryObject, jsonParser);
+		break;
+	}
+	case QueryKind::Update:
+	{
+		LatencySpan span(metrics().queryUpdate);
+		handleUpdateQuery(queryObject, jsonParser);
+		break;
+	}
+	case QueryKind::Delete:
+	{
+		LatencySpan span(metrics().queryDelete);
+		handleDeleteQuery(queryObject, jsonParser);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void QueryHandler::handleBatch(const std::vector<const rapidjson::Value *> &queries, JSONParser &jsonParser)
+{
+	for (std::size_t first = 0; first < queries.size(); first += kBatchWindow)
+	{
+		runBatchWindow(queries.data() + first, std::min(kBatchWindow, queries.size() - first), jsonParser);
+	}
+}
+
+WorkStealingPool &QueryHandler::batchPool()
+{
+	if (!pool)
+	{
+		pool = std::make_unique<WorkStealingPool>(batchThreads);
+		for (std::size_t i = 0; i < pool->size(); ++i)
+		{
+			batchWorkers.push_back(std::make_unique<GetWorker>());
+		}
+	}
+	return *pool;
+}
+
+void QueryHandler::runBatchWindow(const rapidjson::Value *const *queries, std::size_t count, JSONParser &jsonParser)
+{
+	if (batchThreads <= 1)
+	{
+		// Nothing to overlap, submission order is already a valid schedule
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			dispatchQuery(*queries[i], jsonParser);
+		}
+		return;
+	}
+	WorkStealingPool &workers = batchPool();
+
+	// Each query goes one group past the last earlier query on its symbol it has to wait for: a read waits
+	// for the previous write, a write for the previous write and every read since
+	std::vector<std::vector<PlannedQuery>> levels;
+	std::unordered_map<std::string, SymbolLevels> symbols;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const rapidjson::Value &queryObject = *queries[i];
+		QueryKind kind;
+		if (!queryObject.IsObject() || !queryObject.HasMember("query_type") || !queryKind(queryObject["query_type"], kind) ||
+			!queryObject.HasMember("symbol") || !queryObject["symbol"].IsString())
+		{
+			// Touches no symbol; the usual handler reports what is wrong with it
+			dispatchQuery(queryObject, jsonParser);
+			continue;
+		}
+		MarketId market;
+		if (!queryMarket(queryObject, jsonParser, market))
+		{
+			continue;
+		}
+
+		SymbolLevels &symbolLevels = symbols[std::string(1, static_cast<char>(market)) + queryObject["symbol"].GetString()];
+		std::size_t level;
+		if (kind == QueryKind::Get)
+		{
+			level = symbolLevels.afterWrite;
+			symbolLevels.afterReads = std::max(symbolLevels.afterReads, level + 1);
+		}
+		else
+		{
+			level = std::max(symbolLevels.afterWrite, symbolLevels.afterReads);
+			symbolLevels.afterWrite = level + 1;
+		}
+		if (level == levels.size())
+		{
+			levels.emplace_back();
+		}
+		levels[level].push_back({i, kind});
+	}
+
+	std::vector<BatchAnswer> answers(count);
+	for (const std::unique_ptr<GetWorker> &worker : batchWorkers)
+	{
+		worker->batchAnswers.clear();
+	}
+	for (const std::vector<PlannedQuery> &level : levels)
+	{
+		workers.parallelFor(level.size(), kBatchGrain, [&](std::size_t worker, std::size_t begin, std::size_t end)
+							{
+								GetWorker &getState = *batchWorkers[worker];
+								for (std::size_t k = begin; k < end; ++k)
+								{
+									const rapidjson::Value &queryObject = *queries[level[k].index];
+									if (level[k].kind == QueryKind::Get)
+									{
+										LatencySpan span(metrics().queryGet);
+										const char *answer;
+										std::size_t size;
+										if (answerGet(queryObject, jsonParser, getState, answer, size))
+										{
+											answers[level[k].index] = {worker, getState.batchAnswers.size(), size, true};
+											getState.batchAnswers.append(answer, size);
+										}
+									}
+									else if (level[k].kind == QueryKind::Update)
+									{
+										LatencySpan span(metrics().queryUpdate);
+										handleUpdateQuery(queryObject, jsonParser);
+									}
+									else
+									{
+										LatencySpan span(metrics().queryDelete);
+										handleDeleteQuery(queryObject, jsonParser);
+									}
+								} });
+	}
+
+	// Answers leave in submission order, whichever worker produced them
+	for (const BatchAnswer &answer : answers)
+	{
+		if (answer.present)
+		{
+			answerWriter.writeSerialized(batchWorkers[answer.worker]->batchAnswers.data() + answer.offset, answer.size);
+		}
+	}
+}
 
 void QueryHandler::handleQueries(const std::string &queryFile, JSONParser &jsonParser)
 {
 	try
 	{
-		std::ifstream file(queryFile);
-		if (!file.is_open())
+		// Read into a buffer kept from the last pass; a mapping would fault with SIGBUS if the file were
+		// truncated under it
+		if (!queryFileBytes.read(queryFile))
 		{
-			logger->error("Error opening query file.");
+			logger->error("Error opening query file {}: {}", queryFile, std::strerror(errno));
 			return;
 		}
 
-		std::ostringstream queryContents; // converting contents of file into a string
-		queryContents << file.rdbuf();
-		file.close();
-
-		rapidjson::Document queryDocument;
-		queryDocument.Parse(queryContents.str().c_str());
+		// Parsed into the arena, so a file of the same size as the last one allocates nothing
+		JsonArena::Document &queryDocument = queryArena.document();
+		queryDocument.Parse(queryFileBytes.data());
 
 		if (queryDocument.HasParseError())
 		{
@@ -41,6 +318,10 @@ void QueryHandler::handleQueries(const std::string &queryFile, JSONParser &jsonP
 		{
 			const rapidjson::Value &queryArray = queryDocument["query"];
 
+			// Only ids still present in the file need remembering, so the list never outgrows the file.
+			// Sorted vectors reused from the last read instead of a hash set rebuilt node by node.
+			fileIds.clear();
+			newIds.clear();
 			for (rapidjson::SizeType i = 0; i < queryArray.Size(); ++i)
 			{
 				const rapidjson::Value &queryObject = queryArray[i];
@@ -48,35 +329,12 @@ void QueryHandler::handleQueries(const std::string &queryFile, JSONParser &jsonP
 				if (queryObject.HasMember("id") && queryObject["id"].IsInt())
 				{
 					int id = queryObject["id"].GetInt();
+					fileIds.push_back(id);
 
-					// Check if the query has changed
-					if (processedIds.find(id) == processedIds.end())
+					// Check if the query has changed; a removed id that comes back is caught by the window below
+					if (!std::binary_search(documentIds.begin(), documentIds.end(), id))
 					{
-						// Process the query
-
-						std::string queryType = queryObject["query_type"].GetString();
-
-						if (queryType == "GET")
-						{
-							handleGetQuery(queryObject, jsonParser);
-						}
-						else if (queryType == "UPDATE")
-						{
-
-							handleUpdateQuery(queryObject, jsonParser);
-						}
-						else if (queryType == "DELETE")
-						{
-
-							handleDeleteQuery(queryObject, jsonParser);
-						}
-						else
-						{
-							logger->error("Invalid query type: {}", queryType);
-						}
-
-						// Update processed IDs
-						processedIds.insert(id);
+						newIds.emplace_back(id, i);
 					}
 				}
 				else
@@ -84,6 +342,26 @@ void QueryHandler::handleQueries(const std::string &queryFile, JSONParser &jsonP
 					logger->error("Missing or invalid 'id' in JSON query.");
 				}
 			}
+			std::sort(fileIds.begin(), fileIds.end());
+			fileIds.erase(std::unique(fileIds.begin(), fileIds.end()), fileIds.end());
+			documentIds.swap(fileIds);
+
+			// An id repeated within the file runs once, at its first occurrence; then back to file order
+			std::sort(newIds.begin(), newIds.end());
+			newIds.erase(std::unique(newIds.begin(), newIds.end(), [](const std::pair<int, rapidjson::SizeType> &a, const std::pair<int, rapidjson::SizeType> &b)
+									 { return a.first == b.first; }),
+						 newIds.end());
+			std::sort(newIds.begin(), newIds.end(), [](const std::pair<int, rapidjson::SizeType> &a, const std::pair<int, rapidjson::SizeType> &b)
+					  { return a.second < b.second; });
+			newQueries.clear();
+			for (const auto &newId : newIds)
+			{
+				if (rememberId(newId.first))
+				{
+					newQueries.push_back(&queryArray[newId.second]);
+				}
+			}
+			handleBatch(newQueries, jsonParser);
 		}
 		else
 		{
@@ -96,107 +374,267 @@ void QueryHandler::handleQueries(const std::string &queryFile, JSONParser &jsonP
 	}
 }
 
-void QueryHandler::handleGetQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser) // jsonparcer object to call symbolinfo
+void QueryHandler::handleQueryLog(const std::string &logFile, JSONParser &jsonParser)
 {
-	if (!queryObject.IsObject())
+	try
 	{
-		logger->error("Invalid query object.");
-		return;
-	}
+		int fd = ::open(logFile.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			logger->error("Error opening query log {}: {}", logFile, std::strerror(errno));
+			return;
+		}
 
-	if (!queryObject.HasMember("symbol") || !queryObject["symbol"].IsString())
-	{
-		logger->error("Missing or invalid 'symbol' in the query object.");
-		return;
-	}
+		struct stat info;
+		if (::fstat(fd, &info) != 0)
+		{
+			logger->error("Error reading query log {}: {}", logFile, std::strerror(errno));
+			::close(fd);
+			return;
+		}
 
-	std::string symbol = queryObject["symbol"].GetString();
+		// A shorter or different file means the log was truncated or rotated, start over
+		unsigned long long inode = static_cast<unsigned long long>(info.st_ino);
+		if (inode != queryLogInode || static_cast<std::uint64_t>(info.st_size) < queryLogOffset)
+		{
+			if (queryLogOffset > 0)
+			{
+				logger->warn("Query log {} was truncated or replaced, reading it from the start.", logFile);
+			}
+			queryLogInode = inode;
+			queryLogOffset = 0;
+			// The new log numbers its queries from scratch
+			processedIds.clear();
+			processedIdOrder.clear();
+		}
+
+		// Read only what was appended since the last call
+		std::size_t pending = static_cast<std::size_t>(info.st_size) - static_cast<std::size_t>(queryLogOffset);
+		queryLogBuffer.resize(pending);
+		std::size_t received = 0;
+		while (received < pending)
+		{
+			ssize_t count = ::pread(fd, &queryLogBuffer[received], pending - received, static_cast<off_t>(queryLogOffset + received));
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				break;
+			}
+			received += static_cast<std::size_t>(count);
+		}
+		::close(fd);
+		queryLogBuffer.resize(received);
+
+		// A record without its trailing newline is still being written; leave it for the next call
+		std::size_t lastNewline = queryLogBuffer.rfind('\n');
+		if (lastNewline == std::string::npos)
+		{
+			return;
+		}
+		std::size_t consumed = lastNewline + 1;
 
-	logger->info("GET Query - Symbol: {}", symbol);
+		std::size_t lineStart = 0;
+		while (lineStart < consumed)
+		{
+			std::size_t lineEnd = queryLogBuffer.find('\n', lineStart);
+			std::size_t recordOffset = queryLogOffset + lineStart;
+			queryLogBuffer[lineEnd] = '\0';
+			const char *line = queryLogBuffer.c_str() + lineStart;
+			lineStart = lineEnd + 1;
 
-	const std::unordered_map<std::string, std::string> &symbolInfo = jsonParser.getSymbolInfo(symbol);
-	logger->info("Before processing query. SymbolInfoMap size: {}", jsonParser.getSymbolInfoMap().size());
-	rapidjson::Document answerDoc;
-	answerDoc.SetObject();
+			if (line[std::strspn(line, " \t\r")] == '\0')
+			{
+				continue; // blank line
+			}
 
-	if (symbolInfo.find("status") != symbolInfo.end())
-	{
-		logger->info("GET Query - Symbol: {}, DataField: status, Value: {}", symbol, symbolInfo.at("status"));
-		rapidjson::Value statusKey("status", answerDoc.GetAllocator());
-		rapidjson::Value statusValue(symbolInfo.at("status").c_str(), answerDoc.GetAllocator());
-		answerDoc.AddMember(statusKey, statusValue, answerDoc.GetAllocator());
+			// Each record rewinds the arena; reusing one Document would keep every record's values
+			JsonArena::Document &queryDocument = queryArena.document();
+			queryDocument.Parse(line);
+			if (queryDocument.HasParseError() || !queryDocument.IsObject())
+			{
+				logger->error("Error parsing query log record at byte {}. Parse error code: {}, Offset: {}", recordOffset, queryDocument.GetParseError(), queryDocument.GetErrorOffset());
+				continue;
+			}
+			if (!queryDocument.HasMember("id") || !queryDocument["id"].IsInt())
+			{
+				logger->error("Missing or invalid 'id' in JSON query.");
+				continue;
+			}
+
+			// The byte offset already guarantees each record runs once; the id window only
+			// catches a writer that appends the same query twice
+			int id = queryDocument["id"].GetInt();
+			if (rememberId(id))
+			{
+				dispatchQuery(queryDocument, jsonParser);
+			}
+			else
+			{
+				logger->warn("Skipping duplicate query id {} in query log.", id);
+			}
+		}
+
+		queryLogOffset += consumed;
 	}
-	else
+	catch (std::exception const &e)
 	{
-		logger->warn("GET Query - Symbol: {}, DataField: status not found.", symbol);
+		logger->error("Error: {}", e.what());
 	}
+}
 
-	// Handle tickSize
-	if (symbolInfo.find("tickSize") != symbolInfo.end())
+bool QueryHandler::rememberId(int id)
+{
+	if (!processedIds.insert(id).second)
 	{
-		logger->info("GET Query - Symbol: {}, DataField: tickSize, Value: {}", symbol, symbolInfo.at("tickSize"));
-		rapidjson::Value tickSizeKey("tickSize", answerDoc.GetAllocator());
-		rapidjson::Value tickSizeValue(symbolInfo.at("tickSize").c_str(), answerDoc.GetAllocator());
-		answerDoc.AddMember(tickSizeKey, tickSizeValue, answerDoc.GetAllocator());
+		return false;
 	}
-	else
+	processedIdOrder.push_back(id);
+	if (processedIdOrder.size() > kMaxRememberedIds)
 	{
-		logger->warn("GET Query - Symbol: {}, DataField: tickSize not found.", symbol);
+		processedIds.erase(processedIdOrder.front());
+		processedIdOrder.pop_front();
 	}
+	return true;
+}
 
-	// Handle stepSize
-	if (symbolInfo.find("stepSize") != symbolInfo.end())
+void QueryHandler::handleGetQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser)
+{
+	const char *answer;
+	std::size_t size;
+	if (answerGet(queryObject, jsonParser, getWorker, answer, size))
 	{
-		logger->info("GET Query - Symbol: {}, DataField: stepSize, Value: {}", symbol, symbolInfo.at("stepSize"));
-		rapidjson::Value stepSizeKey("stepSize", answerDoc.GetAllocator());
-		rapidjson::Value stepSizeValue(symbolInfo.at("stepSize").c_str(), answerDoc.GetAllocator());
-		answerDoc.AddMember(stepSizeKey, stepSizeValue, answerDoc.GetAllocator());
+		answerWriter.writeSerialized(answer, size);
 	}
-	else
+}
+
+bool QueryHandler::answerGet(const rapidjson::Value &queryObject, JSONParser &jsonParser, GetWorker &worker, const char *&answer, std::size_t &size) // jsonparcer object to call symbolinfo
+{
+	if (!queryObject.IsObject())
 	{
-		logger->warn("GET Query - Symbol: {}, DataField: stepSize not found.", symbol);
+		logger->error("Invalid query object.");
+		return false;
 	}
 
-	// Handle quoteAsset
-	if (symbolInfo.find("quoteAsset") != symbolInfo.end())
+	if (!queryObject.HasMember("symbol") || !queryObject["symbol"].IsString())
 	{
-		logger->info("GET Query - Symbol: {}, DataField: quoteAsset, Value: {}", symbol, symbolInfo.at("quoteAsset"));
-		rapidjson::Value quoteAssetKey("quoteAsset", answerDoc.GetAllocator());
-		rapidjson::Value quoteAssetValue(symbolInfo.at("quoteAsset").c_str(), answerDoc.GetAllocator());
-		answerDoc.AddMember(quoteAssetKey, quoteAssetValue, answerDoc.GetAllocator());
+		logger->error("Missing or invalid 'symbol' in the query object.");
+		return false;
 	}
-	else
+
+	// Into the worker's string, which keeps its capacity from one GET to the next
+	worker.symbol.assign(queryObject["symbol"].GetString(), queryObject["symbol"].GetStringLength());
+	MarketId market;
+	SymbolFieldMask fields;
+	if (!queryMarket(queryObject, jsonParser, market) || !queryFields(queryObject, fields))
 	{
-		logger->warn("GET Query - Symbol: {}, DataField: quoteAsset not found.", symbol);
+		return false;
 	}
+	return answerSymbol(market, worker.symbol, fields, false, jsonParser, worker, answer, size);
+}
 
-	if (!symbolInfo.empty())
-	{
-		// Check if the symbol is deleted
-		const auto &deletedIt = std::find_if(symbolInfo.begin(), symbolInfo.end(),
-											 [](const auto &entry)
-											 { return entry.second.empty(); });
+bool QueryHandler::answerGet(MarketId market, const std::string &symbol, SymbolFieldMask fields, JSONParser &jsonParser, const char *&answer, std::size_t &size)
+{
+	return answerSymbol(market, symbol, fields ? fields : FieldRegistry::kDefaultAnswerFields, true, jsonParser, getWorker, answer, size);
+}
 
-		if (deletedIt != symbolInfo.end())
+bool QueryHandler::answerSymbol(MarketId market, const std::string &symbol, SymbolFieldMask fields, bool requireLive, JSONParser &jsonParser, GetWorker &worker, const char *&answer, std::size_t &size)
+{
+	SPDLOG_LOGGER_DEBUG(logger, "GET Query - Symbol: {}", symbol);
+
+	// One snapshot for the whole query, a concurrent UPDATE cannot tear the answer
+	std::shared_ptr<const SymbolSnapshot> snapshot = jsonParser.snapshot();
+	SymbolSnapshot::Row row = snapshot->find(symbol, market);
+	if (!row && requireLive)
+	{
+		return false;
+	}
+	// A row keeps its version until it is changed, so an answer built from that version is still exact
+	CachedAnswer *cached = nullptr;
+	if (row)
+	{
+		std::uint64_t version = row.table->version(row.id);
+		cached = &worker.answerCache[answerCacheSet(version, fields)];
+		if (cached[1].version == version && cached[1].fields == fields)
 		{
-			logger->error("GET Query - Symbol: {}, Error: Symbol is deleted.", symbol);
-			return;
+			std::swap(cached[0], cached[1]);
+		}
+		if (cached[0].version == version && cached[0].fields == fields)
+		{
+			metrics().answerCacheHits.fetch_add(1, std::memory_order_relaxed);
+			answer = cached[0].answer.data();
+			size = cached[0].answer.size();
+			return true;
+		}
+	}
+	metrics().answerCacheMisses.fetch_add(1, std::memory_order_relaxed);
+	SPDLOG_LOGGER_TRACE(logger, "Before processing query. SymbolTable size: {}", snapshot->size());
+
+	// Collect the fields first, an answer is only written for symbols that are not deleted
+	constexpr std::size_t kFieldCount = FieldRegistry::kCount;
+	std::string answerValues[kFieldCount];
+	bool present[kFieldCount] = {};
+	for (std::size_t i = 0; i < kFieldCount; ++i)
+	{
+		const FieldSpec &spec = FieldRegistry::kSpecs[i];
+		if (!(fields & symbolFieldBit(spec.field)))
+		{
+			continue;
+		}
+		if (row && row.table->hasField(row.id, spec.field))
+		{
+			answerValues[i] = row.table->fieldText(row.id, spec.field);
+			present[i] = true;
+			SPDLOG_LOGGER_TRACE(logger, "GET Query - Symbol: {}, DataField: {}, Value: {}", symbol, spec.name, answerValues[i]);
+			// Check if the symbol is deleted
+			if (answerValues[i].empty())
+			{
+				logger->error("GET Query - Symbol: {}, Error: Symbol is deleted.", symbol);
+				return false;
+			}
+		}
+		else
+		{
+			logger->warn("GET Query - Symbol: {}, DataField: {} not found.", symbol, spec.name);
 		}
 	}
-	logger->info("After processing query. SymbolInfoMap size: {}", jsonParser.getSymbolInfoMap().size());
+	SPDLOG_LOGGER_TRACE(logger, "After processing query. SymbolTable size: {}", snapshot->size());
 
-	std::ofstream outputFile("answers.json", std::ios::app);
-	if (outputFile.is_open())
+	worker.buffer.Clear();
+	AnswerWriter::JSONWriter writer(worker.buffer);
+	writer.StartObject();
+	for (std::size_t i = 0; i < kFieldCount; ++i)
 	{
-		rapidjson::OStreamWrapper osw(outputFile);
-		rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(osw);
-		answerDoc.Accept(writer);
-		outputFile << "," << std::endl; // Adding a newline to separate entries
+		if (present[i])
+		{
+			const FieldSpec &spec = FieldRegistry::kSpecs[i];
+			writer.Key(spec.name, static_cast<rapidjson::SizeType>(FieldRegistry::nameLength(spec.field)));
+			writer.String(answerValues[i].c_str(), static_cast<rapidjson::SizeType>(answerValues[i].size()));
+		}
 	}
-	else
+	writer.EndObject();
+
+	// Unknown symbols have no version to key the answer by and are rebuilt every time
+	if (cached)
 	{
-		logger->error("Failed to open answers.json for writing.");
+		// The older entry of the set makes way
+		std::swap(cached[0], cached[1]);
+		cached[0].version = row.table->version(row.id);
+		cached[0].fields = fields;
+		cached[0].answer.assign(worker.buffer.GetString(), worker.buffer.GetSize());
 	}
+	answer = worker.buffer.GetString();
+	size = worker.buffer.GetSize();
+	return true;
+}
+
+std::size_t QueryHandler::answerCacheSet(std::uint64_t version, SymbolFieldMask fields)
+{
+	// Fibonacci hashing spreads versions handed out in a row over different sets
+	std::uint64_t key = version ^ (static_cast<std::uint64_t>(fields) << 48);
+	return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - kAnswerCacheSetBits)) * 2;
 }
 
 void QueryHandler::handleUpdateQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser)
@@ -214,8 +652,13 @@ void QueryHandler::handleUpdateQuery(const rapidjson::Value &queryObject, JSONPa
 	}
 
 	std::string symbol = queryObject["symbol"].GetString();
+	MarketId market;
+	if (!queryMarket(queryObject, jsonParser, market))
+	{
+		return;
+	}
 
-	logger->info("UPDATE Query - Symbol: {}", symbol);
+	SPDLOG_LOGGER_DEBUG(logger, "UPDATE Query - Symbol: {}", symbol);
 
 	if (!queryObject.HasMember("data"))
 	{
@@ -231,18 +674,35 @@ void QueryHandler::handleUpdateQuery(const rapidjson::Value &queryObject, JSONPa
 		return;
 	}
 
-	// Convert the dataObject to an unordered_map
-	std::unordered_map<std::string, std::string> updatedInfo;
+	// Names and values are checked here, against the field registry, before anything is published. An UPDATE
+	// applies whole or not at all, like one from the query socket.
+	std::vector<std::pair<SymbolField, std::string>> updates;
 	for (rapidjson::Value::ConstMemberIterator itr = dataObject.MemberBegin(); itr != dataObject.MemberEnd(); ++itr)
 	{
-		if (itr->value.IsString())
+		SymbolField field;
+		if (!FieldRegistry::find(itr->name.GetString(), itr->name.GetStringLength(), field))
 		{
-			updatedInfo[itr->name.GetString()] = itr->value.GetString();
+			logger->warn("Symbol: {}, unknown field {}, update dropped.", symbol, itr->name.GetString());
+			return;
 		}
+		if (!itr->value.IsString())
+		{
+			logger->warn("Symbol: {}, Field: {} is not a string, update dropped.", symbol, itr->name.GetString());
+			return;
+		}
+		std::string value(itr->value.GetString(), itr->value.GetStringLength());
+		if (!FieldRegistry::validValue(field, value))
+		{
+			logger->warn("Symbol: {}, Field: {} rejected malformed value {}, update dropped.", symbol, itr->name.GetString(), value);
+			return;
+		}
+		updates.emplace_back(field, std::move(value));
 	}
 
-	// Call the handleUpdate method to perform the update
-	jsonParser.handleUpdate(symbol, updatedInfo);
+	if (!updates.empty())
+	{
+		jsonParser.handleUpdate(symbol, updates, market);
+	}
 }
 
 void QueryHandler::handleDeleteQuery(const rapidjson::Value &queryObject, JSONParser &jsonParser)
@@ -261,8 +721,13 @@ void QueryHandler::handleDeleteQuery(const rapidjson::Value &queryObject, JSONPa
 	}
 
 	std::string symbol = queryObject["symbol"].GetString();
+	MarketId market;
+	if (!queryMarket(queryObject, jsonParser, market))
+	{
+		return;
+	}
 
-	logger->info("DELETE Query - Symbol: {}", symbol);
+	SPDLOG_LOGGER_DEBUG(logger, "DELETE Query - Symbol: {}", symbol);
 
-	jsonParser.handleDelete(symbol);
+	jsonParser.handleDelete(symbol, market);
 }
\ No newline at end of file
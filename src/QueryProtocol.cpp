@@ -0,0 +1,149 @@
+#include "QueryProtocol.h"
+#include <algorithm>
+
+namespace
+{
+	template <typename T>
+	void appendValue(std::string &out, T value)
+	{
+		out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+
+	void appendShortString(std::string &out, const std::string &text)
+	{
+		uint8_t length = static_cast<uint8_t>(std::min<std::size_t>(text.size(), 255));
+		appendValue(out, length);
+		out.append(text, 0, length);
+	}
+
+	// Bounds-checked reads over one frame body
+	struct BodyReader
+	{
+		const char *at;
+		const char *end;
+
+		template <typename T>
+		bool value(T &out)
+		{
+			if (static_cast<std::size_t>(end - at) < sizeof(T))
+			{
+				return false;
+			}
+			std::memcpy(&out, at, sizeof(T));
+			at += sizeof(T);
+			return true;
+		}
+
+		bool shortString(std::string &out)
+		{
+			uint8_t length;
+			if (!value(length) || static_cast<std::size_t>(end - at) < length)
+			{
+				return false;
+			}
+			out.assign(at, length);
+			at += length;
+			return true;
+		}
+	};
+
+	// Length prefix of a frame whose body starts at start
+	void patchLength(std::string &out, std::size_t start)
+	{
+		uint32_t length = static_cast<uint32_t>(out.size() - start - kWireLengthSize);
+		std::memcpy(&out[start], &length, sizeof(length));
+	}
+}
+
+void encodeWireQuery(const WireQuery &query, std::string &out)
+{
+	std::size_t start = out.size();
+	appendValue(out, uint32_t(0));
+	appendValue(out, query.id);
+	appendValue(out, static_cast<uint8_t>(query.type));
+	appendShortString(out, query.market);
+	appendShortString(out, query.symbol);
+	if (query.type == WireQueryType::Get)
+	{
+		appendValue(out, query.fields);
+	}
+	else if (query.type == WireQueryType::Update)
+	{
+		appendValue(out, static_cast<uint8_t>(query.updates.size()));
+		for (const auto &update : query.updates)
+		{
+			appendValue(out, static_cast<uint8_t>(update.first));
+			appendShortString(out, update.second);
+		}
+	}
+	patchLength(out, start);
+}
+
+void encodeWireResponse(uint32_t id, WireStatus status, const char *answer, std::size_t size, std::string &out)
+{
+	std::size_t start = out.size();
+	appendValue(out, uint32_t(0));
+	appendValue(out, id);
+	appendValue(out, static_cast<uint8_t>(status));
+	out.append(answer, size);
+	patchLength(out, start);
+}
+
+bool decodeWireQuery(const char *body, std::size_t size, WireQuery &query)
+{
+	BodyReader reader{body, body + size};
+	uint8_t type;
+	if (!reader.value(query.id) || !reader.value(type) || !reader.shortString(query.market) || !reader.shortString(query.symbol))
+	{
+		return false;
+	}
+	query.type = static_cast<WireQueryType>(type);
+	query.fields = 0;
+	query.updates.clear();
+	switch (query.type)
+	{
+	case WireQueryType::Get:
+		if (!reader.value(query.fields))
+		{
+			return false;
+		}
+		break;
+	case WireQueryType::Update:
+	{
+		uint8_t count;
+		if (!reader.value(count))
+		{
+			return false;
+		}
+		query.updates.resize(count);
+		for (auto &update : query.updates)
+		{
+			uint8_t field;
+			if (!reader.value(field) || !reader.shortString(update.second))
+			{
+				return false;
+			}
+			update.first = static_cast<SymbolField>(field);
+		}
+		break;
+	}
+	default:
+		// DELETE has nothing more; unknown types still decode so the id can be answered with BadRequest
+		break;
+	}
+	return reader.at == reader.end;
+}
+
+bool decodeWireResponse(const char *body, std::size_t size, uint32_t &id, WireStatus &status, const char *&answer, std::size_t &answerSize)
+{
+	BodyReader reader{body, body + size};
+	uint8_t code;
+	if (!reader.value(id) || !reader.value(code))
+	{
+		return false;
+	}
+	status = static_cast<WireStatus>(code);
+	answer = reader.at;
+	answerSize = static_cast<std::size_t>(reader.end - reader.at);
+	return true;
+}
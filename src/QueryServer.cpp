@@ -0,0 +1,252 @@
+#include "BinanceHandler.h"
+#include "QueryProtocol.h"
+#include "FieldRegistry.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/write.hpp>
+#include <unistd.h>
+
+namespace net = boost::asio;
+using local = net::local::stream_protocol;
+
+namespace
+{
+	// Responses waiting for the socket beyond this stop the reading, so a client that never reads
+	// cannot make the server buffer without bound
+	constexpr std::size_t kMaxPendingResponses = 4 * 1024 * 1024;
+
+	// Decodes requests off one connection and runs them on the server's thread
+	class QuerySession : public std::enable_shared_from_this<QuerySession>
+	{
+	public:
+		using Handler = std::function<WireStatus(const WireQuery &query, const char *&answer, std::size_t &size)>;
+
+		QuerySession(local::socket socket, const Handler &handler) : socket(std::move(socket)), handler(handler), input(kMaxWireFrame + kWireLengthSize) {}
+
+		void start() { read(); }
+
+	private:
+		void read()
+		{
+			socket.async_read_some(net::buffer(input.data() + received, input.size() - received),
+								   [self = shared_from_this()](boost::system::error_code ec, std::size_t count)
+								   { self->onRead(ec, count); });
+		}
+
+		void onRead(boost::system::error_code ec, std::size_t count)
+		{
+			if (ec)
+			{
+				// Closed by the client; responses still pending are dropped with the connection
+				return;
+			}
+			received += count;
+
+			// Every complete frame in the buffer is answered before the next read, responses in order
+			std::size_t consumed = 0;
+			uint32_t length;
+			while (wireFrameLength(input.data() + consumed, received - consumed, length))
+			{
+				if (length > kMaxWireFrame)
+				{
+					logger->error("Query socket: {} byte frame exceeds the {} byte limit, closing the connection.", length, kMaxWireFrame);
+					return close();
+				}
+				if (received - consumed < kWireLengthSize + length)
+				{
+					break;
+				}
+				if (!decodeWireQuery(input.data() + consumed + kWireLengthSize, length, query))
+				{
+					logger->error("Query socket: malformed request frame, closing the connection.");
+					return close();
+				}
+				consumed += kWireLengthSize + length;
+
+				const char *answer = nullptr;
+				std::size_t size = 0;
+				WireStatus status = handler(query, answer, size);
+				encodeWireResponse(query.id, status, answer, size, pending);
+			}
+			// Keep the partial frame at the front
+			std::memmove(input.data(), input.data() + consumed, received - consumed);
+			received -= consumed;
+
+			write();
+			if (pending.size() < kMaxPendingResponses)
+			{
+				read();
+			}
+			else
+			{
+				readPaused = true;
+			}
+		}
+
+		// One write in flight; responses produced meanwhile go out with the next one
+		void write()
+		{
+			if (writing || pending.empty())
+			{
+				return;
+			}
+			sending.swap(pending);
+			writing = true;
+			net::async_write(socket, net::buffer(sending),
+							 [self = shared_from_this()](boost::system::error_code ec, std::size_t)
+							 { self->onWrite(ec); });
+		}
+
+		void onWrite(boost::system::error_code ec)
+		{
+			writing = false;
+			sending.clear();
+			if (ec)
+			{
+				return close();
+			}
+			if (readPaused)
+			{
+				readPaused = false;
+				read();
+			}
+			write();
+		}
+
+		void close()
+		{
+			boost::system::error_code ignored;
+			socket.close(ignored);
+		}
+
+		local::socket socket;
+		const Handler &handler;
+		std::vector<char> input;
+		std::size_t received = 0;
+		WireQuery query;
+		std::string pending;
+		std::string sending;
+		bool writing = false;
+		bool readPaused = false;
+	};
+}
+
+struct QueryServer::Impl
+{
+	Impl(JSONParser &jsonParser, const std::string &socketPath) : jsonParser(jsonParser), socketPath(socketPath), acceptor(ioc)
+	{
+		handler = [this](const WireQuery &query, const char *&answer, std::size_t &size)
+		{ return handle(query, answer, size); };
+
+		// A socket file left behind by an earlier run would make bind fail
+		::unlink(socketPath.c_str());
+		local::endpoint endpoint(socketPath);
+		acceptor.open(endpoint.protocol());
+		acceptor.bind(endpoint);
+		acceptor.listen(net::socket_base::max_listen_connections);
+		accept();
+		logger->info("Serving queries on unix socket {}", socketPath);
+		worker = std::thread([this]
+							 { ioc.run(); });
+	}
+
+	~Impl()
+	{
+		ioc.stop();
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+		::unlink(socketPath.c_str());
+	}
+
+	void accept()
+	{
+		acceptor.async_accept([this](boost::system::error_code ec, local::socket socket)
+							  {
+								  if (ec == net::error::operation_aborted)
+								  {
+									  return;
+								  }
+								  if (!ec)
+								  {
+									  std::make_shared<QuerySession>(std::move(socket), handler)->start();
+								  }
+								  accept(); });
+	}
+
+	// Same effect as the JSON query of that type; only ever called on the server's thread
+	WireStatus handle(const WireQuery &query, const char *&answer, std::size_t &size)
+	{
+		requests.fetch_add(1, std::memory_order_relaxed);
+		MarketId market = 0;
+		if (!query.market.empty() && !jsonParser.findMarket(query.market, market))
+		{
+			return WireStatus::BadRequest;
+		}
+
+		switch (query.type)
+		{
+		case WireQueryType::Get:
+		{
+			LatencySpan span(metrics().queryGet);
+			if (query.fields >= symbolFieldBit(SymbolField::Count))
+			{
+				return WireStatus::BadRequest;
+			}
+			return queryHandler.answerGet(market, query.symbol, query.fields, jsonParser, answer, size) ? WireStatus::Ok : WireStatus::NotFound;
+		}
+		case WireQueryType::Update:
+		{
+			LatencySpan span(metrics().queryUpdate);
+			// Checked against the field registry like UPDATE queries from the file, before any lookup
+			for (const auto &update : query.updates)
+			{
+				if (update.first >= SymbolField::Count || !FieldRegistry::validValue(update.first, update.second))
+				{
+					return WireStatus::BadRequest;
+				}
+			}
+			if (!jsonParser.snapshot()->find(query.symbol, market))
+			{
+				return WireStatus::NotFound;
+			}
+			// A value the table refuses drops the whole update, nothing is published
+			return jsonParser.handleUpdate(query.symbol, query.updates, market) ? WireStatus::Ok : WireStatus::BadRequest;
+		}
+		case WireQueryType::Delete:
+		{
+			LatencySpan span(metrics().queryDelete);
+			if (!jsonParser.snapshot()->find(query.symbol, market))
+			{
+				return WireStatus::NotFound;
+			}
+			jsonParser.handleDelete(query.symbol, market);
+			return WireStatus::Ok;
+		}
+		default:
+			return WireStatus::BadRequest;
+		}
+	}
+
+	JSONParser &jsonParser;
+	std::string socketPath;
+	QueryHandler queryHandler;
+	QuerySession::Handler handler;
+	std::atomic<std::uint64_t> requests{0};
+	net::io_context ioc;
+	local::acceptor acceptor;
+	std::thread worker;
+};
+
+QueryServer::QueryServer(JSONParser &jsonParser, const std::string &socketPath)
+	: impl(std::make_unique<Impl>(jsonParser, socketPath))
+{
+}
+
+QueryServer::~QueryServer() = default;
+
+std::uint64_t QueryServer::getRequestCount() const
+{
+	return impl->requests.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,247 @@
+#include "BinanceHandler.h"
+#include "SharedSymbolTable.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	void copyText(char *out, std::size_t size, const std::string &text)
+	{
+		std::memset(out, 0, size);
+		std::memcpy(out, text.data(), std::min(text.size(), size));
+	}
+
+	SharedSymbolData recordData(const SymbolTable &table, SymbolTable::SymbolId id)
+	{
+		SharedSymbolData data = {};
+		data.version = table.version(id);
+		data.live = 1;
+		for (unsigned field = 0; field < static_cast<unsigned>(SymbolField::Count); ++field)
+		{
+			if (table.hasField(id, static_cast<SymbolField>(field)))
+			{
+				data.fields |= symbolFieldBit(static_cast<SymbolField>(field));
+			}
+		}
+		FixedDecimal tickSize = table.tickSize(id);
+		FixedDecimal stepSize = table.stepSize(id);
+		FixedDecimal minQty = table.minQty(id);
+		FixedDecimal minNotional = table.minNotional(id);
+		data.tickMantissa = tickSize.mantissa;
+		data.tickScale = data.has(SymbolField::TickSize) ? tickSize.scale : FixedDecimal::kEmpty;
+		data.stepMantissa = stepSize.mantissa;
+		data.stepScale = data.has(SymbolField::StepSize) ? stepSize.scale : FixedDecimal::kEmpty;
+		data.minQtyMantissa = minQty.mantissa;
+		data.minQtyScale = data.has(SymbolField::MinQty) ? minQty.scale : FixedDecimal::kEmpty;
+		data.minNotionalMantissa = minNotional.mantissa;
+		data.minNotionalScale = data.has(SymbolField::MinNotional) ? minNotional.scale : FixedDecimal::kEmpty;
+		if (data.has(SymbolField::Status))
+		{
+			data.status = static_cast<uint8_t>(table.status(id));
+			copyText(data.statusText, sizeof(data.statusText), table.statusText(id));
+		}
+		if (data.has(SymbolField::QuoteAsset))
+		{
+			copyText(data.quoteAsset, sizeof(data.quoteAsset), table.quoteAssetText(id));
+		}
+		if (data.has(SymbolField::BaseAsset))
+		{
+			copyText(data.baseAsset, sizeof(data.baseAsset), table.baseAssetText(id));
+		}
+		if (data.has(SymbolField::ContractType))
+		{
+			copyText(data.contractType, sizeof(data.contractType), table.contractTypeText(id));
+		}
+		return data;
+	}
+}
+
+SharedSymbolPublisher::SharedSymbolPublisher(const std::string &name, uint32_t capacity)
+	: name(name), capacity(capacity), mappedSize(SharedSymbolSegment::bytesFor(capacity)), writtenVersion(capacity, 0)
+{
+	// A segment left by an earlier run may still be mapped by readers: tell them, then start a new one
+	int previous = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+	if (previous >= 0)
+	{
+		struct stat status;
+		if (::fstat(previous, &status) == 0 && static_cast<std::size_t>(status.st_size) >= sizeof(SharedSymbolHeader))
+		{
+			void *old = ::mmap(nullptr, sizeof(SharedSymbolHeader), PROT_READ | PROT_WRITE, MAP_SHARED, previous, 0);
+			if (old != MAP_FAILED)
+			{
+				static_cast<SharedSymbolHeader *>(old)->retired.store(1, std::memory_order_release);
+				::munmap(old, sizeof(SharedSymbolHeader));
+			}
+		}
+		::close(previous);
+		::shm_unlink(name.c_str());
+	}
+
+	int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		throw std::runtime_error("shm_open " + name + ": " + std::strerror(errno));
+	}
+	if (::ftruncate(fd, static_cast<off_t>(mappedSize)) != 0)
+	{
+		int error = errno;
+		::close(fd);
+		::shm_unlink(name.c_str());
+		throw std::runtime_error("ftruncate " + name + ": " + std::strerror(error));
+	}
+	mapping = ::mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	int error = errno;
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		mapping = nullptr;
+		::shm_unlink(name.c_str());
+		throw std::runtime_error("mmap " + name + ": " + std::strerror(error));
+	}
+
+	// The segment starts zeroed: no rows, empty index. The magic goes in last so a reader opening the
+	// segment this early refuses it instead of reading a half-written header.
+	SharedSymbolHeader &header = SharedSymbolSegment(mapping).header();
+	header.layoutVersion = kSharedSymbolLayoutVersion;
+	header.capacity = capacity;
+	header.indexSlots = SharedSymbolSegment::indexSlotsFor(capacity);
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(header.magic, kSharedSymbolMagic, sizeof(header.magic));
+	logger->info("Publishing the symbol table in shared memory {} ({} symbols, {} bytes).", name, capacity, mappedSize);
+}
+
+SharedSymbolPublisher::~SharedSymbolPublisher()
+{
+	if (mapping)
+	{
+		SharedSymbolSegment(mapping).header().retired.store(1, std::memory_order_release);
+		::munmap(mapping, mappedSize);
+		::shm_unlink(name.c_str());
+	}
+}
+
+std::size_t SharedSymbolPublisher::rowCount() const
+{
+	return SharedSymbolSegment(mapping).header().rowCount.load(std::memory_order_relaxed);
+}
+
+void SharedSymbolPublisher::publishAll(const SymbolSnapshot &snapshot)
+{
+	SharedSymbolSegment segment(mapping);
+	std::vector<bool> seen(capacity, false);
+	snapshot.forEach([&](const std::string &symbol, SymbolSnapshot::Row row)
+					 {
+						 uint32_t slot = writeRow(row.table->market(row.id), symbol, row);
+						 if (slot != SharedSymbolSegment::npos)
+						 {
+							 seen[slot] = true;
+						 } });
+	// Whatever the snapshot no longer has is deleted
+	uint32_t rows = segment.header().rowCount.load(std::memory_order_relaxed);
+	for (uint32_t slot = 0; slot < rows; ++slot)
+	{
+		if (!seen[slot] && writtenVersion[slot] != 0)
+		{
+			const SharedSymbolRecord &record = segment.record(slot);
+			writeRow(record.market, std::string(record.name, record.nameLength), SymbolSnapshot::Row());
+		}
+	}
+	segment.header().publishCount.fetch_add(1, std::memory_order_release);
+}
+
+void SharedSymbolPublisher::publish(const SymbolSnapshot &snapshot, const std::vector<SymbolKey> &changed)
+{
+	for (const SymbolKey &key : changed)
+	{
+		writeRow(key.market, key.symbol, snapshot.find(key.symbol, key.market));
+	}
+	SharedSymbolSegment(mapping).header().publishCount.fetch_add(1, std::memory_order_release);
+}
+
+uint32_t SharedSymbolPublisher::writeRow(MarketId market, const std::string &symbol, SymbolSnapshot::Row row)
+{
+	SharedSymbolSegment segment(mapping);
+	SharedSymbolHeader &header = segment.header();
+	uint32_t slot = segment.find(symbol.data(), symbol.size(), market);
+	if (slot == SharedSymbolSegment::npos)
+	{
+		if (!row)
+		{
+			// Never published, nothing to delete
+			return slot;
+		}
+		uint32_t rows = header.rowCount.load(std::memory_order_relaxed);
+		if (rows == capacity || symbol.size() > kSharedSymbolMaxName)
+		{
+			if (symbol.size() > kSharedSymbolMaxName || !reportedFull)
+			{
+				logger->error("Shared memory {}: no room for symbol {} ({} of {} slots used, names up to {} bytes).", name, symbol, rows, capacity, kSharedSymbolMaxName);
+				reportedFull = reportedFull || rows == capacity;
+			}
+			return SharedSymbolSegment::npos;
+		}
+		// Name first, then the index entry that makes it findable
+		slot = rows;
+		SharedSymbolRecord &record = segment.record(slot);
+		record.market = market;
+		record.nameLength = static_cast<uint8_t>(symbol.size());
+		std::memcpy(record.name, symbol.data(), symbol.size());
+		uint32_t mask = header.indexSlots - 1;
+		uint32_t position = SharedSymbolSegment::hash(symbol.data(), symbol.size(), market) & mask;
+		while (segment.indexEntry(position).load(std::memory_order_relaxed) != 0)
+		{
+			position = (position + 1) & mask;
+		}
+		segment.indexEntry(position).store(slot + 1, std::memory_order_release);
+		header.rowCount.store(rows + 1, std::memory_order_release);
+	}
+
+	uint64_t version = row ? row.table->version(row.id) : 0;
+	if (version == writtenVersion[slot])
+	{
+		return slot;
+	}
+	SharedSymbolData data = {};
+	if (row)
+	{
+		data = recordData(*row.table, row.id);
+	}
+	uint64_t words[sizeof(SharedSymbolData) / sizeof(uint64_t)];
+	std::memcpy(words, &data, sizeof(data));
+
+	// Seqlock write: odd sequence, data, even sequence
+	SharedSymbolRecord &record = segment.record(slot);
+	uint32_t sequence = record.sequence.load(std::memory_order_relaxed);
+	record.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (std::size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i)
+	{
+		record.words[i].store(words[i], std::memory_order_relaxed);
+	}
+	record.sequence.store(sequence + 2, std::memory_order_release);
+	writtenVersion[slot] = version;
+	return slot;
+}
+
+bool JSONParser::setSharedMemory(const std::string &name, uint32_t capacity)
+{
+	std::lock_guard<std::mutex> lock(writeMutex);
+	sharedTable.reset();
+	if (name.empty())
+	{
+		return true;
+	}
+	try
+	{
+		sharedTable = std::make_unique<SharedSymbolPublisher>(name, capacity);
+		sharedTable->publishAll(*snapshot());
+		return true;
+	}
+	catch (std::exception const &e)
+	{
+		logger->error("Error: {}", e.what());
+		sharedTable.reset();
+		return false;
+	}
+}
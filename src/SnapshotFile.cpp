@@ -0,0 +1,294 @@
+#include "BinanceHandler.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace
+{
+	constexpr char kSnapshotMagic[8] = {'B', 'N', 'S', 'N', 'A', 'P', '\0', '\0'};
+	// Bump whenever SymbolTable::serialize() or the payload below changes shape
+	constexpr uint32_t kSnapshotFormatVersion = 2;
+	// Written as is; a file from a host of the other byte order reads back swapped and is refused
+	constexpr uint32_t kByteOrderMark = 0x01020304;
+
+	// Fixed-size and a multiple of 8, so the payload, and every column in it, stays 8-byte aligned
+	struct SnapshotHeader
+	{
+		char magic[8];
+		uint32_t formatVersion;
+		uint32_t byteOrder;
+		uint64_t payloadSize;
+		uint32_t payloadCrc;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(SnapshotHeader) == 32, "snapshot header layout");
+
+	uint32_t checksum(const char *data, std::size_t size)
+	{
+		uLong crc = ::crc32(0L, Z_NULL, 0);
+		// zlib takes uInt lengths, feed it in pieces below 4 GiB
+		while (size > 0)
+		{
+			uInt piece = static_cast<uInt>(std::min<std::size_t>(size, 1u << 30));
+			crc = ::crc32(crc, reinterpret_cast<const Bytef *>(data), piece);
+			data += piece;
+			size -= piece;
+		}
+		return static_cast<uint32_t>(crc);
+	}
+
+	bool writeAll(int fd, const char *data, std::size_t size)
+	{
+		while (size > 0)
+		{
+			ssize_t count = ::write(fd, data, size);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				return false;
+			}
+			data += count;
+			size -= static_cast<std::size_t>(count);
+		}
+		return true;
+	}
+}
+
+bool JSONParser::saveSnapshot(const std::string &path)
+{
+	return writeSnapshot(path);
+}
+
+void JSONParser::setSnapshotFile(const std::string &path, std::chrono::milliseconds minInterval)
+{
+	{
+		std::lock_guard<std::mutex> wakeLock(snapshotMutex);
+		snapshotInterval = minInterval;
+	}
+	std::lock_guard<std::mutex> lock(writeMutex);
+	snapshotFile = path;
+	if (!path.empty() && !snapshotThread.joinable())
+	{
+		snapshotThread = std::thread([this]
+									 { snapshotLoop(); });
+	}
+}
+
+void JSONParser::markSnapshotDirty()
+{
+	if (snapshotFile.empty())
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> wakeLock(snapshotMutex);
+		snapshotDirty = true;
+	}
+	snapshotWake.notify_one();
+}
+
+void JSONParser::snapshotLoop()
+{
+	std::chrono::steady_clock::time_point lastWrite;
+	std::unique_lock<std::mutex> wakeLock(snapshotMutex);
+	while (true)
+	{
+		snapshotWake.wait(wakeLock, [this]
+						  { return snapshotDirty || snapshotStopping; });
+		if (!snapshotDirty)
+		{
+			return;
+		}
+		// Changes arriving until the interval is up go into the same write; shutdown writes at once
+		snapshotWake.wait_until(wakeLock, lastWrite + snapshotInterval, [this]
+								{ return snapshotStopping; });
+		snapshotDirty = false;
+		wakeLock.unlock();
+
+		std::string path;
+		{
+			std::lock_guard<std::mutex> lock(writeMutex);
+			path = snapshotFile;
+		}
+		if (!path.empty())
+		{
+			writeSnapshot(path);
+		}
+		lastWrite = std::chrono::steady_clock::now();
+		wakeLock.lock();
+	}
+}
+
+JSONParser::~JSONParser()
+{
+	{
+		std::lock_guard<std::mutex> wakeLock(snapshotMutex);
+		snapshotStopping = true;
+	}
+	snapshotWake.notify_one();
+	if (snapshotThread.joinable())
+	{
+		snapshotThread.join();
+	}
+}
+
+bool JSONParser::writeSnapshot(const std::string &path)
+{
+	// The copy is all that happens under the lock; serializing, the checksum and the file I/O do not hold
+	// up parses, UPDATEs or stream events
+	SymbolTable table;
+	std::vector<std::string> markets;
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		table = exchangeTable;
+		markets = marketNames;
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	std::string file(sizeof(SnapshotHeader), '\0');
+
+	// Payload: market names, padded to 8 bytes, then the table
+	uint32_t marketCount = static_cast<uint32_t>(markets.size());
+	file.append(reinterpret_cast<const char *>(&marketCount), sizeof(marketCount));
+	for (const std::string &name : markets)
+	{
+		uint32_t length = static_cast<uint32_t>(name.size());
+		file.append(reinterpret_cast<const char *>(&length), sizeof(length));
+		file.append(name);
+	}
+	file.append((8 - file.size() % 8) % 8, '\0');
+	table.serialize(file);
+
+	SnapshotHeader header = {};
+	std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+	header.formatVersion = kSnapshotFormatVersion;
+	header.byteOrder = kByteOrderMark;
+	header.payloadSize = file.size() - sizeof(SnapshotHeader);
+	header.payloadCrc = checksum(file.data() + sizeof(SnapshotHeader), header.payloadSize);
+	std::memcpy(&file[0], &header, sizeof(header));
+
+	// Written next to the target and renamed over it, so a reader never maps a half-written file
+	std::string temporary = path + ".tmp";
+	int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		logger->error("Error writing snapshot {}: {}", temporary, std::strerror(errno));
+		return false;
+	}
+	bool written = writeAll(fd, file.data(), file.size()) && ::fsync(fd) == 0;
+	int error = errno;
+	::close(fd);
+	if (!written || ::rename(temporary.c_str(), path.c_str()) != 0)
+	{
+		logger->error("Error writing snapshot {}: {}", path, std::strerror(written ? errno : error));
+		::unlink(temporary.c_str());
+		return false;
+	}
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+	logger->info("Saved snapshot {} with {} symbols in {} bytes ({} us).", path, table.size(), file.size(), elapsed.count());
+	return true;
+}
+
+bool JSONParser::loadSnapshot(const std::string &path)
+{
+	try
+	{
+		auto started = std::chrono::steady_clock::now();
+		MappedFile file;
+		if (!file.open(path))
+		{
+			logger->warn("No snapshot loaded from {}: {}", path, std::strerror(errno));
+			return false;
+		}
+
+		SnapshotHeader header;
+		if (file.size() < sizeof(header))
+		{
+			logger->error("Snapshot {} is truncated.", path);
+			return false;
+		}
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0)
+		{
+			logger->error("{} is not a snapshot file.", path);
+			return false;
+		}
+		if (header.byteOrder != kByteOrderMark || header.formatVersion != kSnapshotFormatVersion)
+		{
+			logger->error("Snapshot {} has format version {} and byte order {:#x}, expected version {}; ignoring it.", path, header.formatVersion, header.byteOrder, kSnapshotFormatVersion);
+			return false;
+		}
+		const char *payload = file.data() + sizeof(header);
+		if (header.payloadSize != file.size() - sizeof(header) || checksum(payload, header.payloadSize) != header.payloadCrc)
+		{
+			logger->error("Snapshot {} is truncated or corrupt (checksum mismatch).", path);
+			return false;
+		}
+
+		// Market ids are this process's; the snapshot's are translated by name
+		const char *at = payload;
+		const char *end = payload + header.payloadSize;
+		uint32_t markets;
+		std::vector<std::string> names;
+		bool read = end - at >= static_cast<std::ptrdiff_t>(sizeof(markets));
+		if (read)
+		{
+			std::memcpy(&markets, at, sizeof(markets));
+			at += sizeof(markets);
+		}
+		for (uint32_t i = 0; read && i < markets; ++i)
+		{
+			uint32_t length = 0;
+			read = end - at >= static_cast<std::ptrdiff_t>(sizeof(length));
+			if (read)
+			{
+				std::memcpy(&length, at, sizeof(length));
+				at += sizeof(length);
+				read = static_cast<std::size_t>(end - at) >= length;
+			}
+			if (read)
+			{
+				names.emplace_back(at, length);
+				at += length;
+			}
+		}
+		std::size_t tableOffset = (static_cast<std::size_t>(at - file.data()) + 7) / 8 * 8;
+		SymbolTable table;
+		std::vector<MarketId> marketIds;
+		if (read && tableOffset <= file.size())
+		{
+			for (const std::string &name : names)
+			{
+				marketIds.push_back(addMarket(name));
+			}
+			read = table.deserialize(file.data() + tableOffset, file.size() - tableOffset, marketIds);
+		}
+		if (!read)
+		{
+			logger->error("Snapshot {} passed its checksum but its contents are inconsistent; ignoring it.", path);
+			return false;
+		}
+
+		std::size_t symbols = table.size();
+		{
+			std::lock_guard<std::mutex> lock(writeMutex);
+			exchangeTable = table;
+			localOverrides.clear();
+			publish(std::make_shared<const SymbolSnapshot>(std::move(table)));
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+		logger->info("Loaded snapshot {} with {} symbols of {} markets in {} us.", path, symbols, names.size(), elapsed.count());
+		return true;
+	}
+	catch (std::exception const &e)
+	{
+		logger->error("Error: {}", e.what());
+		return false;
+	}
+}
@@ -0,0 +1,134 @@
+#include "SymbolSnapshot.h"
+#include <algorithm>
+
+SymbolSnapshot::SymbolSnapshot()
+	: base(std::make_shared<SymbolTable>()), delta(std::make_shared<SymbolTable>())
+{
+}
+
+SymbolSnapshot::SymbolSnapshot(SymbolTable table)
+	: base(std::make_shared<SymbolTable>(std::move(table))), delta(std::make_shared<SymbolTable>()), liveCount(base->size())
+{
+}
+
+SymbolSnapshot::SymbolSnapshot(std::shared_ptr<const SymbolTable> base, std::shared_ptr<const SymbolTable> delta, std::size_t liveCount)
+	: base(std::move(base)), delta(std::move(delta)), liveCount(liveCount)
+{
+}
+
+SymbolSnapshot::Row SymbolSnapshot::find(const std::string &symbol, MarketId market) const
+{
+	// The delta overrides the base, including symbols it has deleted
+	if (delta->rowCount() > 0)
+	{
+		SymbolTable::SymbolId id = delta->findRow(symbol, market);
+		if (id != SymbolTable::npos)
+		{
+			return delta->isLive(id) ? Row{delta.get(), id} : Row{};
+		}
+	}
+	SymbolTable::SymbolId id = base->find(symbol, market);
+	return id != SymbolTable::npos ? Row{base.get(), id} : Row{};
+}
+
+std::unordered_map<std::string, std::string> SymbolSnapshot::toMap(const std::string &symbol, MarketId market) const
+{
+	Row row = find(symbol, market);
+	return row ? row.table->toMap(row.id) : std::unordered_map<std::string, std::string>();
+}
+
+void SymbolSnapshot::forEach(const std::function<void(const std::string &symbol, Row row)> &visit) const
+{
+	for (SymbolTable::SymbolId id = 0; id < base->rowCount(); ++id)
+	{
+		if (base->isLive(id))
+		{
+			std::string symbol = base->name(id);
+			if (delta->findRow(symbol, base->market(id)) == SymbolTable::npos)
+			{
+				visit(symbol, Row{base.get(), id});
+			}
+		}
+	}
+	for (SymbolTable::SymbolId id = 0; id < delta->rowCount(); ++id)
+	{
+		if (delta->isLive(id))
+		{
+			visit(delta->name(id), Row{delta.get(), id});
+		}
+	}
+}
+
+std::shared_ptr<const SymbolSnapshot> SymbolSnapshot::withEdit(const SymbolKey &key, const RowEdit &edit) const
+{
+	return withEdits({key}, edit);
+}
+
+std::shared_ptr<const SymbolSnapshot> SymbolSnapshot::withEdits(const std::vector<SymbolKey> &keys, const RowEdit &edit) const
+{
+	const std::size_t deltaLimit = std::max(kMinDeltaRows, base->rowCount() / kDeltaFraction);
+	if (delta->rowCount() + keys.size() > deltaLimit)
+	{
+		// Too many rows for the delta (a full load, a large refresh): edit a merged copy instead
+		SymbolTable merged = compacted();
+		for (const SymbolKey &key : keys)
+		{
+			SymbolTable::SymbolId id = merged.find(key.symbol, key.market);
+			edit(merged, id != SymbolTable::npos ? id : merged.insert(key.symbol, key.market));
+		}
+		return std::make_shared<const SymbolSnapshot>(std::move(merged));
+	}
+
+	auto nextDelta = std::make_shared<SymbolTable>(*delta);
+	std::size_t nextLive = liveCount;
+	for (const SymbolKey &key : keys)
+	{
+		// A row already in the delta decides the symbol's state, otherwise the base does
+		SymbolTable::SymbolId id = nextDelta->findRow(key.symbol, key.market);
+		bool wasLive;
+		if (id != SymbolTable::npos)
+		{
+			wasLive = nextDelta->isLive(id);
+			if (!wasLive)
+			{
+				nextDelta->insert(key.symbol, key.market);
+			}
+		}
+		else
+		{
+			SymbolTable::SymbolId baseId = base->find(key.symbol, key.market);
+			wasLive = baseId != SymbolTable::npos;
+			id = nextDelta->insert(key.symbol, key.market);
+			if (wasLive)
+			{
+				nextDelta->copyRow(id, *base, baseId);
+			}
+		}
+		edit(*nextDelta, id);
+		nextLive = nextLive - (wasLive ? 1 : 0) + (nextDelta->isLive(id) ? 1 : 0);
+	}
+	return std::shared_ptr<const SymbolSnapshot>(new SymbolSnapshot(base, std::move(nextDelta), nextLive));
+}
+
+SymbolTable SymbolSnapshot::compacted() const
+{
+	SymbolTable merged(*base);
+	for (SymbolTable::SymbolId id = 0; id < delta->rowCount(); ++id)
+	{
+		std::string symbol = delta->name(id);
+		if (delta->isLive(id))
+		{
+			merged.copyRow(merged.insert(symbol, delta->market(id)), *delta, id);
+		}
+		else
+		{
+			merged.erase(symbol, delta->market(id));
+		}
+	}
+	return merged;
+}
+
+std::size_t SymbolSnapshot::memoryUsage() const
+{
+	return sizeof(*this) + base->memoryUsage() + delta->memoryUsage();
+}
@@ -0,0 +1,826 @@
+#include "SymbolTable.h"
+#include "FieldRegistry.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+	const int64_t kPowersOfTen[] = {
+		1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL, 1000000000LL,
+		10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL, 100000000000000LL,
+		1000000000000000LL, 10000000000000000LL, 100000000000000000LL, 1000000000000000000LL};
+
+	std::vector<std::string> statusSeed()
+	{
+		return {"PRE_TRADING", "TRADING", "POST_TRADING", "END_OF_DAY", "HALT", "AUCTION_MATCH", "BREAK",
+				"PENDING_TRADING", "DELIVERING", "DELIVERED", "PRE_DELIVERING", "SETTLING", "CLOSE"};
+	}
+
+	std::vector<std::string> quoteSeed()
+	{
+		return {"USDT", "BTC", "ETH", "BNB", "BUSD", "USDC", "FDUSD", "TUSD", "USD", "EUR", "TRY"};
+	}
+
+	std::vector<std::string> contractTypeSeed()
+	{
+		return {"PERPETUAL", "CURRENT_QUARTER", "NEXT_QUARTER", "CURRENT_MONTH", "NEXT_MONTH", "PERPETUAL_DELIVERING"};
+	}
+
+	// Shared by every table, so a version is never handed out twice in the process
+	uint64_t nextVersion()
+	{
+		static std::atomic<uint64_t> lastVersion{0};
+		return lastVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	// Snapshot layout helpers. Values are written in host byte order; the file header records it.
+	void alignTo8(std::string &out, std::size_t start)
+	{
+		out.append((8 - (out.size() - start) % 8) % 8, '\0');
+	}
+
+	template <typename T>
+	void appendColumn(std::string &out, std::size_t start, const std::vector<T> &column)
+	{
+		uint64_t count = column.size();
+		out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+		out.append(reinterpret_cast<const char *>(column.data()), column.size() * sizeof(T));
+		alignTo8(out, start);
+	}
+
+	template <typename Code>
+	void appendDictionary(std::string &out, std::size_t start, const StringDictionary<Code> &dictionary)
+	{
+		uint64_t count = dictionary.size();
+		out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+		for (std::size_t code = 0; code < dictionary.size(); ++code)
+		{
+			const std::string &text = dictionary.text(static_cast<Code>(code));
+			// Values come from UPDATEs as well, which put no limit on their length
+			uint32_t length = static_cast<uint32_t>(text.size());
+			out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+			out.append(text, 0, length);
+		}
+		alignTo8(out, start);
+	}
+
+	// Bounds-checked cursor over serialize() output; every read fails once the data runs out
+	class SnapshotReader
+	{
+	public:
+		SnapshotReader(const char *data, std::size_t size) : start(data), at(data), end(data + size) {}
+
+		template <typename T>
+		bool column(std::vector<T> &values, std::size_t expected)
+		{
+			uint64_t count;
+			if (!pod(count) || count != expected || static_cast<std::size_t>(end - at) / sizeof(T) < count)
+			{
+				return false;
+			}
+			values.resize(count);
+			std::memcpy(values.data(), at, count * sizeof(T));
+			at += count * sizeof(T);
+			return align();
+		}
+
+		bool bytes(std::string &text, std::size_t size)
+		{
+			if (static_cast<std::size_t>(end - at) < size)
+			{
+				return false;
+			}
+			text.assign(at, size);
+			at += size;
+			return true;
+		}
+
+		bool dictionary(std::vector<std::string> &names)
+		{
+			uint64_t count;
+			if (!pod(count) || count > static_cast<std::size_t>(end - at))
+			{
+				return false;
+			}
+			names.resize(count);
+			for (std::string &text : names)
+			{
+				uint32_t length;
+				if (!pod(length) || !bytes(text, length))
+				{
+					return false;
+				}
+			}
+			return align();
+		}
+
+		template <typename T>
+		bool pod(T &value)
+		{
+			if (static_cast<std::size_t>(end - at) < sizeof(T))
+			{
+				return false;
+			}
+			std::memcpy(&value, at, sizeof(T));
+			at += sizeof(T);
+			return true;
+		}
+
+		bool align()
+		{
+			std::size_t padding = (8 - static_cast<std::size_t>(at - start) % 8) % 8;
+			if (static_cast<std::size_t>(end - at) < padding)
+			{
+				return false;
+			}
+			at += padding;
+			return true;
+		}
+
+	private:
+		const char *start;
+		const char *at;
+		const char *end;
+	};
+
+	bool validScale(uint8_t scale)
+	{
+		return scale <= FixedDecimal::kMaxScale || scale == FixedDecimal::kEmpty;
+	}
+
+	template <typename Code>
+	bool codesBelow(const std::vector<Code> &codes, std::size_t limit)
+	{
+		return std::all_of(codes.begin(), codes.end(), [limit](Code code)
+						   { return code < limit; });
+	}
+}
+
+bool FixedDecimal::parse(const char *text, std::size_t length, FixedDecimal &out)
+{
+	if (length == 0)
+	{
+		out = FixedDecimal{};
+		return true;
+	}
+
+	std::size_t i = 0;
+	bool negative = text[0] == '-';
+	if (negative)
+	{
+		++i;
+	}
+
+	int64_t mantissa = 0;
+	int digits = 0;
+	int scale = -1;
+	for (; i < length; ++i)
+	{
+		char c = text[i];
+		if (c == '.' && scale < 0)
+		{
+			scale = 0;
+			continue;
+		}
+		if (c < '0' || c > '9' || digits >= 18)
+		{
+			return false;
+		}
+		mantissa = mantissa * 10 + (c - '0');
+		++digits;
+		if (scale >= 0)
+		{
+			++scale;
+		}
+	}
+
+	if (digits == 0 || scale == 0 || scale > kMaxScale)
+	{
+		return false; // "-", ".", "1." and friends
+	}
+
+	out.mantissa = negative ? -mantissa : mantissa;
+	out.scale = static_cast<uint8_t>(scale < 0 ? 0 : scale);
+	return true;
+}
+
+bool FixedDecimal::toScale(uint8_t targetScale, int64_t &out) const
+{
+	if (empty() || targetScale > kMaxScale)
+	{
+		return false;
+	}
+	if (scale > targetScale)
+	{
+		int64_t dropped = kPowersOfTen[scale - targetScale];
+		if (mantissa % dropped != 0)
+		{
+			return false;
+		}
+		out = mantissa / dropped;
+		return true;
+	}
+	return !__builtin_mul_overflow(mantissa, kPowersOfTen[targetScale - scale], &out);
+}
+
+std::string FixedDecimal::toString() const
+{
+	if (empty())
+	{
+		return "";
+	}
+
+	uint64_t magnitude = mantissa < 0 ? 0 - static_cast<uint64_t>(mantissa) : static_cast<uint64_t>(mantissa);
+	std::string digits = std::to_string(magnitude);
+	if (digits.size() <= scale)
+	{
+		digits.insert(0, scale + 1 - digits.size(), '0');
+	}
+	if (scale > 0)
+	{
+		digits.insert(digits.size() - scale, 1, '.');
+	}
+	if (mantissa < 0)
+	{
+		digits.insert(0, 1, '-');
+	}
+	return digits;
+}
+
+const char *symbolFieldName(SymbolField field)
+{
+	return FieldRegistry::spec(field).name;
+}
+
+bool symbolFieldFromName(const std::string &name, SymbolField &field)
+{
+	return FieldRegistry::find(name.data(), name.size(), field);
+}
+
+bool symbolFieldFromQueryName(const char *name, std::size_t length, SymbolField &field)
+{
+	return FieldRegistry::findLoose(name, length, field);
+}
+
+template <typename Code>
+StringDictionary<Code>::StringDictionary(std::vector<std::string> seed)
+{
+	for (const auto &text : seed)
+	{
+		intern(text);
+	}
+}
+
+template <typename Code>
+Code StringDictionary<Code>::intern(const std::string &text)
+{
+	auto it = codes.find(text);
+	if (it != codes.end())
+	{
+		return it->second;
+	}
+	if (names.size() > std::numeric_limits<Code>::max())
+	{
+		throw std::length_error("Too many distinct values for dictionary column");
+	}
+	Code code = static_cast<Code>(names.size());
+	names.push_back(text);
+	codes.emplace(text, code);
+	return code;
+}
+
+template <typename Code>
+std::size_t StringDictionary<Code>::memoryUsage() const
+{
+	std::size_t bytes = names.capacity() * sizeof(std::string) + codes.bucket_count() * sizeof(void *) +
+						codes.size() * (sizeof(std::pair<const std::string, Code>) + 2 * sizeof(void *));
+	for (const auto &text : names)
+	{
+		if (text.capacity() > 15)
+		{
+			bytes += 2 * (text.capacity() + 1); // key copy in the map as well
+		}
+	}
+	return bytes;
+}
+
+template class StringDictionary<uint8_t>;
+template class StringDictionary<uint16_t>;
+
+SymbolTable::SymbolTable()
+	: slots(64, npos), statusNames(statusSeed()), quoteNames(quoteSeed()), baseNames(quoteSeed()), contractNames(contractTypeSeed())
+{
+}
+
+uint32_t SymbolTable::hashName(const char *symbol, std::size_t length, MarketId market)
+{
+	// FNV-1a over the market byte and the name, symbols are short upper-case ASCII
+	uint32_t hash = (2166136261u ^ market) * 16777619u;
+	for (std::size_t i = 0; i < length; ++i)
+	{
+		hash ^= static_cast<unsigned char>(symbol[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+bool SymbolTable::rowIs(SymbolId id, const char *symbol, std::size_t length, MarketId market) const
+{
+	return marketOf[id] == market && nameLength[id] == length && std::memcmp(namePool.data() + nameOffset[id], symbol, length) == 0;
+}
+
+SymbolTable::SymbolId SymbolTable::find(const std::string &symbol, MarketId market) const
+{
+	return find(symbol.data(), symbol.size(), market);
+}
+
+SymbolTable::SymbolId SymbolTable::find(const char *symbol, std::size_t length, MarketId market) const
+{
+	SymbolId id = findRow(symbol, length, market);
+	return (id != npos && (flags[id] & kLive)) ? id : npos;
+}
+
+SymbolTable::SymbolId SymbolTable::findRow(const std::string &symbol, MarketId market) const
+{
+	return findRow(symbol.data(), symbol.size(), market);
+}
+
+SymbolTable::SymbolId SymbolTable::findRow(const char *symbol, std::size_t length, MarketId market) const
+{
+	const std::size_t mask = slots.size() - 1;
+	for (std::size_t slot = hashName(symbol, length, market) & mask;; slot = (slot + 1) & mask)
+	{
+		SymbolId id = slots[slot];
+		if (id == npos || rowIs(id, symbol, length, market))
+		{
+			return id;
+		}
+	}
+}
+
+void SymbolTable::growIndex()
+{
+	buildIndex(slots.size() * 2);
+}
+
+void SymbolTable::buildIndex(std::size_t slotCount)
+{
+	std::vector<SymbolId> grown(slotCount, npos);
+	const std::size_t mask = grown.size() - 1;
+	for (SymbolId id = 0; id < rowCount(); ++id)
+	{
+		std::size_t slot = hashName(namePool.data() + nameOffset[id], nameLength[id], marketOf[id]) & mask;
+		while (grown[slot] != npos)
+		{
+			slot = (slot + 1) & mask;
+		}
+		grown[slot] = id;
+	}
+	slots.swap(grown);
+}
+
+SymbolTable::SymbolId SymbolTable::insert(const std::string &symbol, MarketId market)
+{
+	if (symbol.size() > std::numeric_limits<uint8_t>::max())
+	{
+		throw std::length_error("Symbol name too long: " + symbol);
+	}
+
+	const std::size_t mask = slots.size() - 1;
+	std::size_t slot = hashName(symbol.data(), symbol.size(), market) & mask;
+	for (; slots[slot] != npos; slot = (slot + 1) & mask)
+	{
+		SymbolId id = slots[slot];
+		if (rowIs(id, symbol.data(), symbol.size(), market))
+		{
+			if (!(flags[id] & kLive))
+			{
+				++liveCount;
+			}
+			flags[id] = kLive;
+			versionOf[id] = nextVersion();
+			return id;
+		}
+	}
+
+	SymbolId id = static_cast<SymbolId>(rowCount());
+	slots[slot] = id;
+	nameOffset.push_back(static_cast<uint32_t>(namePool.size()));
+	nameLength.push_back(static_cast<uint8_t>(symbol.size()));
+	namePool.append(symbol);
+	marketOf.push_back(market);
+
+	flags.push_back(kLive);
+	versionOf.push_back(nextVersion());
+	statusCode.push_back(0);
+	quoteCode.push_back(0);
+	tickMantissa.push_back(0);
+	tickScale.push_back(FixedDecimal::kEmpty);
+	stepMantissa.push_back(0);
+	stepScale.push_back(FixedDecimal::kEmpty);
+	baseCode.push_back(0);
+	contractCode.push_back(0);
+	minQtyMantissa.push_back(0);
+	minQtyScale.push_back(FixedDecimal::kEmpty);
+	minNotionalMantissa.push_back(0);
+	minNotionalScale.push_back(FixedDecimal::kEmpty);
+	++liveCount;
+
+	// Keep the load factor at or below one half
+	if (rowCount() * 2 > slots.size())
+	{
+		growIndex();
+	}
+	return id;
+}
+
+bool SymbolTable::erase(const std::string &symbol, MarketId market)
+{
+	SymbolId id = find(symbol, market);
+	if (id == npos)
+	{
+		return false;
+	}
+	flags[id] = 0;
+	versionOf[id] = nextVersion();
+	--liveCount;
+	return true;
+}
+
+void SymbolTable::clear()
+{
+	*this = SymbolTable();
+}
+
+std::string SymbolTable::name(SymbolId id) const
+{
+	return namePool.substr(nameOffset[id], nameLength[id]);
+}
+
+void SymbolTable::setStatus(SymbolId id, const std::string &status)
+{
+	statusCode[id] = statusNames.intern(status);
+	flags[id] |= symbolFieldBit(SymbolField::Status);
+	versionOf[id] = nextVersion();
+}
+
+void SymbolTable::setQuoteAsset(SymbolId id, const std::string &quoteAsset)
+{
+	quoteCode[id] = quoteNames.intern(quoteAsset);
+	flags[id] |= symbolFieldBit(SymbolField::QuoteAsset);
+	versionOf[id] = nextVersion();
+}
+
+void SymbolTable::setTickSize(SymbolId id, const FixedDecimal &tickSize)
+{
+	tickMantissa[id] = tickSize.mantissa;
+	tickScale[id] = tickSize.scale;
+	flags[id] |= symbolFieldBit(SymbolField::TickSize);
+	versionOf[id] = nextVersion();
+}
+
+void SymbolTable::setStepSize(SymbolId id, const FixedDecimal &stepSize)
+{
+	stepMantissa[id] = stepSize.mantissa;
+	stepScale[id] = stepSize.scale;
+	flags[id] |= symbolFieldBit(SymbolField::StepSize);
+	versionOf[id] = nextVersion();
+}
+
+void SymbolTable::setBaseAsset(SymbolId id, const std::string &baseAsset)
+{
+	baseCode[id] = baseNames.intern(baseAsset);
+	flags[id] |= symbolFieldBit(SymbolField::BaseAsset);
+	versionOf[id] = nextVersion();
+}
+
+void SymbolTable::setContractType(SymbolId id, const std::string &contractType)
+{
+	contractCode[id] = contractNames.intern(contractType);
+	flags[id] |= symbolFieldBit(SymbolField::ContractType);
+	versionOf[id] = nextVersion();
+}
+
+void SymbolTable::setMinQty(SymbolId id, const FixedDecimal &minQty)
+{
+	minQtyMantissa[id] = minQty.mantissa;
+	minQtyScale[id] = minQty.scale;
+	flags[id] |= symbolFieldBit(SymbolField::MinQty);
+	versionOf[id] = nextVersion();
+}
+
+void SymbolTable::setMinNotional(SymbolId id, const FixedDecimal &minNotional)
+{
+	minNotionalMantissa[id] = minNotional.mantissa;
+	minNotionalScale[id] = minNotional.scale;
+	flags[id] |= symbolFieldBit(SymbolField::MinNotional);
+	versionOf[id] = nextVersion();
+}
+
+bool SymbolTable::setField(SymbolId id, const std::string &field, const std::string &value)
+{
+	SymbolField which;
+	return symbolFieldFromName(field, which) && setField(id, which, value);
+}
+
+bool SymbolTable::setField(SymbolId id, SymbolField field, const std::string &value)
+{
+	FixedDecimal decimal;
+	switch (field)
+	{
+	// A dictionary column that has used all of its codes refuses new values
+	case SymbolField::Status:
+		if (!statusNames.holds(value))
+		{
+			return false;
+		}
+		setStatus(id, value);
+		return true;
+	case SymbolField::QuoteAsset:
+		if (!quoteNames.holds(value))
+		{
+			return false;
+		}
+		setQuoteAsset(id, value);
+		return true;
+	case SymbolField::TickSize:
+		if (!FixedDecimal::parse(value, decimal))
+		{
+			return false;
+		}
+		setTickSize(id, decimal);
+		return true;
+	case SymbolField::StepSize:
+		if (!FixedDecimal::parse(value, decimal))
+		{
+			return false;
+		}
+		setStepSize(id, decimal);
+		return true;
+	case SymbolField::BaseAsset:
+		if (!baseNames.holds(value))
+		{
+			return false;
+		}
+		setBaseAsset(id, value);
+		return true;
+	case SymbolField::ContractType:
+		if (!contractNames.holds(value))
+		{
+			return false;
+		}
+		setContractType(id, value);
+		return true;
+	case SymbolField::MinQty:
+		if (!FixedDecimal::parse(value, decimal))
+		{
+			return false;
+		}
+		setMinQty(id, decimal);
+		return true;
+	case SymbolField::MinNotional:
+		if (!FixedDecimal::parse(value, decimal))
+		{
+			return false;
+		}
+		setMinNotional(id, decimal);
+		return true;
+	default:
+		return false;
+	}
+}
+
+void SymbolTable::copyRow(SymbolId id, const SymbolTable &source, SymbolId sourceId)
+{
+	const RowFlags fieldBits = source.flags[sourceId] & static_cast<RowFlags>(~kLive);
+	flags[id] = static_cast<RowFlags>((flags[id] & kLive) | fieldBits);
+	versionOf[id] = source.versionOf[sourceId];
+	statusCode[id] = statusNames.intern(source.statusText(sourceId));
+	quoteCode[id] = quoteNames.intern(source.quoteAssetText(sourceId));
+	tickMantissa[id] = source.tickMantissa[sourceId];
+	tickScale[id] = source.tickScale[sourceId];
+	stepMantissa[id] = source.stepMantissa[sourceId];
+	stepScale[id] = source.stepScale[sourceId];
+	baseCode[id] = baseNames.intern(source.baseAssetText(sourceId));
+	contractCode[id] = contractNames.intern(source.contractTypeText(sourceId));
+	minQtyMantissa[id] = source.minQtyMantissa[sourceId];
+	minQtyScale[id] = source.minQtyScale[sourceId];
+	minNotionalMantissa[id] = source.minNotionalMantissa[sourceId];
+	minNotionalScale[id] = source.minNotionalScale[sourceId];
+}
+
+bool SymbolTable::sameRow(SymbolId id, const SymbolTable &other, SymbolId otherId) const
+{
+	const RowFlags fieldBits = flags[id] & static_cast<RowFlags>(~kLive);
+	if (fieldBits != (other.flags[otherId] & static_cast<RowFlags>(~kLive)))
+	{
+		return false;
+	}
+	// Absent fields may hold stale values, only present ones are compared
+	return (!hasField(id, SymbolField::Status) || statusText(id) == other.statusText(otherId)) &&
+		   (!hasField(id, SymbolField::QuoteAsset) || quoteAssetText(id) == other.quoteAssetText(otherId)) &&
+		   (!hasField(id, SymbolField::TickSize) || (tickMantissa[id] == other.tickMantissa[otherId] && tickScale[id] == other.tickScale[otherId])) &&
+		   (!hasField(id, SymbolField::StepSize) || (stepMantissa[id] == other.stepMantissa[otherId] && stepScale[id] == other.stepScale[otherId])) &&
+		   (!hasField(id, SymbolField::BaseAsset) || baseAssetText(id) == other.baseAssetText(otherId)) &&
+		   (!hasField(id, SymbolField::ContractType) || contractTypeText(id) == other.contractTypeText(otherId)) &&
+		   (!hasField(id, SymbolField::MinQty) || (minQtyMantissa[id] == other.minQtyMantissa[otherId] && minQtyScale[id] == other.minQtyScale[otherId])) &&
+		   (!hasField(id, SymbolField::MinNotional) || (minNotionalMantissa[id] == other.minNotionalMantissa[otherId] && minNotionalScale[id] == other.minNotionalScale[otherId]));
+}
+
+std::string SymbolTable::fieldText(SymbolId id, SymbolField field) const
+{
+	switch (field)
+	{
+	case SymbolField::Status:
+		return statusText(id);
+	case SymbolField::QuoteAsset:
+		return quoteAssetText(id);
+	case SymbolField::TickSize:
+		return tickSize(id).toString();
+	case SymbolField::StepSize:
+		return stepSize(id).toString();
+	case SymbolField::BaseAsset:
+		return baseAssetText(id);
+	case SymbolField::ContractType:
+		return contractTypeText(id);
+	case SymbolField::MinQty:
+		return minQty(id).toString();
+	case SymbolField::MinNotional:
+		return minNotional(id).toString();
+	default:
+		return "";
+	}
+}
+
+bool SymbolTable::fieldIs(SymbolId id, SymbolField field, const char *value, std::size_t length) const
+{
+	if (!hasField(id, field))
+	{
+		return false;
+	}
+	auto textIs = [value, length](const std::string &text)
+	{
+		return text.size() == length && std::memcmp(text.data(), value, length) == 0;
+	};
+	auto decimalIs = [value, length](const FixedDecimal &decimal)
+	{
+		FixedDecimal parsed;
+		return FixedDecimal::parse(value, length, parsed) && parsed.mantissa == decimal.mantissa && parsed.scale == decimal.scale;
+	};
+	switch (field)
+	{
+	case SymbolField::Status:
+		return textIs(statusText(id));
+	case SymbolField::QuoteAsset:
+		return textIs(quoteAssetText(id));
+	case SymbolField::TickSize:
+		return decimalIs(tickSize(id));
+	case SymbolField::StepSize:
+		return decimalIs(stepSize(id));
+	case SymbolField::BaseAsset:
+		return textIs(baseAssetText(id));
+	case SymbolField::ContractType:
+		return textIs(contractTypeText(id));
+	case SymbolField::MinQty:
+		return decimalIs(minQty(id));
+	case SymbolField::MinNotional:
+		return decimalIs(minNotional(id));
+	default:
+		return false;
+	}
+}
+
+std::unordered_map<std::string, std::string> SymbolTable::toMap(SymbolId id) const
+{
+	std::unordered_map<std::string, std::string> info;
+	if (!isLive(id))
+	{
+		return info;
+	}
+	for (unsigned i = 0; i < static_cast<unsigned>(SymbolField::Count); ++i)
+	{
+		SymbolField field = static_cast<SymbolField>(i);
+		if (hasField(id, field))
+		{
+			info.emplace(symbolFieldName(field), fieldText(id, field));
+		}
+	}
+	return info;
+}
+
+std::size_t SymbolTable::memoryUsage() const
+{
+	return sizeof(*this) + namePool.capacity() + nameOffset.capacity() * sizeof(uint32_t) +
+		   nameLength.capacity() + marketOf.capacity() + slots.capacity() * sizeof(SymbolId) + flags.capacity() * sizeof(RowFlags) + versionOf.capacity() * sizeof(uint64_t) +
+		   statusCode.capacity() + quoteCode.capacity() * sizeof(uint16_t) +
+		   tickMantissa.capacity() * sizeof(int64_t) + tickScale.capacity() +
+		   stepMantissa.capacity() * sizeof(int64_t) + stepScale.capacity() +
+		   baseCode.capacity() * sizeof(uint16_t) + contractCode.capacity() +
+		   minQtyMantissa.capacity() * sizeof(int64_t) + minQtyScale.capacity() +
+		   minNotionalMantissa.capacity() * sizeof(int64_t) + minNotionalScale.capacity() +
+		   statusNames.memoryUsage() + quoteNames.memoryUsage() + baseNames.memoryUsage() + contractNames.memoryUsage();
+}
+
+void SymbolTable::serialize(std::string &out) const
+{
+	const std::size_t start = out.size();
+	uint64_t rows = rowCount();
+	uint64_t poolSize = namePool.size();
+	out.append(reinterpret_cast<const char *>(&rows), sizeof(rows));
+	out.append(reinterpret_cast<const char *>(&poolSize), sizeof(poolSize));
+	out.append(namePool);
+	alignTo8(out, start);
+
+	appendColumn(out, start, nameOffset);
+	appendColumn(out, start, nameLength);
+	appendColumn(out, start, marketOf);
+	appendColumn(out, start, flags);
+	appendColumn(out, start, statusCode);
+	appendColumn(out, start, quoteCode);
+	appendColumn(out, start, tickMantissa);
+	appendColumn(out, start, tickScale);
+	appendColumn(out, start, stepMantissa);
+	appendColumn(out, start, stepScale);
+	appendColumn(out, start, baseCode);
+	appendColumn(out, start, contractCode);
+	appendColumn(out, start, minQtyMantissa);
+	appendColumn(out, start, minQtyScale);
+	appendColumn(out, start, minNotionalMantissa);
+	appendColumn(out, start, minNotionalScale);
+
+	appendDictionary(out, start, statusNames);
+	appendDictionary(out, start, quoteNames);
+	appendDictionary(out, start, baseNames);
+	appendDictionary(out, start, contractNames);
+}
+
+bool SymbolTable::deserialize(const char *data, std::size_t size, const std::vector<MarketId> &markets)
+{
+	clear();
+	SymbolTable table;
+	SnapshotReader reader(data, size);
+	uint64_t rows;
+	uint64_t poolSize;
+	std::vector<std::string> statusList, quoteList, baseList, contractList;
+	bool read = reader.pod(rows) && rows < npos && reader.pod(poolSize) && reader.bytes(table.namePool, poolSize) && reader.align() &&
+				reader.column(table.nameOffset, rows) && reader.column(table.nameLength, rows) && reader.column(table.marketOf, rows) &&
+				reader.column(table.flags, rows) && reader.column(table.statusCode, rows) && reader.column(table.quoteCode, rows) &&
+				reader.column(table.tickMantissa, rows) && reader.column(table.tickScale, rows) &&
+				reader.column(table.stepMantissa, rows) && reader.column(table.stepScale, rows) &&
+				reader.column(table.baseCode, rows) && reader.column(table.contractCode, rows) &&
+				reader.column(table.minQtyMantissa, rows) && reader.column(table.minQtyScale, rows) &&
+				reader.column(table.minNotionalMantissa, rows) && reader.column(table.minNotionalScale, rows) &&
+				reader.dictionary(statusList) && reader.dictionary(quoteList) && reader.dictionary(baseList) && reader.dictionary(contractList);
+	if (!read || statusList.size() > 256 || quoteList.size() > 65536 || baseList.size() > 65536 || contractList.size() > 256)
+	{
+		return false;
+	}
+
+	// Seeding in file order gives every text its code from the file; a repeated text would not
+	table.statusNames = StringDictionary<uint8_t>(statusList);
+	table.quoteNames = StringDictionary<uint16_t>(quoteList);
+	table.baseNames = StringDictionary<uint16_t>(baseList);
+	table.contractNames = StringDictionary<uint8_t>(contractList);
+	if (table.statusNames.size() != statusList.size() || table.quoteNames.size() != quoteList.size() ||
+		table.baseNames.size() != baseList.size() || table.contractNames.size() != contractList.size() ||
+		!codesBelow(table.statusCode, statusList.size()) || !codesBelow(table.quoteCode, quoteList.size()) ||
+		!codesBelow(table.baseCode, baseList.size()) || !codesBelow(table.contractCode, contractList.size()))
+	{
+		return false;
+	}
+
+	const RowFlags knownFlags = kLive | static_cast<RowFlags>((1u << static_cast<unsigned>(SymbolField::Count)) - 1);
+	table.versionOf.resize(rows);
+	for (SymbolId id = 0; id < rows; ++id)
+	{
+		if (static_cast<uint64_t>(table.nameOffset[id]) + table.nameLength[id] > poolSize || table.marketOf[id] >= markets.size() ||
+			(table.flags[id] & ~knownFlags) || !validScale(table.tickScale[id]) || !validScale(table.stepScale[id]) ||
+			!validScale(table.minQtyScale[id]) || !validScale(table.minNotionalScale[id]))
+		{
+			return false;
+		}
+		table.marketOf[id] = markets[table.marketOf[id]];
+		table.versionOf[id] = nextVersion();
+		table.liveCount += (table.flags[id] & kLive) ? 1 : 0;
+	}
+
+	std::size_t slotCount = 64;
+	while (slotCount < rows * 2)
+	{
+		slotCount *= 2;
+	}
+	table.buildIndex(slotCount);
+	// Each (market, name) may appear once, a duplicate would be unreachable
+	for (SymbolId id = 0; id < rows; ++id)
+	{
+		if (table.findRow(table.namePool.data() + table.nameOffset[id], table.nameLength[id], table.marketOf[id]) != id)
+		{
+			return false;
+		}
+	}
+	*this = std::move(table);
+	return true;
+}
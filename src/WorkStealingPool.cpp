@@ -0,0 +1,132 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(std::size_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (std::size_t i = 0; i < threadCount; ++i)
+	{
+		queues.push_back(std::make_unique<Queue>());
+	}
+	// Worker 0 is whoever calls parallelFor
+	for (std::size_t worker = 1; worker < threadCount; ++worker)
+	{
+		threads.emplace_back([this, worker]
+							 { workerLoop(worker); });
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void WorkStealingPool::parallelFor(std::size_t count, std::size_t grain, const RangeTask &rangeTask)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	grain = std::max<std::size_t>(grain, 1);
+	if (queues.size() == 1 || count <= grain)
+	{
+		rangeTask(0, 0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		task = &rangeTask;
+		pending = (count + grain - 1) / grain;
+		std::size_t next = 0;
+		for (std::size_t begin = 0; begin < count; begin += grain)
+		{
+			Queue &queue = *queues[next++ % queues.size()];
+			std::lock_guard<std::mutex> queueLock(queue.mutex);
+			queue.ranges.push_back({begin, std::min(begin + grain, count)});
+		}
+		++generation;
+	}
+	wake.notify_all();
+
+	while (runOne(0))
+	{
+	}
+	std::unique_lock<std::mutex> lock(wakeMutex);
+	done.wait(lock, [this]
+			  { return pending == 0; });
+	task = nullptr;
+}
+
+bool WorkStealingPool::runOne(std::size_t worker)
+{
+	Range range;
+	bool found = false;
+	{
+		Queue &own = *queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.ranges.empty())
+		{
+			range = own.ranges.front();
+			own.ranges.pop_front();
+			found = true;
+		}
+	}
+	for (std::size_t offset = 1; !found && offset < queues.size(); ++offset)
+	{
+		// Steal from the far end, away from where the owner is working
+		Queue &victim = *queues[(worker + offset) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.ranges.empty())
+		{
+			range = victim.ranges.back();
+			victim.ranges.pop_back();
+			found = true;
+			steals.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	if (!found)
+	{
+		return false;
+	}
+
+	(*task)(worker, range.begin, range.end);
+	if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		done.notify_all();
+	}
+	return true;
+}
+
+void WorkStealingPool::workerLoop(std::size_t worker)
+{
+	std::uint64_t seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wake.wait(lock, [this, seen]
+					  { return stopping || generation != seen; });
+			if (stopping)
+			{
+				return;
+			}
+			seen = generation;
+		}
+		while (runOne(worker))
+		{
+		}
+	}
+}
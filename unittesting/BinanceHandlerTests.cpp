@@ -2,11 +2,82 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/basic_file_sink.h"
 #include "BinanceHandler.h"
+#include "FieldRegistry.h"
+#include "LocalTlsServer.h"
+#include "LocalWebSocketServer.h"
+#include "JsonScanner.h"
+#include "Logging.h"
+#include "OrderBook.h"
+#include "OrderNormalizer.h"
+#include "QueryProtocol.h"
+#include "SharedSymbolTable.h"
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <random>
 #include <sstream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
 
 std::shared_ptr<spdlog::logger> logger;
 
+// Allocation-counting hook: every operator new of the test binary goes through here, and is counted
+// while countedAllocations runs its work
+namespace
+{
+	std::atomic<bool> countingAllocations{false};
+	std::atomic<std::size_t> allocationCount{0};
+
+	std::size_t countedAllocations(const std::function<void()> &work)
+	{
+		allocationCount = 0;
+		countingAllocations = true;
+		work();
+		countingAllocations = false;
+		return allocationCount;
+	}
+}
+
+void *operator new(std::size_t size)
+{
+	if (countingAllocations.load(std::memory_order_relaxed))
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (void *block = std::malloc(size ? size : 1))
+	{
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+// GCC pairs the free() below with the library's operator new once it is inlined into callers and warns at
+// every deletion; the replacement operator new above does allocate with malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *block) noexcept
+{
+	std::free(block);
+}
+
+void operator delete(void *block, std::size_t) noexcept
+{
+	std::free(block);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
 TEST(BinanceHandlerTests, ConnectionAndDataRetrieval)
 {
 	HTTPRequest httpRequest;
@@ -34,6 +105,804 @@ TEST(BinanceHandlerTests, DataParsing)
 	ASSERT_EQ(symbolInfo.find("tickSize")->second, "0.10");
 }
 
+TEST(BinanceHandlerTests, SessionReusesConnection)
+{
+	HTTPRequest httpRequest;
+	LocalTlsServer server([](const LocalTlsServer::Request &req, LocalTlsServer::Response &res)
+						  { res.body() = "{\"target\":\"" + std::string(req.target()) + "\"}"; });
+
+	HTTPSession &session = httpRequest.getSession("127.0.0.1", std::to_string(server.port()));
+	const int requests = 20;
+	for (int i = 0; i < requests; ++i)
+	{
+		ASSERT_EQ(session.request("/api/v3/exchangeInfo", 11), "{\"target\":\"/api/v3/exchangeInfo\"}");
+	}
+
+	ASSERT_EQ(server.requests(), static_cast<std::size_t>(requests));
+	ASSERT_EQ(server.handshakes(), 1u);
+	ASSERT_EQ(session.getHandshakeCount(), 1u);
+}
+
+TEST(BinanceHandlerTests, SessionReconnectsAfterServerClose)
+{
+	HTTPRequest httpRequest;
+	// The server closes every connection after three responses
+	LocalTlsServer server([](const LocalTlsServer::Request &, LocalTlsServer::Response &res)
+						  { res.body() = "{}"; },
+						  3);
+
+	std::string port = std::to_string(server.port());
+	const int requests = 10;
+	for (int i = 0; i < requests; ++i)
+	{
+		ASSERT_EQ(httpRequest.performBinanceAPIRequest("127.0.0.1", port, "/fapi/v1/exchangeInfo", 11), "{}");
+	}
+
+	HTTPSession &session = httpRequest.getSession("127.0.0.1", port);
+	ASSERT_EQ(server.requests(), static_cast<std::size_t>(requests));
+	ASSERT_EQ(server.handshakes(), 4u);
+	ASSERT_EQ(session.getHandshakeCount(), 4u);
+	// Every reconnect after the first connection resumes the cached TLS session
+	ASSERT_EQ(session.getResumedHandshakeCount(), 3u);
+	ASSERT_EQ(server.resumedHandshakes(), 3u);
+}
+
+// Trimmed exchangeInfo with the shapes the parser has to skip over
+static const std::string kExchangeInfoSample = R"({
+	"timezone": "UTC",
+	"serverTime": 1700000000000,
+	"rateLimits": [{"rateLimitType": "REQUEST_WEIGHT", "interval": "MINUTE", "limit": 6000}],
+	"exchangeFilters": [],
+	"symbols": [
+		{
+			"symbol": "BTCUSDT",
+			"status": "TRADING",
+			"baseAsset": "BTC",
+			"quoteAsset": "USDT",
+			"orderTypes": ["LIMIT", "MARKET"],
+			"isSpotTradingAllowed": true,
+			"filters": [
+				{"filterType": "PRICE_FILTER", "minPrice": "0.01000000", "tickSize": "0.01000000"},
+				{"filterType": "LOT_SIZE", "minQty": "0.00001000", "stepSize": "0.00001000"},
+				{"filterType": "MARKET_LOT_SIZE", "minQty": "0.00000000", "stepSize": "0.00000000"}
+			],
+			"permissionSets": [["SPOT", "MARGIN"]]
+		},
+		{
+			"status": "BREAK",
+			"symbol": "ETHBTC",
+			"quoteAsset": "BTC",
+			"filters": [
+				{"stepSize": "0.00010000", "filterType": "LOT_SIZE"},
+				{"tickSize": "0.00001000", "filterType": "PRICE_FILTER"}
+			]
+		},
+		{
+			"symbol": "NOFILTERS",
+			"status": "HALT",
+			"quoteAsset": "TRY",
+			"filters": []
+		}
+	]
+})";
+
+TEST(JSONParserTests, ParsesExchangeInfoInOnePass)
+{
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(kExchangeInfoSample));
+	ASSERT_EQ(jsonParser.snapshot()->size(), 3u);
+
+	auto btc = jsonParser.getSymbolInfo("BTCUSDT");
+	ASSERT_EQ(btc.at("status"), "TRADING");
+	ASSERT_EQ(btc.at("quoteAsset"), "USDT");
+	ASSERT_EQ(btc.at("tickSize"), "0.01000000");
+	ASSERT_EQ(btc.at("stepSize"), "0.00001000");
+
+	// Key order inside objects does not matter
+	auto eth = jsonParser.getSymbolInfo("ETHBTC");
+	ASSERT_EQ(eth.at("status"), "BREAK");
+	ASSERT_EQ(eth.at("tickSize"), "0.00001000");
+	ASSERT_EQ(eth.at("stepSize"), "0.00010000");
+
+	auto noFilters = jsonParser.getSymbolInfo("NOFILTERS");
+	ASSERT_EQ(noFilters.at("tickSize"), "");
+
+	JSONParser invalid;
+	ASSERT_FALSE(invalid.performJSONDataParsing("{\"symbols\": [}"));
+	ASSERT_FALSE(invalid.performJSONDataParsing("{\"timezone\": \"UTC\"}"));
+}
+
+TEST(JSONParserTests, StreamedParseMatchesWholeDocument)
+{
+	JSONParser whole;
+	ASSERT_TRUE(whole.performJSONDataParsing(kExchangeInfoSample));
+
+	// Deliver the body in small uneven chunks like a socket would
+	std::size_t offset = 0;
+	ChunkReader readChunk = [&offset](char *buffer, std::size_t size)
+	{
+		std::size_t count = std::min<std::size_t>({size, 7, kExchangeInfoSample.size() - offset});
+		kExchangeInfoSample.copy(buffer, count, offset);
+		offset += count;
+		return count;
+	};
+
+	JSONParser streamed;
+	ASSERT_TRUE(streamed.performJSONDataParsing(readChunk));
+	ASSERT_EQ(streamed.getSymbolInfoMap(), whole.getSymbolInfoMap());
+}
+
+TEST(JSONParserTests, ScannerMatchesReader)
+{
+	// Skipped fields hold brackets and quotes inside strings, escapes, nesting and runs longer than a block
+	std::string padding(150, 'x');
+	std::string json = R"({"timezone":"UTC","serverTime":1565246363776,"e":-0.5E+2,"z":0,"t":true,"f":false,"n":null,"rateLimits":[{"note":"]}\"[{\\","nested":[[[{"a":[]}]]],"n":-1.5e3}],"symbols":[)"
+					   R"({"symbol":"BTC\u0055SDT","status":"TRADING","quoteAsset":"USDT","ignored":{"text":")" + padding + R"(\\","more":[1,2,{"x":"}"}]},)"
+					   R"("filters":[{"filterType":"PRICE_FILTER","tickSize":"0.01000000","extra":[null,true,false]},)"
+					   R"({"filterType":"LOT_SIZE","stepSize":"0.00100000","minQty":"0.00100000"}]},)"
+					   R"( { "symbol" : "ETHBTC" , "status" : "BREAK" , "quoteAsset" : "BTC" , "filters" : [ { "filterType" : "PRICE_FILTER" , "tickSize" : "0.00001000" } ,)"
+					   R"( { "filterType" : "LOT_SIZE" , "stepSize" : "0.00010000" } ] , "permissions" : [ ")" + padding + R"(" ] } ] } )";
+	JSONParser reader;
+	reader.setExchangeInfoParser(ExchangeInfoParser::Reader);
+	ASSERT_TRUE(reader.performJSONDataParsing(json));
+	ASSERT_EQ(reader.getSymbolInfo("BTCUSDT").at("tickSize"), "0.01000000");
+	ASSERT_EQ(reader.getSymbolInfo("ETHBTC").at("stepSize"), "0.00010000");
+	JSONParser sample;
+	sample.setExchangeInfoParser(ExchangeInfoParser::Reader);
+	ASSERT_TRUE(sample.performJSONDataParsing(kExchangeInfoSample));
+
+	// The same checks on every classifier this CPU can run, whichever one it would pick
+	const ScanBackend detected = activeScanBackend();
+	for (ScanBackend backend : {ScanBackend::Scalar, ScanBackend::SSE2, ScanBackend::AVX2})
+	{
+		const char *name = scanBackendName(backend);
+		if (!setScanBackend(backend))
+		{
+			continue;
+		}
+		ASSERT_EQ(activeScanBackend(), backend);
+
+		JSONParser scanner;
+		scanner.setExchangeInfoParser(ExchangeInfoParser::Scanner);
+		ASSERT_TRUE(scanner.performJSONDataParsing(json));
+		ASSERT_EQ(scanner.getSymbolInfoMap(), reader.getSymbolInfoMap()) << name;
+		ASSERT_TRUE(scanner.performJSONDataParsing(kExchangeInfoSample));
+		ASSERT_EQ(scanner.getSymbolInfoMap(), sample.getSymbolInfoMap()) << name;
+
+		// Every chunk size puts block and token boundaries somewhere else
+		for (std::size_t chunk : {1, 3, 63, 64, 65, 4096})
+		{
+			std::size_t offset = 0;
+			ChunkReader readChunk = [&](char *buffer, std::size_t size)
+			{
+				std::size_t count = std::min({size, chunk, json.size() - offset});
+				json.copy(buffer, count, offset);
+				offset += count;
+				return count;
+			};
+			JSONParser streamed;
+			streamed.setExchangeInfoParser(ExchangeInfoParser::Scanner);
+			ASSERT_TRUE(streamed.performJSONDataParsing(readChunk)) << chunk << ' ' << name;
+			ASSERT_EQ(streamed.getSymbolInfoMap(), reader.getSymbolInfoMap()) << chunk << ' ' << name;
+		}
+
+		for (const char *invalid : {"{\"symbols\": [}", "{\"symbols\": []} []", "{\"symbols\": [],}", R"({"rateLimits":["]"],"symbols":[)",
+									R"({"rateLimits":[{"a":"\"]}"}, "symbols":[]})", R"({"symbols":[{"symbol":"A" "status":"TRADING"}]})",
+									R"({"symbols":[{"symbol":"A\q"}]})", "", "nul", R"({"x":tru,"symbols":[]})", R"({"serverTime":12abc,"symbols":[]})",
+									R"({"a":-,"symbols":[]})", R"({"a":nullx,"symbols":[]})", R"({"symbols":[],"a":01})", R"({"symbols":[],"a":1.})",
+									R"({"symbols":[],"a":1e+})", R"({"symbols":[],"a":1"})"})
+		{
+			JSONParser failing;
+			failing.setExchangeInfoParser(ExchangeInfoParser::Scanner);
+			ASSERT_FALSE(failing.performJSONDataParsing(invalid)) << invalid << ' ' << name;
+		}
+	}
+	ASSERT_TRUE(setScanBackend(detected));
+	ASSERT_TRUE(scanBackendSupported(ScanBackend::Scalar));
+}
+
+TEST(BinanceHandlerTests, StreamedRequestParsesBody)
+{
+	HTTPRequest httpRequest;
+	LocalTlsServer server([](const LocalTlsServer::Request &, LocalTlsServer::Response &res)
+						  { res.body() = kExchangeInfoSample; });
+
+	JSONParser jsonParser;
+	bool parsed = false;
+	std::string port = std::to_string(server.port());
+	for (int i = 0; i < 2; ++i)
+	{
+		ASSERT_TRUE(httpRequest.streamBinanceAPIRequest("127.0.0.1", port, "/api/v3/exchangeInfo", 11, [&](const ChunkReader &readChunk)
+														{ parsed = jsonParser.performJSONDataParsing(readChunk); }));
+		ASSERT_TRUE(parsed);
+	}
+
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("tickSize"), "0.01000000");
+	// The fully consumed body leaves the connection reusable
+	ASSERT_EQ(server.handshakes(), 1u);
+}
+
+static std::string exchangeInfoWith(const std::vector<std::pair<std::string, std::string>> &symbolTicks)
+{
+	std::string json = R"({"timezone":"UTC","symbols":[)";
+	for (std::size_t i = 0; i < symbolTicks.size(); ++i)
+	{
+		json += (i ? "," : "") + std::string(R"({"symbol":")") + symbolTicks[i].first + R"(","status":"TRADING","quoteAsset":"USDT","filters":[)" +
+				R"({"filterType":"PRICE_FILTER","tickSize":")" + symbolTicks[i].second + R"("},{"filterType":"LOT_SIZE","stepSize":"0.001"}]})";
+	}
+	return json + "]}";
+}
+
+TEST(JSONParserTests, RefreshKeepsLocalOverridesUntilExchangeChanges)
+{
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}, {"BNBUSDT", "0.01"}})));
+	jsonParser.handleUpdate("BTCUSDT", {{"status", "BREAK"}});
+	jsonParser.handleDelete("ETHUSDT");
+
+	// Same exchange data: nothing is rewritten, no new version is published, the overrides stay
+	std::shared_ptr<const SymbolSnapshot> before = jsonParser.snapshot();
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}, {"BNBUSDT", "0.01"}})));
+	ASSERT_EQ(jsonParser.snapshot(), before);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "BREAK");
+	ASSERT_TRUE(jsonParser.getSymbolInfo("ETHUSDT").empty());
+
+	// The exchange changes BTCUSDT and ETHUSDT, delists BNBUSDT and lists a new symbol
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.10"}, {"ETHUSDT", "0.05"}, {"SOLUSDT", "0.01"}})));
+	auto btc = jsonParser.getSymbolInfo("BTCUSDT");
+	ASSERT_EQ(btc.at("status"), "TRADING");
+	ASSERT_EQ(btc.at("tickSize"), "0.10");
+	ASSERT_EQ(jsonParser.getSymbolInfo("ETHUSDT").at("tickSize"), "0.05");
+	ASSERT_TRUE(jsonParser.getSymbolInfo("BNBUSDT").empty());
+	ASSERT_EQ(jsonParser.getSymbolInfo("SOLUSDT").at("tickSize"), "0.01");
+	ASSERT_EQ(jsonParser.snapshot()->size(), 3u);
+
+	// A failed fetch leaves the table alone
+	ASSERT_FALSE(jsonParser.performJSONDataParsing("{\"symbols\": [}"));
+	ASSERT_EQ(jsonParser.snapshot()->size(), 3u);
+}
+
+TEST(BinanceHandlerTests, RefresherPicksUpNewExchangeInfo)
+{
+	std::atomic<int> served{0};
+	LocalTlsServer server([&served](const LocalTlsServer::Request &, LocalTlsServer::Response &res)
+						  { res.body() = exchangeInfoWith({{"BTCUSDT", ++served > 1 ? "0.10" : "0.01"}}); });
+
+	JSONParser jsonParser;
+	ExchangeInfoRefresher refresher(jsonParser, "127.0.0.1", std::to_string(server.port()), "/api/v3/exchangeInfo", 11, std::chrono::seconds(1));
+	ASSERT_TRUE(refresher.refreshNow());
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("tickSize"), "0.01");
+
+	refresher.start();
+	for (int i = 0; i < 300 && refresher.getRefreshCount() < 2; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	refresher.stop();
+	ASSERT_GE(refresher.getRefreshCount(), 2u);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("tickSize"), "0.10");
+	// Refreshes reuse the kept-alive connection
+	ASSERT_EQ(server.handshakes(), 1u);
+}
+
+// windowBits 15 + 16 writes gzip framing, plain 15 the zlib framing used for "deflate"
+static std::string compressBody(const std::string &body, int windowBits)
+{
+	z_stream stream{};
+	deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+	std::string compressed(deflateBound(&stream, body.size()), '\0');
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body.data()));
+	stream.avail_in = static_cast<uInt>(body.size());
+	stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+	stream.avail_out = static_cast<uInt>(compressed.size());
+	deflate(&stream, Z_FINISH);
+	compressed.resize(stream.total_out);
+	deflateEnd(&stream);
+	return compressed;
+}
+
+TEST(BinanceHandlerTests, ConditionalCompressedFetch)
+{
+	namespace http = boost::beast::http;
+	std::atomic<int> compressedRequests{0};
+	LocalTlsServer server([&compressedRequests](const LocalTlsServer::Request &req, LocalTlsServer::Response &res)
+						  {
+							  if (req[http::field::if_none_match] == "\"v1\"")
+							  {
+								  res.result(http::status::not_modified);
+								  return;
+							  }
+							  if (req[http::field::accept_encoding].find("gzip") != boost::beast::string_view::npos)
+							  {
+								  ++compressedRequests;
+								  res.set(http::field::content_encoding, "gzip");
+								  res.body() = compressBody(kExchangeInfoSample, 15 + 16);
+							  }
+							  else
+							  {
+								  res.body() = kExchangeInfoSample;
+							  }
+							  res.set(http::field::etag, "\"v1\"");
+							  res.set(http::field::last_modified, "Sat, 17 Oct 2026 00:00:00 GMT"); });
+	std::string port = std::to_string(server.port());
+
+	JSONParser jsonParser;
+	{
+		ExchangeInfoRefresher refresher(jsonParser, "127.0.0.1", port, "/api/v3/exchangeInfo", 11, std::chrono::seconds(0));
+		ASSERT_TRUE(refresher.refreshNow());
+		ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("tickSize"), "0.01000000");
+		std::shared_ptr<const SymbolSnapshot> first = jsonParser.snapshot();
+
+		// The second fetch is revalidated and answered 304, nothing is parsed or published
+		ASSERT_TRUE(refresher.refreshNow());
+		ASSERT_EQ(refresher.getRefreshCount(), 1u);
+		ASSERT_EQ(refresher.getNotModifiedCount(), 1u);
+		ASSERT_EQ(jsonParser.snapshot(), first);
+	}
+
+	// A body that does not parse is fetched whole again, not revalidated into a 304
+	std::atomic<int> conditionalRequests{0};
+	LocalTlsServer brokenServer([&conditionalRequests](const LocalTlsServer::Request &req, LocalTlsServer::Response &res)
+								{
+									if (!req[http::field::if_none_match].empty())
+									{
+										++conditionalRequests;
+										res.result(http::status::not_modified);
+										return;
+									}
+									res.body() = "{\"symbols\":[";
+									res.set(http::field::etag, "\"broken\""); });
+	{
+		JSONParser brokenParser;
+		ExchangeInfoRefresher refresher(brokenParser, "127.0.0.1", std::to_string(brokenServer.port()), "/api/v3/exchangeInfo", 11, std::chrono::seconds(0));
+		ASSERT_FALSE(refresher.refreshNow());
+		ASSERT_FALSE(refresher.refreshNow());
+		ASSERT_EQ(refresher.getFailureCount(), 2u);
+		ASSERT_EQ(refresher.getNotModifiedCount(), 0u);
+		ASSERT_EQ(conditionalRequests.load(), 0);
+	}
+
+	// Unconditional requests still get the whole body, inflated (the mock serves one connection at a time,
+	// so the refresher's kept-alive session is closed first)
+	HTTPRequest httpRequest;
+	ASSERT_EQ(httpRequest.performBinanceAPIRequest("127.0.0.1", port, "/api/v3/exchangeInfo", 11), kExchangeInfoSample);
+	ASSERT_EQ(compressedRequests.load(), 2);
+
+	LocalTlsServer deflateServer([](const LocalTlsServer::Request &, LocalTlsServer::Response &res)
+								 {
+									 res.set(http::field::content_encoding, "deflate");
+									 res.body() = compressBody(kExchangeInfoSample, 15); });
+	JSONParser deflated;
+	bool parsed = false;
+	ASSERT_TRUE(httpRequest.streamBinanceAPIRequest("127.0.0.1", std::to_string(deflateServer.port()), "/api/v3/exchangeInfo", 11, [&](const ChunkReader &readChunk)
+													{ parsed = deflated.performJSONDataParsing(readChunk); }));
+	ASSERT_TRUE(parsed);
+	ASSERT_EQ(deflated.getSymbolInfoMap(), jsonParser.getSymbolInfoMap());
+}
+
+TEST(JSONParserTests, MarketsMergeIndependently)
+{
+	JSONParser jsonParser;
+	MarketId usdm = jsonParser.addMarket("usdm");
+	ASSERT_EQ(jsonParser.addMarket("usdm"), usdm);
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}})));
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.10"}}), usdm));
+
+	// Same symbol name, two rows
+	ASSERT_EQ(jsonParser.snapshot()->size(), 3u);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("tickSize"), "0.01");
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT", usdm).at("tickSize"), "0.10");
+	ASSERT_TRUE(jsonParser.getSymbolInfo("ETHUSDT", usdm).empty());
+
+	// A refresh of one market only delists that market's symbols, and overrides are per market
+	jsonParser.handleUpdate("BTCUSDT", {{"status", "BREAK"}});
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"ETHUSDT", "0.05"}}), usdm));
+	ASSERT_TRUE(jsonParser.getSymbolInfo("BTCUSDT", usdm).empty());
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "BREAK");
+	ASSERT_EQ(jsonParser.getSymbolInfo("ETHUSDT").at("tickSize"), "0.01");
+	ASSERT_EQ(jsonParser.getSymbolInfo("ETHUSDT", usdm).at("tickSize"), "0.05");
+	ASSERT_EQ(jsonParser.getSymbolInfoMap(usdm).size(), 1u);
+
+	// Queries pick the market by name
+	rapidjson::Document deleteQuery;
+	deleteQuery.Parse(R"({"id": 1, "query_type": "DELETE", "symbol": "ETHUSDT", "market": "usdm"})");
+	QueryHandler queryHandler;
+	queryHandler.dispatchQuery(deleteQuery, jsonParser);
+	ASSERT_TRUE(jsonParser.getSymbolInfo("ETHUSDT", usdm).empty());
+	ASSERT_FALSE(jsonParser.getSymbolInfo("ETHUSDT").empty());
+}
+
+TEST(JSONParserTests, SnapshotRestoresExchangeData)
+{
+	const std::string path = "symbols_test.snapshot";
+	std::remove(path.c_str());
+	// Text of any length survives, including values that only differ past their first 256 bytes
+	const std::string longMarketName(300, 'm');
+	const std::string longAsset(300, 'a');
+	{
+		JSONParser jsonParser;
+		MarketId usdm = jsonParser.addMarket("usdm");
+		MarketId longMarket = jsonParser.addMarket(longMarketName);
+		jsonParser.setSnapshotFile(path);
+		std::string longAssets = R"({"symbols":[)";
+		for (const char *suffix : {"1", "2"})
+		{
+			longAssets += std::string(*suffix == '1' ? "" : ",") + R"({"symbol":"LONG)" + suffix + R"(","status":"TRADING","baseAsset":")" + longAsset + suffix +
+						  R"(","quoteAsset":"USDT","filters":[{"filterType":"PRICE_FILTER","tickSize":"0.01"},{"filterType":"LOT_SIZE","stepSize":"0.001"}]})";
+		}
+		ASSERT_TRUE(jsonParser.performJSONDataParsing(longAssets + "]}", longMarket));
+		ASSERT_TRUE(jsonParser.performJSONDataParsing(R"({"symbols":[{"symbol":"BTCUSDT","status":"TRADING","baseAsset":"BTC","quoteAsset":"USDT",
+			"filters":[{"filterType":"PRICE_FILTER","tickSize":"0.01"},{"filterType":"LOT_SIZE","stepSize":"0.001","minQty":"0.001"}]}]})"));
+		ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.10"}, {"ETHUSDT", "0.05"}}), usdm));
+		// Local edits are not exchange data and stay out of the file
+		jsonParser.handleUpdate("BTCUSDT", {{"status", "BREAK"}});
+		jsonParser.handleDelete("ETHUSDT", usdm);
+	}
+
+	// Market ids follow this process's registration order, the snapshot's are matched by name
+	JSONParser restored;
+	MarketId coinm = restored.addMarket("coinm");
+	ASSERT_TRUE(restored.loadSnapshot(path));
+	MarketId usdm;
+	ASSERT_TRUE(restored.findMarket("usdm", usdm));
+	ASSERT_NE(usdm, coinm);
+	ASSERT_EQ(restored.snapshot()->size(), 5u);
+	MarketId longMarket;
+	ASSERT_TRUE(restored.findMarket(longMarketName, longMarket));
+	ASSERT_EQ(restored.getSymbolInfo("LONG1", longMarket).at("baseAsset"), longAsset + "1");
+	ASSERT_EQ(restored.getSymbolInfo("LONG2", longMarket).at("baseAsset"), longAsset + "2");
+	auto btc = restored.getSymbolInfo("BTCUSDT");
+	ASSERT_EQ(btc.at("status"), "TRADING");
+	ASSERT_EQ(btc.at("baseAsset"), "BTC");
+	ASSERT_EQ(btc.at("minQty"), "0.001");
+	ASSERT_EQ(restored.getSymbolInfo("BTCUSDT", usdm).at("tickSize"), "0.10");
+	ASSERT_EQ(restored.getSymbolInfo("ETHUSDT", usdm).at("tickSize"), "0.05");
+	ASSERT_TRUE(restored.getSymbolInfo("ETHUSDT", coinm).empty());
+
+	// The snapshot is the merge baseline: the same exchange data again changes nothing
+	std::shared_ptr<const SymbolSnapshot> before = restored.snapshot();
+	ASSERT_TRUE(restored.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.10"}, {"ETHUSDT", "0.05"}}), usdm));
+	ASSERT_EQ(restored.snapshot(), before);
+
+	// Any flipped byte fails the checksum, a short file the size check; the table is left alone
+	std::string contents;
+	{
+		std::ifstream input(path, std::ios::binary);
+		contents.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+	}
+	for (std::size_t offset : {std::size_t(40), contents.size() - 1, std::size_t(8)})
+	{
+		std::string corrupt = contents;
+		corrupt[offset] ^= 0x20;
+		std::ofstream(path, std::ios::binary | std::ios::trunc) << corrupt;
+		JSONParser rejected;
+		ASSERT_FALSE(rejected.loadSnapshot(path));
+		ASSERT_EQ(rejected.snapshot()->size(), 0u);
+	}
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << contents.substr(0, contents.size() / 2);
+	ASSERT_FALSE(restored.loadSnapshot(path));
+	ASSERT_EQ(restored.snapshot(), before);
+	std::remove(path.c_str());
+	ASSERT_FALSE(restored.loadSnapshot(path));
+}
+
+TEST(BinanceHandlerTests, MarketFetcherFetchesInParallel)
+{
+	namespace http = boost::beast::http;
+	// Each mock market takes a while to answer; fetched one after another they would take 3 x kDelay
+	const std::chrono::milliseconds kDelay(300);
+	auto slowMarket = [kDelay](const std::string &tick, bool gzip)
+	{
+		return [kDelay, tick, gzip](const LocalTlsServer::Request &, LocalTlsServer::Response &res)
+		{
+			std::this_thread::sleep_for(kDelay);
+			res.body() = exchangeInfoWith({{"BTCUSDT", tick}, {"ETHUSDT", tick}});
+			if (gzip)
+			{
+				res.set(http::field::content_encoding, "gzip");
+				res.body() = compressBody(res.body(), 15 + 16);
+			}
+		};
+	};
+	LocalTlsServer spot(slowMarket("0.01", false));
+	LocalTlsServer usdm(slowMarket("0.10", true));
+	LocalTlsServer coinm(slowMarket("0.20", false));
+
+	std::vector<MarketEndpoint> endpoints(4);
+	ASSERT_TRUE(parseEndpointUrl("https://127.0.0.1:" + std::to_string(spot.port()) + "/api/v3/exchangeInfo", endpoints[0]));
+	ASSERT_TRUE(parseEndpointUrl("https://127.0.0.1:" + std::to_string(usdm.port()) + "/fapi/v1/exchangeInfo", endpoints[1]));
+	ASSERT_TRUE(parseEndpointUrl("https://127.0.0.1:" + std::to_string(coinm.port()) + "/dapi/v1/exchangeInfo", endpoints[2]));
+	// Nothing listens on port 1, that market fails without holding up the others
+	ASSERT_TRUE(parseEndpointUrl("https://127.0.0.1:1/api/v3/exchangeInfo", endpoints[3]));
+	endpoints[0].market = "spot";
+	endpoints[1].market = "usdm";
+	endpoints[2].market = "coinm";
+	endpoints[3].market = "down";
+	ASSERT_EQ(endpoints[1].target, "/fapi/v1/exchangeInfo");
+
+	JSONParser jsonParser;
+	MarketFetcher fetcher(jsonParser, 2);
+	auto started = std::chrono::steady_clock::now();
+	ASSERT_EQ(fetcher.fetchAll(endpoints, 11), 3u);
+	auto elapsed = std::chrono::steady_clock::now() - started;
+	ASSERT_LT(elapsed, 2 * kDelay);
+
+	MarketId market;
+	ASSERT_TRUE(jsonParser.findMarket("coinm", market));
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT", market).at("tickSize"), "0.20");
+	ASSERT_TRUE(jsonParser.findMarket("usdm", market));
+	ASSERT_EQ(jsonParser.getSymbolInfo("ETHUSDT", market).at("tickSize"), "0.10");
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("tickSize"), "0.01");
+	ASSERT_EQ(jsonParser.snapshot()->size(), 6u);
+}
+
+TEST(MarketStreamTests, ReplayedTrafficUpdatesTheTableAcrossReconnects)
+{
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}})));
+	jsonParser.handleUpdate("ETHUSDT", {{"status", "BREAK"}});
+
+	// Recorded combined-stream traffic; the first connection is cut after five frames
+	LocalWebSocketServer server({R"({"result":null,"id":1})",
+								 R"({"stream":"btcusdt@depth","data":{"e":"depthUpdate","E":1,"s":"BTCUSDT","U":100,"u":105,"b":[["1.00","2"]],"a":[]}})",
+								 R"({"stream":"!contractInfo","data":{"e":"contractInfo","E":2,"s":"BTCUSDT","ps":"BTCUSDT","ct":"PERPETUAL","cs":"HALT","bks":[{"bs":1,"bnf":0}]}})",
+								 // 106 to 110 never arrived
+								 R"({"stream":"btcusdt@depth","data":{"e":"depthUpdate","E":3,"s":"BTCUSDT","U":111,"u":115,"b":[],"a":[["1.01","0"]]}})",
+								 // Older than what the stream already delivered, dropped
+								 R"({"stream":"btcusdt@depth","data":{"e":"depthUpdate","E":4,"s":"BTCUSDT","U":106,"u":110,"b":[],"a":[]}})",
+								 R"({"result":null,"id":2})",
+								 // Filter change from a relay that uses the exchangeInfo field names
+								 R"({"e":"symbolUpdate","E":5,"s":"ETHUSDT","status":"TRADING","tickSize":"0.00100000"})",
+								 R"({"stream":"!contractInfo","data":{"e":"contractInfo","E":6,"s":"BTCUSDT","ct":"PERPETUAL","cs":"HALT"}})"},
+								5);
+
+	MarketStreamOptions options;
+	options.host = "127.0.0.1";
+	options.port = std::to_string(server.port());
+	options.streams = {"!contractInfo", "btcusdt@depth"};
+	options.initialBackoff = std::chrono::milliseconds(10);
+	MarketStream stream(jsonParser, options);
+	std::atomic<int> resyncs{0};
+	stream.setResyncHandler([&resyncs](MarketId)
+							{ ++resyncs; });
+	stream.start();
+	for (int i = 0; i < 500 && (stream.getMessageCount() < 8 || server.pongs() == 0); ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	stream.stop();
+
+	ASSERT_EQ(stream.getMessageCount(), 8u);
+	ASSERT_EQ(stream.getConnectionCount(), 2u);
+	ASSERT_EQ(server.subscriptions().front(), R"({"method":"SUBSCRIBE","params":["!contractInfo","btcusdt@depth"],"id":1})");
+	ASSERT_GE(server.pongs(), 1u);
+	// One gap, one reconnect; the repeated contractInfo changed nothing
+	ASSERT_EQ(stream.getGapCount(), 1u);
+	ASSERT_EQ(resyncs.load(), 2);
+	ASSERT_EQ(stream.getAppliedCount(), 2u);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "HALT");
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("contractType"), "PERPETUAL");
+	// The exchange changed ETHUSDT, which ends the local override
+	ASSERT_EQ(jsonParser.getSymbolInfo("ETHUSDT").at("tickSize"), "0.00100000");
+	ASSERT_EQ(jsonParser.getSymbolInfo("ETHUSDT").at("status"), "TRADING");
+}
+
+TEST(OrderBookTests, SnapshotAndDiffsFollowTheUpdateIds)
+{
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01000000"}})));
+	std::unique_ptr<OrderBook> book = OrderBook::forSymbol(*jsonParser.snapshot(), "BTCUSDT");
+	ASSERT_TRUE(book);
+	ASSERT_FALSE(OrderBook::forSymbol(*jsonParser.snapshot(), "ETHUSDT"));
+
+	// Diffs before the snapshot wait for it; the one it already covers is dropped on replay
+	auto diff = [&book](const std::string &json)
+	{ return book->applyDiff(json.data(), json.size()); };
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":95,"u":100,"b":[["100.00","9"]],"a":[]})"), OrderBook::Result::Buffered);
+	ASSERT_EQ(diff(R"({"stream":"btcusdt@depth","data":{"e":"depthUpdate","U":99,"u":102,"b":[["100.01","1.5"],["99.99","0"]],"a":[["100.03","2"]]}})"), OrderBook::Result::Buffered);
+	std::string snapshot = R"({"lastUpdateId":100,"bids":[["100.00","1.000"],["99.99","3.000"],["99.98","4"]],"asks":[["100.02","2.500"],["100.04","1"]]})";
+	ASSERT_EQ(book->applySnapshot(snapshot.data(), snapshot.size()), OrderBook::Result::Applied);
+	ASSERT_TRUE(book->synced());
+	ASSERT_EQ(book->lastUpdateId(), 102u);
+
+	DepthLevel best;
+	ASSERT_TRUE(book->bestBid(best));
+	ASSERT_EQ(book->price(best.ticks).toString(), "100.01000000");
+	ASSERT_EQ(book->quantity(best.quantity).toString(), "1.500");
+	ASSERT_EQ(book->bidLevels(), 3u);
+	ASSERT_EQ(book->bid(1).quantity, 1000);
+	ASSERT_EQ(book->bid(2).ticks, 9998);
+	ASSERT_TRUE(book->bestAsk(best));
+	ASSERT_EQ(best.ticks, 10002);
+	ASSERT_EQ(book->ask(1).ticks, 10003);
+
+	// In sequence, stale, then a gap that waits for the next snapshot
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":103,"u":104,"b":[["100.01","0"]],"a":[["100.02","0"]]})"), OrderBook::Result::Applied);
+	ASSERT_TRUE(book->bestBid(best));
+	ASSERT_EQ(best.ticks, 10000);
+	ASSERT_TRUE(book->bestAsk(best));
+	ASSERT_EQ(best.ticks, 10003);
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":101,"u":104,"b":[],"a":[]})"), OrderBook::Result::Stale);
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":106,"u":107,"b":[["100.00","7"]],"a":[]})"), OrderBook::Result::Gap);
+	ASSERT_FALSE(book->synced());
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":108,"u":108,"b":[],"a":[["100.05","1"]]})"), OrderBook::Result::Buffered);
+	snapshot = R"({"lastUpdateId":106,"bids":[["100.00","5"]],"asks":[["100.03","1"]]})";
+	ASSERT_EQ(book->applySnapshot(snapshot.data(), snapshot.size()), OrderBook::Result::Applied);
+	ASSERT_EQ(book->lastUpdateId(), 108u);
+	ASSERT_EQ(book->bid(0).quantity, 7000);
+	ASSERT_EQ(book->askLevels(), 2u);
+
+	// Futures diffs chain on "pu"; prices off the tick grid are refused
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":110,"u":112,"pu":108,"b":[],"a":[["100.03","0"]]})"), OrderBook::Result::Applied);
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":113,"u":113,"pu":112,"b":[["100.005","1"]],"a":[]})"), OrderBook::Result::Rejected);
+	ASSERT_EQ(diff(R"({"e":"depthUpdate","U":113,"u":113,"pu":111,"b":[],"a":[]})"), OrderBook::Result::Gap);
+}
+
+TEST(OrderBookTests, FlatLevelsMatchAnOrderedMap)
+{
+	// Random absolute updates around a drifting mid, checked level by level against std::map
+	OrderBook book({5, 2}, {1, 3});
+	DepthUpdate snapshot;
+	snapshot.lastId = 1;
+	ASSERT_EQ(book.applySnapshot(snapshot), OrderBook::Result::Applied);
+	std::map<int64_t, int64_t> bids;
+	std::map<int64_t, int64_t> asks;
+	std::mt19937 random(7);
+	int64_t mid = 20000;
+	for (uint64_t id = 2; id < 20000; ++id)
+	{
+		DepthUpdate update;
+		update.firstId = update.lastId = id;
+		mid += static_cast<int64_t>(random() % 3) - 1;
+		auto randomLevel = [&random](int64_t from, int64_t direction)
+		{
+			int64_t ticks = from + direction * static_cast<int64_t>(random() % 50);
+			return DepthLevel{ticks, random() % 4 == 0 ? 0 : 1 + static_cast<int64_t>(random() % 1000)};
+		};
+		for (int i = 0; i < 4; ++i)
+		{
+			DepthLevel bid = randomLevel(mid - 1, -1);
+			update.bids.push_back(bid);
+			if (bid.quantity)
+			{
+				bids[bid.ticks] = bid.quantity;
+			}
+			else
+			{
+				bids.erase(bid.ticks);
+			}
+			DepthLevel ask = randomLevel(mid + 1, 1);
+			update.asks.push_back(ask);
+			if (ask.quantity)
+			{
+				asks[ask.ticks] = ask.quantity;
+			}
+			else
+			{
+				asks.erase(ask.ticks);
+			}
+		}
+		ASSERT_EQ(book.applyDiff(update), OrderBook::Result::Applied);
+	}
+	ASSERT_EQ(book.bidLevels(), bids.size());
+	ASSERT_EQ(book.askLevels(), asks.size());
+	std::size_t i = 0;
+	for (auto it = bids.rbegin(); it != bids.rend(); ++it, ++i)
+	{
+		ASSERT_EQ(book.bid(i).ticks, it->first);
+		ASSERT_EQ(book.bid(i).quantity, it->second);
+	}
+	i = 0;
+	for (const auto &level : asks)
+	{
+		ASSERT_EQ(book.ask(i).ticks, level.first);
+		ASSERT_EQ(book.ask(i++).quantity, level.second);
+	}
+}
+
+TEST(OrderNormalizerTests, RoundsAndValidatesAgainstDecimalFilters)
+{
+	JSONParser jsonParser;
+	jsonParser.setSymbolInfoMap({
+		{"BTCUSDT", {{"status", "TRADING"}, {"tickSize", "0.05000000"}, {"stepSize", "0.00100000"}, {"minQty", "0.00100000"}, {"minNotional", "5.00000000"}}},
+		{"OLDUSDT", {{"status", "BREAK"}, {"tickSize", "0.01"}, {"stepSize", "1"}}},
+		{"TINYUSDT", {{"status", "TRADING"}, {"tickSize", "0.000000001"}, {"stepSize", "1"}}},
+	});
+	OrderNormalizer normalizer(*jsonParser.snapshot());
+	OrderNormalizer::Slot btc = normalizer.find("BTCUSDT");
+	ASSERT_NE(btc, OrderNormalizer::kUnknownSlot);
+	// A tickSize finer than kScale cannot be honoured
+	ASSERT_EQ(normalizer.find("TINYUSDT"), OrderNormalizer::kUnknownSlot);
+	ASSERT_EQ(normalizer.find("BTCUSDT", 1), OrderNormalizer::kUnknownSlot);
+
+	auto units = [](const char *text)
+	{
+		int64_t value = 0;
+		EXPECT_TRUE(OrderNormalizer::toUnits(text, std::strlen(text), value)) << text;
+		return value;
+	};
+	using Rounding = OrderNormalizer::Rounding;
+	ASSERT_EQ(OrderNormalizer::toString(normalizer.roundPrice(btc, units("100.07"))), "100.05000000");
+	ASSERT_EQ(OrderNormalizer::toString(normalizer.roundPrice(btc, units("100.075"))), "100.10000000");
+	ASSERT_EQ(OrderNormalizer::toString(normalizer.roundPrice(btc, units("100.09"), Rounding::Down)), "100.05000000");
+	ASSERT_EQ(OrderNormalizer::toString(normalizer.roundPrice(btc, units("100.01"), Rounding::Up)), "100.05000000");
+	ASSERT_EQ(OrderNormalizer::toString(normalizer.roundPrice(btc, units("100.05"), Rounding::Up)), "100.05000000");
+	ASSERT_EQ(OrderNormalizer::toString(normalizer.roundQuantity(btc, units("1.23456"))), "1.23400000");
+	ASSERT_EQ(OrderNormalizer::toString(normalizer.roundQuantity(btc, units("1.23456"), Rounding::Up)), "1.23500000");
+	ASSERT_EQ(normalizer.roundQuantity(btc, units("-1")), 0);
+	int64_t ignored;
+	ASSERT_FALSE(OrderNormalizer::toUnits("0.123456789", 11, ignored));
+
+	ASSERT_EQ(normalizer.validate(btc, units("100.05"), units("0.05")), 0);
+	ASSERT_EQ(normalizer.validate(btc, units("100.05"), units("0.049")), OrderViolation::BelowMinNotional);
+	ASSERT_EQ(normalizer.validate(btc, units("100.07"), units("0.0005")),
+			  OrderViolation::PriceOffTick | OrderViolation::QuantityOffStep | OrderViolation::BelowMinQty | OrderViolation::BelowMinNotional);
+	ASSERT_EQ(normalizer.validate(btc, units("-100"), units("1")), OrderViolation::NonPositive | OrderViolation::BelowMinNotional);
+	ASSERT_EQ(normalizer.validate(normalizer.find("OLDUSDT"), units("1.01"), units("3")), OrderViolation::NotTrading);
+	ASSERT_EQ(normalizer.validate(OrderNormalizer::kUnknownSlot, units("1"), units("1")) & OrderViolation::UnknownSymbol, OrderViolation::UnknownSymbol);
+}
+
+TEST(OrderNormalizerTests, BatchesMatchPlainDivision)
+{
+	// Ticks of every magnitude, values up to 2^62; the reciprocal remainders must agree with % everywhere
+	std::mt19937_64 random(11);
+	std::unordered_map<std::string, std::unordered_map<std::string, std::string>> symbols;
+	std::vector<int64_t> ticks;
+	for (int i = 0; i < 64; ++i)
+	{
+		int64_t mantissa = 1 + static_cast<int64_t>(random() % 999);
+		int scale = static_cast<int>(random() % 9);
+		int64_t tick = mantissa;
+		for (int digit = scale; digit < 8; ++digit)
+		{
+			tick *= 10;
+		}
+		ticks.push_back(tick);
+		symbols["SYM" + std::to_string(i)] = {{"status", "TRADING"}, {"tickSize", FixedDecimal{mantissa, static_cast<uint8_t>(scale)}.toString()}};
+	}
+	JSONParser jsonParser;
+	jsonParser.setSymbolInfoMap(symbols);
+	OrderNormalizer normalizer(*jsonParser.snapshot());
+
+	std::vector<OrderNormalizer::Slot> slots;
+	std::vector<int64_t> prices;
+	std::vector<int64_t> tickOf;
+	for (int i = 0; i < 20000; ++i)
+	{
+		int symbol = static_cast<int>(random() % ticks.size());
+		slots.push_back(normalizer.find("SYM" + std::to_string(symbol)));
+		tickOf.push_back(ticks[symbol]);
+		int64_t price = static_cast<int64_t>(random() >> (2 + random() % 60));
+		prices.push_back(i % 7 == 0 ? price - price % ticks[symbol] : price);
+	}
+	for (auto rounding : {OrderNormalizer::Rounding::Down, OrderNormalizer::Rounding::Up, OrderNormalizer::Rounding::Nearest})
+	{
+		std::vector<int64_t> rounded = prices;
+		normalizer.roundPrices(slots.data(), rounded.data(), rounded.size(), rounding);
+		for (std::size_t i = 0; i < prices.size(); ++i)
+		{
+			int64_t rest = prices[i] % tickOf[i];
+			int64_t expected = prices[i] - rest;
+			if (rounding == OrderNormalizer::Rounding::Up && rest != 0)
+			{
+				expected += tickOf[i];
+			}
+			if (rounding == OrderNormalizer::Rounding::Nearest && 2 * rest >= tickOf[i])
+			{
+				expected += tickOf[i];
+			}
+			ASSERT_EQ(rounded[i], expected) << prices[i] << " tick " << tickOf[i];
+		}
+	}
+	std::vector<uint8_t> violations(prices.size());
+	std::vector<int64_t> quantities(prices.size(), 1);
+	normalizer.validate(slots.data(), prices.data(), quantities.data(), violations.data(), prices.size());
+	for (std::size_t i = 0; i < prices.size(); ++i)
+	{
+		ASSERT_EQ((violations[i] & OrderViolation::PriceOffTick) != 0, prices[i] % tickOf[i] != 0);
+	}
+}
+
 TEST(QueryHandlerTests, HandleGetQuery)
 {
 	JSONParser jsonParser;
@@ -51,6 +920,7 @@ TEST(QueryHandlerTests, HandleGetQuery)
 
 	QueryHandler queryHandler;
 	queryHandler.handleGetQuery(queryObject, jsonParser);
+	queryHandler.getAnswerWriter().flush();
 
 	ASSERT_EQ(jsonParser.getSymbolInfoMap().size(), 2);
 
@@ -181,6 +1051,1056 @@ TEST(QueryHandlerTests, GetQueryAfterUpdateQuery)
 	ASSERT_EQ(updatedInfo.at("stepSize"), "0.001");
 }
 
+TEST(QueryHandlerTests, GetAnswersAreCachedUntilTheSymbolChanges)
+{
+	const std::string answerFile = "answers_cache_test.json";
+	std::remove(answerFile.c_str());
+
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}})));
+	std::vector<std::string> answers;
+	{
+		AnswerWriter::Options options;
+		options.path = answerFile;
+		QueryHandler queryHandler(options);
+		auto get = [&](const char *symbol)
+		{
+			rapidjson::Document getDocument(rapidjson::kObjectType);
+			getDocument.AddMember("query_type", "GET", getDocument.GetAllocator());
+			getDocument.AddMember("symbol", rapidjson::StringRef(symbol), getDocument.GetAllocator());
+			queryHandler.dispatchQuery(getDocument, jsonParser);
+		};
+
+		std::uint64_t hits = metrics().answerCacheHits;
+		std::uint64_t misses = metrics().answerCacheMisses;
+		get("BTCUSDT");
+		get("BTCUSDT");
+		get("BTCUSDT");
+		ASSERT_EQ(metrics().answerCacheHits - hits, 2u);
+		ASSERT_EQ(metrics().answerCacheMisses - misses, 1u);
+
+		// UPDATE, refresh and DELETE each give the row a new version, the next GET rebuilds the answer
+		jsonParser.handleUpdate("BTCUSDT", {{"status", "BREAK"}});
+		get("BTCUSDT");
+		ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.10"}, {"ETHUSDT", "0.01"}})));
+		get("BTCUSDT");
+		get("ETHUSDT");
+		get("ETHUSDT");
+		jsonParser.handleDelete("ETHUSDT");
+		get("ETHUSDT");
+		ASSERT_EQ(metrics().answerCacheHits - hits, 3u);
+		ASSERT_EQ(metrics().answerCacheMisses - misses, 5u);
+	}
+
+	std::ifstream input(answerFile);
+	std::string line;
+	while (std::getline(input, line))
+	{
+		answers.push_back(line);
+	}
+	ASSERT_EQ(answers.size(), 8u);
+	ASSERT_EQ(answers[0], answers[2]);
+	ASSERT_EQ(answers[0], "{\"status\":\"TRADING\",\"tickSize\":\"0.01\",\"stepSize\":\"0.001\",\"quoteAsset\":\"USDT\"}");
+	ASSERT_NE(answers[3].find("\"status\":\"BREAK\""), std::string::npos);
+	ASSERT_NE(answers[4].find("\"status\":\"TRADING\",\"tickSize\":\"0.10\""), std::string::npos);
+	ASSERT_EQ(answers[5], answers[6]);
+	// The deleted symbol is unknown again
+	ASSERT_EQ(answers[7], "{}");
+	std::remove(answerFile.c_str());
+}
+
+TEST(QueryHandlerTests, GetQueryProjectsRequestedFields)
+{
+	SymbolField field;
+	ASSERT_TRUE(symbolFieldFromQueryName("ticksize", 8, field));
+	ASSERT_EQ(field, SymbolField::TickSize);
+	ASSERT_TRUE(symbolFieldFromQueryName("contract_type", 13, field));
+	ASSERT_EQ(field, SymbolField::ContractType);
+	ASSERT_FALSE(symbolFieldFromQueryName("tick", 4, field));
+	ASSERT_FALSE(symbolFieldFromQueryName("stepSizes", 9, field));
+
+	const std::string answerFile = "answers_projection_test.json";
+	std::remove(answerFile.c_str());
+
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(R"({"symbols":[{"symbol":"BTCUSDT","pair":"BTCUSDT","contractType":"PERPETUAL","status":"TRADING",
+		"baseAsset":"BTC","quoteAsset":"USDT","filters":[{"filterType":"PRICE_FILTER","tickSize":"0.10"},
+		{"filterType":"LOT_SIZE","stepSize":"0.001","minQty":"0.001"},{"filterType":"MARKET_LOT_SIZE","minQty":"0.010"},
+		{"filterType":"MIN_NOTIONAL","notional":"100"}]}]})"));
+	auto info = jsonParser.getSymbolInfo("BTCUSDT");
+	ASSERT_EQ(info.size(), 8u);
+	ASSERT_EQ(info.at("minQty"), "0.001");
+	ASSERT_EQ(info.at("baseAsset"), "BTC");
+
+	{
+		AnswerWriter::Options options;
+		options.path = answerFile;
+		QueryHandler queryHandler(options);
+		for (const char *query : {R"({"query_type":"GET","symbol":"BTCUSDT","data":["status","ticksize","contract_type","MINNOTIONAL","bogus"]})",
+								  R"({"query_type":"GET","symbol":"BTCUSDT"})",
+								  R"({"query_type":"GET","symbol":"BTCUSDT","data":["minQty","baseAsset"]})",
+								  R"({"query_type":"GET","symbol":"BTCUSDT","data":["ticksize","status","contract_type","minNotional"]})",
+								  R"({"query_type":"GET","symbol":"BTCUSDT","data":"status"})"})
+		{
+			rapidjson::Document queryDocument;
+			queryDocument.Parse(query);
+			queryHandler.dispatchQuery(queryDocument, jsonParser);
+		}
+	}
+
+	std::ifstream input(answerFile);
+	std::vector<std::string> answers;
+	std::string line;
+	while (std::getline(input, line))
+	{
+		answers.push_back(line);
+	}
+	ASSERT_EQ(answers.size(), 4u);
+	ASSERT_EQ(answers[0], R"({"status":"TRADING","tickSize":"0.10","contractType":"PERPETUAL","minNotional":"100"})");
+	ASSERT_EQ(answers[1], R"({"status":"TRADING","tickSize":"0.10","stepSize":"0.001","quoteAsset":"USDT"})");
+	ASSERT_EQ(answers[2], R"({"baseAsset":"BTC","minQty":"0.001"})");
+	// Same fields in another order is the same projection
+	ASSERT_EQ(answers[3], answers[0]);
+	std::remove(answerFile.c_str());
+}
+
+TEST(QueryHandlerTests, FieldRegistryResolvesAndValidatesUpdates)
+{
+	// Every name and exchangeInfo key comes back through the compile-time hash, nothing else does
+	for (const FieldSpec &spec : FieldRegistry::kSpecs)
+	{
+		SymbolField field;
+		ASSERT_TRUE(FieldRegistry::find(spec.name, std::strlen(spec.name), field));
+		ASSERT_EQ(field, spec.field);
+		ASSERT_EQ(FieldRegistry::nameLength(field), std::strlen(spec.name));
+		ASSERT_TRUE(FieldRegistry::findExchangeKey(spec.name, std::strlen(spec.name), field));
+		ASSERT_EQ(field, spec.field);
+	}
+	SymbolField field;
+	ASSERT_TRUE(FieldRegistry::findExchangeKey("notional", 8, field));
+	ASSERT_EQ(field, SymbolField::MinNotional);
+	ASSERT_FALSE(FieldRegistry::find("notional", 8, field));
+	ASSERT_FALSE(FieldRegistry::find("ticksize", 8, field));
+	ASSERT_TRUE(FieldRegistry::findLoose("TICK_SIZE", 9, field));
+	ASSERT_EQ(field, SymbolField::TickSize);
+	ASSERT_FALSE(FieldRegistry::find("", 0, field));
+	ASSERT_FALSE(FieldRegistry::findLoose("_", 1, field));
+	ASSERT_EQ(FieldRegistry::filterFields("LOT_SIZE", 8), symbolFieldBit(SymbolField::StepSize) | symbolFieldBit(SymbolField::MinQty));
+	ASSERT_EQ(FieldRegistry::filterFields("MIN_NOTIONAL", 12), symbolFieldBit(SymbolField::MinNotional));
+	ASSERT_EQ(FieldRegistry::filterFields("MAX_NUM_ORDERS", 14), 0);
+
+	constexpr std::array<const char *, 3> kTypeNames = {{"GET", "UPDATE", "DELETE"}};
+	constexpr NameTable<3> kTypes(kTypeNames);
+	static_assert(kTypes.complete(), "");
+	ASSERT_EQ(kTypes.find("UPDATE", 6), 1u);
+	ASSERT_EQ(kTypes.find("update", 6), 3u);
+	ASSERT_EQ(kTypes.find("GETX", 4), 3u);
+
+	JSONParser jsonParser;
+	jsonParser.setSymbolInfoMap({
+		{"BTCUSDT", {{"status", "TRADING"}, {"tickSize", "0.01"}, {"stepSize", "0.001"}, {"quoteAsset", "USDT"}}},
+	});
+	std::shared_ptr<const SymbolSnapshot> before = jsonParser.snapshot();
+	QueryHandler queryHandler;
+	rapidjson::Document queryObject;
+
+	// A malformed value, an unknown name, a value that is not a string or no field at all: the update is
+	// dropped whole and nothing is published
+	for (const char *data : {R"({"status":"BREAK","tickSize":"abc","stepSize":"0.01"})", R"({"status":"BREAK","volume":"1"})",
+							 R"({"status":"BREAK","stepSize":0.01})", "{}"})
+	{
+		queryObject.Parse((R"({"id":1,"query_type":"UPDATE","symbol":"BTCUSDT","data":)" + std::string(data) + "}").c_str());
+		queryHandler.dispatchQuery(queryObject, jsonParser);
+		ASSERT_EQ(jsonParser.snapshot(), before) << data;
+	}
+
+	queryObject.Parse(R"({"id":2,"query_type":"UPDATE","symbol":"BTCUSDT","data":{"status":"BREAK","stepSize":"0.01"}})");
+	queryHandler.dispatchQuery(queryObject, jsonParser);
+	const std::unordered_map<std::string, std::string> info = jsonParser.getSymbolInfo("BTCUSDT");
+	ASSERT_EQ(info.at("status"), "BREAK");
+	ASSERT_EQ(info.at("tickSize"), "0.01");
+	ASSERT_EQ(info.at("stepSize"), "0.01");
+}
+
+TEST(QueryHandlerTests, BatchMatchesSerialExecution)
+{
+	const std::vector<std::pair<std::string, std::string>> symbols = {{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}, {"BNBUSDT", "0.01"}, {"SOLUSDT", "0.01"}};
+	// Mostly GETs with UPDATEs and DELETEs of the same symbols in between, enough per group to be split
+	// over the pool
+	std::vector<rapidjson::Document> queries;
+	std::size_t gets = 0;
+	for (int i = 0; i < 4000; ++i)
+	{
+		rapidjson::Document query(rapidjson::kObjectType);
+		const char *type = i % 10 == 3 ? "UPDATE" : i % 97 == 5 ? "DELETE" : "GET";
+		gets += type[0] == 'G';
+		query.AddMember("query_type", rapidjson::StringRef(type), query.GetAllocator());
+		query.AddMember("symbol", rapidjson::StringRef(symbols[i % symbols.size()].first.c_str()), query.GetAllocator());
+		if (i % 10 == 3)
+		{
+			rapidjson::Value data(rapidjson::kObjectType);
+			rapidjson::Value tickSize(std::to_string(i).c_str(), query.GetAllocator());
+			data.AddMember("tickSize", tickSize, query.GetAllocator());
+			query.AddMember("data", data, query.GetAllocator());
+		}
+		queries.push_back(std::move(query));
+	}
+	std::vector<const rapidjson::Value *> batch;
+	for (const rapidjson::Document &query : queries)
+	{
+		batch.push_back(&query);
+	}
+
+	auto run = [&](std::size_t threads)
+	{
+		const std::string answerFile = "answers_batch_test.json";
+		std::remove(answerFile.c_str());
+		JSONParser jsonParser;
+		EXPECT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith(symbols)));
+		{
+			AnswerWriter::Options options;
+			options.path = answerFile;
+			QueryHandler queryHandler(options, threads);
+			queryHandler.handleBatch(batch, jsonParser);
+		}
+		std::ifstream input(answerFile);
+		std::vector<std::string> answers;
+		std::string line;
+		while (std::getline(input, line))
+		{
+			answers.push_back(line);
+		}
+		std::remove(answerFile.c_str());
+		return answers;
+	};
+
+	std::vector<std::string> serial = run(1);
+	std::vector<std::string> parallel = run(4);
+	ASSERT_EQ(serial.size(), gets);
+	ASSERT_EQ(parallel, serial);
+	// A GET right after an UPDATE of its symbol sees the new value
+	ASSERT_NE(std::find(serial.begin(), serial.end(), R"({"status":"TRADING","tickSize":"3","stepSize":"0.001","quoteAsset":"USDT"})"), serial.end());
+}
+
+TEST(QueryHandlerTests, QueryLogReadsOnlyAppendedRecords)
+{
+	JSONParser jsonParser;
+	jsonParser.setSymbolInfoMap({
+		{"BTCUSDT", {{"status", "TRADING"}, {"tickSize", "0.01"}, {"stepSize", "0.001"}, {"quoteAsset", "USDT"}}},
+		{"ETHUSDT", {{"status", "TRADING"}, {"tickSize", "0.02"}, {"stepSize", "0.002"}, {"quoteAsset", "USDT"}}},
+	});
+	QueryHandler queryHandler;
+	const std::string logFile = "query_log_test.ndjson";
+
+	std::string first = R"({"id":10,"query_type":"UPDATE","symbol":"BTCUSDT","data":{"status":"BREAK"}})"
+						"\n";
+	std::ofstream(logFile, std::ios::trunc) << first << R"({"id":11,"query_type":"DELETE","sym)";
+	queryHandler.handleQueryLog(logFile, jsonParser);
+
+	// The half-written second record is left for the next call
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "BREAK");
+	ASSERT_EQ(jsonParser.getSymbolInfo("ETHUSDT").size(), 4u);
+	ASSERT_EQ(queryHandler.getQueryLogOffset(), first.size());
+
+	std::ofstream(logFile, std::ios::app) << R"(bol":"ETHUSDT"})"
+										  << "\n"
+										  << R"({"id":10,"query_type":"UPDATE","symbol":"BTCUSDT","data":{"status":"TRADING"}})"
+										  << "\n";
+	queryHandler.handleQueryLog(logFile, jsonParser);
+
+	// The delete completes, the repeated id is skipped
+	ASSERT_TRUE(jsonParser.getSymbolInfo("ETHUSDT").empty());
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "BREAK");
+
+	// Nothing new, nothing happens
+	std::uint64_t offset = queryHandler.getQueryLogOffset();
+	queryHandler.handleQueryLog(logFile, jsonParser);
+	ASSERT_EQ(queryHandler.getQueryLogOffset(), offset);
+
+	// Truncating the log starts it over from the beginning, with its ids
+	std::ofstream(logFile, std::ios::trunc) << R"({"id":10,"query_type":"UPDATE","symbol":"BTCUSDT","data":{"status":"HALT"}})"
+											<< "\n";
+	queryHandler.handleQueryLog(logFile, jsonParser);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "HALT");
+	std::remove(logFile.c_str());
+}
+
+TEST(QueryHandlerTests, RemovedDocumentIdsDoNotRunAgain)
+{
+	JSONParser jsonParser;
+	jsonParser.setSymbolInfoMap({
+		{"BTCUSDT", {{"status", "TRADING"}, {"tickSize", "0.01"}, {"stepSize", "0.001"}, {"quoteAsset", "USDT"}}},
+	});
+	QueryHandler queryHandler;
+	const std::string queryFile = "query_readd_test.json";
+	const std::string update = R"({"id":1,"query_type":"UPDATE","symbol":"BTCUSDT","data":{"status":"BREAK"}})";
+
+	std::ofstream(queryFile, std::ios::trunc) << R"({"query":[)" << update << "]}";
+	queryHandler.handleQueries(queryFile, jsonParser);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "BREAK");
+	jsonParser.handleUpdate("BTCUSDT", {{"status", "TRADING"}});
+
+	// Dropped from the file and written back: it already ran
+	std::ofstream(queryFile, std::ios::trunc) << R"({"query":[]})";
+	queryHandler.handleQueries(queryFile, jsonParser);
+	std::ofstream(queryFile, std::ios::trunc) << R"({"query":[)" << update << "]}";
+	queryHandler.handleQueries(queryFile, jsonParser);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("status"), "TRADING");
+	std::remove(queryFile.c_str());
+}
+
+TEST(QueryHandlerTests, SteadyStateQueriesDoNotAllocate)
+{
+	// A document that spills out of the arena grows it; the same document then fits without the heap
+	JsonArena arena(1024, 1024);
+	arena.document();
+	arena.document().GetAllocator().Malloc(4096);
+	arena.document().GetAllocator().Malloc(4096);
+	std::size_t grown = arena.heapAllocations();
+	for (int i = 0; i < 10; ++i)
+	{
+		arena.document().GetAllocator().Malloc(4096);
+	}
+	arena.document();
+	ASSERT_EQ(arena.heapAllocations(), grown);
+	ASSERT_GE(arena.capacity(), 4096u);
+
+	// Re-reading a query file of the same shape reuses the arena and the id lists
+	const std::string queryFile = "query_arena_test.json";
+	const std::string answerFile = "answers_arena_test.json";
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}})));
+	AnswerWriter::Options options;
+	options.path = answerFile;
+	QueryHandler queryHandler(options);
+	auto writeQueries = [&](int firstId)
+	{
+		std::ofstream out(queryFile, std::ios::trunc);
+		out << R"({"query":[)";
+		for (int i = 0; i < 200; ++i)
+		{
+			out << (i ? "," : "") << R"({"id":)" << firstId + i << R"(,"query_type":"GET","symbol":")" << (i % 2 ? "BTCUSDT" : "ETHUSDT") << R"("})";
+		}
+		out << "]}";
+	};
+	for (int tick = 0; tick < 3; ++tick)
+	{
+		writeQueries(1000 + tick * 200);
+		queryHandler.handleQueries(queryFile, jsonParser);
+	}
+	std::size_t warm = queryHandler.getArenaHeapAllocations();
+	for (int tick = 3; tick < 10; ++tick)
+	{
+		writeQueries(1000 + tick * 200);
+		queryHandler.handleQueries(queryFile, jsonParser);
+	}
+	ASSERT_EQ(queryHandler.getArenaHeapAllocations(), warm);
+
+	// A GET answered from the cache allocates nothing at all
+	rapidjson::Document getDocument(rapidjson::kObjectType);
+	getDocument.AddMember("query_type", "GET", getDocument.GetAllocator());
+	getDocument.AddMember("symbol", "BTCUSDT", getDocument.GetAllocator());
+	spdlog::level::level_enum level = logger->level();
+	logger->set_level(spdlog::level::info);
+	queryHandler.dispatchQuery(getDocument, jsonParser);
+	std::size_t allocations = countedAllocations([&]
+												 {
+													 for (int i = 0; i < 1000; ++i)
+													 {
+														 queryHandler.dispatchQuery(getDocument, jsonParser);
+													 } });
+	logger->set_level(level);
+	ASSERT_EQ(allocations, 0u);
+	std::remove(queryFile.c_str());
+	std::remove(answerFile.c_str());
+}
+
+TEST(QueryHandlerTests, WatcherWakesOnWrite)
+{
+	const std::string queryFile = "query_watch_test.ndjson";
+	std::ofstream(queryFile, std::ios::trunc);
+	QueryFileWatcher watcher(queryFile);
+
+	ASSERT_FALSE(watcher.waitForChange(std::chrono::milliseconds(50)));
+
+	std::thread writer([&queryFile]
+					   {
+						   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+						   std::ofstream(queryFile, std::ios::app) << "{}\n"; });
+	auto start = std::chrono::steady_clock::now();
+	ASSERT_TRUE(watcher.waitForChange(std::chrono::seconds(5)));
+	writer.join();
+	ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+	std::remove(queryFile.c_str());
+}
+
+TEST(QueryServerTests, PipelinedRequestsAnswerInOrder)
+{
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}})));
+	const std::string socketPath = "query_server_test.sock";
+	QueryServer server(jsonParser, socketPath);
+
+	// Everything is sent before the first response is read
+	std::vector<WireQuery> queries(9);
+	queries[0].symbol = "BTCUSDT";
+	queries[1].type = WireQueryType::Update;
+	queries[1].symbol = "BTCUSDT";
+	queries[1].updates = {{SymbolField::TickSize, "0.5"}};
+	queries[2].symbol = "BTCUSDT";
+	queries[2].fields = symbolFieldBit(SymbolField::TickSize);
+	queries[3].type = WireQueryType::Delete;
+	queries[3].symbol = "ETHUSDT";
+	queries[4].symbol = "ETHUSDT";
+	queries[5].symbol = "BTCUSDT";
+	queries[5].market = "no-such-market";
+	queries[6].type = WireQueryType::Delete;
+	queries[6].symbol = "XRPUSDT";
+	queries[7].type = WireQueryType::Update;
+	queries[7].symbol = "BTCUSDT";
+	queries[7].updates = {{SymbolField::StepSize, "0.1"}, {SymbolField::TickSize, "abc"}};
+	queries[8].type = WireQueryType::Update;
+	queries[8].symbol = "XRPUSDT";
+	queries[8].updates = {{SymbolField::MinQty, "1e"}};
+	std::string requests;
+	for (std::size_t i = 0; i < queries.size(); ++i)
+	{
+		queries[i].id = static_cast<uint32_t>(100 + i);
+		encodeWireQuery(queries[i], requests);
+	}
+
+	boost::asio::io_context ioc;
+	boost::asio::local::stream_protocol::socket socket(ioc);
+	socket.connect(boost::asio::local::stream_protocol::endpoint(socketPath));
+	boost::asio::write(socket, boost::asio::buffer(requests));
+
+	std::vector<std::pair<WireStatus, std::string>> responses;
+	for (std::size_t i = 0; i < queries.size(); ++i)
+	{
+		uint32_t length;
+		boost::asio::read(socket, boost::asio::buffer(&length, sizeof(length)));
+		std::vector<char> body(length);
+		boost::asio::read(socket, boost::asio::buffer(body));
+		uint32_t id;
+		WireStatus status;
+		const char *answer;
+		std::size_t size;
+		ASSERT_TRUE(decodeWireResponse(body.data(), body.size(), id, status, answer, size));
+		ASSERT_EQ(id, queries[i].id);
+		responses.emplace_back(status, std::string(answer, size));
+	}
+	ASSERT_EQ(responses[0], std::make_pair(WireStatus::Ok, std::string(R"({"status":"TRADING","tickSize":"0.01","stepSize":"0.001","quoteAsset":"USDT"})")));
+	ASSERT_EQ(responses[1], std::make_pair(WireStatus::Ok, std::string()));
+	ASSERT_EQ(responses[2], std::make_pair(WireStatus::Ok, std::string(R"({"tickSize":"0.5"})")));
+	ASSERT_EQ(responses[3].first, WireStatus::Ok);
+	ASSERT_EQ(responses[4].first, WireStatus::NotFound);
+	ASSERT_EQ(responses[5].first, WireStatus::BadRequest);
+	ASSERT_EQ(responses[6].first, WireStatus::NotFound);
+	// A malformed value rejects the whole update
+	ASSERT_EQ(responses[7].first, WireStatus::BadRequest);
+	// Values are checked before the symbol is looked up
+	ASSERT_EQ(responses[8].first, WireStatus::BadRequest);
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("tickSize"), "0.5");
+	ASSERT_EQ(jsonParser.getSymbolInfo("BTCUSDT").at("stepSize"), "0.001");
+	ASSERT_EQ(server.getRequestCount(), queries.size());
+
+	// A frame over the limit closes the connection without an answer
+	uint32_t oversized = kMaxWireFrame + 1;
+	boost::asio::write(socket, boost::asio::buffer(&oversized, sizeof(oversized)));
+	boost::system::error_code ec;
+	char byte;
+	boost::asio::read(socket, boost::asio::buffer(&byte, 1), ec);
+	ASSERT_EQ(ec, boost::asio::error::eof);
+}
+
+TEST(AnswerWriterTests, BatchesAnswersIntoValidNDJSON)
+{
+	const std::string answerFile = "answers_ndjson_test.json";
+	std::remove(answerFile.c_str());
+	{
+		AnswerWriter::Options options;
+		options.path = answerFile;
+		options.flushInterval = std::chrono::hours(1);
+		AnswerWriter answerWriter(options);
+		for (int i = 0; i < 1000; ++i)
+		{
+			answerWriter.writeWith([i](AnswerWriter::JSONWriter &writer)
+							   {
+								   writer.StartObject();
+								   writer.Key("id");
+								   writer.Int(i);
+								   writer.EndObject(); });
+		}
+		// The first answer goes out on its own, the rest are still one pending batch
+		ASSERT_EQ(answerWriter.getFlushCount(), 1u);
+		answerWriter.flush();
+		ASSERT_EQ(answerWriter.getFlushCount(), 2u);
+	}
+
+	std::ifstream input(answerFile);
+	std::string line;
+	int expected = 0;
+	while (std::getline(input, line))
+	{
+		rapidjson::Document answer;
+		answer.Parse(line.c_str());
+		ASSERT_FALSE(answer.HasParseError());
+		ASSERT_EQ(answer["id"].GetInt(), expected++);
+	}
+	ASSERT_EQ(expected, 1000);
+	std::remove(answerFile.c_str());
+}
+
+TEST(AnswerWriterTests, WritesOneJSONArray)
+{
+	const std::string answerFile = "answers_array_test.json";
+	{
+		AnswerWriter::Options options;
+		options.path = answerFile;
+		options.format = AnswerWriter::Format::JSONArray;
+		options.backgroundFlush = true;
+		options.flushInterval = std::chrono::milliseconds(10);
+		AnswerWriter answerWriter(options);
+
+		rapidjson::Document answer(rapidjson::kObjectType);
+		answer.AddMember("status", "TRADING", answer.GetAllocator());
+		answerWriter.write(answer);
+		answerWriter.write(answer);
+
+		// The timer thread pushes the batch out without another write
+		for (int i = 0; i < 200 && answerWriter.getFlushCount() == 0; ++i)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		ASSERT_GE(answerWriter.getFlushCount(), 1u);
+
+		// Complete JSON while the writer is still open, and again after a later batch
+		for (std::size_t expected : {2u, 3u})
+		{
+			answerWriter.flush();
+			std::ifstream input(answerFile);
+			std::ostringstream contents;
+			contents << input.rdbuf();
+			rapidjson::Document answers;
+			answers.Parse(contents.str().c_str());
+			ASSERT_FALSE(answers.HasParseError());
+			ASSERT_EQ(answers.Size(), expected);
+			answerWriter.write(answer);
+		}
+	}
+
+	std::ifstream input(answerFile);
+	std::ostringstream contents;
+	contents << input.rdbuf();
+	rapidjson::Document answers;
+	answers.Parse(contents.str().c_str());
+	ASSERT_FALSE(answers.HasParseError());
+	ASSERT_TRUE(answers.IsArray());
+	ASSERT_EQ(answers.Size(), 4u);
+	ASSERT_STREQ(answers[1]["status"].GetString(), "TRADING");
+	std::remove(answerFile.c_str());
+}
+
+TEST(MappedFileTests, MapsRegularFilesAndReadsPipes)
+{
+	const std::string path = "mapped_file_test.json";
+	const std::string contents = R"({"query":[{"id":1,"query_type":"GET","symbol":"BTCUSDT"}]})";
+	{
+		std::ofstream file(path, std::ios::trunc);
+		file << contents;
+	}
+
+	// A file filling whole pages still ends in a NUL
+	{
+		std::ofstream file(path + ".pages", std::ios::trunc);
+		file << std::string(2 * 4096, ' ');
+	}
+	MappedFile pages;
+	ASSERT_TRUE(pages.open(path + ".pages"));
+	ASSERT_TRUE(pages.isMapped());
+	ASSERT_EQ(pages.size(), 2u * 4096);
+	ASSERT_EQ(pages.data()[pages.size()], '\0');
+	pages.close();
+	std::remove((path + ".pages").c_str());
+
+	MappedFile file;
+	ASSERT_TRUE(file.open(path));
+	ASSERT_TRUE(file.isMapped());
+	ASSERT_EQ(std::string(file.data(), file.size()), contents);
+	ASSERT_EQ(file.data()[file.size()], '\0');
+	rapidjson::Document document;
+	document.Parse(file.data());
+	ASSERT_FALSE(document.HasParseError());
+	ASSERT_EQ(document["query"].Size(), 1u);
+
+	// read() copies instead, so truncating the file afterwards leaves the view intact
+	ASSERT_TRUE(file.read(path));
+	ASSERT_FALSE(file.isMapped());
+	{
+		std::ofstream truncated(path, std::ios::trunc);
+	}
+	ASSERT_EQ(std::string(file.data(), file.size()), contents);
+	ASSERT_EQ(file.data()[file.size()], '\0');
+	ASSERT_TRUE(file.read(path));
+	ASSERT_EQ(file.size(), 0u);
+
+	// Empty and missing files
+	{
+		std::ofstream empty(path, std::ios::trunc);
+	}
+	ASSERT_TRUE(file.open(path));
+	ASSERT_EQ(file.size(), 0u);
+	ASSERT_STREQ(file.data(), "");
+	std::remove(path.c_str());
+	ASSERT_FALSE(file.open(path));
+	ASSERT_EQ(errno, ENOENT);
+
+	// A pipe has no size to map and is read until the writer closes it
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+	std::string large(200000, 'x');
+	std::thread writer([&]
+					   {
+						   std::size_t sent = 0;
+						   while (sent < large.size())
+						   {
+							   ssize_t count = write(fds[1], large.data() + sent, large.size() - sent);
+							   if (count <= 0)
+							   {
+								   break;
+							   }
+							   sent += static_cast<std::size_t>(count);
+						   }
+						   close(fds[1]); });
+	ASSERT_TRUE(file.open("/proc/self/fd/" + std::to_string(fds[0])));
+	writer.join();
+	close(fds[0]);
+	ASSERT_FALSE(file.isMapped());
+	ASSERT_EQ(file.size(), large.size());
+	ASSERT_EQ(std::string(file.data(), file.size()), large);
+	ASSERT_EQ(file.data()[file.size()], '\0');
+}
+
+TEST(LoggingTests, AsyncLoggerFromConfig)
+{
+	const std::string logFile = "logging_test.log";
+	std::remove(logFile.c_str());
+	std::string config = R"({"logging":{"level":"warn","file":")" + logFile + R"(","console":false,"async":true,"queue_size":64,"overflow":"overrun_oldest"}})";
+	rapidjson::Document configDocument;
+	configDocument.Parse(config.c_str());
+
+	LoggingOptions options;
+	std::string error;
+	ASSERT_TRUE(readLoggingOptions(configDocument, options, error));
+	ASSERT_EQ(options.level, spdlog::level::warn);
+	ASSERT_EQ(options.queueSize, 64u);
+	ASSERT_EQ(options.overflowPolicy, spdlog::async_overflow_policy::overrun_oldest);
+
+	std::shared_ptr<spdlog::logger> asyncLogger = createLogger("logging_test", options);
+	SPDLOG_LOGGER_DEBUG(asyncLogger, "dropped by level {}", 1);
+	asyncLogger->warn("kept {}", 2);
+	asyncLogger->flush();
+	spdlog::drop("logging_test");
+	asyncLogger.reset();
+
+	// The record is written by the pool thread, give it a moment
+	std::string contents;
+	for (int i = 0; i < 200 && contents.find("kept 2") == std::string::npos; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		std::ifstream input(logFile);
+		contents.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+	}
+	ASSERT_NE(contents.find("kept 2"), std::string::npos);
+	ASSERT_EQ(contents.find("dropped"), std::string::npos);
+	std::remove(logFile.c_str());
+
+	rapidjson::Document badConfig;
+	badConfig.Parse(R"({"logging":{"overflow":"sometimes"}})");
+	ASSERT_FALSE(readLoggingOptions(badConfig, options, error));
+}
+
+TEST(SymbolTableTests, FixedDecimalRoundTrip)
+{
+	for (const std::string text : {"0.01000000", "0.10", "1", "1000.5", "-0.001", ""})
+	{
+		FixedDecimal value;
+		ASSERT_TRUE(FixedDecimal::parse(text, value)) << text;
+		ASSERT_EQ(value.toString(), text);
+	}
+
+	FixedDecimal tick;
+	ASSERT_TRUE(FixedDecimal::parse("0.01000000", tick));
+	ASSERT_EQ(tick.mantissa, 1000000);
+	ASSERT_EQ(tick.scale, 8);
+
+	FixedDecimal invalid;
+	ASSERT_FALSE(FixedDecimal::parse("abc", invalid));
+	ASSERT_FALSE(FixedDecimal::parse("1.", invalid));
+	ASSERT_FALSE(FixedDecimal::parse("0.0000000000000000001", invalid));
+}
+
+TEST(SymbolTableTests, DeletedSymbolKeepsItsId)
+{
+	SymbolTable table;
+	SymbolTable::SymbolId btc = table.insert("BTCUSDT");
+	SymbolTable::SymbolId eth = table.insert("ETHUSDT");
+	table.setStatus(btc, "TRADING");
+	table.setQuoteAsset(eth, "USDT");
+
+	ASSERT_EQ(table.status(btc), SymbolStatus::Trading);
+	ASSERT_EQ(table.quoteAsset(eth), QuoteAsset::USDT);
+	ASSERT_EQ(table.size(), 2u);
+
+	ASSERT_TRUE(table.erase("BTCUSDT"));
+	ASSERT_EQ(table.find("BTCUSDT"), SymbolTable::npos);
+	ASSERT_EQ(table.size(), 1u);
+
+	ASSERT_EQ(table.insert("BTCUSDT"), btc);
+	ASSERT_FALSE(table.hasField(btc, SymbolField::Status));
+
+	// Values outside the known enum still round-trip as text
+	ASSERT_TRUE(table.setField(btc, "status", "PENDING"));
+	ASSERT_EQ(table.statusText(btc), "PENDING");
+	ASSERT_FALSE(table.setField(btc, "tickSize", "not-a-number"));
+	ASSERT_FALSE(table.setField(btc, "unknown", "1"));
+
+	// The status column has 256 codes; once they are taken new values are refused, known ones still fit
+	int accepted = 0;
+	while (accepted < 300 && table.setField(btc, "status", "STATUS" + std::to_string(accepted)))
+	{
+		++accepted;
+	}
+	ASSERT_LT(accepted, 256);
+	ASSERT_EQ(table.statusText(btc), "STATUS" + std::to_string(accepted - 1));
+	ASSERT_TRUE(table.setField(btc, "status", "PENDING"));
+
+	// An UPDATE carrying such a value is dropped whole instead of throwing
+	JSONParser jsonParser;
+	jsonParser.setSymbolInfoMap({
+		{"BTCUSDT", {{"status", "TRADING"}, {"tickSize", "0.01"}, {"stepSize", "0.001"}, {"quoteAsset", "USDT"}}},
+	});
+	for (int i = 0; i < 300; ++i)
+	{
+		jsonParser.handleUpdate("BTCUSDT", std::unordered_map<std::string, std::string>{{"tickSize", "0.02"}, {"status", "STATUS" + std::to_string(i)}});
+	}
+	const std::unordered_map<std::string, std::string> info = jsonParser.getSymbolInfo("BTCUSDT");
+	ASSERT_EQ(info.at("tickSize"), "0.02");
+	ASSERT_NE(info.at("status"), "STATUS299");
+}
+
+TEST(SymbolTableTests, ManySymbolsStayAddressable)
+{
+	SymbolTable table;
+	for (int i = 0; i < 5000; ++i)
+	{
+		SymbolTable::SymbolId id = table.insert("SYM" + std::to_string(i));
+		table.setTickSize(id, FixedDecimal{i, 2});
+	}
+	for (int i = 0; i < 5000; ++i)
+	{
+		SymbolTable::SymbolId id = table.find("SYM" + std::to_string(i));
+		ASSERT_NE(id, SymbolTable::npos);
+		ASSERT_EQ(table.tickSize(id).mantissa, i);
+	}
+	ASSERT_GT(table.memoryUsage(), 0u);
+}
+
+TEST(SymbolSnapshotTests, EditsPublishNewVersions)
+{
+	JSONParser jsonParser;
+	jsonParser.setSymbolInfoMap({
+		{"BTCUSDT", {{"status", "TRADING"}, {"tickSize", "0.01"}, {"stepSize", "0.001"}, {"quoteAsset", "USDT"}}},
+		{"ETHUSDT", {{"status", "TRADING"}, {"tickSize", "0.02"}, {"stepSize", "0.002"}, {"quoteAsset", "USDT"}}},
+	});
+	std::shared_ptr<const SymbolSnapshot> before = jsonParser.snapshot();
+
+	jsonParser.handleUpdate("BTCUSDT", {{"status", "BREAK"}});
+	jsonParser.handleDelete("ETHUSDT");
+	std::shared_ptr<const SymbolSnapshot> after = jsonParser.snapshot();
+
+	// The version a reader already holds does not change underneath it
+	ASSERT_EQ(before->toMap("BTCUSDT").at("status"), "TRADING");
+	ASSERT_TRUE(before->find("ETHUSDT"));
+	ASSERT_EQ(before->size(), 2u);
+
+	ASSERT_EQ(after->toMap("BTCUSDT").at("status"), "BREAK");
+	ASSERT_EQ(after->toMap("BTCUSDT").at("tickSize"), "0.01");
+	ASSERT_FALSE(after->find("ETHUSDT"));
+	ASSERT_EQ(after->size(), 1u);
+	ASSERT_EQ(after->deltaRows(), 2u);
+
+	// Enough edits fold the delta back into the base
+	for (int i = 0; i < 200; ++i)
+	{
+		jsonParser.setSymbolInfo("SYM" + std::to_string(i), {{"status", "TRADING"}});
+	}
+	std::shared_ptr<const SymbolSnapshot> compacted = jsonParser.snapshot();
+	ASSERT_EQ(compacted->size(), 201u);
+	ASSERT_LT(compacted->deltaRows(), 200u);
+	ASSERT_EQ(compacted->toMap("BTCUSDT").at("status"), "BREAK");
+	ASSERT_FALSE(compacted->find("ETHUSDT"));
+	ASSERT_EQ(jsonParser.getSymbolInfoMap().size(), 201u);
+}
+
+TEST(SymbolSnapshotTests, ReadersSeeWholeUpdatesWhileWriterRuns)
+{
+	const int kSymbols = 256;
+	const int kReaders = 4;
+	JSONParser jsonParser;
+	std::unordered_map<std::string, std::unordered_map<std::string, std::string>> symbols;
+	for (int i = 0; i < kSymbols; ++i)
+	{
+		symbols["SYM" + std::to_string(i)] = {{"status", "TRADING"}, {"tickSize", "0"}, {"stepSize", "0"}};
+	}
+	jsonParser.setSymbolInfoMap(symbols);
+
+	// The writer always sets tickSize and stepSize to the same value in one UPDATE, so a reader that
+	// finds them different has seen half of an update
+	std::atomic<bool> done{false};
+	std::atomic<std::size_t> torn{0};
+	std::atomic<std::size_t> reads{0};
+	std::vector<std::thread> readers;
+	for (int r = 0; r < kReaders; ++r)
+	{
+		readers.emplace_back([&, r]
+							 {
+								 std::size_t next = static_cast<std::size_t>(r);
+								 while (!done)
+								 {
+									 std::shared_ptr<const SymbolSnapshot> view = jsonParser.snapshot();
+									 SymbolSnapshot::Row row = view->find("SYM" + std::to_string(next++ % kSymbols));
+									 if (row && row.table->tickSize(row.id).toString() != row.table->stepSize(row.id).toString())
+									 {
+										 ++torn;
+									 }
+									 ++reads;
+								 } });
+	}
+
+	for (int i = 1; i <= 3000; ++i)
+	{
+		std::string symbol = "SYM" + std::to_string(i % kSymbols);
+		std::string value = std::to_string(i);
+		if (i % 100 == 0)
+		{
+			jsonParser.handleDelete(symbol);
+			jsonParser.setSymbolInfo(symbol, {{"status", "TRADING"}, {"tickSize", value}, {"stepSize", value}});
+		}
+		else
+		{
+			jsonParser.handleUpdate(symbol, {{"tickSize", value}, {"stepSize", value}});
+		}
+	}
+	done = true;
+	for (std::thread &reader : readers)
+	{
+		reader.join();
+	}
+
+	ASSERT_EQ(torn.load(), 0u);
+	ASSERT_GT(reads.load(), 0u);
+	ASSERT_EQ(jsonParser.snapshot()->size(), static_cast<std::size_t>(kSymbols));
+	ASSERT_EQ(jsonParser.getSymbolInfo("SYM" + std::to_string(3000 % kSymbols)).at("tickSize"), "3000");
+}
+
+TEST(SharedSymbolTests, ForkedReadersNeverSeeTornRecords)
+{
+	const int kSymbols = 64;
+	const int kReaders = 2;
+	const std::string segmentName = "/binance_symbols_test_" + std::to_string(::getpid());
+
+	// Two versions of every symbol, one with all decimals 1 and one with all 2. The writer flips the
+	// whole segment between them as fast as it can, so a reader that finds a record mixing 1s and 2s
+	// has seen half of one write and half of another.
+	std::shared_ptr<const SymbolSnapshot> versions[2];
+	for (int v = 0; v < 2; ++v)
+	{
+		SymbolTable table;
+		FixedDecimal value{v + 1, 0};
+		for (int i = 0; i < kSymbols; ++i)
+		{
+			SymbolTable::SymbolId id = table.insert("SYM" + std::to_string(i));
+			table.setStatus(id, "TRADING");
+			table.setTickSize(id, value);
+			table.setStepSize(id, value);
+			table.setMinQty(id, value);
+			table.setMinNotional(id, value);
+		}
+		versions[v] = std::make_shared<const SymbolSnapshot>(std::move(table));
+	}
+	auto publisher = std::make_unique<SharedSymbolPublisher>(segmentName, kSymbols);
+	publisher->publishAll(*versions[0]);
+
+	// Readers are separate processes using only the header-only reader; they run until the segment is
+	// retired and report through their exit code
+	int ready[2];
+	ASSERT_EQ(::pipe(ready), 0);
+	std::vector<pid_t> readers;
+	for (int r = 0; r < kReaders; ++r)
+	{
+		pid_t pid = ::fork();
+		ASSERT_GE(pid, 0);
+		if (pid == 0)
+		{
+			SharedSymbolReader reader;
+			char byte = 1;
+			if (!reader.open(segmentName) || reader.rowCount() != kSymbols || ::write(ready[1], &byte, 1) != 1)
+			{
+				::_exit(3);
+			}
+			std::size_t torn = 0;
+			std::size_t seen[2] = {};
+			SharedSymbolData data;
+			for (uint32_t next = static_cast<uint32_t>(r); !reader.retired(); ++next)
+			{
+				if (reader.read(next % kSymbols, data))
+				{
+					torn += data.tickMantissa != data.stepMantissa || data.tickMantissa != data.minQtyMantissa || data.tickMantissa != data.minNotionalMantissa;
+					++seen[(data.tickMantissa - 1) & 1];
+				}
+			}
+			::_exit(torn > 0 ? 1 : seen[0] == 0 || seen[1] == 0 ? 2 : 0);
+		}
+		readers.push_back(pid);
+	}
+	for (int r = 0; r < kReaders; ++r)
+	{
+		char byte;
+		ASSERT_EQ(::read(ready[0], &byte, 1), 1);
+	}
+	::close(ready[0]);
+	::close(ready[1]);
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+	for (int round = 1; std::chrono::steady_clock::now() < deadline; ++round)
+	{
+		publisher->publishAll(*versions[round & 1]);
+	}
+	publisher.reset();
+
+	for (pid_t pid : readers)
+	{
+		int status = 0;
+		ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+		ASSERT_TRUE(WIFEXITED(status));
+		ASSERT_EQ(WEXITSTATUS(status), 0);
+	}
+	ASSERT_FALSE(SharedSymbolReader().open(segmentName));
+}
+
+TEST(SharedSymbolTests, ParserMirrorsUpdatesAndDeletes)
+{
+	const std::string segmentName = "/binance_symbols_test_" + std::to_string(::getpid());
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}, {"ETHUSDT", "0.01"}})));
+	ASSERT_TRUE(jsonParser.setSharedMemory(segmentName, 16));
+
+	SharedSymbolReader reader;
+	ASSERT_TRUE(reader.open(segmentName));
+	uint32_t bitcoin = reader.find("BTCUSDT");
+	SharedSymbolData data;
+	ASSERT_TRUE(reader.read(bitcoin, data));
+	ASSERT_STREQ(data.statusText, "TRADING");
+	ASSERT_EQ(data.status, static_cast<uint8_t>(SymbolStatus::Trading));
+	ASSERT_STREQ(data.quoteAsset, "USDT");
+	ASSERT_DOUBLE_EQ(data.tickSize(), 0.01);
+	ASSERT_TRUE(std::isnan(data.minNotional()));
+
+	uint64_t published = reader.publishCount();
+	jsonParser.handleUpdate("BTCUSDT", {{"tickSize", "0.5"}, {"status", "HALT"}});
+	ASSERT_GT(reader.publishCount(), published);
+	ASSERT_TRUE(reader.read(bitcoin, data));
+	ASSERT_DOUBLE_EQ(data.tickSize(), 0.5);
+	ASSERT_STREQ(data.statusText, "HALT");
+
+	// A deleted symbol keeps its slot and comes back in it
+	jsonParser.handleDelete("BTCUSDT");
+	ASSERT_FALSE(reader.read(bitcoin, data));
+	jsonParser.setSymbolInfo("BTCUSDT", {{"status", "TRADING"}, {"tickSize", "0.1"}});
+	ASSERT_EQ(reader.find("BTCUSDT"), bitcoin);
+	ASSERT_TRUE(reader.read(bitcoin, data));
+	ASSERT_DOUBLE_EQ(data.tickSize(), 0.1);
+
+	// A refresh that delists a symbol removes it from the segment as well
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(exchangeInfoWith({{"BTCUSDT", "0.01"}})));
+	ASSERT_FALSE(reader.read(reader.find("ETHUSDT"), data));
+	ASSERT_EQ(reader.find("XRPUSDT"), SharedSymbolReader::npos);
+
+	ASSERT_FALSE(reader.retired());
+	jsonParser.setSharedMemory("", 0);
+	ASSERT_TRUE(reader.retired());
+}
+
+TEST(MetricsTests, HistogramQuantilesAndPrometheusEndpoint)
+{
+	auto histogram = std::make_unique<LatencyHistogram>();
+	std::vector<std::thread> writers;
+	for (int t = 0; t < 4; ++t)
+	{
+		writers.emplace_back([&histogram]
+							 {
+								 for (std::uint64_t value = 1; value <= 10000; ++value)
+								 {
+									 histogram->record(value * 1000);
+								 } });
+	}
+	for (std::thread &writer : writers)
+	{
+		writer.join();
+	}
+
+	// Buckets are at most ~3% wide, so the quantiles land just above the exact values
+	LatencyHistogram::Snapshot snapshot = histogram->snapshot();
+	ASSERT_EQ(snapshot.count, 40000u);
+	ASSERT_EQ(snapshot.sumNs, 4ull * 1000 * 10000 * 10001 / 2);
+	ASSERT_GE(snapshot.quantileNs(0.5), 5000000u);
+	ASSERT_LE(snapshot.quantileNs(0.5), 5160000u);
+	ASSERT_GE(snapshot.quantileNs(0.99), 9900000u);
+	ASSERT_LE(snapshot.quantileNs(0.99), 10220000u);
+	ASSERT_EQ(LatencyHistogram::bucketIndex(63), 63u);
+	ASSERT_EQ(LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(1000)), 1007u);
+	ASSERT_EQ(LatencyHistogram::bucketIndex(UINT64_MAX), LatencyHistogram::kBuckets - 1);
+
+	JSONParser jsonParser;
+	ASSERT_TRUE(jsonParser.performJSONDataParsing(kExchangeInfoSample));
+	rapidjson::Document getQuery;
+	getQuery.Parse(R"({"id": 1, "query_type": "GET", "symbol": "BTCUSDT"})");
+	QueryHandler queryHandler;
+	queryHandler.dispatchQuery(getQuery, jsonParser);
+
+	MetricsOptions options;
+	options.listen = true;
+	options.port = 0;
+	MetricsExporter exporter(options);
+	ASSERT_NE(exporter.port(), 0);
+
+	namespace http = boost::beast::http;
+	auto scrape = [&exporter](const std::string &target)
+	{
+		boost::asio::io_context ioc;
+		boost::asio::ip::tcp::socket socket(ioc);
+		socket.connect({boost::asio::ip::make_address("127.0.0.1"), exporter.port()});
+		http::request<http::empty_body> request{http::verb::get, target, 11};
+		request.set(http::field::host, "127.0.0.1");
+		http::write(socket, request);
+		boost::beast::flat_buffer buffer;
+		http::response<http::string_body> response;
+		http::read(socket, buffer, response);
+		return response;
+	};
+
+	http::response<http::string_body> response = scrape("/metrics");
+	ASSERT_EQ(response.result(), http::status::ok);
+	const std::string &text = response.body();
+	ASSERT_NE(text.find("# TYPE binance_http_phase_seconds summary"), std::string::npos);
+	ASSERT_NE(text.find("binance_http_phase_seconds{phase=\"handshake\",quantile=\"0.99\"}"), std::string::npos);
+	ASSERT_EQ(text.find("binance_query_seconds_count{type=\"GET\"} 0\n"), std::string::npos);
+	ASSERT_NE(text.find("binance_query_seconds_count{type=\"GET\"}"), std::string::npos);
+	ASSERT_EQ(text.find("binance_parse_bytes_total 0\n"), std::string::npos);
+	ASSERT_EQ(scrape("/other").result(), http::status::not_found);
+}
+
 int main(int argc, char **argv)
 {
 	setenv("GTEST_LOG", "INFO", 1);
@@ -0,0 +1,138 @@
+#ifndef LOCAL_WEBSOCKET_SERVER_H
+#define LOCAL_WEBSOCKET_SERVER_H
+
+// Minimal stand-in for the Binance market streams, used by the unit tests. Replays recorded text frames
+// over wss:// on 127.0.0.1, one connection at a time, with the certificate of LocalTlsServer.
+
+#include "LocalTlsServer.h"
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <mutex>
+#include <vector>
+
+class LocalWebSocketServer
+{
+public:
+	// Every connection is pinged, then gets the recorded frames once the client's first message (its
+	// SUBSCRIBE) arrived. With dropAfter, a connection is cut without a close frame after that many
+	// frames, and the next one carries on with the frame after.
+	explicit LocalWebSocketServer(std::vector<std::string> frames, std::size_t dropAfter = 0)
+		: ctx(boost::asio::ssl::context::tls_server),
+		  acceptor(ioc, {boost::asio::ip::make_address("127.0.0.1"), 0}),
+		  frames(std::move(frames)),
+		  dropAfter(dropAfter)
+	{
+		ctx.use_certificate_chain(boost::asio::buffer(std::string(LocalTlsServer::kCertificate)));
+		ctx.use_private_key(boost::asio::buffer(std::string(LocalTlsServer::kPrivateKey)), boost::asio::ssl::context::pem);
+		worker = std::thread([this]
+							 { run(); });
+	}
+
+	~LocalWebSocketServer()
+	{
+		stopping = true;
+		// Unblock the read on the open connection, then wake the blocking accept
+		int fd = activeSocket.exchange(-1);
+		if (fd >= 0)
+		{
+			::shutdown(fd, SHUT_RDWR);
+		}
+		boost::system::error_code ec;
+		boost::asio::io_context wakeContext;
+		boost::asio::ip::tcp::socket wake(wakeContext);
+		wake.connect({boost::asio::ip::make_address("127.0.0.1"), port()}, ec);
+		worker.join();
+	}
+
+	unsigned short port() const { return acceptor.local_endpoint().port(); }
+	std::size_t connections() const { return connectionCount; }
+	std::size_t pongs() const { return pongCount; }
+	// First message of every connection, in order
+	std::vector<std::string> subscriptions() const
+	{
+		std::lock_guard<std::mutex> lock(subscriptionMutex);
+		return subscriptionList;
+	}
+
+private:
+	void run()
+	{
+		namespace websocket = boost::beast::websocket;
+		std::size_t next = 0;
+		while (!stopping)
+		{
+			boost::system::error_code ec;
+			boost::asio::ip::tcp::socket socket(ioc);
+			acceptor.accept(socket, ec);
+			if (ec || stopping)
+			{
+				continue;
+			}
+
+			websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> ws(std::move(socket), ctx);
+			activeSocket = ws.next_layer().next_layer().native_handle();
+			ws.next_layer().handshake(boost::asio::ssl::stream_base::server, ec);
+			if (!ec)
+			{
+				ws.accept(ec);
+			}
+			if (ec)
+			{
+				activeSocket = -1;
+				continue;
+			}
+			++connectionCount;
+			ws.control_callback([this](websocket::frame_type kind, boost::beast::string_view)
+								{
+									if (kind == websocket::frame_type::pong)
+									{
+										++pongCount;
+									} });
+
+			boost::beast::flat_buffer buffer;
+			ws.read(buffer, ec);
+			if (!ec)
+			{
+				std::lock_guard<std::mutex> lock(subscriptionMutex);
+				subscriptionList.push_back(boost::beast::buffers_to_string(buffer.data()));
+			}
+			buffer.consume(buffer.size());
+			ws.ping({}, ec);
+			ws.text(true);
+			bool dropped = false;
+			for (std::size_t sent = 0; !ec && next < frames.size(); ++sent)
+			{
+				if (dropAfter && sent == dropAfter)
+				{
+					dropped = true;
+					break;
+				}
+				ws.write(boost::asio::buffer(frames[next]), ec);
+				next += !ec;
+			}
+			// Reading takes the pong, until the client or the destructor ends the connection
+			while (!ec && !dropped)
+			{
+				ws.read(buffer, ec);
+				buffer.consume(buffer.size());
+			}
+			activeSocket = -1;
+			ws.next_layer().next_layer().close(ec);
+		}
+	}
+
+	boost::asio::io_context ioc;
+	boost::asio::ssl::context ctx;
+	boost::asio::ip::tcp::acceptor acceptor;
+	std::vector<std::string> frames;
+	std::size_t dropAfter;
+	std::thread worker;
+	std::atomic<bool> stopping{false};
+	std::atomic<int> activeSocket{-1};
+	std::atomic<std::size_t> connectionCount{0};
+	std::atomic<std::size_t> pongCount{0};
+	mutable std::mutex subscriptionMutex;
+	std::vector<std::string> subscriptionList;
+};
+
+#endif